@@ -0,0 +1,608 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <bzlib.h>
+#include <zlib.h>
+#include <zstd.h>
+
+#include "archive_file.h"
+
+#define ARCHIVE_FILE_MIN_ALLOCATION (16 * 1024 * 1024)
+
+//
+// zlib and bzip2 count input in unsigned int, bigger archives are fed in steps
+//
+#define ARCHIVE_FILE_MAX_INPUT_STEP (1024u * 1024 * 1024)
+
+//
+// Upper bound on the size hint taken from the archive header, so a damaged header
+// can't make the first allocation absurd
+//
+#define ARCHIVE_FILE_MAX_HINT_RATIO 64
+
+static void *archive_file_run(void *user_data);
+static int archive_file_decompress_zstd(ArchiveFile *file);
+static int archive_file_decompress_gzip(ArchiveFile *file);
+static int archive_file_decompress_bzip2(ArchiveFile *file);
+static ArchiveChunk *archive_file_acquire_chunk(ArchiveFile *file);
+static void archive_file_publish_chunk(ArchiveFile *file, size_t size);
+static size_t archive_file_size_hint(const ArchiveFile *file);
+static bool archive_file_reserve(ArchiveFile *file, size_t free_size);
+
+int archive_detect_format(const u8 *data, size_t size)
+{
+    if (size >= 4 && data[0] == 0x28 && data[1] == 0xB5 && data[2] == 0x2F && data[3] == 0xFD)
+    {
+        return ARCHIVE_FORMAT_ZSTD;
+    }
+    if (size >= 2 && data[0] == 0x1F && data[1] == 0x8B)
+    {
+        return ARCHIVE_FORMAT_GZIP;
+    }
+    if (size >= 3 && data[0] == 'B' && data[1] == 'Z' && data[2] == 'h')
+    {
+        return ARCHIVE_FORMAT_BZIP2;
+    }
+
+    return ARCHIVE_FORMAT_NONE;
+}
+
+const char *archive_format_to_string(int format)
+{
+    switch (format)
+    {
+    case ARCHIVE_FORMAT_ZSTD:
+        return "zstd";
+    case ARCHIVE_FORMAT_GZIP:
+        return "gzip";
+    case ARCHIVE_FORMAT_BZIP2:
+        return "bzip2";
+    default:
+        return "none";
+    }
+}
+
+int archive_file_open(ArchiveFile *file, const u8 *input, size_t input_size, int format, size_t window_size)
+{
+    memset(file, 0, sizeof(*file));
+    file->format = format;
+    file->input = input;
+    file->input_size = input_size;
+    file->window_size = window_size;
+
+    for (u32 i = 0; i < ARCHIVE_FILE_CHUNK_COUNT; i++)
+    {
+        file->chunks[i].data = (u8 *)malloc(ARCHIVE_FILE_CHUNK_SIZE);
+        if (!file->chunks[i].data)
+        {
+            for (u32 j = 0; j < i; j++)
+            {
+                free(file->chunks[j].data);
+            }
+            return ARCHIVE_FILE_RET_OOM;
+        }
+    }
+
+    //
+    // Reserving the decompressed size up front saves copying the demo on every doubling.
+    // When the allocation fails the buffer grows as usual
+    //
+    if (window_size > 0)
+    {
+        file->data = (u8 *)malloc(window_size);
+        if (!file->data)
+        {
+            for (u32 i = 0; i < ARCHIVE_FILE_CHUNK_COUNT; i++)
+            {
+                free(file->chunks[i].data);
+            }
+            return ARCHIVE_FILE_RET_OOM;
+        }
+        file->data_capacity = window_size;
+    }
+    else
+    {
+        const size_t size_hint = archive_file_size_hint(file);
+        if (size_hint > ARCHIVE_FILE_MIN_ALLOCATION)
+        {
+            file->data = (u8 *)malloc(size_hint);
+            file->data_capacity = (file->data) ? size_hint : 0;
+        }
+    }
+
+    pthread_mutex_init(&file->mutex, nullptr);
+    pthread_cond_init(&file->chunk_ready, nullptr);
+    pthread_cond_init(&file->chunk_free, nullptr);
+
+    if (pthread_create(&file->thread, nullptr, archive_file_run, file) != 0)
+    {
+        pthread_cond_destroy(&file->chunk_free);
+        pthread_cond_destroy(&file->chunk_ready);
+        pthread_mutex_destroy(&file->mutex);
+        for (u32 i = 0; i < ARCHIVE_FILE_CHUNK_COUNT; i++)
+        {
+            free(file->chunks[i].data);
+        }
+        free(file->data);
+        return ARCHIVE_FILE_RET_THREAD_ERROR;
+    }
+
+    return ARCHIVE_FILE_RET_OK;
+}
+
+void archive_file_close(ArchiveFile *file)
+{
+    pthread_mutex_lock(&file->mutex);
+    file->shutdown = true;
+    pthread_cond_broadcast(&file->chunk_free);
+    pthread_mutex_unlock(&file->mutex);
+
+    pthread_join(file->thread, nullptr);
+
+    pthread_cond_destroy(&file->chunk_free);
+    pthread_cond_destroy(&file->chunk_ready);
+    pthread_mutex_destroy(&file->mutex);
+
+    for (u32 i = 0; i < ARCHIVE_FILE_CHUNK_COUNT; i++)
+    {
+        free(file->chunks[i].data);
+        file->chunks[i].data = nullptr;
+    }
+
+    free(file->data);
+    file->data = nullptr;
+    file->data_size = 0;
+    file->data_capacity = 0;
+}
+
+int archive_file_read(ArchiveFile *file)
+{
+    while (true)
+    {
+        pthread_mutex_lock(&file->mutex);
+        const u32 chunk_count = file->chunk_count;
+        const u32 chunk_index = file->chunk_head;
+        const bool is_finished = file->is_finished;
+        const int result = file->result;
+        pthread_mutex_unlock(&file->mutex);
+
+        if (chunk_count == 0)
+        {
+            if (!is_finished)
+            {
+                return ARCHIVE_FILE_RET_OK;
+            }
+            return (result == ARCHIVE_FILE_RET_OK) ? ARCHIVE_FILE_RET_END : result;
+        }
+
+        //
+        // The decompression thread doesn't touch a published chunk, it's copied unlocked
+        //
+        const ArchiveChunk *chunk = &file->chunks[chunk_index];
+        const size_t remaining_size = chunk->size - file->chunk_offset;
+        size_t copy_size = remaining_size;
+        if (file->window_size > 0)
+        {
+            copy_size = (remaining_size < file->data_capacity - file->data_size) ? remaining_size : file->data_capacity - file->data_size;
+        }
+        else if (!archive_file_reserve(file, copy_size))
+        {
+            return ARCHIVE_FILE_RET_OOM;
+        }
+        memcpy(file->data + file->data_size, chunk->data + file->chunk_offset, copy_size);
+        file->data_size += copy_size;
+
+        //
+        // The rest of the chunk waits for the window to have room again
+        //
+        if (copy_size < remaining_size)
+        {
+            file->chunk_offset += copy_size;
+            return ARCHIVE_FILE_RET_OK;
+        }
+        file->chunk_offset = 0;
+
+        pthread_mutex_lock(&file->mutex);
+        file->chunk_head = (file->chunk_head + 1) % ARCHIVE_FILE_CHUNK_COUNT;
+        file->chunk_count--;
+        pthread_cond_signal(&file->chunk_free);
+        pthread_mutex_unlock(&file->mutex);
+    }
+}
+
+void archive_file_discard(ArchiveFile *file, size_t size)
+{
+    memmove(file->data, file->data + size, file->data_size - size);
+    file->data_size -= size;
+    file->data_offset += size;
+}
+
+void archive_file_wait(ArchiveFile *file)
+{
+    pthread_mutex_lock(&file->mutex);
+    while (file->chunk_count == 0 && !file->is_finished)
+    {
+        pthread_cond_wait(&file->chunk_ready, &file->mutex);
+    }
+    pthread_mutex_unlock(&file->mutex);
+}
+
+u8 *archive_file_take_data(ArchiveFile *file, size_t *out_size)
+{
+    u8 *data = file->data;
+    *out_size = file->data_size;
+
+    file->data = nullptr;
+    file->data_size = 0;
+    file->data_capacity = 0;
+
+    return data;
+}
+
+static void *archive_file_run(void *user_data)
+{
+    ArchiveFile *file = (ArchiveFile *)user_data;
+
+    int ret_code;
+    switch (file->format)
+    {
+    case ARCHIVE_FORMAT_ZSTD:
+        ret_code = archive_file_decompress_zstd(file);
+        break;
+    case ARCHIVE_FORMAT_GZIP:
+        ret_code = archive_file_decompress_gzip(file);
+        break;
+    case ARCHIVE_FORMAT_BZIP2:
+        ret_code = archive_file_decompress_bzip2(file);
+        break;
+    default:
+        ret_code = ARCHIVE_FILE_RET_CORRUPT;
+        break;
+    }
+
+    pthread_mutex_lock(&file->mutex);
+    file->result = ret_code;
+    file->is_finished = true;
+    pthread_cond_broadcast(&file->chunk_ready);
+    pthread_mutex_unlock(&file->mutex);
+
+    return nullptr;
+}
+
+//
+// Skippable frames and several frames back to back (zstd -T, concatenated files) are
+// handled by the zstd stream itself
+//
+static int archive_file_decompress_zstd(ArchiveFile *file)
+{
+    ZSTD_DStream *stream = ZSTD_createDStream();
+    if (!stream)
+    {
+        return ARCHIVE_FILE_RET_OOM;
+    }
+
+    ZSTD_inBuffer input = { file->input, file->input_size, 0 };
+    //
+    // Zero once the last frame was decoded and flushed completely
+    //
+    size_t frame_ret = 1;
+    int ret_code = ARCHIVE_FILE_RET_OK;
+
+    while (true)
+    {
+        ArchiveChunk *chunk = archive_file_acquire_chunk(file);
+        if (!chunk)
+        {
+            break;
+        }
+
+        ZSTD_outBuffer output = { chunk->data, ARCHIVE_FILE_CHUNK_SIZE, 0 };
+        while (output.pos < output.size)
+        {
+            frame_ret = ZSTD_decompressStream(stream, &output, &input);
+            if (ZSTD_isError(frame_ret))
+            {
+                ret_code = ARCHIVE_FILE_RET_CORRUPT;
+                break;
+            }
+            //
+            // With all input consumed and room left, everything decoded was flushed
+            //
+            if (input.pos == input.size && output.pos < output.size)
+            {
+                break;
+            }
+        }
+
+        archive_file_publish_chunk(file, output.pos);
+
+        if (ret_code != ARCHIVE_FILE_RET_OK)
+        {
+            break;
+        }
+        if (input.pos == input.size && output.pos < output.size)
+        {
+            ret_code = (frame_ret == 0) ? ARCHIVE_FILE_RET_OK : ARCHIVE_FILE_RET_CORRUPT;
+            break;
+        }
+    }
+
+    ZSTD_freeDStream(stream);
+
+    return ret_code;
+}
+
+//
+// Concatenated gzip members (pigz, appended archives) are decompressed one after the other
+//
+static int archive_file_decompress_gzip(ArchiveFile *file)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+    {
+        return ARCHIVE_FILE_RET_OOM;
+    }
+
+    size_t input_pos = 0;
+    bool is_member_complete = false;
+    int ret_code = ARCHIVE_FILE_RET_OK;
+
+    while (true)
+    {
+        ArchiveChunk *chunk = archive_file_acquire_chunk(file);
+        if (!chunk)
+        {
+            break;
+        }
+
+        stream.next_out = chunk->data;
+        stream.avail_out = ARCHIVE_FILE_CHUNK_SIZE;
+        bool is_input_done = false;
+
+        while (stream.avail_out > 0)
+        {
+            if (stream.avail_in == 0)
+            {
+                if (input_pos == file->input_size)
+                {
+                    is_input_done = true;
+                    break;
+                }
+                const size_t step = file->input_size - input_pos;
+                stream.next_in = (Bytef *)(file->input + input_pos);
+                stream.avail_in = (uInt)((step < ARCHIVE_FILE_MAX_INPUT_STEP) ? step : ARCHIVE_FILE_MAX_INPUT_STEP);
+                input_pos += stream.avail_in;
+            }
+
+            const int inflate_ret = inflate(&stream, Z_NO_FLUSH);
+            if (inflate_ret == Z_STREAM_END)
+            {
+                is_member_complete = true;
+                if (stream.avail_in > 0 || input_pos < file->input_size)
+                {
+                    inflateReset(&stream);
+                    is_member_complete = false;
+                }
+                continue;
+            }
+            if (inflate_ret != Z_OK)
+            {
+                ret_code = (inflate_ret == Z_MEM_ERROR) ? ARCHIVE_FILE_RET_OOM : ARCHIVE_FILE_RET_CORRUPT;
+                break;
+            }
+        }
+
+        archive_file_publish_chunk(file, ARCHIVE_FILE_CHUNK_SIZE - stream.avail_out);
+
+        if (ret_code != ARCHIVE_FILE_RET_OK)
+        {
+            break;
+        }
+        if (is_input_done)
+        {
+            ret_code = (is_member_complete) ? ARCHIVE_FILE_RET_OK : ARCHIVE_FILE_RET_CORRUPT;
+            break;
+        }
+    }
+
+    inflateEnd(&stream);
+
+    return ret_code;
+}
+
+//
+// Multi-stream archives (pbzip2, lbzip2) are decompressed one stream after the other
+//
+static int archive_file_decompress_bzip2(ArchiveFile *file)
+{
+    bz_stream stream;
+    memset(&stream, 0, sizeof(stream));
+
+    if (BZ2_bzDecompressInit(&stream, 0, 0) != BZ_OK)
+    {
+        return ARCHIVE_FILE_RET_OOM;
+    }
+
+    size_t input_pos = 0;
+    bool is_stream_complete = false;
+    bool is_stream_open = true;
+    int ret_code = ARCHIVE_FILE_RET_OK;
+
+    while (true)
+    {
+        ArchiveChunk *chunk = archive_file_acquire_chunk(file);
+        if (!chunk)
+        {
+            break;
+        }
+
+        stream.next_out = (char *)chunk->data;
+        stream.avail_out = ARCHIVE_FILE_CHUNK_SIZE;
+        bool is_input_done = false;
+
+        while (stream.avail_out > 0)
+        {
+            if (stream.avail_in == 0)
+            {
+                if (input_pos == file->input_size)
+                {
+                    is_input_done = true;
+                    break;
+                }
+                const size_t step = file->input_size - input_pos;
+                stream.next_in = (char *)(file->input + input_pos);
+                stream.avail_in = (unsigned int)((step < ARCHIVE_FILE_MAX_INPUT_STEP) ? step : ARCHIVE_FILE_MAX_INPUT_STEP);
+                input_pos += stream.avail_in;
+            }
+
+            const int decompress_ret = BZ2_bzDecompress(&stream);
+            if (decompress_ret == BZ_STREAM_END)
+            {
+                is_stream_complete = true;
+                if (stream.avail_in > 0 || input_pos < file->input_size)
+                {
+                    //
+                    // bzip2 has no reset, the next stream gets a fresh decoder
+                    //
+                    char *next_in = stream.next_in;
+                    const unsigned int avail_in = stream.avail_in;
+                    char *next_out = stream.next_out;
+                    const unsigned int avail_out = stream.avail_out;
+
+                    BZ2_bzDecompressEnd(&stream);
+                    memset(&stream, 0, sizeof(stream));
+                    if (BZ2_bzDecompressInit(&stream, 0, 0) != BZ_OK)
+                    {
+                        is_stream_open = false;
+                        ret_code = ARCHIVE_FILE_RET_OOM;
+                        break;
+                    }
+                    stream.next_in = next_in;
+                    stream.avail_in = avail_in;
+                    stream.next_out = next_out;
+                    stream.avail_out = avail_out;
+                    is_stream_complete = false;
+                }
+                continue;
+            }
+            if (decompress_ret != BZ_OK)
+            {
+                ret_code = (decompress_ret == BZ_MEM_ERROR) ? ARCHIVE_FILE_RET_OOM : ARCHIVE_FILE_RET_CORRUPT;
+                break;
+            }
+        }
+
+        archive_file_publish_chunk(file, ARCHIVE_FILE_CHUNK_SIZE - stream.avail_out);
+
+        if (ret_code != ARCHIVE_FILE_RET_OK)
+        {
+            break;
+        }
+        if (is_input_done)
+        {
+            ret_code = (is_stream_complete) ? ARCHIVE_FILE_RET_OK : ARCHIVE_FILE_RET_CORRUPT;
+            break;
+        }
+    }
+
+    if (is_stream_open)
+    {
+        BZ2_bzDecompressEnd(&stream);
+    }
+
+    return ret_code;
+}
+
+//
+// Blocks until a chunk is free to decompress into, nullptr when the file is closed
+//
+static ArchiveChunk *archive_file_acquire_chunk(ArchiveFile *file)
+{
+    pthread_mutex_lock(&file->mutex);
+    while (file->chunk_count == ARCHIVE_FILE_CHUNK_COUNT && !file->shutdown)
+    {
+        pthread_cond_wait(&file->chunk_free, &file->mutex);
+    }
+
+    ArchiveChunk *chunk = nullptr;
+    if (!file->shutdown)
+    {
+        chunk = &file->chunks[(file->chunk_head + file->chunk_count) % ARCHIVE_FILE_CHUNK_COUNT];
+    }
+    pthread_mutex_unlock(&file->mutex);
+
+    return chunk;
+}
+
+//
+// Hands the chunk from archive_file_acquire_chunk to the parsing thread
+//
+static void archive_file_publish_chunk(ArchiveFile *file, size_t size)
+{
+    if (size == 0)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&file->mutex);
+    file->chunks[(file->chunk_head + file->chunk_count) % ARCHIVE_FILE_CHUNK_COUNT].size = size;
+    file->chunk_count++;
+    pthread_cond_signal(&file->chunk_ready);
+    pthread_mutex_unlock(&file->mutex);
+}
+
+//
+// Decompressed size as recorded by the archive, 0 when it doesn't say. zstd frames may
+// carry the content size, gzip stores it modulo 4 GiB in the last four bytes
+//
+static size_t archive_file_size_hint(const ArchiveFile *file)
+{
+    u64 size = 0;
+
+    if (file->format == ARCHIVE_FORMAT_ZSTD)
+    {
+        const unsigned long long content_size = ZSTD_getFrameContentSize(file->input, file->input_size);
+        if (content_size != ZSTD_CONTENTSIZE_UNKNOWN && content_size != ZSTD_CONTENTSIZE_ERROR)
+        {
+            size = content_size;
+        }
+    }
+    else if (file->format == ARCHIVE_FORMAT_GZIP && file->input_size >= 18)
+    {
+        const u8 *trailer = file->input + file->input_size - 4;
+        size = (u64)trailer[0] | ((u64)trailer[1] << 8) | ((u64)trailer[2] << 16) | ((u64)trailer[3] << 24);
+    }
+
+    if (size > (u64)file->input_size * ARCHIVE_FILE_MAX_HINT_RATIO)
+    {
+        return 0;
+    }
+
+    return (size_t)size;
+}
+
+static bool archive_file_reserve(ArchiveFile *file, size_t free_size)
+{
+    if (file->data_capacity - file->data_size >= free_size)
+    {
+        return true;
+    }
+
+    size_t new_capacity = (file->data_capacity) ? file->data_capacity * 2 : ARCHIVE_FILE_MIN_ALLOCATION;
+    while (new_capacity - file->data_size < free_size)
+    {
+        new_capacity *= 2;
+    }
+
+    u8 *data = (u8 *)realloc(file->data, new_capacity);
+    if (!data)
+    {
+        return false;
+    }
+
+    file->data = data;
+    file->data_capacity = new_capacity;
+    return true;
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+//
+// Decompresses a demo stored as .dem.zst, .dem.gz or .dem.bz2, recognised by the magic
+// bytes of the container rather than the file name. A decompression thread inflates the
+// archive into a small ring of fixed chunks while the parsing thread appends the
+// finished chunks to one growing heap buffer, so the raw demo never touches the disk and
+// decompression overlaps with parsing. The buffer belongs to the parsing thread alone,
+// the decompression thread never sees it move.
+//
+// With a window the buffer is allocated once at that size instead. Chunks are only
+// appended while there's room, the caller discards what it parsed to make more.
+//
+
+#include <pthread.h>
+
+#include "common.h"
+
+#define ARCHIVE_FORMAT_NONE 0
+#define ARCHIVE_FORMAT_ZSTD 1
+#define ARCHIVE_FORMAT_GZIP 2
+#define ARCHIVE_FORMAT_BZIP2 3
+
+#define ARCHIVE_FILE_RET_OK 0
+#define ARCHIVE_FILE_RET_OOM 1
+#define ARCHIVE_FILE_RET_THREAD_ERROR 2
+//
+// The archive is damaged or ends in the middle of a compressed block
+//
+#define ARCHIVE_FILE_RET_CORRUPT 3
+//
+// Everything was decompressed and appended, nothing more will arrive
+//
+#define ARCHIVE_FILE_RET_END 4
+
+//
+// Decompressed bytes per chunk, and chunks the decompression thread may run ahead
+//
+#define ARCHIVE_FILE_CHUNK_SIZE (4 * 1024 * 1024)
+#define ARCHIVE_FILE_CHUNK_COUNT 4
+
+typedef struct
+{
+    u8 *data;
+    size_t size;
+} ArchiveChunk;
+
+typedef struct
+{
+    int format;
+    const u8 *input;
+    size_t input_size;
+
+    //
+    // Chunks [chunk_head, chunk_head + chunk_count) are filled and wait to be appended,
+    // the decompression thread only writes to the others
+    //
+    ArchiveChunk chunks[ARCHIVE_FILE_CHUNK_COUNT];
+    u32 chunk_head;
+    u32 chunk_count;
+    //
+    // Set by the decompression thread once it stopped, result is ARCHIVE_FILE_RET_OK
+    // when the whole archive was decompressed
+    //
+    bool is_finished;
+    int result;
+    bool shutdown;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t chunk_ready;
+    pthread_cond_t chunk_free;
+    pthread_t thread;
+
+    //
+    // Parsing thread only
+    //
+    u8 *data;
+    size_t data_size;
+    size_t data_capacity;
+    //
+    // 0 to grow data with the demo. Offset of data in the demo once bytes were
+    // discarded, and bytes of the head chunk already appended to a full window
+    //
+    size_t window_size;
+    u64 data_offset;
+    size_t chunk_offset;
+} ArchiveFile;
+
+//
+// ARCHIVE_FORMAT_NONE when data doesn't start like one of the supported containers
+//
+int archive_detect_format(const u8 *data, size_t size);
+const char *archive_format_to_string(int format);
+
+//
+// Starts decompressing input on a new thread. input has to stay valid until
+// archive_file_close. window_size 0 keeps the whole demo in data
+//
+int archive_file_open(ArchiveFile *file, const u8 *input, size_t input_size, int format, size_t window_size);
+
+//
+// Stops the decompression thread and frees the buffers, data included unless it was
+// taken with archive_file_take_data
+//
+void archive_file_close(ArchiveFile *file);
+
+//
+// Appends the chunks decompressed since the last call, without blocking. data may move.
+// Returns ARCHIVE_FILE_RET_END once the archive is drained, or the error that stopped it
+//
+int archive_file_read(ArchiveFile *file);
+
+//
+// Drops the first size bytes of data, moving the rest to the front
+//
+void archive_file_discard(ArchiveFile *file, size_t size);
+
+//
+// Blocks until a chunk was decompressed or decompression stopped
+//
+void archive_file_wait(ArchiveFile *file);
+
+//
+// Hands the decompressed buffer to the caller, who frees it
+//
+u8 *archive_file_take_data(ArchiveFile *file, size_t *out_size);
@@ -0,0 +1,127 @@
+#include <stdlib.h>
+
+#include "arena.h"
+
+static ArenaBlock *arena_push_block(Arena *arena, size_t min_size);
+static void *arena_protobuf_alloc(void *allocator_data, size_t size);
+static void arena_protobuf_free(void *allocator_data, void *pointer);
+
+void arena_init(Arena *arena, size_t block_size)
+{
+    arena->blocks = nullptr;
+    arena->block_size = block_size;
+    arena->used = 0;
+    arena->peak_used = 0;
+    arena->reserved = 0;
+    arena->block_allocations = 0;
+}
+
+static ArenaBlock *arena_push_block(Arena *arena, size_t min_size)
+{
+    const size_t size = (min_size > arena->block_size) ? min_size : arena->block_size;
+    ArenaBlock *block = (ArenaBlock *)malloc(sizeof(ArenaBlock) + size);
+    if (!block)
+    {
+        return nullptr;
+    }
+
+    block->next = arena->blocks;
+    block->size = size;
+    block->used = 0;
+
+    arena->blocks = block;
+    arena->reserved += size;
+    arena->block_allocations++;
+
+    return block;
+}
+
+void *arena_alloc(Arena *arena, size_t size)
+{
+    const size_t aligned_size = (size + (ARENA_ALIGNMENT - 1)) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+    ArenaBlock *block = arena->blocks;
+    if (!block || block->size - block->used < aligned_size)
+    {
+        block = arena_push_block(arena, aligned_size);
+        if (!block)
+        {
+            return nullptr;
+        }
+    }
+
+    void *result = block->data + block->used;
+    block->used += aligned_size;
+
+    arena->used += aligned_size;
+    if (arena->used > arena->peak_used)
+    {
+        arena->peak_used = arena->used;
+    }
+
+    return result;
+}
+
+void arena_reset(Arena *arena)
+{
+    ArenaBlock *block = arena->blocks;
+
+    if (block && block->next)
+    {
+        //
+        // Outgrew a single block. Replace them all with one that fits the high water mark
+        //
+        const size_t new_block_size = (arena->peak_used > arena->block_size) ? arena->peak_used : arena->block_size;
+        arena_free(arena);
+        arena->block_size = new_block_size;
+        arena_push_block(arena, new_block_size);
+        arena->used = 0;
+        return;
+    }
+
+    if (block)
+    {
+        block->used = 0;
+    }
+
+    arena->used = 0;
+}
+
+void arena_free(Arena *arena)
+{
+    ArenaBlock *block = arena->blocks;
+    while (block)
+    {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    arena->blocks = nullptr;
+    arena->used = 0;
+    arena->reserved = 0;
+}
+
+static void *arena_protobuf_alloc(void *allocator_data, size_t size)
+{
+    return arena_alloc((Arena *)allocator_data, size);
+}
+
+static void arena_protobuf_free(void *allocator_data, void *pointer)
+{
+    //
+    // Released in bulk by arena_reset
+    //
+    UNUSED(allocator_data);
+    UNUSED(pointer);
+}
+
+ProtobufCAllocator arena_protobuf_allocator(Arena *arena)
+{
+    ProtobufCAllocator allocator = {
+        .alloc = arena_protobuf_alloc,
+        .free = arena_protobuf_free,
+        .allocator_data = arena,
+    };
+    return allocator;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+//
+// Bump allocator. Allocations are carved out of large blocks and released all at once
+// with arena_reset, which is what protobuf-c messages decoded for a single frame want.
+// Also exposed as a ProtobufCAllocator so *__unpack calls can use it directly.
+//
+
+#include <stdalign.h>
+
+#include <protobuf-c/protobuf-c.h>
+
+#include "common.h"
+
+#define ARENA_ALIGNMENT 16
+
+typedef struct ArenaBlock
+{
+    struct ArenaBlock *next;
+    size_t size;
+    size_t used;
+    alignas(ARENA_ALIGNMENT) u8 data[];
+} ArenaBlock;
+
+typedef struct
+{
+    //
+    // Block currently being allocated from, older blocks follow through next
+    //
+    ArenaBlock *blocks;
+    size_t block_size;
+    //
+    // Bytes handed out since the last reset, and the most ever handed out between resets
+    //
+    size_t used;
+    size_t peak_used;
+    //
+    // Bytes held in blocks
+    //
+    size_t reserved;
+    u32 block_allocations;
+} Arena;
+
+void arena_init(Arena *arena, size_t block_size);
+void *arena_alloc(Arena *arena, size_t size);
+//
+// Releases every allocation. Keeps a single block big enough for everything that was
+// allocated since the previous reset, so steady state resets never touch malloc
+//
+void arena_reset(Arena *arena);
+void arena_free(Arena *arena);
+
+ProtobufCAllocator arena_protobuf_allocator(Arena *arena);
@@ -0,0 +1,558 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "arrow_export.h"
+
+#define FRAME_COLUMN_TICK 0
+#define FRAME_COLUMN_COMMAND 1
+#define FRAME_COLUMN_COMPRESSED 2
+#define FRAME_COLUMN_STORED_SIZE 3
+#define FRAME_COLUMN_SIZE 4
+#define FRAME_COLUMN_END_OFFSET 5
+
+#define MESSAGE_COLUMN_TICK 0
+#define MESSAGE_COLUMN_ID 1
+#define MESSAGE_COLUMN_SIZE 2
+
+#define GAME_EVENT_COLUMN_TICK 0
+#define GAME_EVENT_COLUMN_SEQUENCE 1
+#define GAME_EVENT_COLUMN_NAME 2
+#define GAME_EVENT_COLUMN_KEY 3
+#define GAME_EVENT_COLUMN_STRING 4
+#define GAME_EVENT_COLUMN_FLOAT 5
+#define GAME_EVENT_COLUMN_INT 6
+#define GAME_EVENT_COLUMN_BOOL 7
+#define GAME_EVENT_COLUMN_UINT64 8
+
+#define ENTITY_COLUMN_TICK 0
+#define ENTITY_COLUMN_INDEX 1
+#define ENTITY_COLUMN_CLASS 2
+#define ENTITY_COLUMN_EVENT 3
+#define ENTITY_COLUMN_FIELD 4
+#define ENTITY_COLUMN_BOOL 5
+#define ENTITY_COLUMN_INT 6
+#define ENTITY_COLUMN_UINT 7
+#define ENTITY_COLUMN_FLOAT 8
+#define ENTITY_COLUMN_STRING 9
+#define ENTITY_COLUMN_X 10
+#define ENTITY_COLUMN_Y 11
+#define ENTITY_COLUMN_Z 12
+
+static const ArrowField frame_fields[] = {
+    [FRAME_COLUMN_TICK] = { "tick", ARROW_TYPE_UINT32, false },
+    [FRAME_COLUMN_COMMAND] = { "command", ARROW_TYPE_UINT8, false },
+    [FRAME_COLUMN_COMPRESSED] = { "compressed", ARROW_TYPE_BOOL, false },
+    [FRAME_COLUMN_STORED_SIZE] = { "stored_size", ARROW_TYPE_UINT32, false },
+    [FRAME_COLUMN_SIZE] = { "size", ARROW_TYPE_UINT32, false },
+    [FRAME_COLUMN_END_OFFSET] = { "end_offset", ARROW_TYPE_UINT64, false },
+};
+
+static const ArrowField message_fields[] = {
+    [MESSAGE_COLUMN_TICK] = { "tick", ARROW_TYPE_UINT32, false },
+    [MESSAGE_COLUMN_ID] = { "message_id", ARROW_TYPE_UINT32, false },
+    [MESSAGE_COLUMN_SIZE] = { "size", ARROW_TYPE_UINT32, false },
+};
+
+static const ArrowField game_event_fields[] = {
+    [GAME_EVENT_COLUMN_TICK] = { "tick", ARROW_TYPE_UINT32, false },
+    [GAME_EVENT_COLUMN_SEQUENCE] = { "sequence", ARROW_TYPE_UINT64, false },
+    [GAME_EVENT_COLUMN_NAME] = { "name", ARROW_TYPE_UTF8, false },
+    [GAME_EVENT_COLUMN_KEY] = { "key", ARROW_TYPE_UTF8, true },
+    [GAME_EVENT_COLUMN_STRING] = { "string_value", ARROW_TYPE_UTF8, true },
+    [GAME_EVENT_COLUMN_FLOAT] = { "float_value", ARROW_TYPE_FLOAT32, true },
+    [GAME_EVENT_COLUMN_INT] = { "int_value", ARROW_TYPE_INT32, true },
+    [GAME_EVENT_COLUMN_BOOL] = { "bool_value", ARROW_TYPE_BOOL, true },
+    [GAME_EVENT_COLUMN_UINT64] = { "uint64_value", ARROW_TYPE_UINT64, true },
+};
+
+static const ArrowField entity_fields[] = {
+    [ENTITY_COLUMN_TICK] = { "tick", ARROW_TYPE_UINT32, false },
+    [ENTITY_COLUMN_INDEX] = { "entity_index", ARROW_TYPE_UINT32, false },
+    [ENTITY_COLUMN_CLASS] = { "class", ARROW_TYPE_UTF8, false },
+    [ENTITY_COLUMN_EVENT] = { "event", ARROW_TYPE_UINT8, false },
+    [ENTITY_COLUMN_FIELD] = { "field", ARROW_TYPE_UTF8, true },
+    [ENTITY_COLUMN_BOOL] = { "bool_value", ARROW_TYPE_BOOL, true },
+    [ENTITY_COLUMN_INT] = { "int_value", ARROW_TYPE_INT64, true },
+    [ENTITY_COLUMN_UINT] = { "uint_value", ARROW_TYPE_UINT64, true },
+    [ENTITY_COLUMN_FLOAT] = { "float_value", ARROW_TYPE_FLOAT32, true },
+    [ENTITY_COLUMN_STRING] = { "string_value", ARROW_TYPE_UTF8, true },
+    [ENTITY_COLUMN_X] = { "x", ARROW_TYPE_FLOAT32, true },
+    [ENTITY_COLUMN_Y] = { "y", ARROW_TYPE_FLOAT32, true },
+    [ENTITY_COLUMN_Z] = { "z", ARROW_TYPE_FLOAT32, true },
+};
+
+static const char *table_names[ARROW_EXPORT_TABLE_COUNT] = {
+    [ARROW_EXPORT_TABLE_FRAMES] = "frames.arrow",
+    [ARROW_EXPORT_TABLE_MESSAGES] = "messages.arrow",
+    [ARROW_EXPORT_TABLE_GAME_EVENTS] = "game_events.arrow",
+    [ARROW_EXPORT_TABLE_ENTITIES] = "entities.arrow",
+};
+
+static void arrow_export_free_classes(ArrowExport *arrow_export);
+static int arrow_export_end_row(ArrowExport *arrow_export, u32 table);
+static void arrow_export_frame(ArrowExport *arrow_export, const DemoEvent *event);
+static void arrow_export_message(ArrowExport *arrow_export, const DemoEvent *event);
+static void arrow_export_game_event(ArrowExport *arrow_export, const DemoEvent *event);
+static void arrow_export_entity(ArrowExport *arrow_export, const DemoEvent *event);
+static void arrow_export_keyframe(ArrowExport *arrow_export, u32 tick);
+static int arrow_export_entity_row(ArrowExport *arrow_export, u32 tick, u32 entity_index, const EntityClass *entity_class, u32 event, const ArrowExportColumn *column, u32 row);
+static const ArrowExportClass *arrow_export_class(ArrowExport *arrow_export, const EntityClass *entity_class);
+static void arrow_export_add_column(void *user_data, const char *name, u32 column, const FieldDecoder *decoder);
+static void arrow_export_entity_value(ArrowWriter *writer, const EntityValue *value, const FieldDecoder *decoder);
+
+int arrow_export_open(ArrowExport *arrow_export, const char *directory, u32 batch_rows, u32 entity_mode, const EntityEngine *entities)
+{
+    memset(arrow_export, 0, sizeof(*arrow_export));
+    arrow_export->entity_mode = entity_mode;
+    arrow_export->entities = entities;
+
+    static const ArrowField *table_fields[ARROW_EXPORT_TABLE_COUNT] = {
+        [ARROW_EXPORT_TABLE_FRAMES] = frame_fields,
+        [ARROW_EXPORT_TABLE_MESSAGES] = message_fields,
+        [ARROW_EXPORT_TABLE_GAME_EVENTS] = game_event_fields,
+        [ARROW_EXPORT_TABLE_ENTITIES] = entity_fields,
+    };
+    static const u32 table_field_counts[ARROW_EXPORT_TABLE_COUNT] = {
+        [ARROW_EXPORT_TABLE_FRAMES] = sizeof(frame_fields) / sizeof(frame_fields[0]),
+        [ARROW_EXPORT_TABLE_MESSAGES] = sizeof(message_fields) / sizeof(message_fields[0]),
+        [ARROW_EXPORT_TABLE_GAME_EVENTS] = sizeof(game_event_fields) / sizeof(game_event_fields[0]),
+        [ARROW_EXPORT_TABLE_ENTITIES] = sizeof(entity_fields) / sizeof(entity_fields[0]),
+    };
+
+    for (u32 table = 0; table < ARROW_EXPORT_TABLE_COUNT; table++)
+    {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", directory, table_names[table]);
+
+        const int ret_code = arrow_writer_open(&arrow_export->tables[table], path, table_fields[table], table_field_counts[table], batch_rows);
+        if (ret_code != ARROW_WRITER_RET_OK)
+        {
+            for (u32 i = 0; i < table; i++)
+            {
+                arrow_writer_close(&arrow_export->tables[i]);
+            }
+            return (ret_code == ARROW_WRITER_RET_OOM) ? ARROW_EXPORT_RET_OOM : ARROW_EXPORT_RET_IO_ERROR;
+        }
+    }
+
+    return ARROW_EXPORT_RET_OK;
+}
+
+int arrow_export_close(ArrowExport *arrow_export)
+{
+    for (u32 table = 0; table < ARROW_EXPORT_TABLE_COUNT; table++)
+    {
+        const int ret_code = arrow_writer_close(&arrow_export->tables[table]);
+        if (ret_code != ARROW_WRITER_RET_OK && arrow_export->error == ARROW_EXPORT_RET_OK)
+        {
+            arrow_export->error = (ret_code == ARROW_WRITER_RET_OOM) ? ARROW_EXPORT_RET_OOM : ARROW_EXPORT_RET_IO_ERROR;
+        }
+    }
+
+    arrow_export_free_classes(arrow_export);
+
+    return arrow_export->error;
+}
+
+static void arrow_export_free_classes(ArrowExport *arrow_export)
+{
+    for (u32 i = 0; i < arrow_export->class_count; i++)
+    {
+        ArrowExportClass *export_class = &arrow_export->classes[i];
+        for (u32 c = 0; c < export_class->column_count; c++)
+        {
+            free(export_class->columns[c].name);
+        }
+        free(export_class->columns);
+        free(export_class->column_lookup);
+    }
+    free(arrow_export->classes);
+    arrow_export->classes = nullptr;
+    arrow_export->class_count = 0;
+}
+
+int arrow_export_event(void *user_data, const DemoEvent *event)
+{
+    ArrowExport *arrow_export = (ArrowExport *)user_data;
+
+    switch (event->kind)
+    {
+    case DEMO_EVENT_FRAME:
+        arrow_export_frame(arrow_export, event);
+        break;
+    case DEMO_EVENT_NET_MESSAGE:
+        arrow_export_message(arrow_export, event);
+        break;
+    case DEMO_EVENT_GAME_EVENT:
+        arrow_export_game_event(arrow_export, event);
+        break;
+    case DEMO_EVENT_FULL_PACKET_END:
+        if (arrow_export->entity_mode == ARROW_EXPORT_ENTITIES_CHANGES && arrow_export->entities)
+        {
+            arrow_export_keyframe(arrow_export, event->tick);
+        }
+        break;
+    case DEMO_EVENT_ENTITY:
+        arrow_export_entity(arrow_export, event);
+        break;
+    default:
+        break;
+    }
+
+    return (arrow_export->error != ARROW_EXPORT_RET_OK) ? 1 : 0;
+}
+
+static int arrow_export_end_row(ArrowExport *arrow_export, u32 table)
+{
+    const int ret_code = arrow_writer_end_row(&arrow_export->tables[table]);
+    if (ret_code != ARROW_WRITER_RET_OK && arrow_export->error == ARROW_EXPORT_RET_OK)
+    {
+        arrow_export->error = (ret_code == ARROW_WRITER_RET_OOM) ? ARROW_EXPORT_RET_OOM : ARROW_EXPORT_RET_IO_ERROR;
+    }
+    return ret_code;
+}
+
+static void arrow_export_frame(ArrowExport *arrow_export, const DemoEvent *event)
+{
+    ArrowWriter *writer = &arrow_export->tables[ARROW_EXPORT_TABLE_FRAMES];
+    arrow_writer_set_uint(writer, FRAME_COLUMN_TICK, event->tick);
+    arrow_writer_set_uint(writer, FRAME_COLUMN_COMMAND, event->frame.command);
+    arrow_writer_set_bool(writer, FRAME_COLUMN_COMPRESSED, event->frame.is_compressed);
+    arrow_writer_set_uint(writer, FRAME_COLUMN_STORED_SIZE, event->frame.stored_size);
+    arrow_writer_set_uint(writer, FRAME_COLUMN_SIZE, event->frame.size);
+    arrow_writer_set_uint(writer, FRAME_COLUMN_END_OFFSET, event->frame.end_offset);
+    arrow_export_end_row(arrow_export, ARROW_EXPORT_TABLE_FRAMES);
+}
+
+static void arrow_export_message(ArrowExport *arrow_export, const DemoEvent *event)
+{
+    ArrowWriter *writer = &arrow_export->tables[ARROW_EXPORT_TABLE_MESSAGES];
+    arrow_writer_set_uint(writer, MESSAGE_COLUMN_TICK, event->tick);
+    arrow_writer_set_uint(writer, MESSAGE_COLUMN_ID, event->net_message.message_id);
+    arrow_writer_set_uint(writer, MESSAGE_COLUMN_SIZE, event->net_message.size);
+    arrow_export_end_row(arrow_export, ARROW_EXPORT_TABLE_MESSAGES);
+}
+
+static void arrow_export_game_event(ArrowExport *arrow_export, const DemoEvent *event)
+{
+    ArrowWriter *writer = &arrow_export->tables[ARROW_EXPORT_TABLE_GAME_EVENTS];
+    const GameEvent *game_event = &event->game_event;
+    const u64 sequence = arrow_export->game_event_count++;
+
+    //
+    // Events without keys still get a row
+    //
+    const u32 row_count = (game_event->value_count > 0) ? game_event->value_count : 1;
+    for (u32 i = 0; i < row_count; i++)
+    {
+        arrow_writer_set_uint(writer, GAME_EVENT_COLUMN_TICK, event->tick);
+        arrow_writer_set_uint(writer, GAME_EVENT_COLUMN_SEQUENCE, sequence);
+        arrow_writer_set_string(writer, GAME_EVENT_COLUMN_NAME, game_event->name, strlen(game_event->name));
+
+        if (i < game_event->value_count)
+        {
+            const char *key_name = game_event->descriptor->keys[i].name;
+            arrow_writer_set_string(writer, GAME_EVENT_COLUMN_KEY, key_name, strlen(key_name));
+
+            const GameEventValue *value = &game_event->values[i];
+            switch (value->kind)
+            {
+            case GAME_EVENT_VALUE_STRING:
+                arrow_writer_set_string(writer, GAME_EVENT_COLUMN_STRING, value->string_value, strlen(value->string_value));
+                break;
+            case GAME_EVENT_VALUE_FLOAT:
+                arrow_writer_set_float(writer, GAME_EVENT_COLUMN_FLOAT, value->float_value);
+                break;
+            case GAME_EVENT_VALUE_INT:
+                arrow_writer_set_int(writer, GAME_EVENT_COLUMN_INT, value->int_value);
+                break;
+            case GAME_EVENT_VALUE_BOOL:
+                arrow_writer_set_bool(writer, GAME_EVENT_COLUMN_BOOL, value->bool_value);
+                break;
+            case GAME_EVENT_VALUE_UINT64:
+                arrow_writer_set_uint(writer, GAME_EVENT_COLUMN_UINT64, value->uint64_value);
+                break;
+            default:
+                break;
+            }
+        }
+
+        if (arrow_export_end_row(arrow_export, ARROW_EXPORT_TABLE_GAME_EVENTS) != ARROW_WRITER_RET_OK)
+        {
+            return;
+        }
+    }
+}
+
+static void arrow_export_entity(ArrowExport *arrow_export, const DemoEvent *event)
+{
+    const DemoEntityEvent *entity_event = &event->entity;
+    const EntityClass *entity_class = entity_event->entity_class;
+    const bool is_change_log = arrow_export->entity_mode == ARROW_EXPORT_ENTITIES_CHANGES;
+
+    //
+    // Values are only worth a row while the entity is around
+    //
+    const bool has_values = entity_event->event == ENTITY_EVENT_CREATED || entity_event->event == ENTITY_EVENT_UPDATED;
+    const ArrowExportClass *export_class = nullptr;
+    if (has_values && (entity_class->projection || is_change_log))
+    {
+        export_class = arrow_export_class(arrow_export, entity_class);
+        if (!export_class)
+        {
+            return;
+        }
+    }
+
+    if (!export_class || export_class->column_count == 0)
+    {
+        //
+        // An update that wrote nothing of interest has nothing to log
+        //
+        if (!(is_change_log && entity_event->event == ENTITY_EVENT_UPDATED))
+        {
+            arrow_export_entity_row(arrow_export, event->tick, entity_event->entity_index, entity_class, entity_event->event, nullptr, 0);
+        }
+        return;
+    }
+
+    if (is_change_log && entity_event->event == ENTITY_EVENT_UPDATED)
+    {
+        for (u32 i = 0; i < entity_event->changed_column_count; i++)
+        {
+            const u32 index = export_class->column_lookup[entity_event->changed_columns[i]];
+            if (index == UINT32_MAX)
+            {
+                continue;
+            }
+            if (arrow_export_entity_row(arrow_export, event->tick, entity_event->entity_index, entity_class, entity_event->event, &export_class->columns[index], entity_event->row) != ARROW_WRITER_RET_OK)
+            {
+                return;
+            }
+        }
+        return;
+    }
+
+    for (u32 i = 0; i < export_class->column_count; i++)
+    {
+        if (arrow_export_entity_row(arrow_export, event->tick, entity_event->entity_index, entity_class, entity_event->event, &export_class->columns[i], entity_event->row) != ARROW_WRITER_RET_OK)
+        {
+            return;
+        }
+    }
+}
+
+//
+// Every field of every live entity the query reports, so a reader can start from here
+// instead of the start of the demo
+//
+static void arrow_export_keyframe(ArrowExport *arrow_export, u32 tick)
+{
+    const EntityEngine *engine = arrow_export->entities;
+
+    for (u32 entity_index = 0; entity_index < ENTITY_MAX_COUNT; entity_index++)
+    {
+        if (!entity_engine_exists(engine, entity_index))
+        {
+            continue;
+        }
+
+        const EntityClass *entity_class = entity_engine_class_of(engine, entity_index);
+        if (entity_class->is_excluded)
+        {
+            continue;
+        }
+
+        const ArrowExportClass *export_class = arrow_export_class(arrow_export, entity_class);
+        if (!export_class)
+        {
+            return;
+        }
+
+        const u32 row = engine->slots[entity_index].row;
+        if (export_class->column_count == 0)
+        {
+            arrow_export_entity_row(arrow_export, tick, entity_index, entity_class, ARROW_EXPORT_ENTITY_KEYFRAME, nullptr, row);
+        }
+        for (u32 i = 0; i < export_class->column_count; i++)
+        {
+            arrow_export_entity_row(arrow_export, tick, entity_index, entity_class, ARROW_EXPORT_ENTITY_KEYFRAME, &export_class->columns[i], row);
+        }
+
+        if (arrow_export->error != ARROW_EXPORT_RET_OK)
+        {
+            return;
+        }
+    }
+}
+
+//
+// One row of entities.arrow, the value of column at row of the class table. A null field
+// without column
+//
+static int arrow_export_entity_row(ArrowExport *arrow_export, u32 tick, u32 entity_index, const EntityClass *entity_class, u32 event, const ArrowExportColumn *column, u32 row)
+{
+    ArrowWriter *writer = &arrow_export->tables[ARROW_EXPORT_TABLE_ENTITIES];
+    arrow_writer_set_uint(writer, ENTITY_COLUMN_TICK, tick);
+    arrow_writer_set_uint(writer, ENTITY_COLUMN_INDEX, entity_index);
+    arrow_writer_set_string(writer, ENTITY_COLUMN_CLASS, entity_class->name, strlen(entity_class->name));
+    arrow_writer_set_uint(writer, ENTITY_COLUMN_EVENT, event);
+
+    if (column)
+    {
+        arrow_writer_set_string(writer, ENTITY_COLUMN_FIELD, column->name, column->name_length);
+        arrow_export_entity_value(writer, &entity_class_column(entity_class, column->column)[row], column->decoder);
+    }
+
+    return arrow_export_end_row(arrow_export, ARROW_EXPORT_TABLE_ENTITIES);
+}
+
+//
+// The projected columns of entity_class with their names. Classes are set up again for
+// every demo, a class seen before under another EntityClass is resolved anew
+//
+static const ArrowExportClass *arrow_export_class(ArrowExport *arrow_export, const EntityClass *entity_class)
+{
+    if (entity_class->id >= arrow_export->class_count)
+    {
+        const u32 new_count = entity_class->id + 1;
+        ArrowExportClass *new_classes = (ArrowExportClass *)realloc(arrow_export->classes, new_count * sizeof(ArrowExportClass));
+        if (!new_classes)
+        {
+            arrow_export->error = ARROW_EXPORT_RET_OOM;
+            return nullptr;
+        }
+        memset(&new_classes[arrow_export->class_count], 0, (new_count - arrow_export->class_count) * sizeof(ArrowExportClass));
+        arrow_export->classes = new_classes;
+        arrow_export->class_count = new_count;
+    }
+
+    ArrowExportClass *export_class = &arrow_export->classes[entity_class->id];
+    if (export_class->entity_class == entity_class)
+    {
+        return export_class;
+    }
+
+    for (u32 c = 0; c < export_class->column_count; c++)
+    {
+        free(export_class->columns[c].name);
+    }
+    export_class->column_count = 0;
+    export_class->entity_class = entity_class;
+
+    entity_class_visit_columns(entity_class, arrow_export_add_column, export_class);
+
+    //
+    // A column that couldn't be added leaves the class to be resolved again next time
+    //
+    if (export_class->entity_class != entity_class)
+    {
+        arrow_export->error = ARROW_EXPORT_RET_OOM;
+        return nullptr;
+    }
+
+    if (arrow_export->entity_mode == ARROW_EXPORT_ENTITIES_CHANGES)
+    {
+        const u32 column_count = entity_class->serializer->column_count;
+        u32 *column_lookup = (u32 *)realloc(export_class->column_lookup, (column_count + 1) * sizeof(u32));
+        if (!column_lookup)
+        {
+            export_class->entity_class = nullptr;
+            arrow_export->error = ARROW_EXPORT_RET_OOM;
+            return nullptr;
+        }
+        export_class->column_lookup = column_lookup;
+
+        for (u32 column = 0; column < column_count; column++)
+        {
+            column_lookup[column] = UINT32_MAX;
+        }
+        for (u32 i = 0; i < export_class->column_count; i++)
+        {
+            column_lookup[export_class->columns[i].column] = i;
+        }
+    }
+
+    return export_class;
+}
+
+static void arrow_export_add_column(void *user_data, const char *name, u32 column, const FieldDecoder *decoder)
+{
+    ArrowExportClass *export_class = (ArrowExportClass *)user_data;
+    if (!export_class->entity_class)
+    {
+        return;
+    }
+
+    if (export_class->column_count == export_class->column_capacity)
+    {
+        const u32 new_capacity = (export_class->column_capacity) ? export_class->column_capacity * 2 : 8;
+        ArrowExportColumn *new_columns = (ArrowExportColumn *)realloc(export_class->columns, new_capacity * sizeof(ArrowExportColumn));
+        if (!new_columns)
+        {
+            export_class->entity_class = nullptr;
+            return;
+        }
+        export_class->columns = new_columns;
+        export_class->column_capacity = new_capacity;
+    }
+
+    char *name_copy = strdup(name);
+    if (!name_copy)
+    {
+        export_class->entity_class = nullptr;
+        return;
+    }
+
+    ArrowExportColumn *export_column = &export_class->columns[export_class->column_count++];
+    export_column->column = column;
+    export_column->decoder = decoder;
+    export_column->name = name_copy;
+    export_column->name_length = (u32)strlen(name_copy);
+}
+
+static void arrow_export_entity_value(ArrowWriter *writer, const EntityValue *value, const FieldDecoder *decoder)
+{
+    switch (decoder->kind)
+    {
+    case FIELD_DECODER_BOOL:
+        arrow_writer_set_bool(writer, ENTITY_COLUMN_BOOL, value->bool_value);
+        break;
+    case FIELD_DECODER_SIGNED:
+    case FIELD_DECODER_SIGNED64:
+        arrow_writer_set_int(writer, ENTITY_COLUMN_INT, value->int_value);
+        break;
+    case FIELD_DECODER_STRING:
+        if (value->string)
+        {
+            arrow_writer_set_string(writer, ENTITY_COLUMN_STRING, value->string, strlen(value->string));
+        }
+        break;
+    case FIELD_DECODER_FLOAT_NOSCALE:
+    case FIELD_DECODER_FLOAT_QUANTIZED:
+    case FIELD_DECODER_FLOAT_COORD:
+    case FIELD_DECODER_FLOAT_SIMTIME:
+    case FIELD_DECODER_FLOAT_RUNETIME:
+        arrow_writer_set_float(writer, ENTITY_COLUMN_FLOAT, value->float_value);
+        break;
+    case FIELD_DECODER_VECTOR:
+    case FIELD_DECODER_VECTOR_NORMAL:
+    case FIELD_DECODER_QANGLE_PITCH_YAW:
+    case FIELD_DECODER_QANGLE_PRECISE:
+    case FIELD_DECODER_QANGLE_FIXED:
+    case FIELD_DECODER_QANGLE_COORD:
+    {
+        const u32 component_count = (decoder->kind == FIELD_DECODER_VECTOR) ? decoder->component_count : 3;
+        for (u32 i = 0; i < component_count && i < 3; i++)
+        {
+            arrow_writer_set_float(writer, ENTITY_COLUMN_X + i, value->vector[i]);
+        }
+        break;
+    }
+    default:
+        arrow_writer_set_uint(writer, ENTITY_COLUMN_UINT, value->uint_value);
+        break;
+    }
+}
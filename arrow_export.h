@@ -0,0 +1,114 @@
+#pragma once
+
+//
+// Exports parser events as Arrow IPC tables, one file per kind of row in an output
+// directory, for analytics engines to query directly:
+//
+//   frames.arrow       one row per frame: tick, command, sizes, end offset
+//   messages.arrow     one row per reported net message: tick, message ID, size
+//   game_events.arrow  one row per key of every subscribed game event, rows of the same
+//                      event share its sequence number. Values land in the column of
+//                      their type, the others are null
+//   entities.arrow     one row per projected field of every entity event (see
+//                      DemoQuery.entity_fields), or one row with a null field when the
+//                      class has no projection. Vectors and angles fill x, y and z
+//
+// With ARROW_EXPORT_ENTITIES_CHANGES, entities.arrow is a change log instead: an update
+// only gets rows for the fields it wrote, a create gets every field, with or without a
+// projection. Once each full packet was applied (DEMO_EVENT_FULL_PACKET_END) each live
+// entity gets a row per field with event ARROW_EXPORT_ENTITY_KEYFRAME. The state at any
+// tick is the last keyframe before it with the rows that follow it in the file applied
+// on top, up to that tick
+//
+// arrow_export_event is a DemoEventHandler, values go from the event straight into the
+// column buffers of arrow_writer.h.
+//
+
+#include "common.h"
+#include "arrow_writer.h"
+#include "demoparser.h"
+
+#define ARROW_EXPORT_TABLE_FRAMES 0
+#define ARROW_EXPORT_TABLE_MESSAGES 1
+#define ARROW_EXPORT_TABLE_GAME_EVENTS 2
+#define ARROW_EXPORT_TABLE_ENTITIES 3
+#define ARROW_EXPORT_TABLE_COUNT 4
+
+//
+// How entities.arrow is written
+//
+#define ARROW_EXPORT_ENTITIES_SNAPSHOT 0
+#define ARROW_EXPORT_ENTITIES_CHANGES 1
+
+//
+// Event column value of keyframe rows, past the ENTITY_EVENT_* values
+//
+#define ARROW_EXPORT_ENTITY_KEYFRAME 4
+
+#define ARROW_EXPORT_RET_OK 0
+#define ARROW_EXPORT_RET_OOM 1
+#define ARROW_EXPORT_RET_IO_ERROR 2
+
+typedef struct
+{
+    u32 column;
+    const FieldDecoder *decoder;
+    char *name;
+    u32 name_length;
+} ArrowExportColumn;
+
+//
+// Field names of a class, resolved on its first entity event rather than on every one
+//
+typedef struct
+{
+    const EntityClass *entity_class;
+    ArrowExportColumn *columns;
+    u32 column_count;
+    u32 column_capacity;
+    //
+    // Index into columns by class column, UINT32_MAX for columns without a name. Only
+    // built for change logs, which look up the columns an update wrote
+    //
+    u32 *column_lookup;
+} ArrowExportClass;
+
+typedef struct
+{
+    ArrowWriter tables[ARROW_EXPORT_TABLE_COUNT];
+    //
+    // Sequence number of the next game event
+    //
+    u64 game_event_count;
+
+    //
+    // Indexed by class ID
+    //
+    ArrowExportClass *classes;
+    u32 class_count;
+
+    //
+    // One of ARROW_EXPORT_ENTITIES_*. Change logs read the keyframes from entities
+    //
+    u32 entity_mode;
+    const EntityEngine *entities;
+
+    int error;
+} ArrowExport;
+
+//
+// Creates the table files in directory, which has to exist. batch_rows 0 picks
+// ARROW_WRITER_DEFAULT_BATCH_ROWS. entities is the engine of the parser the events come
+// from, nullptr for no keyframes. Change logs need DemoParserOptions.entity_changes
+//
+int arrow_export_open(ArrowExport *arrow_export, const char *directory, u32 batch_rows, u32 entity_mode, const EntityEngine *entities);
+
+//
+// Finishes every table. Returns the first error of the export
+//
+int arrow_export_close(ArrowExport *arrow_export);
+
+//
+// DemoEventHandler taking the ArrowExport as user_data. Stops the parse on the first error
+//
+int arrow_export_event(void *user_data, const DemoEvent *event);
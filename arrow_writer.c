@@ -0,0 +1,828 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "arrow_writer.h"
+
+//
+// Arrow format constants, see Schema.fbs and Message.fbs of the Arrow format
+//
+#define ARROW_METADATA_VERSION_V5 4
+#define ARROW_MESSAGE_HEADER_SCHEMA 1
+#define ARROW_MESSAGE_HEADER_RECORD_BATCH 3
+#define ARROW_TYPE_ID_INT 2
+#define ARROW_TYPE_ID_FLOATING_POINT 3
+#define ARROW_TYPE_ID_UTF8 5
+#define ARROW_TYPE_ID_BOOL 6
+#define ARROW_PRECISION_SINGLE 1
+#define ARROW_PRECISION_DOUBLE 2
+
+#define ARROW_FILE_MAGIC "ARROW1"
+#define ARROW_CONTINUATION 0xFFFFFFFFu
+#define ARROW_METADATA_INITIAL_CAPACITY 4096
+#define ARROW_STRINGS_INITIAL_CAPACITY (64 * 1024)
+
+static void arrow_writer_free(ArrowWriter *writer);
+static bool arrow_writer_write(ArrowWriter *writer, const void *data, size_t size);
+static bool arrow_writer_pad(ArrowWriter *writer, size_t size);
+static int arrow_writer_flush(ArrowWriter *writer);
+static bool arrow_writer_write_message(ArrowWriter *writer, u64 body_size, ArrowBlock *out_block);
+
+static size_t flat_reserve(ArrowWriter *writer, size_t size, size_t alignment);
+static size_t flat_table(ArrowWriter *writer, const u8 *field_sizes, u32 field_count, size_t *out_positions);
+static size_t flat_vector(ArrowWriter *writer, u32 count, u32 element_size, u32 alignment);
+static size_t flat_string(ArrowWriter *writer, const char *value);
+static void flat_put(ArrowWriter *writer, size_t pos, const void *value, size_t size);
+static void flat_put_offset(ArrowWriter *writer, size_t pos, size_t target);
+static size_t arrow_build_schema(ArrowWriter *writer);
+static size_t arrow_build_field(ArrowWriter *writer, const ArrowField *field);
+
+static u32 arrow_type_width(u8 type)
+{
+    switch (type)
+    {
+    case ARROW_TYPE_UINT8:
+        return 1;
+    case ARROW_TYPE_UINT32:
+    case ARROW_TYPE_INT32:
+    case ARROW_TYPE_FLOAT32:
+        return 4;
+    case ARROW_TYPE_UINT64:
+    case ARROW_TYPE_INT64:
+    case ARROW_TYPE_FLOAT64:
+        return 8;
+    default:
+        //
+        // Bits for bools, strings keep their offsets separately
+        //
+        return 0;
+    }
+}
+
+static inline size_t arrow_align8(size_t size)
+{
+    return (size + 7) & ~(size_t)7;
+}
+
+static inline size_t arrow_bitmap_size(u32 row_count)
+{
+    return ((size_t)row_count + 7) / 8;
+}
+
+int arrow_writer_open(ArrowWriter *writer, const char *path, const ArrowField *fields, u32 field_count, u32 batch_rows)
+{
+    memset(writer, 0, sizeof(*writer));
+    writer->batch_rows = (batch_rows > 0) ? batch_rows : ARROW_WRITER_DEFAULT_BATCH_ROWS;
+
+    writer->columns = (ArrowColumn *)calloc(field_count, sizeof(ArrowColumn));
+    writer->metadata = (u8 *)malloc(ARROW_METADATA_INITIAL_CAPACITY);
+    if (!writer->columns || !writer->metadata)
+    {
+        arrow_writer_free(writer);
+        return ARROW_WRITER_RET_OOM;
+    }
+    writer->column_count = field_count;
+    writer->metadata_capacity = ARROW_METADATA_INITIAL_CAPACITY;
+
+    //
+    // Every buffer is sized for a full batch up front, only strings grow
+    //
+    for (u32 i = 0; i < field_count; i++)
+    {
+        ArrowColumn *column = &writer->columns[i];
+        column->field = fields[i];
+
+        const u32 width = arrow_type_width(fields[i].type);
+        const size_t values_size = (width > 0) ? (size_t)writer->batch_rows * width : arrow_bitmap_size(writer->batch_rows);
+        column->values = (fields[i].type == ARROW_TYPE_UTF8) ? nullptr : (u8 *)calloc(1, values_size);
+        column->validity = (u8 *)calloc(1, arrow_bitmap_size(writer->batch_rows));
+
+        bool is_allocated = column->validity && (column->values || fields[i].type == ARROW_TYPE_UTF8);
+        if (fields[i].type == ARROW_TYPE_UTF8)
+        {
+            column->offsets = (i32 *)calloc((size_t)writer->batch_rows + 1, sizeof(i32));
+            column->strings = (char *)malloc(ARROW_STRINGS_INITIAL_CAPACITY);
+            column->string_capacity = ARROW_STRINGS_INITIAL_CAPACITY;
+            is_allocated = is_allocated && column->offsets && column->strings;
+        }
+
+        if (!is_allocated)
+        {
+            arrow_writer_free(writer);
+            return ARROW_WRITER_RET_OOM;
+        }
+    }
+
+    writer->file = fopen(path, "wb");
+    if (!writer->file)
+    {
+        arrow_writer_free(writer);
+        return ARROW_WRITER_RET_IO_ERROR;
+    }
+
+    //
+    // File magic padded to 8 bytes, then the schema message of the IPC stream
+    //
+    static const char magic[8] = ARROW_FILE_MAGIC;
+    const size_t schema = arrow_build_schema(writer);
+    if (!arrow_writer_write(writer, magic, sizeof(magic)) || schema == SIZE_MAX || !arrow_writer_write_message(writer, 0, nullptr))
+    {
+        const int ret_code = (writer->error != ARROW_WRITER_RET_OK) ? writer->error : ARROW_WRITER_RET_IO_ERROR;
+        fclose(writer->file);
+        arrow_writer_free(writer);
+        return ret_code;
+    }
+
+    return ARROW_WRITER_RET_OK;
+}
+
+int arrow_writer_close(ArrowWriter *writer)
+{
+    if (writer->row_count > 0)
+    {
+        arrow_writer_flush(writer);
+    }
+
+    if (writer->error == ARROW_WRITER_RET_OK)
+    {
+        //
+        // End of stream marker, then the footer: the schema again and where every record
+        // batch starts
+        //
+        const u32 end_of_stream[2] = { ARROW_CONTINUATION, 0 };
+        arrow_writer_write(writer, end_of_stream, sizeof(end_of_stream));
+
+        writer->metadata_size = 0;
+        const size_t root = flat_reserve(writer, 4, 4);
+        const u8 footer_sizes[4] = { 2, 4, 4, 4 };
+        size_t footer_fields[4];
+        const size_t footer = flat_table(writer, footer_sizes, 4, footer_fields);
+        const i16 version = ARROW_METADATA_VERSION_V5;
+        flat_put(writer, footer_fields[0], &version, sizeof(version));
+        flat_put_offset(writer, root, footer);
+
+        const size_t schema = arrow_build_schema(writer);
+        flat_put_offset(writer, footer_fields[1], schema);
+
+        const size_t dictionaries = flat_vector(writer, 0, 24, 8);
+        flat_put_offset(writer, footer_fields[2], dictionaries);
+
+        const size_t batches = flat_vector(writer, writer->block_count, 24, 8);
+        flat_put_offset(writer, footer_fields[3], batches);
+        for (u32 i = 0; i < writer->block_count; i++)
+        {
+            const size_t block = batches + 4 + (size_t)i * 24;
+            const i64 offset = (i64)writer->blocks[i].offset;
+            const i32 metadata_size = (i32)writer->blocks[i].metadata_size;
+            const i64 body_size = (i64)writer->blocks[i].body_size;
+            flat_put(writer, block, &offset, sizeof(offset));
+            flat_put(writer, block + 8, &metadata_size, sizeof(metadata_size));
+            flat_put(writer, block + 16, &body_size, sizeof(body_size));
+        }
+
+        if (writer->error == ARROW_WRITER_RET_OK)
+        {
+            const i32 footer_size = (i32)writer->metadata_size;
+            arrow_writer_write(writer, writer->metadata, writer->metadata_size);
+            arrow_writer_write(writer, &footer_size, sizeof(footer_size));
+            arrow_writer_write(writer, ARROW_FILE_MAGIC, 6);
+        }
+    }
+
+    if (fclose(writer->file) != 0 && writer->error == ARROW_WRITER_RET_OK)
+    {
+        writer->error = ARROW_WRITER_RET_IO_ERROR;
+    }
+
+    const int ret_code = writer->error;
+    arrow_writer_free(writer);
+    return ret_code;
+}
+
+static void arrow_writer_free(ArrowWriter *writer)
+{
+    for (u32 i = 0; i < writer->column_count; i++)
+    {
+        free(writer->columns[i].values);
+        free(writer->columns[i].validity);
+        free(writer->columns[i].offsets);
+        free(writer->columns[i].strings);
+    }
+    free(writer->columns);
+    free(writer->blocks);
+    free(writer->metadata);
+
+    writer->columns = nullptr;
+    writer->column_count = 0;
+    writer->blocks = nullptr;
+    writer->metadata = nullptr;
+}
+
+//
+// Row values
+//
+
+static inline void arrow_column_set_valid(ArrowColumn *column, u32 row)
+{
+    column->validity[row / 8] |= (u8)(1u << (row % 8));
+}
+
+void arrow_writer_set_bool(ArrowWriter *writer, u32 column_index, bool value)
+{
+    ArrowColumn *column = &writer->columns[column_index];
+    const u32 row = writer->row_count;
+    if (value)
+    {
+        column->values[row / 8] |= (u8)(1u << (row % 8));
+    }
+    arrow_column_set_valid(column, row);
+}
+
+void arrow_writer_set_uint(ArrowWriter *writer, u32 column_index, u64 value)
+{
+    ArrowColumn *column = &writer->columns[column_index];
+    const u32 row = writer->row_count;
+    switch (column->field.type)
+    {
+    case ARROW_TYPE_UINT8:
+        column->values[row] = (u8)value;
+        break;
+    case ARROW_TYPE_UINT32:
+    case ARROW_TYPE_INT32:
+        ((u32 *)column->values)[row] = (u32)value;
+        break;
+    case ARROW_TYPE_UINT64:
+    case ARROW_TYPE_INT64:
+        ((u64 *)column->values)[row] = value;
+        break;
+    default:
+        return;
+    }
+    arrow_column_set_valid(column, row);
+}
+
+void arrow_writer_set_int(ArrowWriter *writer, u32 column_index, i64 value)
+{
+    arrow_writer_set_uint(writer, column_index, (u64)value);
+}
+
+void arrow_writer_set_float(ArrowWriter *writer, u32 column_index, f64 value)
+{
+    ArrowColumn *column = &writer->columns[column_index];
+    const u32 row = writer->row_count;
+    switch (column->field.type)
+    {
+    case ARROW_TYPE_FLOAT32:
+        ((f32 *)column->values)[row] = (f32)value;
+        break;
+    case ARROW_TYPE_FLOAT64:
+        ((f64 *)column->values)[row] = value;
+        break;
+    default:
+        return;
+    }
+    arrow_column_set_valid(column, row);
+}
+
+void arrow_writer_set_string(ArrowWriter *writer, u32 column_index, const char *value, size_t length)
+{
+    ArrowColumn *column = &writer->columns[column_index];
+    if (writer->error != ARROW_WRITER_RET_OK || column->field.type != ARROW_TYPE_UTF8)
+    {
+        return;
+    }
+
+    //
+    // One value per row, a second call replaces the first
+    //
+    const u32 row = writer->row_count;
+    column->string_size = (size_t)column->offsets[row];
+
+    if (column->string_size + length > column->string_capacity)
+    {
+        size_t new_capacity = column->string_capacity * 2;
+        while (new_capacity < column->string_size + length)
+        {
+            new_capacity *= 2;
+        }
+        char *new_strings = (char *)realloc(column->strings, new_capacity);
+        if (!new_strings)
+        {
+            writer->error = ARROW_WRITER_RET_OOM;
+            return;
+        }
+        column->strings = new_strings;
+        column->string_capacity = new_capacity;
+    }
+
+    memcpy(column->strings + column->string_size, value, length);
+    column->string_size += length;
+    arrow_column_set_valid(column, row);
+}
+
+int arrow_writer_end_row(ArrowWriter *writer)
+{
+    if (writer->error != ARROW_WRITER_RET_OK)
+    {
+        return writer->error;
+    }
+
+    //
+    // Rows without a string still need their offset, an empty slice
+    //
+    const u32 row = writer->row_count;
+    for (u32 i = 0; i < writer->column_count; i++)
+    {
+        ArrowColumn *column = &writer->columns[i];
+        if (column->field.type == ARROW_TYPE_UTF8)
+        {
+            if (!(column->validity[row / 8] & (1u << (row % 8))))
+            {
+                column->string_size = (size_t)column->offsets[row];
+            }
+            if (column->string_size > INT32_MAX)
+            {
+                writer->error = ARROW_WRITER_RET_OOM;
+                return writer->error;
+            }
+            column->offsets[row + 1] = (i32)column->string_size;
+        }
+    }
+
+    writer->row_count++;
+    writer->total_rows++;
+
+    return (writer->row_count == writer->batch_rows) ? arrow_writer_flush(writer) : ARROW_WRITER_RET_OK;
+}
+
+//
+// Record batches
+//
+
+static u32 arrow_column_null_count(const ArrowColumn *column, u32 row_count)
+{
+    u32 valid_count = 0;
+    for (u32 row = 0; row < row_count; row++)
+    {
+        valid_count += (column->validity[row / 8] >> (row % 8)) & 1u;
+    }
+    return row_count - valid_count;
+}
+
+//
+// Sizes of the buffers of a column in body order: validity, then offsets and data or
+// just data. Returns the buffer count
+//
+static u32 arrow_column_buffers(const ArrowColumn *column, u32 row_count, u32 null_count, size_t *out_sizes)
+{
+    out_sizes[0] = (null_count > 0) ? arrow_bitmap_size(row_count) : 0;
+
+    if (column->field.type == ARROW_TYPE_UTF8)
+    {
+        out_sizes[1] = ((size_t)row_count + 1) * sizeof(i32);
+        out_sizes[2] = column->string_size;
+        return 3;
+    }
+
+    const u32 width = arrow_type_width(column->field.type);
+    out_sizes[1] = (width > 0) ? (size_t)row_count * width : arrow_bitmap_size(row_count);
+    return 2;
+}
+
+static const void *arrow_column_buffer_data(const ArrowColumn *column, u32 buffer)
+{
+    switch (buffer)
+    {
+    case 0:
+        return column->validity;
+    case 1:
+        return (column->field.type == ARROW_TYPE_UTF8) ? (const void *)column->offsets : (const void *)column->values;
+    default:
+        return column->strings;
+    }
+}
+
+//
+// Writes the filled rows as one record batch and resets the column buffers
+//
+static int arrow_writer_flush(ArrowWriter *writer)
+{
+    if (writer->error != ARROW_WRITER_RET_OK)
+    {
+        return writer->error;
+    }
+
+    const u32 row_count = writer->row_count;
+
+    u32 *null_counts = (u32 *)calloc(writer->column_count + 1, sizeof(u32));
+    if (!null_counts)
+    {
+        writer->error = ARROW_WRITER_RET_OOM;
+        return writer->error;
+    }
+
+    u32 buffer_count = 0;
+    for (u32 i = 0; i < writer->column_count; i++)
+    {
+        const ArrowColumn *column = &writer->columns[i];
+        null_counts[i] = (column->field.nullable) ? arrow_column_null_count(column, row_count) : 0;
+        buffer_count += (column->field.type == ARROW_TYPE_UTF8) ? 3 : 2;
+    }
+
+    //
+    // Message { version, header_type, header: RecordBatch, bodyLength }
+    //
+    writer->metadata_size = 0;
+    const size_t root = flat_reserve(writer, 4, 4);
+    const u8 message_sizes[4] = { 2, 1, 4, 8 };
+    size_t message_fields[4];
+    const size_t message = flat_table(writer, message_sizes, 4, message_fields);
+    flat_put_offset(writer, root, message);
+
+    const i16 version = ARROW_METADATA_VERSION_V5;
+    const u8 header_type = ARROW_MESSAGE_HEADER_RECORD_BATCH;
+    flat_put(writer, message_fields[0], &version, sizeof(version));
+    flat_put(writer, message_fields[1], &header_type, sizeof(header_type));
+
+    //
+    // RecordBatch { length, nodes: [FieldNode], buffers: [Buffer] }
+    //
+    const u8 batch_sizes[3] = { 8, 4, 4 };
+    size_t batch_fields[3];
+    const size_t batch = flat_table(writer, batch_sizes, 3, batch_fields);
+    flat_put_offset(writer, message_fields[2], batch);
+
+    const i64 length = row_count;
+    flat_put(writer, batch_fields[0], &length, sizeof(length));
+
+    const size_t nodes = flat_vector(writer, writer->column_count, 16, 8);
+    flat_put_offset(writer, batch_fields[1], nodes);
+    const size_t buffers = flat_vector(writer, buffer_count, 16, 8);
+    flat_put_offset(writer, batch_fields[2], buffers);
+
+    u64 body_size = 0;
+    u32 buffer_index = 0;
+    for (u32 i = 0; i < writer->column_count; i++)
+    {
+        const i64 node[2] = { row_count, null_counts[i] };
+        flat_put(writer, nodes + 4 + (size_t)i * 16, node, sizeof(node));
+
+        size_t sizes[3];
+        const u32 column_buffer_count = arrow_column_buffers(&writer->columns[i], row_count, null_counts[i], sizes);
+        for (u32 b = 0; b < column_buffer_count; b++)
+        {
+            const i64 buffer[2] = { (i64)body_size, (i64)sizes[b] };
+            flat_put(writer, buffers + 4 + (size_t)buffer_index * 16, buffer, sizeof(buffer));
+            body_size += arrow_align8(sizes[b]);
+            buffer_index++;
+        }
+    }
+
+    const i64 body_length = (i64)body_size;
+    flat_put(writer, message_fields[3], &body_length, sizeof(body_length));
+
+    ArrowBlock block;
+    bool write_ok = arrow_writer_write_message(writer, body_size, &block);
+
+    //
+    // The body is written straight from the column buffers
+    //
+    for (u32 i = 0; i < writer->column_count && write_ok; i++)
+    {
+        const ArrowColumn *column = &writer->columns[i];
+        size_t sizes[3];
+        const u32 column_buffer_count = arrow_column_buffers(column, row_count, null_counts[i], sizes);
+        for (u32 b = 0; b < column_buffer_count && write_ok; b++)
+        {
+            write_ok = arrow_writer_write(writer, arrow_column_buffer_data(column, b), sizes[b]) &&
+                       arrow_writer_pad(writer, arrow_align8(sizes[b]) - sizes[b]);
+        }
+    }
+
+    free(null_counts);
+
+    if (!write_ok)
+    {
+        return writer->error;
+    }
+
+    if (writer->block_count == writer->block_capacity)
+    {
+        const u32 new_capacity = (writer->block_capacity) ? writer->block_capacity * 2 : 16;
+        ArrowBlock *new_blocks = (ArrowBlock *)realloc(writer->blocks, new_capacity * sizeof(ArrowBlock));
+        if (!new_blocks)
+        {
+            writer->error = ARROW_WRITER_RET_OOM;
+            return writer->error;
+        }
+        writer->blocks = new_blocks;
+        writer->block_capacity = new_capacity;
+    }
+    writer->blocks[writer->block_count++] = block;
+
+    for (u32 i = 0; i < writer->column_count; i++)
+    {
+        ArrowColumn *column = &writer->columns[i];
+        const u32 width = arrow_type_width(column->field.type);
+        if (column->values)
+        {
+            memset(column->values, 0, (width > 0) ? (size_t)row_count * width : arrow_bitmap_size(row_count));
+        }
+        memset(column->validity, 0, arrow_bitmap_size(row_count));
+        column->string_size = 0;
+    }
+    writer->row_count = 0;
+
+    return ARROW_WRITER_RET_OK;
+}
+
+//
+// Frames the metadata built in writer->metadata as an encapsulated message: continuation
+// marker, metadata size, then the metadata padded to 8 bytes. The body follows
+//
+static bool arrow_writer_write_message(ArrowWriter *writer, u64 body_size, ArrowBlock *out_block)
+{
+    if (writer->error != ARROW_WRITER_RET_OK)
+    {
+        return false;
+    }
+
+    const size_t padded_size = arrow_align8(writer->metadata_size);
+    const u32 prefix[2] = { ARROW_CONTINUATION, (u32)padded_size };
+
+    if (out_block)
+    {
+        out_block->offset = writer->file_offset;
+        out_block->metadata_size = (u32)(sizeof(prefix) + padded_size);
+        out_block->body_size = body_size;
+    }
+
+    return arrow_writer_write(writer, prefix, sizeof(prefix)) && arrow_writer_write(writer, writer->metadata, writer->metadata_size) &&
+           arrow_writer_pad(writer, padded_size - writer->metadata_size);
+}
+
+static bool arrow_writer_write(ArrowWriter *writer, const void *data, size_t size)
+{
+    if (writer->error != ARROW_WRITER_RET_OK)
+    {
+        return false;
+    }
+    if (size > 0 && fwrite(data, 1, size, writer->file) != size)
+    {
+        writer->error = ARROW_WRITER_RET_IO_ERROR;
+        return false;
+    }
+    writer->file_offset += size;
+    return true;
+}
+
+static bool arrow_writer_pad(ArrowWriter *writer, size_t size)
+{
+    static const u8 zeros[8] = { 0 };
+    return arrow_writer_write(writer, zeros, size);
+}
+
+//
+// FlatBuffers, laid out front to back in writer->metadata. Tables are preceded by their
+// vtable, and everything a table refers to is appended after it, so every offset points
+// forward the way the format requires. Positions are relative to the start of the
+// metadata, SIZE_MAX once out of memory
+//
+
+static size_t flat_reserve(ArrowWriter *writer, size_t size, size_t alignment)
+{
+    if (writer->error != ARROW_WRITER_RET_OK)
+    {
+        return SIZE_MAX;
+    }
+
+    const size_t pos = (writer->metadata_size + alignment - 1) & ~(alignment - 1);
+    if (pos + size > writer->metadata_capacity)
+    {
+        size_t new_capacity = writer->metadata_capacity * 2;
+        while (new_capacity < pos + size)
+        {
+            new_capacity *= 2;
+        }
+        u8 *new_metadata = (u8 *)realloc(writer->metadata, new_capacity);
+        if (!new_metadata)
+        {
+            writer->error = ARROW_WRITER_RET_OOM;
+            return SIZE_MAX;
+        }
+        writer->metadata = new_metadata;
+        writer->metadata_capacity = new_capacity;
+    }
+
+    memset(writer->metadata + writer->metadata_size, 0, pos + size - writer->metadata_size);
+    writer->metadata_size = pos + size;
+    return pos;
+}
+
+static void flat_put(ArrowWriter *writer, size_t pos, const void *value, size_t size)
+{
+    if (writer->error == ARROW_WRITER_RET_OK && pos != SIZE_MAX)
+    {
+        memcpy(writer->metadata + pos, value, size);
+    }
+}
+
+static void flat_put_offset(ArrowWriter *writer, size_t pos, size_t target)
+{
+    if (pos != SIZE_MAX && target != SIZE_MAX)
+    {
+        const u32 offset = (u32)(target - pos);
+        flat_put(writer, pos, &offset, sizeof(offset));
+    }
+}
+
+//
+// field_sizes holds the inline size of every field in schema order, 0 for fields left
+// out. Fields are placed largest first so that each one lands aligned
+//
+static size_t flat_table(ArrowWriter *writer, const u8 *field_sizes, u32 field_count, size_t *out_positions)
+{
+    const size_t vtable = flat_reserve(writer, 4 + 2 * (size_t)field_count, 2);
+    const size_t table = flat_reserve(writer, 4, 4);
+
+    for (u32 size = 8; size >= 1; size /= 2)
+    {
+        for (u32 i = 0; i < field_count; i++)
+        {
+            if (field_sizes[i] == size)
+            {
+                out_positions[i] = flat_reserve(writer, size, size);
+            }
+        }
+    }
+
+    if (writer->error != ARROW_WRITER_RET_OK)
+    {
+        for (u32 i = 0; i < field_count; i++)
+        {
+            out_positions[i] = SIZE_MAX;
+        }
+        return SIZE_MAX;
+    }
+
+    const u16 vtable_header[2] = { (u16)(4 + 2 * field_count), (u16)(writer->metadata_size - table) };
+    flat_put(writer, vtable, vtable_header, sizeof(vtable_header));
+    for (u32 i = 0; i < field_count; i++)
+    {
+        const u16 field_offset = (field_sizes[i] > 0) ? (u16)(out_positions[i] - table) : 0;
+        flat_put(writer, vtable + 4 + 2 * (size_t)i, &field_offset, sizeof(field_offset));
+    }
+
+    const i32 vtable_offset = (i32)(table - vtable);
+    flat_put(writer, table, &vtable_offset, sizeof(vtable_offset));
+
+    return table;
+}
+
+//
+// The length sits right before the elements, which start aligned
+//
+static size_t flat_vector(ArrowWriter *writer, u32 count, u32 element_size, u32 alignment)
+{
+    alignment = (alignment > 4) ? alignment : 4;
+    const size_t padding = (alignment - (writer->metadata_size + 4) % alignment) % alignment;
+    const size_t start = flat_reserve(writer, padding + 4 + (size_t)count * element_size, 1);
+    if (start == SIZE_MAX)
+    {
+        return SIZE_MAX;
+    }
+
+    const size_t vector = start + padding;
+    flat_put(writer, vector, &count, sizeof(count));
+    return vector;
+}
+
+static size_t flat_string(ArrowWriter *writer, const char *value)
+{
+    const u32 length = (u32)strlen(value);
+    const size_t string = flat_reserve(writer, 4 + (size_t)length + 1, 4);
+    flat_put(writer, string, &length, sizeof(length));
+    flat_put(writer, string + 4, value, length);
+    return string;
+}
+
+//
+// Message { version, header_type, header: Schema, bodyLength } for the stream, or just
+// the Schema table for the footer when building inside one
+//
+static size_t arrow_build_schema(ArrowWriter *writer)
+{
+    size_t root = SIZE_MAX;
+    size_t message_fields[4] = { SIZE_MAX, SIZE_MAX, SIZE_MAX, SIZE_MAX };
+
+    const bool is_message = writer->metadata_size == 0;
+    if (is_message)
+    {
+        root = flat_reserve(writer, 4, 4);
+        const u8 message_sizes[4] = { 2, 1, 4, 8 };
+        const size_t message = flat_table(writer, message_sizes, 4, message_fields);
+        flat_put_offset(writer, root, message);
+
+        const i16 version = ARROW_METADATA_VERSION_V5;
+        const u8 header_type = ARROW_MESSAGE_HEADER_SCHEMA;
+        flat_put(writer, message_fields[0], &version, sizeof(version));
+        flat_put(writer, message_fields[1], &header_type, sizeof(header_type));
+    }
+
+    //
+    // Schema { endianness (little, the default), fields: [Field] }
+    //
+    const u8 schema_sizes[2] = { 0, 4 };
+    size_t schema_fields[2];
+    const size_t schema = flat_table(writer, schema_sizes, 2, schema_fields);
+    flat_put_offset(writer, message_fields[2], schema);
+
+    const size_t fields = flat_vector(writer, writer->column_count, 4, 4);
+    flat_put_offset(writer, schema_fields[1], fields);
+
+    for (u32 i = 0; i < writer->column_count; i++)
+    {
+        const size_t field = arrow_build_field(writer, &writer->columns[i].field);
+        if (fields != SIZE_MAX)
+        {
+            flat_put_offset(writer, fields + 4 + (size_t)i * 4, field);
+        }
+    }
+
+    return (writer->error == ARROW_WRITER_RET_OK) ? schema : SIZE_MAX;
+}
+
+//
+// Field { name, nullable, type_type, type, dictionary, children }
+//
+static size_t arrow_build_field(ArrowWriter *writer, const ArrowField *arrow_field)
+{
+    const u8 field_sizes[6] = { 4, 1, 1, 4, 0, 4 };
+    size_t field_positions[6];
+    const size_t field = flat_table(writer, field_sizes, 6, field_positions);
+
+    u8 type_id;
+    switch (arrow_field->type)
+    {
+    case ARROW_TYPE_BOOL:
+        type_id = ARROW_TYPE_ID_BOOL;
+        break;
+    case ARROW_TYPE_FLOAT32:
+    case ARROW_TYPE_FLOAT64:
+        type_id = ARROW_TYPE_ID_FLOATING_POINT;
+        break;
+    case ARROW_TYPE_UTF8:
+        type_id = ARROW_TYPE_ID_UTF8;
+        break;
+    default:
+        type_id = ARROW_TYPE_ID_INT;
+        break;
+    }
+
+    const u8 nullable = arrow_field->nullable;
+    flat_put(writer, field_positions[1], &nullable, sizeof(nullable));
+    flat_put(writer, field_positions[2], &type_id, sizeof(type_id));
+
+    const size_t name = flat_string(writer, arrow_field->name);
+    flat_put_offset(writer, field_positions[0], name);
+
+    size_t type;
+    if (type_id == ARROW_TYPE_ID_INT)
+    {
+        //
+        // Int { bitWidth, is_signed }
+        //
+        const u8 int_sizes[2] = { 4, 1 };
+        size_t int_fields[2];
+        type = flat_table(writer, int_sizes, 2, int_fields);
+
+        const i32 bit_width = (i32)arrow_type_width(arrow_field->type) * 8;
+        const u8 is_signed = arrow_field->type == ARROW_TYPE_INT32 || arrow_field->type == ARROW_TYPE_INT64;
+        flat_put(writer, int_fields[0], &bit_width, sizeof(bit_width));
+        flat_put(writer, int_fields[1], &is_signed, sizeof(is_signed));
+    }
+    else if (type_id == ARROW_TYPE_ID_FLOATING_POINT)
+    {
+        //
+        // FloatingPoint { precision }
+        //
+        const u8 float_sizes[1] = { 2 };
+        size_t float_fields[1];
+        type = flat_table(writer, float_sizes, 1, float_fields);
+
+        const i16 precision = (arrow_field->type == ARROW_TYPE_FLOAT32) ? ARROW_PRECISION_SINGLE : ARROW_PRECISION_DOUBLE;
+        flat_put(writer, float_fields[0], &precision, sizeof(precision));
+    }
+    else
+    {
+        //
+        // Bool and Utf8 have no parameters
+        //
+        type = flat_table(writer, nullptr, 0, nullptr);
+    }
+    flat_put_offset(writer, field_positions[3], type);
+
+    const size_t children = flat_vector(writer, 0, 4, 4);
+    flat_put_offset(writer, field_positions[5], children);
+
+    return field;
+}
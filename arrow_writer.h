@@ -0,0 +1,128 @@
+#pragma once
+
+//
+// Writes a table as an Arrow IPC file (the format also known as Feather v2), which
+// DuckDB, Polars and pyarrow read straight from a memory mapping. Values are written
+// into per-column buffers in place, one row at a time, and every batch_rows rows the
+// buffers go out as one record batch and are reused. Memory stays bounded by the batch
+// size however long the table gets. The FlatBuffers metadata the format needs is laid
+// out by hand, there is no dependency on an Arrow library.
+//
+
+#include "common.h"
+
+#define ARROW_TYPE_BOOL 0
+#define ARROW_TYPE_UINT8 1
+#define ARROW_TYPE_UINT32 2
+#define ARROW_TYPE_INT32 3
+#define ARROW_TYPE_UINT64 4
+#define ARROW_TYPE_INT64 5
+#define ARROW_TYPE_FLOAT32 6
+#define ARROW_TYPE_FLOAT64 7
+#define ARROW_TYPE_UTF8 8
+
+#define ARROW_WRITER_RET_OK 0
+#define ARROW_WRITER_RET_OOM 1
+#define ARROW_WRITER_RET_IO_ERROR 2
+
+//
+// Rows per record batch unless asked otherwise
+//
+#define ARROW_WRITER_DEFAULT_BATCH_ROWS (64 * 1024)
+
+typedef struct
+{
+    const char *name;
+    u8 type;
+    //
+    // Rows that never set the column are null. Non nullable columns read as zero instead
+    //
+    bool nullable;
+} ArrowField;
+
+typedef struct
+{
+    ArrowField field;
+    //
+    // batch_rows values, or bits for ARROW_TYPE_BOOL
+    //
+    u8 *values;
+    //
+    // One bit per row, set when the row has a value
+    //
+    u8 *validity;
+    //
+    // ARROW_TYPE_UTF8 only, batch_rows + 1 offsets into strings
+    //
+    i32 *offsets;
+    char *strings;
+    size_t string_size;
+    size_t string_capacity;
+} ArrowColumn;
+
+typedef struct
+{
+    u64 offset;
+    u32 metadata_size;
+    u64 body_size;
+} ArrowBlock;
+
+typedef struct
+{
+    FILE *file;
+    u64 file_offset;
+
+    ArrowColumn *columns;
+    u32 column_count;
+    u32 batch_rows;
+    //
+    // Rows of the batch being filled, the current row is row_count
+    //
+    u32 row_count;
+    u64 total_rows;
+
+    //
+    // Record batches written so far, listed again in the footer
+    //
+    ArrowBlock *blocks;
+    u32 block_count;
+    u32 block_capacity;
+
+    //
+    // Scratch for the FlatBuffers metadata of each message
+    //
+    u8 *metadata;
+    size_t metadata_size;
+    size_t metadata_capacity;
+
+    //
+    // First error, every later call is a no-op returning it
+    //
+    int error;
+} ArrowWriter;
+
+//
+// Creates path and writes the schema. fields is copied, the names have to outlive the
+// writer. batch_rows 0 picks ARROW_WRITER_DEFAULT_BATCH_ROWS
+//
+int arrow_writer_open(ArrowWriter *writer, const char *path, const ArrowField *fields, u32 field_count, u32 batch_rows);
+
+//
+// Writes the rows not flushed yet and the footer, then closes the file. Returns the
+// first error the writer ran into
+//
+int arrow_writer_close(ArrowWriter *writer);
+
+//
+// Set values of the current row. Integers and floats are converted to the column's width
+//
+void arrow_writer_set_bool(ArrowWriter *writer, u32 column, bool value);
+void arrow_writer_set_uint(ArrowWriter *writer, u32 column, u64 value);
+void arrow_writer_set_int(ArrowWriter *writer, u32 column, i64 value);
+void arrow_writer_set_float(ArrowWriter *writer, u32 column, f64 value);
+void arrow_writer_set_string(ArrowWriter *writer, u32 column, const char *value, size_t length);
+
+//
+// Finishes the current row, flushing the batch once it's full
+//
+int arrow_writer_end_row(ArrowWriter *writer);
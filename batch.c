@@ -0,0 +1,483 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "batch.h"
+#include "batch_reader.h"
+
+//
+// Directory entries picked up as demos, archives are decompressed when parsed
+//
+static const char *const batch_demo_extensions[] = { ".dem", ".dem.zst", ".dem.gz", ".dem.bz2" };
+
+//
+// Jobs of one worker, a slice of the job indices. Jobs are never pushed once the batch
+// runs, so popping is moving head forward
+//
+typedef struct
+{
+    pthread_mutex_t mutex;
+    u32 *job_indices;
+    u32 head;
+    u32 tail;
+} BatchQueue;
+
+typedef struct BatchPool BatchPool;
+
+typedef struct
+{
+    BatchPool *pool;
+    u32 index;
+    f64 read_wait_seconds;
+} BatchWorker;
+
+struct BatchPool
+{
+    BatchJobList *list;
+    BatchQueue *queues;
+    BatchWorker *workers;
+    u32 worker_count;
+    BatchJobFunction function;
+    void *user_data;
+    //
+    // nullptr when every job opens its own demo
+    //
+    BatchReader *reader;
+};
+
+typedef struct
+{
+    const char *name;
+    u32 job_index;
+} BatchJobName;
+
+static int batch_job_list_push(BatchJobList *list, const char *path, u64 size);
+static bool batch_is_demo_name(const char *name);
+static int batch_job_compare(const void *a, const void *b);
+static int batch_number_names(BatchJobList *list);
+static int batch_job_name_compare(const void *a, const void *b);
+static bool batch_queue_pop(BatchQueue *queue, u32 *out_job_index);
+static void *batch_worker_run(void *user_data);
+static void batch_worker_run_read_ahead(BatchWorker *worker);
+static f64 batch_seconds_since(const struct timespec *start_time);
+
+void batch_job_list_init(BatchJobList *list)
+{
+    list->jobs = nullptr;
+    list->job_count = 0;
+    list->job_capacity = 0;
+}
+
+void batch_job_list_free(BatchJobList *list)
+{
+    for (u32 i = 0; i < list->job_count; i++)
+    {
+        free(list->jobs[i].path);
+    }
+    free(list->jobs);
+    batch_job_list_init(list);
+}
+
+static int batch_job_list_push(BatchJobList *list, const char *path, u64 size)
+{
+    if (list->job_count == list->job_capacity)
+    {
+        const u32 new_capacity = (list->job_capacity) ? list->job_capacity * 2 : 64;
+        BatchJob *new_jobs = (BatchJob *)realloc(list->jobs, new_capacity * sizeof(BatchJob));
+        if (!new_jobs)
+        {
+            return BATCH_RET_OOM;
+        }
+        list->jobs = new_jobs;
+        list->job_capacity = new_capacity;
+    }
+
+    char *path_copy = strdup(path);
+    if (!path_copy)
+    {
+        return BATCH_RET_OOM;
+    }
+
+    BatchJob *job = &list->jobs[list->job_count++];
+    job->path = path_copy;
+    job->size = size;
+    job->result = 0;
+    job->data = nullptr;
+    job->data_size = 0;
+    job->mtime_ns = 0;
+    job->name_index = 0;
+
+    return BATCH_RET_OK;
+}
+
+int batch_job_list_add(BatchJobList *list, const char *path)
+{
+    struct stat file_stat;
+    if (stat(path, &file_stat) != 0)
+    {
+        return BATCH_RET_IO_ERROR;
+    }
+
+    if (!S_ISDIR(file_stat.st_mode))
+    {
+        return batch_job_list_push(list, path, (u64)file_stat.st_size);
+    }
+
+    DIR *directory = opendir(path);
+    if (!directory)
+    {
+        return BATCH_RET_IO_ERROR;
+    }
+
+    int ret_code = BATCH_RET_OK;
+
+    struct dirent *entry;
+    while ((entry = readdir(directory)) != nullptr)
+    {
+        if (!batch_is_demo_name(entry->d_name))
+        {
+            continue;
+        }
+
+        char entry_path[4096];
+        if (snprintf(entry_path, sizeof(entry_path), "%s/%s", path, entry->d_name) >= (int)sizeof(entry_path))
+        {
+            continue;
+        }
+
+        struct stat entry_stat;
+        if (stat(entry_path, &entry_stat) != 0 || !S_ISREG(entry_stat.st_mode))
+        {
+            continue;
+        }
+
+        ret_code = batch_job_list_push(list, entry_path, (u64)entry_stat.st_size);
+        if (ret_code != BATCH_RET_OK)
+        {
+            break;
+        }
+    }
+
+    closedir(directory);
+
+    return ret_code;
+}
+
+static bool batch_is_demo_name(const char *name)
+{
+    const size_t name_length = strlen(name);
+
+    for (u32 i = 0; i < sizeof(batch_demo_extensions) / sizeof(batch_demo_extensions[0]); i++)
+    {
+        const size_t extension_length = strlen(batch_demo_extensions[i]);
+        if (name_length > extension_length && strcmp(name + name_length - extension_length, batch_demo_extensions[i]) == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//
+// Largest first, ties by path so runs over the same input schedule the same way
+//
+static int batch_job_compare(const void *a, const void *b)
+{
+    const BatchJob *job_a = (const BatchJob *)a;
+    const BatchJob *job_b = (const BatchJob *)b;
+
+    if (job_a->size != job_b->size)
+    {
+        return (job_a->size > job_b->size) ? -1 : 1;
+    }
+    return strcmp(job_a->path, job_b->path);
+}
+
+//
+// Sets name_index from the order the jobs were added in, before batch_run reorders them
+//
+static int batch_number_names(BatchJobList *list)
+{
+    BatchJobName *names = (BatchJobName *)malloc(((size_t)list->job_count + 1) * sizeof(BatchJobName));
+    if (!names)
+    {
+        return BATCH_RET_OOM;
+    }
+
+    for (u32 i = 0; i < list->job_count; i++)
+    {
+        const char *separator = strrchr(list->jobs[i].path, '/');
+        names[i].name = (separator) ? separator + 1 : list->jobs[i].path;
+        names[i].job_index = i;
+    }
+
+    qsort(names, list->job_count, sizeof(BatchJobName), batch_job_name_compare);
+
+    for (u32 i = 1; i < list->job_count; i++)
+    {
+        if (strcmp(names[i].name, names[i - 1].name) == 0)
+        {
+            list->jobs[names[i].job_index].name_index = list->jobs[names[i - 1].job_index].name_index + 1;
+        }
+    }
+
+    free(names);
+
+    return BATCH_RET_OK;
+}
+
+//
+// By name, then in the order the jobs were added
+//
+static int batch_job_name_compare(const void *a, const void *b)
+{
+    const BatchJobName *name_a = (const BatchJobName *)a;
+    const BatchJobName *name_b = (const BatchJobName *)b;
+
+    const int name_order = strcmp(name_a->name, name_b->name);
+    if (name_order != 0)
+    {
+        return name_order;
+    }
+    return (name_a->job_index > name_b->job_index) - (name_a->job_index < name_b->job_index);
+}
+
+static bool batch_queue_pop(BatchQueue *queue, u32 *out_job_index)
+{
+    pthread_mutex_lock(&queue->mutex);
+
+    const bool has_job = queue->head < queue->tail;
+    if (has_job)
+    {
+        *out_job_index = queue->job_indices[queue->head++];
+    }
+
+    pthread_mutex_unlock(&queue->mutex);
+
+    return has_job;
+}
+
+static void *batch_worker_run(void *user_data)
+{
+    BatchWorker *worker = (BatchWorker *)user_data;
+    BatchPool *pool = worker->pool;
+
+    if (pool->reader)
+    {
+        batch_worker_run_read_ahead(worker);
+        return nullptr;
+    }
+
+    while (true)
+    {
+        //
+        // Own queue first, then the others starting at the next worker so thieves
+        // spread out over the victims. Thieves also take the largest job left in a
+        // queue, the goal is the shortest tail rather than the least contention
+        //
+        u32 job_index = 0;
+        bool has_job = false;
+
+        for (u32 i = 0; i < pool->worker_count && !has_job; i++)
+        {
+            has_job = batch_queue_pop(&pool->queues[(worker->index + i) % pool->worker_count], &job_index);
+        }
+
+        if (!has_job)
+        {
+            break;
+        }
+
+        BatchJob *job = &pool->list->jobs[job_index];
+        job->result = pool->function(pool->user_data, worker->index, job);
+    }
+
+    return nullptr;
+}
+
+//
+// Takes whichever demo finished reading first. The reader reads them largest first,
+// so the schedule stays close to that of the queues
+//
+static void batch_worker_run_read_ahead(BatchWorker *worker)
+{
+    BatchPool *pool = worker->pool;
+
+    while (true)
+    {
+        struct timespec wait_start;
+        clock_gettime(CLOCK_MONOTONIC, &wait_start);
+
+        BatchReaderDemo demo;
+        const bool has_demo = batch_reader_next(pool->reader, &demo);
+        worker->read_wait_seconds += batch_seconds_since(&wait_start);
+
+        if (!has_demo)
+        {
+            break;
+        }
+
+        BatchJob *job = &pool->list->jobs[demo.job_index];
+        job->data = demo.data;
+        job->data_size = demo.data_size;
+        job->mtime_ns = demo.mtime_ns;
+
+        job->result = pool->function(pool->user_data, worker->index, job);
+
+        job->data = nullptr;
+        job->data_size = 0;
+        batch_reader_release(pool->reader, demo.slot_index);
+    }
+}
+
+static f64 batch_seconds_since(const struct timespec *start_time)
+{
+    struct timespec end_time;
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    return (f64)(end_time.tv_sec - start_time->tv_sec) + (f64)(end_time.tv_nsec - start_time->tv_nsec) / 1e9;
+}
+
+int batch_run(BatchJobList *list, u32 thread_count, int read_mode, BatchJobFunction function, void *user_data, BatchStats *out_stats)
+{
+    if (thread_count == 0)
+    {
+        thread_count = 1;
+    }
+    if (list->job_count > 0 && thread_count > list->job_count)
+    {
+        thread_count = list->job_count;
+    }
+
+    if (batch_number_names(list) != BATCH_RET_OK)
+    {
+        return BATCH_RET_OOM;
+    }
+
+    qsort(list->jobs, list->job_count, sizeof(BatchJob), batch_job_compare);
+
+    BatchPool pool;
+    pool.list = list;
+    pool.worker_count = thread_count;
+    pool.function = function;
+    pool.user_data = user_data;
+    pool.reader = nullptr;
+    pool.queues = (BatchQueue *)calloc(thread_count, sizeof(BatchQueue));
+    pool.workers = (BatchWorker *)calloc(thread_count, sizeof(BatchWorker));
+
+    u32 *job_indices = (u32 *)malloc(((size_t)list->job_count + 1) * sizeof(u32));
+    pthread_t *threads = (pthread_t *)calloc(thread_count, sizeof(pthread_t));
+
+    if (!pool.queues || !pool.workers || !job_indices || !threads)
+    {
+        free(pool.queues);
+        free(pool.workers);
+        free(job_indices);
+        free(threads);
+        return BATCH_RET_OOM;
+    }
+
+    //
+    // Deal the sorted jobs round robin, every worker starts on one of the largest demos
+    // and the queues stay balanced in bytes as well as in count
+    //
+    u32 next_index = 0;
+    for (u32 worker_index = 0; worker_index < thread_count; worker_index++)
+    {
+        BatchQueue *queue = &pool.queues[worker_index];
+        pthread_mutex_init(&queue->mutex, nullptr);
+        queue->job_indices = &job_indices[next_index];
+        queue->head = 0;
+        queue->tail = 0;
+
+        for (u32 job_index = worker_index; job_index < list->job_count; job_index += thread_count)
+        {
+            job_indices[next_index++] = job_index;
+            queue->tail++;
+        }
+
+        pool.workers[worker_index].pool = &pool;
+        pool.workers[worker_index].index = worker_index;
+    }
+
+    struct timespec start_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+    //
+    // Without a reader thread the jobs open their own demos, which still works
+    //
+    BatchReader reader;
+    if (read_mode != BATCH_READ_NONE &&
+        batch_reader_init(&reader, list, thread_count + BATCH_READER_READAHEAD_SLOTS, read_mode) == BATCH_READER_RET_OK)
+    {
+        pool.reader = &reader;
+    }
+
+    u32 started_count = 0;
+
+    for (u32 i = 0; i < thread_count; i++)
+    {
+        if (pthread_create(&threads[i], nullptr, batch_worker_run, &pool.workers[i]) != 0)
+        {
+            break;
+        }
+        started_count++;
+    }
+
+    //
+    // If some threads failed to start the ones that did steal their work, if none did
+    // the calling thread does it all
+    //
+    if (started_count == 0)
+    {
+        batch_worker_run(&pool.workers[0]);
+    }
+
+    for (u32 i = 0; i < started_count; i++)
+    {
+        pthread_join(threads[i], nullptr);
+    }
+
+    out_stats->demo_count = list->job_count;
+    out_stats->failed_count = 0;
+    out_stats->byte_count = 0;
+    out_stats->seconds = batch_seconds_since(&start_time);
+    out_stats->read_mode = BATCH_READ_NONE;
+    out_stats->read_wait_seconds = 0.0;
+
+    if (pool.reader)
+    {
+        out_stats->read_mode = reader.mode;
+        for (u32 i = 0; i < thread_count; i++)
+        {
+            out_stats->read_wait_seconds += pool.workers[i].read_wait_seconds;
+        }
+        batch_reader_destroy(&reader);
+    }
+
+    for (u32 i = 0; i < list->job_count; i++)
+    {
+        out_stats->byte_count += list->jobs[i].size;
+        if (list->jobs[i].result != 0)
+        {
+            out_stats->failed_count++;
+        }
+    }
+
+    for (u32 i = 0; i < thread_count; i++)
+    {
+        pthread_mutex_destroy(&pool.queues[i].mutex);
+    }
+
+    free(pool.queues);
+    free(pool.workers);
+    free(job_indices);
+    free(threads);
+
+    return BATCH_RET_OK;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+//
+// Batch mode. Runs many demos through one process on a pool of worker threads, one
+// demo per worker at a time. Jobs are sorted largest first and dealt out round robin
+// to per-worker queues. A worker drains its own queue and then steals from the others,
+// so a few huge demos started last can't leave every other worker idle at the end.
+// When the batch reads the demos ahead itself, workers instead take them in the order
+// the reads completed, which is about the same order.
+//
+
+#include <pthread.h>
+
+#include "common.h"
+
+#define BATCH_RET_OK 0
+#define BATCH_RET_OOM 1
+#define BATCH_RET_IO_ERROR 2
+
+//
+// How the demos are read. With BATCH_READ_NONE every job opens its own demo, otherwise
+// a reader thread loads them into memory ahead of the workers (see batch_reader.h)
+//
+#define BATCH_READ_NONE 0
+#define BATCH_READ_IO_URING 1
+#define BATCH_READ_PREAD 2
+
+typedef struct
+{
+    char *path;
+    u64 size;
+    //
+    // Return code of the job function, set once the job ran
+    //
+    int result;
+    //
+    // The demo as read ahead by the batch, valid during the job function only.
+    // nullptr when the batch doesn't read ahead or the read failed
+    //
+    const u8 *data;
+    size_t data_size;
+    u64 mtime_ns;
+    //
+    // Jobs added before this one with the same file name, set by batch_run. Outputs
+    // named after the file use it to stay apart, 0 for the first or only one
+    //
+    u32 name_index;
+} BatchJob;
+
+typedef struct
+{
+    BatchJob *jobs;
+    u32 job_count;
+    u32 job_capacity;
+} BatchJobList;
+
+typedef struct
+{
+    u32 demo_count;
+    u32 failed_count;
+    u64 byte_count;
+    f64 seconds;
+    //
+    // BATCH_READ_* the demos were actually read with, and the time workers spent
+    // waiting for a demo to finish reading, summed over the workers
+    //
+    int read_mode;
+    f64 read_wait_seconds;
+} BatchStats;
+
+//
+// Processes one job on worker worker_index. Non-zero results count as failures
+//
+typedef int (*BatchJobFunction)(void *user_data, u32 worker_index, BatchJob *job);
+
+void batch_job_list_init(BatchJobList *list);
+void batch_job_list_free(BatchJobList *list);
+
+//
+// Adds a demo file, or every *.dem, *.dem.zst, *.dem.gz and *.dem.bz2 file directly
+// inside a directory
+//
+int batch_job_list_add(BatchJobList *list, const char *path);
+
+//
+// Runs every job on thread_count workers and blocks until all of them finished.
+// Reorders the jobs, largest first, and sets their name_index. read_mode is one of
+// BATCH_READ_*, when reading ahead the workers take the demos in the order their reads
+// completed instead of from the per-worker queues
+//
+int batch_run(BatchJobList *list, u32 thread_count, int read_mode, BatchJobFunction function, void *user_data, BatchStats *out_stats);
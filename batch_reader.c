@@ -0,0 +1,721 @@
+#define _GNU_SOURCE
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#include "batch_reader.h"
+
+//
+// Registered buffers are limited to 1 GiB each, bigger demos are read unregistered
+//
+#define BATCH_READER_MAX_REGISTERED_SIZE (1024ull * 1024 * 1024)
+
+//
+// pread reads this much of a demo per call. Readahead works in the background, a
+// bigger call only means fewer syscalls
+//
+#define BATCH_READER_PREAD_SIZE (8 * 1024 * 1024)
+
+static void *batch_reader_run(void *user_data);
+static bool batch_reader_claim_slots(BatchReader *reader);
+static void batch_reader_open_slot(BatchReader *reader, BatchReaderSlot *slot);
+static void batch_reader_finish_slot(BatchReader *reader, BatchReaderSlot *slot);
+static void batch_reader_read_pread(BatchReader *reader);
+static void batch_reader_read_ring(BatchReader *reader);
+static void batch_reader_abandon(BatchReader *reader);
+static void batch_reader_drain(BatchReader *reader);
+static void batch_reader_queue_read(BatchReader *reader, u32 request_index);
+static void batch_reader_complete_read(BatchReader *reader, u32 request_index, int result);
+
+static bool batch_ring_init(BatchRing *ring, u32 entry_count, u32 buffer_count);
+static void batch_ring_free(BatchRing *ring);
+static bool batch_ring_register_buffer(BatchRing *ring, u32 buffer_index, u8 *data, size_t size);
+static int batch_ring_enter(BatchRing *ring, u32 wait_count);
+
+int batch_reader_init(BatchReader *reader, const BatchJobList *list, u32 slot_count, int mode)
+{
+    memset(reader, 0, sizeof(*reader));
+    reader->list = list;
+    reader->mode = mode;
+    reader->ring.fd = -1;
+    reader->slot_count = (slot_count > 0) ? slot_count : 1;
+    reader->free_count = reader->slot_count;
+
+    reader->slots = (BatchReaderSlot *)calloc(reader->slot_count, sizeof(BatchReaderSlot));
+    reader->ready = (u32 *)calloc(reader->slot_count, sizeof(u32));
+    if (!reader->slots || !reader->ready)
+    {
+        free(reader->slots);
+        free(reader->ready);
+        return BATCH_READER_RET_OOM;
+    }
+
+    for (u32 i = 0; i < reader->slot_count; i++)
+    {
+        reader->slots[i].fd = -1;
+    }
+
+    for (u32 i = 0; i < BATCH_READER_QUEUE_DEPTH; i++)
+    {
+        reader->free_requests[i] = BATCH_READER_QUEUE_DEPTH - 1 - i;
+    }
+    reader->free_request_count = BATCH_READER_QUEUE_DEPTH;
+
+    if (reader->mode == BATCH_READ_IO_URING && !batch_ring_init(&reader->ring, BATCH_READER_QUEUE_DEPTH, reader->slot_count))
+    {
+        reader->mode = BATCH_READ_PREAD;
+    }
+
+    pthread_mutex_init(&reader->mutex, nullptr);
+    pthread_cond_init(&reader->slot_ready, nullptr);
+    pthread_cond_init(&reader->slot_free, nullptr);
+
+    if (pthread_create(&reader->thread, nullptr, batch_reader_run, reader) != 0)
+    {
+        pthread_cond_destroy(&reader->slot_free);
+        pthread_cond_destroy(&reader->slot_ready);
+        pthread_mutex_destroy(&reader->mutex);
+        batch_ring_free(&reader->ring);
+        free(reader->slots);
+        free(reader->ready);
+        return BATCH_READER_RET_THREAD_ERROR;
+    }
+
+    return BATCH_READER_RET_OK;
+}
+
+void batch_reader_destroy(BatchReader *reader)
+{
+    pthread_mutex_lock(&reader->mutex);
+    reader->shutdown = true;
+    pthread_cond_broadcast(&reader->slot_free);
+    pthread_cond_broadcast(&reader->slot_ready);
+    pthread_mutex_unlock(&reader->mutex);
+
+    pthread_join(reader->thread, nullptr);
+
+    //
+    // The reader stops at shutdown with reads still in flight, and closing the ring
+    // doesn't wait for them
+    //
+    batch_reader_drain(reader);
+    batch_ring_free(&reader->ring);
+
+    for (u32 i = 0; i < reader->slot_count; i++)
+    {
+        if (reader->slots[i].fd >= 0)
+        {
+            close(reader->slots[i].fd);
+        }
+
+        //
+        // Reads that couldn't be waited for may still land in the buffer, it's leaked
+        // instead of freed under them
+        //
+        if (reader->slots[i].inflight_count == 0)
+        {
+            free(reader->slots[i].data);
+        }
+    }
+
+    pthread_cond_destroy(&reader->slot_free);
+    pthread_cond_destroy(&reader->slot_ready);
+    pthread_mutex_destroy(&reader->mutex);
+    free(reader->slots);
+    free(reader->ready);
+}
+
+bool batch_reader_next(BatchReader *reader, BatchReaderDemo *out_demo)
+{
+    pthread_mutex_lock(&reader->mutex);
+
+    while (reader->ready_count == 0 && reader->delivered_count < reader->list->job_count && !reader->shutdown)
+    {
+        pthread_cond_wait(&reader->slot_ready, &reader->mutex);
+    }
+
+    if (reader->ready_count == 0)
+    {
+        pthread_mutex_unlock(&reader->mutex);
+        return false;
+    }
+
+    const u32 slot_index = reader->ready[reader->ready_head];
+    reader->ready_head = (reader->ready_head + 1) % reader->slot_count;
+    reader->ready_count--;
+    reader->delivered_count++;
+
+    //
+    // Workers still waiting have nothing left to wait for. Reads only wake one of them,
+    // which matters once workers outrun the reader
+    //
+    if (reader->delivered_count == reader->list->job_count)
+    {
+        pthread_cond_broadcast(&reader->slot_ready);
+    }
+
+    BatchReaderSlot *slot = &reader->slots[slot_index];
+    slot->state = BATCH_READER_SLOT_TAKEN;
+
+    out_demo->job_index = slot->job_index;
+    out_demo->slot_index = slot_index;
+    out_demo->data = (slot->is_loaded) ? slot->data : nullptr;
+    out_demo->data_size = (slot->is_loaded) ? slot->data_size : 0;
+    out_demo->mtime_ns = slot->mtime_ns;
+
+    pthread_mutex_unlock(&reader->mutex);
+
+    return true;
+}
+
+void batch_reader_release(BatchReader *reader, u32 slot_index)
+{
+    pthread_mutex_lock(&reader->mutex);
+    reader->slots[slot_index].state = BATCH_READER_SLOT_FREE;
+    reader->free_count++;
+    pthread_cond_signal(&reader->slot_free);
+    pthread_mutex_unlock(&reader->mutex);
+}
+
+static void *batch_reader_run(void *user_data)
+{
+    BatchReader *reader = (BatchReader *)user_data;
+
+    while (batch_reader_claim_slots(reader))
+    {
+        if (reader->mode == BATCH_READ_IO_URING)
+        {
+            batch_reader_read_ring(reader);
+        }
+        else if (reader->mode == BATCH_READ_PREAD)
+        {
+            batch_reader_read_pread(reader);
+        }
+    }
+
+    return nullptr;
+}
+
+//
+// Starts the next jobs on the free slots, waiting for a slot while nothing is being
+// read. Returns false once every job was read or the reader shuts down
+//
+static bool batch_reader_claim_slots(BatchReader *reader)
+{
+    const u32 job_count = reader->list->job_count;
+
+    pthread_mutex_lock(&reader->mutex);
+
+    while (!reader->shutdown && reader->reading_count == 0 && reader->next_job < job_count && reader->free_count == 0)
+    {
+        pthread_cond_wait(&reader->slot_free, &reader->mutex);
+    }
+
+    if (reader->shutdown || (reader->reading_count == 0 && reader->next_job == job_count))
+    {
+        pthread_mutex_unlock(&reader->mutex);
+        return false;
+    }
+
+    u32 opened_count = 0;
+    u32 opened[BATCH_READER_QUEUE_DEPTH];
+
+    for (u32 i = 0; i < reader->slot_count && reader->next_job < job_count && opened_count < BATCH_READER_QUEUE_DEPTH; i++)
+    {
+        BatchReaderSlot *slot = &reader->slots[i];
+        if (slot->state != BATCH_READER_SLOT_FREE)
+        {
+            continue;
+        }
+
+        slot->state = BATCH_READER_SLOT_READING;
+        slot->job_index = reader->next_job++;
+        reader->free_count--;
+        reader->reading_count++;
+        opened[opened_count++] = i;
+    }
+
+    pthread_mutex_unlock(&reader->mutex);
+
+    //
+    // Slots being read belong to the reader thread, no lock needed from here
+    //
+    for (u32 i = 0; i < opened_count; i++)
+    {
+        BatchReaderSlot *slot = &reader->slots[opened[i]];
+        batch_reader_open_slot(reader, slot);
+        if (!slot->is_loaded || slot->completed_size == slot->data_size)
+        {
+            batch_reader_finish_slot(reader, slot);
+        }
+    }
+
+    return true;
+}
+
+static void batch_reader_open_slot(BatchReader *reader, BatchReaderSlot *slot)
+{
+    const BatchJob *job = &reader->list->jobs[slot->job_index];
+
+    slot->is_loaded = false;
+    slot->data_size = 0;
+    slot->mtime_ns = 0;
+    slot->submitted_size = 0;
+    slot->completed_size = 0;
+
+    if (reader->mode == BATCH_READ_NONE)
+    {
+        return;
+    }
+
+    slot->fd = open(job->path, O_RDONLY | O_CLOEXEC);
+    if (slot->fd < 0)
+    {
+        return;
+    }
+
+    //
+    // Anything but a non-empty regular file is left to the worker, which streams it
+    //
+    struct stat file_stat;
+    if (fstat(slot->fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode) || file_stat.st_size == 0)
+    {
+        close(slot->fd);
+        slot->fd = -1;
+        return;
+    }
+
+    const size_t file_size = (size_t)file_stat.st_size;
+
+    if (slot->data_capacity < file_size)
+    {
+        //
+        // Jobs run largest first, so a slot usually grows on its first demo only
+        //
+        free(slot->data);
+        slot->data = (u8 *)malloc(file_size);
+        slot->data_capacity = (slot->data) ? file_size : 0;
+        slot->is_registered = false;
+
+        if (!slot->data)
+        {
+            close(slot->fd);
+            slot->fd = -1;
+            return;
+        }
+    }
+
+    if (reader->mode == BATCH_READ_IO_URING && !slot->is_registered && reader->ring.has_registered_buffers &&
+        slot->data_capacity <= BATCH_READER_MAX_REGISTERED_SIZE)
+    {
+        slot->is_registered = batch_ring_register_buffer(&reader->ring, (u32)(slot - reader->slots), slot->data, slot->data_capacity);
+    }
+
+    if (reader->mode == BATCH_READ_PREAD)
+    {
+        //
+        // Starts reading the whole demo in the background while earlier slots are
+        // still being read with pread
+        //
+        posix_fadvise(slot->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        posix_fadvise(slot->fd, 0, 0, POSIX_FADV_WILLNEED);
+    }
+
+    slot->data_size = file_size;
+    slot->mtime_ns = (u64)file_stat.st_mtim.tv_sec * 1000000000ull + (u64)file_stat.st_mtim.tv_nsec;
+    slot->is_loaded = true;
+}
+
+//
+// Hands a slot that finished reading, or failed to, to the workers
+//
+static void batch_reader_finish_slot(BatchReader *reader, BatchReaderSlot *slot)
+{
+    if (slot->fd >= 0)
+    {
+        close(slot->fd);
+        slot->fd = -1;
+    }
+
+    pthread_mutex_lock(&reader->mutex);
+
+    slot->state = BATCH_READER_SLOT_READY;
+    reader->ready[(reader->ready_head + reader->ready_count) % reader->slot_count] = (u32)(slot - reader->slots);
+    reader->ready_count++;
+    reader->reading_count--;
+    pthread_cond_signal(&reader->slot_ready);
+
+    pthread_mutex_unlock(&reader->mutex);
+}
+
+//
+// Reads the oldest demo being read to the end, the others are read ahead by the kernel
+//
+static void batch_reader_read_pread(BatchReader *reader)
+{
+    BatchReaderSlot *slot = nullptr;
+    for (u32 i = 0; i < reader->slot_count; i++)
+    {
+        BatchReaderSlot *candidate = &reader->slots[i];
+        if (candidate->state == BATCH_READER_SLOT_READING && (!slot || candidate->job_index < slot->job_index))
+        {
+            slot = candidate;
+        }
+    }
+
+    if (!slot)
+    {
+        return;
+    }
+
+    while (slot->completed_size < slot->data_size)
+    {
+        const size_t remaining_size = slot->data_size - slot->completed_size;
+        const size_t read_size = (remaining_size < BATCH_READER_PREAD_SIZE) ? remaining_size : BATCH_READER_PREAD_SIZE;
+        const ssize_t ret = pread(slot->fd, slot->data + slot->completed_size, read_size, (off_t)slot->completed_size);
+
+        if (ret < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (ret <= 0)
+        {
+            //
+            // Error, or the demo shrank since it was opened
+            //
+            slot->is_loaded = false;
+            break;
+        }
+
+        slot->completed_size += (size_t)ret;
+    }
+
+    batch_reader_finish_slot(reader, slot);
+}
+
+//
+// Queues chunks of the demos being read, oldest demo first, then waits for at least
+// one of them to complete. Small demos are read several at a time this way, and a
+// big one gets the whole queue
+//
+static void batch_reader_read_ring(BatchReader *reader)
+{
+    while (reader->free_request_count > 0)
+    {
+        BatchReaderSlot *slot = nullptr;
+        for (u32 i = 0; i < reader->slot_count; i++)
+        {
+            BatchReaderSlot *candidate = &reader->slots[i];
+            if (candidate->state == BATCH_READER_SLOT_READING && candidate->is_loaded && candidate->submitted_size < candidate->data_size &&
+                (!slot || candidate->job_index < slot->job_index))
+            {
+                slot = candidate;
+            }
+        }
+
+        if (!slot)
+        {
+            break;
+        }
+
+        const size_t remaining_size = slot->data_size - slot->submitted_size;
+        const u32 request_index = reader->free_requests[--reader->free_request_count];
+        BatchReaderRequest *request = &reader->requests[request_index];
+        request->slot_index = (u32)(slot - reader->slots);
+        request->offset = slot->submitted_size;
+        request->size = (u32)((remaining_size < BATCH_READER_CHUNK_SIZE) ? remaining_size : BATCH_READER_CHUNK_SIZE);
+
+        slot->submitted_size += request->size;
+        slot->inflight_count++;
+
+        batch_reader_queue_read(reader, request_index);
+    }
+
+    const bool has_inflight = reader->free_request_count < BATCH_READER_QUEUE_DEPTH;
+    if (batch_ring_enter(&reader->ring, (has_inflight) ? 1 : 0) != 0)
+    {
+        batch_reader_abandon(reader);
+        return;
+    }
+
+    BatchRing *ring = &reader->ring;
+    u32 head = *ring->cq_head;
+    const u32 tail = atomic_load_explicit((_Atomic u32 *)ring->cq_tail, memory_order_acquire);
+
+    while (head != tail)
+    {
+        const struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+        const u32 request_index = (u32)cqe->user_data;
+        const int result = cqe->res;
+        head++;
+        atomic_store_explicit((_Atomic u32 *)ring->cq_head, head, memory_order_release);
+
+        batch_reader_complete_read(reader, request_index, result);
+    }
+}
+
+//
+// The ring stopped working. Reads still in flight may yet land in the slot buffers, so
+// they are never read into again and the workers open the remaining demos themselves.
+// The slots keep their inflight_count, batch_reader_destroy leaves those buffers alone
+//
+static void batch_reader_abandon(BatchReader *reader)
+{
+    reader->mode = BATCH_READ_NONE;
+
+    for (u32 i = 0; i < reader->slot_count; i++)
+    {
+        BatchReaderSlot *slot = &reader->slots[i];
+        if (slot->state == BATCH_READER_SLOT_READING)
+        {
+            slot->is_loaded = false;
+            batch_reader_finish_slot(reader, slot);
+        }
+    }
+}
+
+//
+// Waits for every read still queued or in flight, without queueing the rest of short
+// ones. Gives up when the ring fails, leaving inflight_count set on the slots
+//
+static void batch_reader_drain(BatchReader *reader)
+{
+    BatchRing *ring = &reader->ring;
+
+    while (reader->mode == BATCH_READ_IO_URING && reader->free_request_count < BATCH_READER_QUEUE_DEPTH)
+    {
+        if (batch_ring_enter(ring, 1) != 0)
+        {
+            return;
+        }
+
+        u32 head = *ring->cq_head;
+        const u32 tail = atomic_load_explicit((_Atomic u32 *)ring->cq_tail, memory_order_acquire);
+
+        while (head != tail)
+        {
+            const u32 request_index = (u32)ring->cqes[head & ring->cq_mask].user_data;
+            head++;
+            atomic_store_explicit((_Atomic u32 *)ring->cq_head, head, memory_order_release);
+
+            reader->slots[reader->requests[request_index].slot_index].inflight_count--;
+            reader->free_requests[reader->free_request_count++] = request_index;
+        }
+    }
+}
+
+static void batch_reader_queue_read(BatchReader *reader, u32 request_index)
+{
+    BatchRing *ring = &reader->ring;
+    const BatchReaderRequest *request = &reader->requests[request_index];
+    const BatchReaderSlot *slot = &reader->slots[request->slot_index];
+
+    const u32 tail = *ring->sq_tail;
+    struct io_uring_sqe *sqe = &ring->sqes[tail & ring->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+
+    sqe->opcode = (slot->is_registered) ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe->fd = slot->fd;
+    sqe->off = request->offset;
+    sqe->addr = (u64)(uintptr_t)(slot->data + request->offset);
+    sqe->len = request->size;
+    sqe->buf_index = (u16)((slot->is_registered) ? request->slot_index : 0);
+    sqe->user_data = request_index;
+
+    atomic_store_explicit((_Atomic u32 *)ring->sq_tail, tail + 1, memory_order_release);
+    ring->pending_count++;
+}
+
+static void batch_reader_complete_read(BatchReader *reader, u32 request_index, int result)
+{
+    BatchReaderRequest *request = &reader->requests[request_index];
+    BatchReaderSlot *slot = &reader->slots[request->slot_index];
+
+    if ((result == -EINTR || result == -EAGAIN) && slot->is_loaded)
+    {
+        batch_reader_queue_read(reader, request_index);
+        return;
+    }
+
+    if (result > 0 && (u32)result < request->size && slot->is_loaded)
+    {
+        //
+        // Short read, queue the rest of the chunk
+        //
+        slot->completed_size += (size_t)result;
+        request->offset += (u64)result;
+        request->size -= (u32)result;
+        batch_reader_queue_read(reader, request_index);
+        return;
+    }
+
+    if (result > 0)
+    {
+        slot->completed_size += (size_t)result;
+    }
+    else
+    {
+        //
+        // Error, or the demo shrank since it was opened. Nothing more is queued for it
+        //
+        slot->is_loaded = false;
+    }
+
+    reader->free_requests[reader->free_request_count++] = request_index;
+    slot->inflight_count--;
+
+    if (slot->inflight_count == 0 && (!slot->is_loaded || slot->completed_size == slot->data_size))
+    {
+        batch_reader_finish_slot(reader, slot);
+    }
+}
+
+static bool batch_ring_init(BatchRing *ring, u32 entry_count, u32 buffer_count)
+{
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    const int fd = (int)syscall(__NR_io_uring_setup, entry_count, &params);
+    if (fd < 0)
+    {
+        return false;
+    }
+    ring->fd = fd;
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(u32);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap && ring->cq_ring_size > ring->sq_ring_size)
+    {
+        ring->sq_ring_size = ring->cq_ring_size;
+    }
+
+    ring->sq_ring = mmap(nullptr, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED)
+    {
+        ring->sq_ring = nullptr;
+        batch_ring_free(ring);
+        return false;
+    }
+
+    ring->cq_ring = (single_mmap) ? ring->sq_ring : mmap(nullptr, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (ring->cq_ring == MAP_FAILED)
+    {
+        ring->cq_ring = nullptr;
+        batch_ring_free(ring);
+        return false;
+    }
+
+    ring->sqes = (struct io_uring_sqe *)mmap(nullptr, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED)
+    {
+        ring->sqes = nullptr;
+        batch_ring_free(ring);
+        return false;
+    }
+
+    u8 *sq_ring = (u8 *)ring->sq_ring;
+    u8 *cq_ring = (u8 *)ring->cq_ring;
+    ring->sq_tail = (u32 *)(sq_ring + params.sq_off.tail);
+    ring->sq_mask = *(u32 *)(sq_ring + params.sq_off.ring_mask);
+    ring->cq_head = (u32 *)(cq_ring + params.cq_off.head);
+    ring->cq_tail = (u32 *)(cq_ring + params.cq_off.tail);
+    ring->cq_mask = *(u32 *)(cq_ring + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq_ring + params.cq_off.cqes);
+
+    //
+    // Submission entries are used in ring order, so the indirection array stays fixed
+    //
+    u32 *sq_array = (u32 *)(sq_ring + params.sq_off.array);
+    for (u32 i = 0; i < params.sq_entries; i++)
+    {
+        sq_array[i] = i;
+    }
+
+    //
+    // Sparse buffer table, filled in as the slot buffers get allocated. Kernels before
+    // 5.19 don't have it and read into unregistered buffers
+    //
+    struct io_uring_rsrc_register buffers;
+    memset(&buffers, 0, sizeof(buffers));
+    buffers.nr = buffer_count;
+    buffers.flags = IORING_RSRC_REGISTER_SPARSE;
+    ring->has_registered_buffers = syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS2, &buffers, sizeof(buffers)) == 0;
+
+    return true;
+}
+
+static void batch_ring_free(BatchRing *ring)
+{
+    if (ring->sqes)
+    {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ring && ring->cq_ring != ring->sq_ring)
+    {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if (ring->sq_ring)
+    {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+    if (ring->fd >= 0)
+    {
+        close(ring->fd);
+    }
+
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+static bool batch_ring_register_buffer(BatchRing *ring, u32 buffer_index, u8 *data, size_t size)
+{
+    struct iovec buffer = { .iov_base = data, .iov_len = size };
+
+    struct io_uring_rsrc_update2 update;
+    memset(&update, 0, sizeof(update));
+    update.offset = buffer_index;
+    update.data = (u64)(uintptr_t)&buffer;
+    update.nr = 1;
+
+    return syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS_UPDATE, &update, sizeof(update)) == 1;
+}
+
+//
+// Submits the queued reads and waits for wait_count completions. EAGAIN and EBUSY
+// only mean the kernel is short on resources, the next call after reaping retries
+//
+static int batch_ring_enter(BatchRing *ring, u32 wait_count)
+{
+    while (true)
+    {
+        const long ret = syscall(__NR_io_uring_enter, ring->fd, ring->pending_count, wait_count, (wait_count > 0) ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0);
+        if (ret >= 0)
+        {
+            ring->pending_count -= (u32)ret;
+            return 0;
+        }
+        if (errno == EAGAIN || errno == EBUSY)
+        {
+            return 0;
+        }
+        if (errno != EINTR)
+        {
+            return -1;
+        }
+    }
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+//
+// Reads the demos of a batch ahead of the workers, so the disks stay busy while the
+// workers are busy decompressing and parsing. A reader thread loads whole demos into
+// a fixed set of slot buffers, in job order, and the workers take them in the order
+// they completed. With io_uring several demos are read at once, each in chunks that
+// are queued together, and the slot buffers are registered with the ring once and
+// reused for every demo read into them. Where io_uring isn't available (old kernels,
+// seccomp filters in containers) the reader falls back to pread, asking the kernel to
+// read ahead on the demos queued behind the one being read.
+//
+
+#include <pthread.h>
+
+#include <linux/io_uring.h>
+
+#include "common.h"
+#include "batch.h"
+
+#define BATCH_READER_RET_OK 0
+#define BATCH_READER_RET_OOM 1
+#define BATCH_READER_RET_THREAD_ERROR 2
+
+//
+// Bytes per read request, and requests queued on the ring at most
+//
+#define BATCH_READER_CHUNK_SIZE (1024 * 1024)
+#define BATCH_READER_QUEUE_DEPTH 32
+
+//
+// Slots beyond one per worker, demos read ahead while every worker is busy
+//
+#define BATCH_READER_READAHEAD_SLOTS 2
+
+#define BATCH_READER_SLOT_FREE 0
+#define BATCH_READER_SLOT_READING 1
+#define BATCH_READER_SLOT_READY 2
+#define BATCH_READER_SLOT_TAKEN 3
+
+typedef struct
+{
+    int state;
+    u32 job_index;
+    int fd;
+    //
+    // Cleared when the demo couldn't be read, the worker then opens it itself
+    //
+    bool is_loaded;
+    bool is_registered;
+
+    u8 *data;
+    size_t data_capacity;
+    size_t data_size;
+    u64 mtime_ns;
+
+    size_t submitted_size;
+    size_t completed_size;
+    u32 inflight_count;
+} BatchReaderSlot;
+
+typedef struct
+{
+    u32 slot_index;
+    u64 offset;
+    u32 size;
+} BatchReaderRequest;
+
+typedef struct
+{
+    int fd;
+    u32 *sq_tail;
+    u32 sq_mask;
+    struct io_uring_sqe *sqes;
+    u32 *cq_head;
+    u32 *cq_tail;
+    u32 cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+    //
+    // Queued since the last io_uring_enter
+    //
+    u32 pending_count;
+    bool has_registered_buffers;
+} BatchRing;
+
+typedef struct
+{
+    const BatchJobList *list;
+    //
+    // BATCH_READ_IO_URING or BATCH_READ_PREAD after falling back, BATCH_READ_NONE once
+    // the ring failed mid batch
+    //
+    int mode;
+
+    BatchReaderSlot *slots;
+    u32 slot_count;
+    //
+    // Slots that finished reading, in the order they finished
+    //
+    u32 *ready;
+    u32 ready_head;
+    u32 ready_count;
+
+    u32 next_job;
+    u32 delivered_count;
+    u32 reading_count;
+    u32 free_count;
+    bool shutdown;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t slot_ready;
+    pthread_cond_t slot_free;
+    pthread_t thread;
+
+    //
+    // Reader thread only
+    //
+    BatchRing ring;
+    BatchReaderRequest requests[BATCH_READER_QUEUE_DEPTH];
+    u32 free_requests[BATCH_READER_QUEUE_DEPTH];
+    u32 free_request_count;
+} BatchReader;
+
+typedef struct
+{
+    u32 job_index;
+    u32 slot_index;
+    //
+    // nullptr when the demo couldn't be read ahead
+    //
+    const u8 *data;
+    size_t data_size;
+    u64 mtime_ns;
+} BatchReaderDemo;
+
+//
+// Starts reading the jobs of list in order. mode is BATCH_READ_IO_URING or
+// BATCH_READ_PREAD, io_uring falls back to pread when the ring can't be set up
+//
+int batch_reader_init(BatchReader *reader, const BatchJobList *list, u32 slot_count, int mode);
+
+//
+// Blocks until a demo was read. Returns false once every job was handed out
+//
+bool batch_reader_next(BatchReader *reader, BatchReaderDemo *out_demo);
+
+//
+// Hands the demo's slot back for the next read, its data is invalid afterwards
+//
+void batch_reader_release(BatchReader *reader, u32 slot_index);
+
+//
+// Stops reading and joins the reader thread. Demos not taken yet are dropped
+//
+void batch_reader_destroy(BatchReader *reader);
@@ -0,0 +1,159 @@
+#pragma once
+
+//
+// Shared reporting for the benchmark executables. Every benchmark produces a
+// BenchResult, reported as text or, with --json, as one JSON object per line. Given
+// --baseline, results are compared against a previous --json run and a benchmark
+// whose throughput dropped by more than --threshold percent counts as a regression,
+// which makes the executable exit with 1.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../common.h"
+
+#define BENCH_NAME_MAX 128
+#define BENCH_BASELINE_MAX 256
+#define BENCH_DEFAULT_THRESHOLD_PERCENT 10.0
+
+typedef struct
+{
+    const char *name;
+    f64 seconds;
+    size_t bytes;
+    u64 checksum;
+} BenchResult;
+
+typedef struct
+{
+    char name[BENCH_NAME_MAX];
+    f64 bytes_per_second;
+} BenchBaselineEntry;
+
+typedef struct
+{
+    bool json;
+    f64 threshold_percent;
+    BenchBaselineEntry baseline[BENCH_BASELINE_MAX];
+    u32 baseline_count;
+    u32 regression_count;
+} BenchReporter;
+
+static inline f64 bench_now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (f64)ts.tv_sec + (f64)ts.tv_nsec * 1e-9;
+}
+
+static inline bool bench_load_baseline(BenchReporter *reporter, const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        return false;
+    }
+
+    char line[512];
+    while (fgets(line, sizeof(line), file) && reporter->baseline_count < BENCH_BASELINE_MAX)
+    {
+        BenchBaselineEntry *entry = &reporter->baseline[reporter->baseline_count];
+        if (sscanf(line, "{\"name\":\"%127[^\"]\",\"bytes\":%*u,\"seconds\":%*f,\"bytes_per_second\":%lf", entry->name, &entry->bytes_per_second) == 2)
+        {
+            reporter->baseline_count++;
+        }
+    }
+
+    fclose(file);
+    return true;
+}
+
+//
+// Handles --json, --baseline <file> and --threshold <percent>. Arguments it doesn't
+// know are left for the caller, returns false on a malformed one
+//
+static inline bool bench_reporter_init(BenchReporter *reporter, int argc, char *argv[])
+{
+    memset(reporter, 0, sizeof(*reporter));
+    reporter->threshold_percent = BENCH_DEFAULT_THRESHOLD_PERCENT;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--json") == 0)
+        {
+            reporter->json = true;
+        }
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+        {
+            if (!bench_load_baseline(reporter, argv[++i]))
+            {
+                fprintf(stderr, "Failed to read baseline %s\n", argv[i]);
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+        {
+            reporter->threshold_percent = strtod(argv[++i], nullptr);
+        }
+    }
+
+    return true;
+}
+
+static inline void bench_report(BenchReporter *reporter, BenchResult result)
+{
+    const f64 bytes_per_second = (result.seconds > 0.0) ? (f64)result.bytes / result.seconds : 0.0;
+
+    if (reporter->json)
+    {
+        printf("{\"name\":\"%s\",\"bytes\":%zu,\"seconds\":%.9f,\"bytes_per_second\":%.1f,\"checksum\":\"%016llx\"}\n",
+               result.name, result.bytes, result.seconds, bytes_per_second, (unsigned long long)result.checksum);
+    }
+    else
+    {
+        printf("%-44s %8.3f GB/s  (checksum %016llx)\n", result.name, bytes_per_second / 1e9, (unsigned long long)result.checksum);
+    }
+
+    for (u32 i = 0; i < reporter->baseline_count; i++)
+    {
+        const BenchBaselineEntry *entry = &reporter->baseline[i];
+        if (strcmp(entry->name, result.name) != 0)
+        {
+            continue;
+        }
+
+        const f64 floor = entry->bytes_per_second * (1.0 - reporter->threshold_percent / 100.0);
+        if (bytes_per_second < floor)
+        {
+            fprintf(stderr, "REGRESSION %s: %.3f GB/s, baseline %.3f GB/s (threshold %.1f%%)\n",
+                    result.name, bytes_per_second / 1e9, entry->bytes_per_second / 1e9, reporter->threshold_percent);
+            reporter->regression_count++;
+        }
+        break;
+    }
+}
+
+//
+// Best of repeat runs, the least disturbed one
+//
+static inline BenchResult bench_best_of(BenchResult (*bench)(void *user_data), void *user_data, u32 repeat)
+{
+    BenchResult best = bench(user_data);
+    for (u32 i = 1; i < repeat; i++)
+    {
+        const BenchResult result = bench(user_data);
+        if (result.seconds < best.seconds)
+        {
+            best = result;
+        }
+    }
+    return best;
+}
+
+static inline int bench_reporter_exit_code(const BenchReporter *reporter)
+{
+    return (reporter->regression_count > 0) ? 1 : 0;
+}
@@ -0,0 +1,235 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../common.h"
+#include "../bitstream.h"
+#include "bench.h"
+
+//
+// Microbenchmark for the Bitstream read primitives. Compares the word-at-a-time reader
+// against the original bit-at-a-time implementation that read_valve_var_uint used
+//
+
+#define BENCH_DATA_SIZE (64 * 1024 * 1024)
+#define BENCH_REPEAT 5
+
+typedef struct
+{
+    const u8 *data;
+    size_t size;
+    size_t pos;
+} LegacyBitstream;
+
+static u32 legacy_read_u32(LegacyBitstream *stream, size_t bit_count)
+{
+    size_t byte_pos = stream->pos / 8u;
+    size_t bit_pos = stream->pos % 8u;
+    size_t dst_i = 0;
+    u32 result = 0;
+
+    for (size_t i = 0; i < bit_count; i++)
+    {
+        const u32 bit_mask = 1 << bit_pos;
+        const u32 set_bit = ((u32)stream->data[byte_pos]) & bit_mask;
+        result |= (set_bit << dst_i);
+        dst_i++;
+        if (bit_pos == 7)
+        {
+            bit_pos = 0;
+            byte_pos++;
+        }
+        else
+        {
+            bit_pos++;
+        }
+    }
+
+    stream->pos += bit_count;
+
+    return result;
+}
+
+static u32 legacy_read_valve_var_uint(LegacyBitstream *stream)
+{
+    u32 id = legacy_read_u32(stream, 6);
+    switch (id & 0x30)
+    {
+    case 16:
+        id = (id & 15) | (legacy_read_u32(stream, 4) << 4);
+        break;
+    case 32:
+        id = (id & 15) | (legacy_read_u32(stream, 8) << 4);
+        break;
+    case 48:
+        id = (id & 15) | (legacy_read_u32(stream, 28) << 4);
+        break;
+    }
+    return id;
+}
+
+static u32 legacy_read_varint32(LegacyBitstream *stream)
+{
+    u32 result = 0;
+    for (u32 shift = 0; shift < 35; shift += 7)
+    {
+        const u32 byte = legacy_read_u32(stream, 8);
+        result |= (byte & 0x7Fu) << shift;
+        if (!(byte & 0x80u))
+        {
+            break;
+        }
+    }
+    return result;
+}
+
+static void fill_random(u8 *data, size_t size)
+{
+    u64 state = 0x9E3779B97F4A7C15ull;
+    for (size_t i = 0; i < size; i++)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        data[i] = (u8)state;
+    }
+}
+
+//
+// Stop 64 bits short of the end so no reader runs off the buffer
+//
+#define BENCH_LIMIT_BITS(size) (((size) - 8) * 8u)
+
+static BenchResult bench_legacy_ubitvar(const u8 *data, size_t size)
+{
+    LegacyBitstream stream = { data, size * 8, 0 };
+    u64 checksum = 0;
+    const f64 start = bench_now_seconds();
+    while (stream.pos < BENCH_LIMIT_BITS(size))
+    {
+        checksum += legacy_read_valve_var_uint(&stream);
+    }
+    return (BenchResult){ "read_valve_var_uint (legacy)", bench_now_seconds() - start, stream.pos / 8u, checksum };
+}
+
+static BenchResult bench_ubitvar(const u8 *data, size_t size)
+{
+    Bitstream stream = bitstream_create(data, size);
+    u64 checksum = 0;
+    const f64 start = bench_now_seconds();
+    while (bitstream_tell(&stream) < BENCH_LIMIT_BITS(size))
+    {
+        checksum += bitstream_read_ubitvar(&stream);
+    }
+    return (BenchResult){ "bitstream_read_ubitvar", bench_now_seconds() - start, bitstream_tell(&stream) / 8u, checksum };
+}
+
+static BenchResult bench_legacy_mixed(const u8 *data, size_t size)
+{
+    LegacyBitstream stream = { data, size * 8, 0 };
+    u64 checksum = 0;
+    u32 bit_count = 1;
+    const f64 start = bench_now_seconds();
+    while (stream.pos < BENCH_LIMIT_BITS(size))
+    {
+        checksum += legacy_read_u32(&stream, bit_count);
+        bit_count = (bit_count % 32u) + 1;
+    }
+    return (BenchResult){ "bitstream_read_u32 1..32 (legacy)", bench_now_seconds() - start, stream.pos / 8u, checksum };
+}
+
+static BenchResult bench_mixed(const u8 *data, size_t size)
+{
+    Bitstream stream = bitstream_create(data, size);
+    u64 checksum = 0;
+    u32 bit_count = 1;
+    const f64 start = bench_now_seconds();
+    while (bitstream_tell(&stream) < BENCH_LIMIT_BITS(size))
+    {
+        checksum += bitstream_read_u32(&stream, bit_count);
+        bit_count = (bit_count % 32u) + 1;
+    }
+    return (BenchResult){ "bitstream_read_u32 1..32", bench_now_seconds() - start, bitstream_tell(&stream) / 8u, checksum };
+}
+
+static BenchResult bench_legacy_varint(const u8 *data, size_t size)
+{
+    LegacyBitstream stream = { data, size * 8, 0 };
+    u64 checksum = 0;
+    const f64 start = bench_now_seconds();
+    while (stream.pos < BENCH_LIMIT_BITS(size))
+    {
+        checksum += legacy_read_varint32(&stream);
+    }
+    return (BenchResult){ "varint32 via read_u32(8) (legacy)", bench_now_seconds() - start, stream.pos / 8u, checksum };
+}
+
+static BenchResult bench_varint(const u8 *data, size_t size)
+{
+    Bitstream stream = bitstream_create(data, size);
+    u64 checksum = 0;
+    const f64 start = bench_now_seconds();
+    while (bitstream_tell(&stream) < BENCH_LIMIT_BITS(size))
+    {
+        checksum += bitstream_read_varint32(&stream);
+    }
+    return (BenchResult){ "bitstream_read_varint32", bench_now_seconds() - start, bitstream_tell(&stream) / 8u, checksum };
+}
+
+static BenchResult bench_coord(const u8 *data, size_t size)
+{
+    Bitstream stream = bitstream_create(data, size);
+    f64 checksum = 0.0;
+    const f64 start = bench_now_seconds();
+    while (bitstream_tell(&stream) < BENCH_LIMIT_BITS(size))
+    {
+        checksum += bitstream_read_coord(&stream);
+    }
+    return (BenchResult){ "bitstream_read_coord", bench_now_seconds() - start, bitstream_tell(&stream) / 8u, (u64)checksum };
+}
+
+static void report(BenchReporter *reporter, BenchResult (*bench)(const u8 *, size_t), const u8 *data, size_t size)
+{
+    BenchResult best = bench(data, size);
+    for (int i = 1; i < BENCH_REPEAT; i++)
+    {
+        const BenchResult result = bench(data, size);
+        if (result.seconds < best.seconds)
+        {
+            best = result;
+        }
+    }
+
+    bench_report(reporter, best);
+}
+
+int main(int argc, char *argv[])
+{
+    BenchReporter reporter;
+    if (!bench_reporter_init(&reporter, argc, argv))
+    {
+        return 2;
+    }
+
+    u8 *data = (u8 *)malloc(BENCH_DATA_SIZE);
+    if (!data)
+    {
+        printf("Failed to allocate benchmark data\n");
+        return 1;
+    }
+
+    fill_random(data, BENCH_DATA_SIZE);
+
+    report(&reporter, bench_legacy_ubitvar, data, BENCH_DATA_SIZE);
+    report(&reporter, bench_ubitvar, data, BENCH_DATA_SIZE);
+    report(&reporter, bench_legacy_mixed, data, BENCH_DATA_SIZE);
+    report(&reporter, bench_mixed, data, BENCH_DATA_SIZE);
+    report(&reporter, bench_legacy_varint, data, BENCH_DATA_SIZE);
+    report(&reporter, bench_varint, data, BENCH_DATA_SIZE);
+    report(&reporter, bench_coord, data, BENCH_DATA_SIZE);
+
+    free(data);
+
+    return bench_reporter_exit_code(&reporter);
+}
@@ -0,0 +1,613 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "demo_gen.h"
+
+#include "../demo.h"
+#include "../demoparser.h"
+#include "../frame_prescan.h"
+#include "../arena.h"
+#include "../message_views.h"
+#include "../message_dispatch.h"
+
+//
+// Benchmarks for the parser stages, run over a synthetic demo from demo_gen.c so no
+// match files are needed: frame headers, snappy decompression, every protobuf unpack
+// the parser does next to its zero-copy view where it has one, net message dispatch,
+// and the whole parse with decompression inline and on a thread. Every result counts
+// the bytes the stage consumed, so throughput is comparable across stages.
+//
+
+#define BENCH_REPEAT 5
+
+//
+// Setup messages appear once per demo, they're unpacked repeatedly until about this
+// many bytes went through
+//
+#define BENCH_SINGLE_MESSAGE_BYTES (16 * 1024 * 1024)
+
+//
+// Records taken per frame_prescan call
+//
+#define BENCH_PRESCAN_BATCH 1024
+
+typedef struct
+{
+    u32 command;
+    bool is_compressed;
+    //
+    // Payload as stored in the demo, and decompressed in BenchDemo.payloads
+    //
+    size_t stored_offset;
+    u32 stored_size;
+    size_t offset;
+    u32 size;
+} BenchFrame;
+
+typedef struct
+{
+    u8 *data;
+    size_t size;
+
+    u8 *payloads;
+    size_t payloads_size;
+
+    BenchFrame *frames;
+    u32 frame_count;
+
+    u64 compressed_bytes;
+    u64 decompressed_bytes;
+} BenchDemo;
+
+typedef struct
+{
+    const BenchDemo *demo;
+    u32 command;
+    const char *name;
+    void *(*unpack)(ProtobufCAllocator *allocator, size_t size, const u8 *data);
+} BenchUnpack;
+
+typedef struct
+{
+    const BenchDemo *demo;
+    u32 thread_count;
+    const char *name;
+} BenchEndToEnd;
+
+static bool bench_demo_load(BenchDemo *demo);
+static void bench_demo_free(BenchDemo *demo);
+static const BenchFrame *bench_demo_find(const BenchDemo *demo, u32 command);
+
+static BenchResult bench_frame_headers(void *user_data);
+static BenchResult bench_frame_prescan(void *user_data);
+static BenchResult bench_decompress(void *user_data);
+static BenchResult bench_unpack(void *user_data);
+static BenchResult bench_packet_view(void *user_data);
+static BenchResult bench_full_packet_view(void *user_data);
+static BenchResult bench_dispatch(void *user_data);
+static BenchResult bench_end_to_end(void *user_data);
+
+static int bench_count_message(void *user_data, u32 message_id, const u8 *data, u32 size);
+static int bench_count_event(void *user_data, const DemoEvent *event);
+
+static void *bench_unpack_file_header(ProtobufCAllocator *allocator, size_t size, const u8 *data);
+static void *bench_unpack_file_info(ProtobufCAllocator *allocator, size_t size, const u8 *data);
+static void *bench_unpack_send_tables(ProtobufCAllocator *allocator, size_t size, const u8 *data);
+static void *bench_unpack_flattened_serializer(ProtobufCAllocator *allocator, size_t size, const u8 *data);
+static void *bench_unpack_class_info(ProtobufCAllocator *allocator, size_t size, const u8 *data);
+static void *bench_unpack_packet(ProtobufCAllocator *allocator, size_t size, const u8 *data);
+static void *bench_unpack_full_packet(ProtobufCAllocator *allocator, size_t size, const u8 *data);
+
+static DemoGenOptions bench_gen_options;
+
+int main(int argc, char *argv[])
+{
+    BenchReporter reporter;
+    if (!bench_reporter_init(&reporter, argc, argv))
+    {
+        return 2;
+    }
+
+    demo_gen_options_init(&bench_gen_options);
+    const char *write_demo_path = nullptr;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if ((strcmp(argv[i], "--baseline") == 0 || strcmp(argv[i], "--threshold") == 0) && i + 1 < argc)
+        {
+            i++;
+        }
+        else if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc)
+        {
+            bench_gen_options.tick_count = (u32)strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            bench_gen_options.seed = strtoull(argv[++i], nullptr, 0);
+        }
+        else if (strcmp(argv[i], "--write-demo") == 0 && i + 1 < argc)
+        {
+            write_demo_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--json") != 0)
+        {
+            printf("Usage: %s [--json] [--baseline FILE] [--threshold PERCENT] [--ticks N] [--seed N] [--write-demo FILE]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    BenchDemo demo = { 0 };
+    if (!bench_demo_load(&demo))
+    {
+        bench_demo_free(&demo);
+        return 2;
+    }
+
+    if (write_demo_path)
+    {
+        FILE *file = fopen(write_demo_path, "wb");
+        const bool written = file && fwrite(demo.data, 1, demo.size, file) == demo.size;
+        if (file)
+        {
+            fclose(file);
+        }
+        if (!written)
+        {
+            printf("Failed to write %s\n", write_demo_path);
+            bench_demo_free(&demo);
+            return 2;
+        }
+    }
+
+    if (!reporter.json)
+    {
+        printf("Synthetic demo: %u ticks, %zu bytes, %u frames, %llu bytes compressed -> %llu bytes\n",
+               bench_gen_options.tick_count, demo.size, demo.frame_count,
+               (unsigned long long)demo.compressed_bytes, (unsigned long long)demo.decompressed_bytes);
+    }
+
+    bench_report(&reporter, bench_best_of(bench_frame_headers, &demo, BENCH_REPEAT));
+    bench_report(&reporter, bench_best_of(bench_frame_prescan, &demo, BENCH_REPEAT));
+    bench_report(&reporter, bench_best_of(bench_decompress, &demo, BENCH_REPEAT));
+
+    BenchUnpack unpacks[] = {
+        { &demo, DEMO_COMMAND_FILE_HEADER, "unpack CDemoFileHeader", bench_unpack_file_header },
+        { &demo, DEMO_COMMAND_FILE_INFO, "unpack CDemoFileInfo", bench_unpack_file_info },
+        { &demo, DEMO_COMMAND_SEND_TABLES, "unpack CDemoSendTables", bench_unpack_send_tables },
+        { &demo, DEMO_COMMAND_SEND_TABLES, "unpack CSVCMsg_FlattenedSerializer", bench_unpack_flattened_serializer },
+        { &demo, DEMO_COMMAND_CLASS_INFO, "unpack CDemoClassInfo", bench_unpack_class_info },
+        { &demo, DEMO_COMMAND_PACKET, "unpack CDemoPacket", bench_unpack_packet },
+        { &demo, DEMO_COMMAND_FULL_PACKET, "unpack CDemoFullPacket", bench_unpack_full_packet },
+    };
+    for (u32 i = 0; i < sizeof(unpacks) / sizeof(unpacks[0]); i++)
+    {
+        bench_report(&reporter, bench_best_of(bench_unpack, &unpacks[i], BENCH_REPEAT));
+    }
+
+    bench_report(&reporter, bench_best_of(bench_packet_view, &demo, BENCH_REPEAT));
+    bench_report(&reporter, bench_best_of(bench_full_packet_view, &demo, BENCH_REPEAT));
+    bench_report(&reporter, bench_best_of(bench_dispatch, &demo, BENCH_REPEAT));
+
+    BenchEndToEnd end_to_end[] = {
+        { &demo, 0, "demo_parser_run (inline decompression)" },
+        { &demo, 2, "demo_parser_run (2 decompression threads)" },
+    };
+    for (u32 i = 0; i < sizeof(end_to_end) / sizeof(end_to_end[0]); i++)
+    {
+        bench_report(&reporter, bench_best_of(bench_end_to_end, &end_to_end[i], BENCH_REPEAT));
+    }
+
+    bench_demo_free(&demo);
+
+    return bench_reporter_exit_code(&reporter);
+}
+
+//
+// Generates the demo and splits it into frames up front, so each benchmark only times
+// its own stage
+//
+static bool bench_demo_load(BenchDemo *demo)
+{
+    const int gen_result = demo_gen_write(&bench_gen_options, &demo->data, &demo->size);
+    if (gen_result != DEMO_GEN_RET_OK)
+    {
+        printf("Failed to generate synthetic demo (%d)\n", gen_result);
+        return false;
+    }
+
+    u32 frame_capacity = 0;
+    size_t payloads_capacity = 0;
+    char *decompressed = nullptr;
+    size_t decompressed_capacity = 0;
+
+    size_t pos = sizeof(DemoHeader);
+    DemoFrameHeader header;
+    while (demo_read_frame_header(demo->data, demo->size, &pos, &header) == DEMO_FRAME_HEADER_RET_OK)
+    {
+        const u8 *payload = demo->data + pos;
+        size_t payload_size = header.size;
+
+        if (header.is_compressed)
+        {
+            if (demo_decompress_frame((const char *)payload, header.size, &decompressed, &decompressed_capacity, &payload_size) != DEMO_DECOMPRESS_RET_OK)
+            {
+                printf("Failed to decompress synthetic frame at offset %zu\n", pos);
+                free(decompressed);
+                return false;
+            }
+            payload = (const u8 *)decompressed;
+            demo->compressed_bytes += header.size;
+            demo->decompressed_bytes += payload_size;
+        }
+
+        if (demo->frame_count == frame_capacity)
+        {
+            frame_capacity = (frame_capacity) ? frame_capacity * 2 : 1024;
+            BenchFrame *frames = (BenchFrame *)realloc(demo->frames, frame_capacity * sizeof(BenchFrame));
+            if (!frames)
+            {
+                free(decompressed);
+                return false;
+            }
+            demo->frames = frames;
+        }
+
+        while (demo->payloads_size + payload_size > payloads_capacity)
+        {
+            payloads_capacity = (payloads_capacity) ? payloads_capacity * 2 : 1024 * 1024;
+            u8 *payloads = (u8 *)realloc(demo->payloads, payloads_capacity);
+            if (!payloads)
+            {
+                free(decompressed);
+                return false;
+            }
+            demo->payloads = payloads;
+        }
+
+        memcpy(demo->payloads + demo->payloads_size, payload, payload_size);
+        demo->frames[demo->frame_count++] = (BenchFrame){
+            .command = header.command,
+            .is_compressed = header.is_compressed,
+            .stored_offset = pos,
+            .stored_size = header.size,
+            .offset = demo->payloads_size,
+            .size = (u32)payload_size,
+        };
+        demo->payloads_size += payload_size;
+
+        pos += header.size;
+        if (header.command == DEMO_COMMAND_STOP)
+        {
+            break;
+        }
+    }
+
+    free(decompressed);
+    return true;
+}
+
+static void bench_demo_free(BenchDemo *demo)
+{
+    free(demo->data);
+    free(demo->payloads);
+    free(demo->frames);
+    memset(demo, 0, sizeof(*demo));
+}
+
+static const BenchFrame *bench_demo_find(const BenchDemo *demo, u32 command)
+{
+    for (u32 i = 0; i < demo->frame_count; i++)
+    {
+        if (demo->frames[i].command == command)
+        {
+            return &demo->frames[i];
+        }
+    }
+    return nullptr;
+}
+
+static BenchResult bench_frame_headers(void *user_data)
+{
+    const BenchDemo *demo = (const BenchDemo *)user_data;
+    u64 checksum = 0;
+    size_t pos = sizeof(DemoHeader);
+    DemoFrameHeader header;
+
+    const f64 start = bench_now_seconds();
+    while (demo_read_frame_header(demo->data, demo->size, &pos, &header) == DEMO_FRAME_HEADER_RET_OK)
+    {
+        checksum += header.command + header.tick + header.size;
+        pos += header.size;
+    }
+    return (BenchResult){ "demo_read_frame_header", bench_now_seconds() - start, demo->size, checksum };
+}
+
+//
+// Same frames and checksum as bench_frame_headers, which walks them one
+// demo_read_frame_header call at a time
+//
+static BenchResult bench_frame_prescan(void *user_data)
+{
+    const BenchDemo *demo = (const BenchDemo *)user_data;
+    FramePrescanRecord records[BENCH_PRESCAN_BATCH];
+    u64 checksum = 0;
+    size_t pos = sizeof(DemoHeader);
+
+    const f64 start = bench_now_seconds();
+    while (true)
+    {
+        u32 record_count = 0;
+        const int ret_code = frame_prescan(demo->data, demo->size, &pos, records, BENCH_PRESCAN_BATCH, &record_count);
+        for (u32 i = 0; i < record_count; i++)
+        {
+            checksum += records[i].command + records[i].tick + records[i].size;
+        }
+        if (ret_code != FRAME_PRESCAN_RET_OK)
+        {
+            break;
+        }
+    }
+    return (BenchResult){ "frame_prescan", bench_now_seconds() - start, demo->size, checksum };
+}
+
+static BenchResult bench_decompress(void *user_data)
+{
+    const BenchDemo *demo = (const BenchDemo *)user_data;
+    char *buffer = nullptr;
+    size_t buffer_size = 0;
+    u64 checksum = 0;
+
+    const f64 start = bench_now_seconds();
+    for (u32 i = 0; i < demo->frame_count; i++)
+    {
+        const BenchFrame *frame = &demo->frames[i];
+        if (!frame->is_compressed)
+        {
+            continue;
+        }
+        size_t size = 0;
+        if (demo_decompress_frame((const char *)demo->data + frame->stored_offset, frame->stored_size, &buffer, &buffer_size, &size) == DEMO_DECOMPRESS_RET_OK)
+        {
+            checksum += size + (u8)buffer[size - 1];
+        }
+    }
+    const f64 seconds = bench_now_seconds() - start;
+
+    free(buffer);
+    return (BenchResult){ "snappy decompress (demo_decompress_frame)", seconds, demo->decompressed_bytes, checksum };
+}
+
+//
+// Unpacks into an arena reset after every message, the way the parser's frame arena is
+//
+static BenchResult bench_unpack(void *user_data)
+{
+    const BenchUnpack *bench = (const BenchUnpack *)user_data;
+    const BenchDemo *demo = bench->demo;
+
+    Arena arena;
+    arena_init(&arena, 256 * 1024);
+    ProtobufCAllocator allocator = arena_protobuf_allocator(&arena);
+
+    u64 checksum = 0;
+    size_t bytes = 0;
+
+    const BenchFrame *single = nullptr;
+    if (bench->command != DEMO_COMMAND_PACKET && bench->command != DEMO_COMMAND_FULL_PACKET)
+    {
+        single = bench_demo_find(demo, bench->command);
+    }
+
+    const f64 start = bench_now_seconds();
+
+    if (single)
+    {
+        const u32 repeat = BENCH_SINGLE_MESSAGE_BYTES / ((single->size) ? single->size : 1) + 1;
+        for (u32 r = 0; r < repeat; r++)
+        {
+            checksum += (bench->unpack(&allocator, single->size, demo->payloads + single->offset) != nullptr);
+            arena_reset(&arena);
+        }
+        bytes = (size_t)repeat * single->size;
+    }
+    else
+    {
+        for (u32 i = 0; i < demo->frame_count; i++)
+        {
+            const BenchFrame *frame = &demo->frames[i];
+            if (frame->command != bench->command)
+            {
+                continue;
+            }
+            checksum += (bench->unpack(&allocator, frame->size, demo->payloads + frame->offset) != nullptr);
+            bytes += frame->size;
+            arena_reset(&arena);
+        }
+    }
+    const f64 seconds = bench_now_seconds() - start;
+
+    arena_free(&arena);
+    return (BenchResult){ bench->name, seconds, bytes, checksum };
+}
+
+static BenchResult bench_packet_view(void *user_data)
+{
+    const BenchDemo *demo = (const BenchDemo *)user_data;
+    u64 checksum = 0;
+    size_t bytes = 0;
+
+    const f64 start = bench_now_seconds();
+    for (u32 i = 0; i < demo->frame_count; i++)
+    {
+        const BenchFrame *frame = &demo->frames[i];
+        if (frame->command != DEMO_COMMAND_PACKET)
+        {
+            continue;
+        }
+        WireBytes data;
+        if (cdemo_packet_view_data(demo->payloads + frame->offset, frame->size, &data))
+        {
+            checksum += data.size;
+        }
+        bytes += frame->size;
+    }
+    return (BenchResult){ "view CDemoPacket", bench_now_seconds() - start, bytes, checksum };
+}
+
+static BenchResult bench_full_packet_view(void *user_data)
+{
+    const BenchDemo *demo = (const BenchDemo *)user_data;
+    u64 checksum = 0;
+    size_t bytes = 0;
+
+    const f64 start = bench_now_seconds();
+    for (u32 i = 0; i < demo->frame_count; i++)
+    {
+        const BenchFrame *frame = &demo->frames[i];
+        if (frame->command != DEMO_COMMAND_FULL_PACKET)
+        {
+            continue;
+        }
+        WireBytes string_table;
+        WireBytes packet;
+        if (cdemo_full_packet_view(demo->payloads + frame->offset, frame->size, &string_table, &packet))
+        {
+            checksum += string_table.size + packet.size;
+        }
+        bytes += frame->size;
+    }
+    return (BenchResult){ "view CDemoFullPacket", bench_now_seconds() - start, bytes, checksum };
+}
+
+//
+// Every message ID has a handler, so payloads are handed out rather than skipped
+//
+static BenchResult bench_dispatch(void *user_data)
+{
+    const BenchDemo *demo = (const BenchDemo *)user_data;
+    u64 checksum = 0;
+    size_t bytes = 0;
+
+    MessageDispatcher dispatcher;
+    message_dispatcher_init(&dispatcher);
+    for (u32 message_id = 0; message_id < MESSAGE_ID_MAX; message_id++)
+    {
+        message_dispatcher_register(&dispatcher, message_id, bench_count_message, &checksum);
+    }
+
+    const f64 start = bench_now_seconds();
+    for (u32 i = 0; i < demo->frame_count; i++)
+    {
+        const BenchFrame *frame = &demo->frames[i];
+        if (frame->command != DEMO_COMMAND_PACKET && frame->command != DEMO_COMMAND_SIGNON_PACKET)
+        {
+            continue;
+        }
+        WireBytes data;
+        if (cdemo_packet_view_data(demo->payloads + frame->offset, frame->size, &data))
+        {
+            message_dispatcher_run(&dispatcher, data.data, data.size);
+            bytes += data.size;
+        }
+    }
+    const f64 seconds = bench_now_seconds() - start;
+
+    message_dispatcher_free(&dispatcher);
+    return (BenchResult){ "message_dispatcher_run", seconds, bytes, checksum };
+}
+
+//
+// Only frame events are asked for, which keeps the event handler out of the timing
+//
+static BenchResult bench_end_to_end(void *user_data)
+{
+    const BenchEndToEnd *bench = (const BenchEndToEnd *)user_data;
+    const BenchDemo *demo = bench->demo;
+    u64 checksum = 0;
+
+    DemoParserOptions options;
+    demo_parser_options_init(&options);
+    options.thread_count = bench->thread_count;
+    options.event_mask = DEMO_EVENT_MASK(DEMO_EVENT_FRAME);
+    options.log_level = LOG_LEVEL_ERROR;
+
+    const f64 start = bench_now_seconds();
+    DemoParser parser;
+    if (demo_parser_init(&parser, demo->data, demo->size, &options) == DEMO_PARSER_RET_OK)
+    {
+        demo_parser_run(&parser, bench_count_event, &checksum);
+    }
+    demo_parser_free(&parser);
+    const f64 seconds = bench_now_seconds() - start;
+
+    return (BenchResult){ bench->name, seconds, demo->size, checksum };
+}
+
+static int bench_count_message(void *user_data, u32 message_id, const u8 *data, u32 size)
+{
+    u64 *checksum = (u64 *)user_data;
+    *checksum += message_id + size + ((size) ? data[0] : 0);
+    return 0;
+}
+
+static int bench_count_event(void *user_data, const DemoEvent *event)
+{
+    u64 *checksum = (u64 *)user_data;
+    *checksum += event->frame.command + event->frame.size;
+    return 0;
+}
+
+static void *bench_unpack_file_header(ProtobufCAllocator *allocator, size_t size, const u8 *data)
+{
+    return cdemo_file_header__unpack(allocator, size, data);
+}
+
+static void *bench_unpack_file_info(ProtobufCAllocator *allocator, size_t size, const u8 *data)
+{
+    return cdemo_file_info__unpack(allocator, size, data);
+}
+
+static void *bench_unpack_send_tables(ProtobufCAllocator *allocator, size_t size, const u8 *data)
+{
+    return cdemo_send_tables__unpack(allocator, size, data);
+}
+
+//
+// The serializer is wrapped in CDemoSendTables.data behind a varint size
+//
+static void *bench_unpack_flattened_serializer(ProtobufCAllocator *allocator, size_t size, const u8 *data)
+{
+    WireBytes send_tables;
+    if (!wire_find_bytes(data, size, 1, &send_tables))
+    {
+        return nullptr;
+    }
+
+    WireReader reader = wire_reader_create(send_tables.data, send_tables.size);
+    u64 serializer_size = 0;
+    if (!wire_read_varint(&reader, &serializer_size) || serializer_size > reader.size - reader.pos)
+    {
+        return nullptr;
+    }
+
+    return csvcmsg__flattened_serializer__unpack(allocator, (size_t)serializer_size, send_tables.data + reader.pos);
+}
+
+static void *bench_unpack_class_info(ProtobufCAllocator *allocator, size_t size, const u8 *data)
+{
+    return cdemo_class_info__unpack(allocator, size, data);
+}
+
+static void *bench_unpack_packet(ProtobufCAllocator *allocator, size_t size, const u8 *data)
+{
+    return cdemo_packet__unpack(allocator, size, data);
+}
+
+static void *bench_unpack_full_packet(ProtobufCAllocator *allocator, size_t size, const u8 *data)
+{
+    return cdemo_full_packet__unpack(allocator, size, data);
+}
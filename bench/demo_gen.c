@@ -0,0 +1,605 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <snappy-c.h>
+
+#include "demo_gen.h"
+#include "../demo.h"
+
+#include "protos/demo.pb-c.h"
+#include "protos/netmessages.pb-c.h"
+
+//
+// Tick the game writes on frames sent before the first server tick
+//
+#define DEMO_GEN_SIGNON_TICK 0xFFFFFFFFu
+#define DEMO_GEN_SIGNON_PACKET_COUNT 4
+
+#define DEMO_GEN_NET_TICK 4
+#define DEMO_GEN_USER_MESSAGE 301
+
+typedef struct
+{
+    u8 *data;
+    size_t size;
+    size_t capacity;
+    bool out_of_memory;
+} DemoGenBuffer;
+
+//
+// Writes the bit level encoding message_dispatcher_run reads: UBitVar ID, varint size
+//
+typedef struct
+{
+    DemoGenBuffer *buffer;
+    u64 bits;
+    u32 bit_count;
+} DemoGenBitWriter;
+
+typedef struct
+{
+    u64 state;
+    DemoGenBuffer file;
+    DemoGenBuffer payload;
+    DemoGenBuffer messages;
+    DemoGenBuffer compressed;
+    int result;
+} DemoGen;
+
+static u64 demo_gen_random(DemoGen *gen);
+static u32 demo_gen_random_range(DemoGen *gen, u32 min, u32 max);
+
+static bool demo_gen_buffer_reserve(DemoGenBuffer *buffer, size_t size);
+static void demo_gen_buffer_append(DemoGenBuffer *buffer, const void *data, size_t size);
+static void demo_gen_buffer_append_varint(DemoGenBuffer *buffer, u32 value);
+
+static void demo_gen_bits_write(DemoGenBitWriter *writer, u32 value, u32 bit_count);
+static void demo_gen_bits_write_ubitvar(DemoGenBitWriter *writer, u32 value);
+static void demo_gen_bits_write_varint(DemoGenBitWriter *writer, u32 value);
+static void demo_gen_bits_flush(DemoGenBitWriter *writer);
+
+static void demo_gen_fill(DemoGen *gen, u8 *data, size_t size);
+static void demo_gen_write_frame(DemoGen *gen, u32 command, u32 tick, const u8 *data, size_t size);
+static void demo_gen_write_file_header(DemoGen *gen);
+static void demo_gen_write_send_tables(DemoGen *gen);
+static void demo_gen_write_class_info(DemoGen *gen);
+static void demo_gen_write_packet(DemoGen *gen, u32 command, u32 tick, u32 large_message_rate);
+static void demo_gen_write_file_info(DemoGen *gen, u32 tick_count);
+static void demo_gen_build_messages(DemoGen *gen, u32 large_message_rate);
+
+//
+// Symbol table of the synthetic send tables. The serializers are made of the field
+// types and encoders most common in real CS2 demos
+//
+static const char *demo_gen_symbols[] = {
+    "CBenchPlayer", "CBenchWeapon", "CBenchProjectile",
+    "uint32", "int32", "float32", "bool", "Vector", "QAngle", "GameTime_t", "uint64",
+    "m_iHealth", "m_iTeamNum", "m_flSimulationTime", "m_bAlive", "m_vecOrigin", "m_angRotation",
+    "m_flCreateTime", "m_nOwnerId", "m_iClip1", "m_steamID", "m_vecVelocity",
+    "simtime", "coord",
+};
+
+#define DEMO_GEN_SYMBOL_COUNT (sizeof(demo_gen_symbols) / sizeof(demo_gen_symbols[0]))
+#define DEMO_GEN_NO_SYMBOL -1
+
+typedef struct
+{
+    i32 type;
+    i32 name;
+    i32 encoder;
+    i32 bit_count;
+} DemoGenField;
+
+static const DemoGenField demo_gen_fields[] = {
+    { 3, 11, DEMO_GEN_NO_SYMBOL, 0 },
+    { 4, 12, DEMO_GEN_NO_SYMBOL, 0 },
+    { 5, 13, 22, 0 },
+    { 6, 14, DEMO_GEN_NO_SYMBOL, 0 },
+    { 7, 15, 23, 0 },
+    { 8, 16, DEMO_GEN_NO_SYMBOL, 0 },
+    { 9, 17, DEMO_GEN_NO_SYMBOL, 0 },
+    { 3, 18, DEMO_GEN_NO_SYMBOL, 0 },
+    { 4, 19, DEMO_GEN_NO_SYMBOL, 0 },
+    { 10, 20, DEMO_GEN_NO_SYMBOL, 0 },
+    { 7, 21, DEMO_GEN_NO_SYMBOL, 0 },
+};
+
+#define DEMO_GEN_FIELD_COUNT (sizeof(demo_gen_fields) / sizeof(demo_gen_fields[0]))
+
+static const i32 demo_gen_player_fields[] = { 0, 1, 2, 3, 4, 5, 9, 10 };
+static const i32 demo_gen_weapon_fields[] = { 1, 2, 4, 7, 8 };
+static const i32 demo_gen_projectile_fields[] = { 2, 4, 5, 6, 7, 10 };
+
+void demo_gen_options_init(DemoGenOptions *options)
+{
+    options->seed = 0x9E3779B97F4A7C15ull;
+    options->tick_count = 64 * 60 * 10;
+    options->full_packet_interval = 64 * 60;
+    options->large_message_rate = 20;
+}
+
+int demo_gen_write(const DemoGenOptions *options, u8 **out_data, size_t *out_size)
+{
+    DemoGen gen = { 0 };
+    gen.state = (options->seed) ? options->seed : 1;
+    gen.result = DEMO_GEN_RET_OK;
+
+    DemoHeader header = { 0 };
+    memcpy(header.magic, "PBDEMS2", 8);
+    demo_gen_buffer_append(&gen.file, &header, sizeof(header));
+
+    demo_gen_write_file_header(&gen);
+    for (u32 i = 0; i < DEMO_GEN_SIGNON_PACKET_COUNT; i++)
+    {
+        demo_gen_write_packet(&gen, DEMO_COMMAND_SIGNON_PACKET, DEMO_GEN_SIGNON_TICK, 0);
+    }
+    demo_gen_write_send_tables(&gen);
+    demo_gen_write_class_info(&gen);
+    demo_gen_write_frame(&gen, DEMO_COMMAND_SYNC_TICK, DEMO_GEN_SIGNON_TICK, nullptr, 0);
+
+    for (u32 tick = 0; tick < options->tick_count && gen.result == DEMO_GEN_RET_OK; tick++)
+    {
+        const bool is_full_packet = options->full_packet_interval && (tick % options->full_packet_interval) == 0;
+        demo_gen_write_packet(&gen, (is_full_packet) ? DEMO_COMMAND_FULL_PACKET : DEMO_COMMAND_PACKET, tick, options->large_message_rate);
+
+        //
+        // The odd console command and user command, as recorded from a client
+        //
+        const u32 roll = demo_gen_random_range(&gen, 0, 999);
+        if (roll < 2)
+        {
+            u8 command[24];
+            demo_gen_fill(&gen, command, sizeof(command));
+            demo_gen_write_frame(&gen, DEMO_COMMAND_CONSOLE_CMD, tick, command, sizeof(command));
+        }
+        else if (roll < 10)
+        {
+            u8 command[48];
+            demo_gen_fill(&gen, command, sizeof(command));
+            demo_gen_write_frame(&gen, DEMO_COMMAND_USER_CMD, tick, command, sizeof(command));
+        }
+    }
+
+    demo_gen_write_file_info(&gen, options->tick_count);
+    demo_gen_write_frame(&gen, DEMO_COMMAND_STOP, options->tick_count, nullptr, 0);
+
+    if (gen.file.out_of_memory || gen.payload.out_of_memory || gen.messages.out_of_memory || gen.compressed.out_of_memory)
+    {
+        gen.result = DEMO_GEN_RET_OOM;
+    }
+
+    free(gen.payload.data);
+    free(gen.messages.data);
+    free(gen.compressed.data);
+
+    if (gen.result != DEMO_GEN_RET_OK)
+    {
+        free(gen.file.data);
+        return gen.result;
+    }
+
+    *out_data = gen.file.data;
+    *out_size = gen.file.size;
+    return DEMO_GEN_RET_OK;
+}
+
+static u64 demo_gen_random(DemoGen *gen)
+{
+    gen->state ^= gen->state << 13;
+    gen->state ^= gen->state >> 7;
+    gen->state ^= gen->state << 17;
+    return gen->state;
+}
+
+static u32 demo_gen_random_range(DemoGen *gen, u32 min, u32 max)
+{
+    return min + (u32)(demo_gen_random(gen) % (u64)(max - min + 1));
+}
+
+static bool demo_gen_buffer_reserve(DemoGenBuffer *buffer, size_t size)
+{
+    if (buffer->out_of_memory)
+    {
+        return false;
+    }
+
+    if (buffer->size + size <= buffer->capacity)
+    {
+        return true;
+    }
+
+    size_t capacity = (buffer->capacity) ? buffer->capacity : 4096;
+    while (capacity < buffer->size + size)
+    {
+        capacity *= 2;
+    }
+
+    u8 *data = (u8 *)realloc(buffer->data, capacity);
+    if (!data)
+    {
+        buffer->out_of_memory = true;
+        return false;
+    }
+
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return true;
+}
+
+static void demo_gen_buffer_append(DemoGenBuffer *buffer, const void *data, size_t size)
+{
+    if (size == 0 || !demo_gen_buffer_reserve(buffer, size))
+    {
+        return;
+    }
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+}
+
+static void demo_gen_buffer_append_varint(DemoGenBuffer *buffer, u32 value)
+{
+    u8 bytes[5];
+    u32 count = 0;
+    do
+    {
+        bytes[count] = (u8)(value & 0x7Fu);
+        value >>= 7;
+        if (value)
+        {
+            bytes[count] |= 0x80u;
+        }
+        count++;
+    } while (value);
+    demo_gen_buffer_append(buffer, bytes, count);
+}
+
+static void demo_gen_bits_write(DemoGenBitWriter *writer, u32 value, u32 bit_count)
+{
+    writer->bits |= (u64)(value & (u32)((1ull << bit_count) - 1)) << writer->bit_count;
+    writer->bit_count += bit_count;
+    while (writer->bit_count >= 8)
+    {
+        const u8 byte = (u8)writer->bits;
+        demo_gen_buffer_append(writer->buffer, &byte, 1);
+        writer->bits >>= 8;
+        writer->bit_count -= 8;
+    }
+}
+
+static void demo_gen_bits_write_ubitvar(DemoGenBitWriter *writer, u32 value)
+{
+    //
+    // Low 4 bits, then 2 selector bits picking 0, 4, 8 or 28 more bits
+    //
+    const u32 high = value >> 4;
+    if (high == 0)
+    {
+        demo_gen_bits_write(writer, value & 15u, 6);
+    }
+    else if (high < (1u << 4))
+    {
+        demo_gen_bits_write(writer, (value & 15u) | 16u, 6);
+        demo_gen_bits_write(writer, high, 4);
+    }
+    else if (high < (1u << 8))
+    {
+        demo_gen_bits_write(writer, (value & 15u) | 32u, 6);
+        demo_gen_bits_write(writer, high, 8);
+    }
+    else
+    {
+        demo_gen_bits_write(writer, (value & 15u) | 48u, 6);
+        demo_gen_bits_write(writer, high, 28);
+    }
+}
+
+static void demo_gen_bits_write_varint(DemoGenBitWriter *writer, u32 value)
+{
+    do
+    {
+        u32 byte = value & 0x7Fu;
+        value >>= 7;
+        if (value)
+        {
+            byte |= 0x80u;
+        }
+        demo_gen_bits_write(writer, byte, 8);
+    } while (value);
+}
+
+static void demo_gen_bits_flush(DemoGenBitWriter *writer)
+{
+    if (writer->bit_count > 0)
+    {
+        demo_gen_bits_write(writer, 0, 8 - writer->bit_count);
+    }
+}
+
+//
+// Filler that snappy compresses about as well as real net messages: half of the 8 byte
+// chunks repeat an earlier stretch of the buffer
+//
+static void demo_gen_fill(DemoGen *gen, u8 *data, size_t size)
+{
+    for (size_t pos = 0; pos < size; pos += 8)
+    {
+        const size_t chunk = (size - pos < 8) ? size - pos : 8;
+        const u64 random = demo_gen_random(gen);
+        if (pos >= 64 && (random & 1))
+        {
+            const size_t from = (size_t)(random >> 8) % (pos - chunk);
+            memmove(data + pos, data + from, chunk);
+        }
+        else
+        {
+            const u64 bytes = demo_gen_random(gen);
+            memcpy(data + pos, &bytes, chunk);
+        }
+    }
+}
+
+static void demo_gen_write_frame(DemoGen *gen, u32 command, u32 tick, const u8 *data, size_t size)
+{
+    if (gen->result != DEMO_GEN_RET_OK)
+    {
+        return;
+    }
+
+    if (size >= DEMO_GEN_COMPRESS_THRESHOLD)
+    {
+        size_t compressed_size = snappy_max_compressed_length(size);
+        gen->compressed.size = 0;
+        if (!demo_gen_buffer_reserve(&gen->compressed, compressed_size))
+        {
+            gen->result = DEMO_GEN_RET_OOM;
+            return;
+        }
+        if (snappy_compress((const char *)data, size, (char *)gen->compressed.data, &compressed_size) != SNAPPY_OK)
+        {
+            gen->result = DEMO_GEN_RET_COMPRESS_ERROR;
+            return;
+        }
+
+        demo_gen_buffer_append_varint(&gen->file, command | DEMO_COMMAND_IS_COMPRESSED);
+        demo_gen_buffer_append_varint(&gen->file, tick);
+        demo_gen_buffer_append_varint(&gen->file, (u32)compressed_size);
+        demo_gen_buffer_append(&gen->file, gen->compressed.data, compressed_size);
+        return;
+    }
+
+    demo_gen_buffer_append_varint(&gen->file, command);
+    demo_gen_buffer_append_varint(&gen->file, tick);
+    demo_gen_buffer_append_varint(&gen->file, (u32)size);
+    demo_gen_buffer_append(&gen->file, data, size);
+}
+
+static void demo_gen_write_file_header(DemoGen *gen)
+{
+    CDemoFileHeader header = CDEMO_FILE_HEADER__INIT;
+    header.demo_file_stamp = (char *)"PBDEMS2";
+    header.has_network_protocol = true;
+    header.network_protocol = 14000;
+    header.server_name = (char *)"Benchmark Server";
+    header.client_name = (char *)"SourceTV Demo";
+    header.map_name = (char *)"de_bench";
+    header.game_directory = (char *)"csgo";
+    header.has_build_num = true;
+    header.build_num = 10000;
+
+    gen->payload.size = 0;
+    if (demo_gen_buffer_reserve(&gen->payload, cdemo_file_header__get_packed_size(&header)))
+    {
+        gen->payload.size = cdemo_file_header__pack(&header, gen->payload.data);
+        demo_gen_write_frame(gen, DEMO_COMMAND_FILE_HEADER, DEMO_GEN_SIGNON_TICK, gen->payload.data, gen->payload.size);
+    }
+}
+
+static void demo_gen_write_send_tables(DemoGen *gen)
+{
+    ProtoFlattenedSerializerFieldT fields[DEMO_GEN_FIELD_COUNT];
+    ProtoFlattenedSerializerFieldT *field_pointers[DEMO_GEN_FIELD_COUNT];
+    for (u32 i = 0; i < DEMO_GEN_FIELD_COUNT; i++)
+    {
+        const DemoGenField *source = &demo_gen_fields[i];
+        ProtoFlattenedSerializerFieldT field = PROTO_FLATTENED_SERIALIZER_FIELD_T__INIT;
+        field.has_var_type_sym = true;
+        field.var_type_sym = source->type;
+        field.has_var_name_sym = true;
+        field.var_name_sym = source->name;
+        if (source->encoder != DEMO_GEN_NO_SYMBOL)
+        {
+            field.has_var_encoder_sym = true;
+            field.var_encoder_sym = source->encoder;
+        }
+        if (source->bit_count)
+        {
+            field.has_bit_count = true;
+            field.bit_count = source->bit_count;
+        }
+        fields[i] = field;
+        field_pointers[i] = &fields[i];
+    }
+
+    const struct
+    {
+        const i32 *fields;
+        size_t field_count;
+    } serializer_fields[] = {
+        { demo_gen_player_fields, sizeof(demo_gen_player_fields) / sizeof(i32) },
+        { demo_gen_weapon_fields, sizeof(demo_gen_weapon_fields) / sizeof(i32) },
+        { demo_gen_projectile_fields, sizeof(demo_gen_projectile_fields) / sizeof(i32) },
+    };
+
+    ProtoFlattenedSerializerT serializers[3];
+    ProtoFlattenedSerializerT *serializer_pointers[3];
+    for (u32 i = 0; i < 3; i++)
+    {
+        ProtoFlattenedSerializerT serializer = PROTO_FLATTENED_SERIALIZER_T__INIT;
+        serializer.has_serializer_name_sym = true;
+        serializer.serializer_name_sym = (i32)i;
+        serializer.has_serializer_version = true;
+        serializer.serializer_version = 0;
+        serializer.n_fields_index = serializer_fields[i].field_count;
+        serializer.fields_index = (i32 *)serializer_fields[i].fields;
+        serializers[i] = serializer;
+        serializer_pointers[i] = &serializers[i];
+    }
+
+    CSVCMsgFlattenedSerializer flattened_serializer = CSVCMSG__FLATTENED_SERIALIZER__INIT;
+    flattened_serializer.n_serializers = 3;
+    flattened_serializer.serializers = serializer_pointers;
+    flattened_serializer.n_symbols = DEMO_GEN_SYMBOL_COUNT;
+    flattened_serializer.symbols = (char **)demo_gen_symbols;
+    flattened_serializer.n_fields = DEMO_GEN_FIELD_COUNT;
+    flattened_serializer.fields = field_pointers;
+
+    //
+    // CDemoSendTables.data is the serializer prefixed with its varint size
+    //
+    const size_t serializer_size = csvcmsg__flattened_serializer__get_packed_size(&flattened_serializer);
+    gen->messages.size = 0;
+    demo_gen_buffer_append_varint(&gen->messages, (u32)serializer_size);
+    if (!demo_gen_buffer_reserve(&gen->messages, serializer_size))
+    {
+        return;
+    }
+    gen->messages.size += csvcmsg__flattened_serializer__pack(&flattened_serializer, gen->messages.data + gen->messages.size);
+
+    CDemoSendTables send_tables = CDEMO_SEND_TABLES__INIT;
+    send_tables.has_data = true;
+    send_tables.data.data = gen->messages.data;
+    send_tables.data.len = gen->messages.size;
+
+    gen->payload.size = 0;
+    if (demo_gen_buffer_reserve(&gen->payload, cdemo_send_tables__get_packed_size(&send_tables)))
+    {
+        gen->payload.size = cdemo_send_tables__pack(&send_tables, gen->payload.data);
+        demo_gen_write_frame(gen, DEMO_COMMAND_SEND_TABLES, DEMO_GEN_SIGNON_TICK, gen->payload.data, gen->payload.size);
+    }
+}
+
+static void demo_gen_write_class_info(DemoGen *gen)
+{
+    CDemoClassInfo__ClassT classes[3];
+    CDemoClassInfo__ClassT *class_pointers[3];
+    for (u32 i = 0; i < 3; i++)
+    {
+        CDemoClassInfo__ClassT entry = CDEMO_CLASS_INFO__CLASS_T__INIT;
+        entry.has_class_id = true;
+        entry.class_id = (i32)i;
+        entry.network_name = (char *)demo_gen_symbols[i];
+        classes[i] = entry;
+        class_pointers[i] = &classes[i];
+    }
+
+    CDemoClassInfo class_info = CDEMO_CLASS_INFO__INIT;
+    class_info.n_classes = 3;
+    class_info.classes = class_pointers;
+
+    gen->payload.size = 0;
+    if (demo_gen_buffer_reserve(&gen->payload, cdemo_class_info__get_packed_size(&class_info)))
+    {
+        gen->payload.size = cdemo_class_info__pack(&class_info, gen->payload.data);
+        demo_gen_write_frame(gen, DEMO_COMMAND_CLASS_INFO, DEMO_GEN_SIGNON_TICK, gen->payload.data, gen->payload.size);
+    }
+}
+
+//
+// A net_Tick followed by 0 to 5 sounds, user messages and voice data, with the rare
+// large message standing in for the bursts seen around round starts
+//
+static void demo_gen_build_messages(DemoGen *gen, u32 large_message_rate)
+{
+    static u8 payload[32 * 1024];
+
+    gen->messages.size = 0;
+    DemoGenBitWriter writer = { &gen->messages, 0, 0 };
+
+    demo_gen_fill(gen, payload, 12);
+    demo_gen_bits_write_ubitvar(&writer, DEMO_GEN_NET_TICK);
+    demo_gen_bits_write_varint(&writer, 12);
+    for (u32 i = 0; i < 12; i++)
+    {
+        demo_gen_bits_write(&writer, payload[i], 8);
+    }
+
+    const u32 message_count = demo_gen_random_range(gen, 0, 5);
+    for (u32 m = 0; m < message_count; m++)
+    {
+        u32 message_id = SVC__MESSAGES__svc_Sounds;
+        u32 size = demo_gen_random_range(gen, 16, 96);
+        const u32 kind = demo_gen_random_range(gen, 0, 9);
+        if (kind >= 6 && kind < 9)
+        {
+            message_id = DEMO_GEN_USER_MESSAGE;
+            size = demo_gen_random_range(gen, 24, 512);
+        }
+        else if (kind == 9)
+        {
+            message_id = SVC__MESSAGES__svc_VoiceData;
+            size = demo_gen_random_range(gen, 200, 900);
+        }
+
+        if (demo_gen_random_range(gen, 0, 999) < large_message_rate)
+        {
+            size = demo_gen_random_range(gen, 8 * 1024, (u32)sizeof(payload));
+        }
+
+        demo_gen_fill(gen, payload, size);
+        demo_gen_bits_write_ubitvar(&writer, message_id);
+        demo_gen_bits_write_varint(&writer, size);
+        for (u32 i = 0; i < size; i++)
+        {
+            demo_gen_bits_write(&writer, payload[i], 8);
+        }
+    }
+
+    demo_gen_bits_flush(&writer);
+}
+
+static void demo_gen_write_packet(DemoGen *gen, u32 command, u32 tick, u32 large_message_rate)
+{
+    demo_gen_build_messages(gen, large_message_rate);
+
+    CDemoPacket packet = CDEMO_PACKET__INIT;
+    packet.has_data = true;
+    packet.data.data = gen->messages.data;
+    packet.data.len = gen->messages.size;
+
+    gen->payload.size = 0;
+    if (command == DEMO_COMMAND_FULL_PACKET)
+    {
+        CDemoStringTables string_tables = CDEMO_STRING_TABLES__INIT;
+        CDemoFullPacket full_packet = CDEMO_FULL_PACKET__INIT;
+        full_packet.string_table = &string_tables;
+        full_packet.packet = &packet;
+        if (demo_gen_buffer_reserve(&gen->payload, cdemo_full_packet__get_packed_size(&full_packet)))
+        {
+            gen->payload.size = cdemo_full_packet__pack(&full_packet, gen->payload.data);
+        }
+    }
+    else if (demo_gen_buffer_reserve(&gen->payload, cdemo_packet__get_packed_size(&packet)))
+    {
+        gen->payload.size = cdemo_packet__pack(&packet, gen->payload.data);
+    }
+
+    demo_gen_write_frame(gen, command, tick, gen->payload.data, gen->payload.size);
+}
+
+static void demo_gen_write_file_info(DemoGen *gen, u32 tick_count)
+{
+    CDemoFileInfo file_info = CDEMO_FILE_INFO__INIT;
+    file_info.has_playback_time = true;
+    file_info.playback_time = (f32)tick_count / 64.0f;
+    file_info.has_playback_ticks = true;
+    file_info.playback_ticks = (i32)tick_count;
+    file_info.has_playback_frames = true;
+    file_info.playback_frames = (i32)tick_count;
+
+    gen->payload.size = 0;
+    if (demo_gen_buffer_reserve(&gen->payload, cdemo_file_info__get_packed_size(&file_info)))
+    {
+        gen->payload.size = cdemo_file_info__pack(&file_info, gen->payload.data);
+        demo_gen_write_frame(gen, DEMO_COMMAND_FILE_INFO, tick_count, gen->payload.data, gen->payload.size);
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+//
+// Deterministic synthetic demo generator for the benchmarks. Writes a complete .dem
+// image in memory: file header, signon packets, send tables with a handful of
+// serializers, class info, one packet per tick with a mix of net messages, a full
+// packet every full_packet_interval ticks, file info and the stop frame. Payloads of
+// DEMO_GEN_COMPRESS_THRESHOLD bytes or more are snappy compressed, like the game does.
+// The same options always produce the same bytes.
+//
+// Net message payloads are filler of the right size and compressibility, not decodable
+// messages, so only IDs the parser skips or forwards untouched are used.
+//
+
+#include "../common.h"
+
+#define DEMO_GEN_RET_OK 0
+#define DEMO_GEN_RET_OOM 1
+#define DEMO_GEN_RET_COMPRESS_ERROR 2
+
+#define DEMO_GEN_COMPRESS_THRESHOLD 64
+
+typedef struct
+{
+    u64 seed;
+    u32 tick_count;
+    u32 full_packet_interval;
+    //
+    // Per mille of packets carrying a large (8 to 32 KB) message
+    //
+    u32 large_message_rate;
+} DemoGenOptions;
+
+void demo_gen_options_init(DemoGenOptions *options);
+
+//
+// On success *out_data is a malloc'd demo image the caller frees
+//
+int demo_gen_write(const DemoGenOptions *options, u8 **out_data, size_t *out_size);
@@ -0,0 +1,386 @@
+#pragma once
+
+//
+// LSB-first bit reader used for everything Valve packs below byte granularity
+// (embedded net messages, entity deltas, string tables).
+//
+// Bits are pulled from a 64-bit buffer that is refilled a whole word at a time,
+// so a read is a shift and a mask in the common case. Everything lives in this
+// header so reads inline into the decoding loops.
+//
+
+#include <assert.h>
+#include <string.h>
+
+#include "common.h"
+
+#define BITSTREAM_COORD_INTEGER_BITS 14
+#define BITSTREAM_COORD_FRACTIONAL_BITS 5
+#define BITSTREAM_COORD_DENOMINATOR (1 << BITSTREAM_COORD_FRACTIONAL_BITS)
+#define BITSTREAM_COORD_RESOLUTION (1.0f / BITSTREAM_COORD_DENOMINATOR)
+
+#define BITSTREAM_NORMAL_FRACTIONAL_BITS 11
+#define BITSTREAM_NORMAL_DENOMINATOR ((1 << BITSTREAM_NORMAL_FRACTIONAL_BITS) - 1)
+#define BITSTREAM_NORMAL_RESOLUTION (1.0f / BITSTREAM_NORMAL_DENOMINATOR)
+
+typedef struct
+{
+    const u8 *data;
+    //
+    // Next byte to be loaded into the buffer
+    //
+    const u8 *next;
+    const u8 *end;
+    //
+    // Unconsumed bits, LSB first. Bits above buffer_bits may already hold the
+    // following bytes, refills OR the same values back in
+    //
+    u64 buffer;
+    u32 buffer_bits;
+    //
+    // Set when a read went past the end of the data. Missing bits read as zero
+    //
+    bool overflowed;
+    //
+    // Size in bits
+    //
+    size_t size;
+} Bitstream;
+
+static inline void bitstream_init(Bitstream *stream, const u8 *data, size_t data_size_bytes)
+{
+    stream->data = data;
+    stream->next = data;
+    stream->end = data + data_size_bytes;
+    stream->buffer = 0;
+    stream->buffer_bits = 0;
+    stream->overflowed = false;
+    stream->size = data_size_bytes * 8;
+}
+
+static inline Bitstream bitstream_create(const u8 *data, size_t data_size_bytes)
+{
+    Bitstream result;
+    bitstream_init(&result, data, data_size_bytes);
+    return result;
+}
+
+//
+// Position in bits
+//
+static inline size_t bitstream_tell(const Bitstream *stream)
+{
+    return (size_t)(stream->next - stream->data) * 8u - stream->buffer_bits;
+}
+
+static inline size_t bitstream_bits_left(const Bitstream *stream)
+{
+    const size_t pos = bitstream_tell(stream);
+    return (pos < stream->size) ? stream->size - pos : 0;
+}
+
+static inline void bitstream_refill_tail(Bitstream *stream)
+{
+    while (stream->buffer_bits <= 56 && stream->next < stream->end)
+    {
+        stream->buffer |= (u64)(*stream->next) << stream->buffer_bits;
+        stream->next++;
+        stream->buffer_bits += 8;
+    }
+}
+
+//
+// Tops the buffer up to at least 56 bits, unless the end of the data is near
+//
+static inline void bitstream_refill(Bitstream *stream)
+{
+    if (stream->end - stream->next >= 8)
+    {
+        u64 word;
+        memcpy(&word, stream->next, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        word = __builtin_bswap64(word);
+#endif
+        stream->buffer |= word << stream->buffer_bits;
+        stream->next += (63 - stream->buffer_bits) >> 3;
+        stream->buffer_bits |= 56;
+    }
+    else
+    {
+        bitstream_refill_tail(stream);
+    }
+}
+
+//
+// Makes sure bit_count bits can be taken from the buffer, padding with zeros past the end
+//
+static inline void bitstream_ensure(Bitstream *stream, u32 bit_count)
+{
+    if (stream->buffer_bits < bit_count)
+    {
+        bitstream_refill(stream);
+        if (stream->buffer_bits < bit_count)
+        {
+            stream->overflowed = true;
+            stream->buffer_bits = bit_count;
+        }
+    }
+}
+
+static inline u32 bitstream_read_u32(Bitstream *stream, u32 bit_count)
+{
+    assert(bit_count <= 32);
+
+    bitstream_ensure(stream, bit_count);
+
+    const u32 result = (u32)(stream->buffer & ((1ull << bit_count) - 1));
+    stream->buffer >>= bit_count;
+    stream->buffer_bits -= bit_count;
+
+    return result;
+}
+
+static inline u64 bitstream_read_u64(Bitstream *stream, u32 bit_count)
+{
+    assert(bit_count <= 64);
+
+    if (bit_count <= 32)
+    {
+        return bitstream_read_u32(stream, bit_count);
+    }
+
+    const u64 low = bitstream_read_u32(stream, 32);
+    const u64 high = bitstream_read_u32(stream, bit_count - 32);
+    return low | (high << 32);
+}
+
+static inline bool bitstream_read_bool(Bitstream *stream)
+{
+    return bitstream_read_u32(stream, 1) != 0;
+}
+
+//
+// Looks at the next bit_count bits without consuming them. Returns false when fewer
+// than bit_count bits are left
+//
+static inline bool bitstream_peek_u32(Bitstream *stream, u32 bit_count, u32 *out_value)
+{
+    assert(bit_count <= 32);
+
+    if (stream->buffer_bits < bit_count)
+    {
+        bitstream_refill(stream);
+        if (stream->buffer_bits < bit_count)
+        {
+            return false;
+        }
+    }
+
+    *out_value = (u32)(stream->buffer & ((1ull << bit_count) - 1));
+    return true;
+}
+
+//
+// Moves the cursor forward without decoding anything
+//
+static inline void bitstream_skip(Bitstream *stream, size_t bit_count)
+{
+    if (bit_count <= stream->buffer_bits)
+    {
+        stream->buffer >>= bit_count;
+        stream->buffer_bits -= (u32)bit_count;
+        return;
+    }
+
+    const size_t target = bitstream_tell(stream) + bit_count;
+    if (target > stream->size)
+    {
+        stream->overflowed = true;
+        stream->next = stream->end;
+        stream->buffer = 0;
+        stream->buffer_bits = 0;
+        return;
+    }
+
+    stream->next = stream->data + (target / 8u);
+    stream->buffer = 0;
+    stream->buffer_bits = 0;
+    bitstream_read_u32(stream, (u32)(target % 8u));
+}
+
+//
+// Valve's UBitVar, a 6 bit value whose top two bits select 0, 4, 8 or 28 extra high bits.
+// Used for message types and entity indices
+//
+static inline u32 bitstream_read_ubitvar(Bitstream *stream)
+{
+    static const u8 extra_bits[4] = { 0, 4, 8, 28 };
+
+    const u32 head = bitstream_read_u32(stream, 6);
+    const u32 extra = bitstream_read_u32(stream, extra_bits[head >> 4]);
+    return (head & 15u) | (extra << 4);
+}
+
+//
+// Protobuf style base-128 varint. When 40 bits are buffered the terminating byte is found
+// with one mask and the 7 bit groups are compacted without a loop
+//
+static inline u32 bitstream_read_varint32(Bitstream *stream)
+{
+    if (stream->buffer_bits < 40)
+    {
+        bitstream_refill(stream);
+    }
+
+    if (stream->buffer_bits >= 40)
+    {
+        const u64 continuation = (~stream->buffer) & 0x8080808080ull;
+        const u32 byte_count = (continuation) ? ((u32)__builtin_ctzll(continuation) + 1) / 8u : 5u;
+        const u32 bit_count = byte_count * 8u;
+        const u64 bytes = stream->buffer & ((1ull << bit_count) - 1);
+
+        stream->buffer >>= bit_count;
+        stream->buffer_bits -= bit_count;
+
+        return (u32)((bytes & 0x7Full) |
+                     ((bytes >> 1) & (0x7Full << 7)) |
+                     ((bytes >> 2) & (0x7Full << 14)) |
+                     ((bytes >> 3) & (0x7Full << 21)) |
+                     ((bytes >> 4) & (0x0Full << 28)));
+    }
+
+    u32 result = 0;
+    for (u32 shift = 0; shift < 35; shift += 7)
+    {
+        const u32 byte = bitstream_read_u32(stream, 8);
+        result |= (byte & 0x7Fu) << shift;
+        if (!(byte & 0x80u))
+        {
+            break;
+        }
+    }
+    return result;
+}
+
+static inline u64 bitstream_read_varint64(Bitstream *stream)
+{
+    u64 result = 0;
+    for (u32 shift = 0; shift < 70; shift += 7)
+    {
+        const u64 byte = bitstream_read_u32(stream, 8);
+        result |= (byte & 0x7Fu) << shift;
+        if (!(byte & 0x80u))
+        {
+            break;
+        }
+    }
+    return result;
+}
+
+static inline i32 bitstream_read_signed_varint32(Bitstream *stream)
+{
+    const u32 value = bitstream_read_varint32(stream);
+    return (i32)((value >> 1) ^ (~(value & 1u) + 1u));
+}
+
+static inline i64 bitstream_read_signed_varint64(Bitstream *stream)
+{
+    const u64 value = bitstream_read_varint64(stream);
+    return (i64)((value >> 1) ^ (~(value & 1u) + 1u));
+}
+
+//
+// Raw IEEE float
+//
+static inline f32 bitstream_read_noscale_float(Bitstream *stream)
+{
+    const u32 bits = bitstream_read_u32(stream, 32);
+    f32 result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+//
+// World coordinate: optional integer and fractional parts followed by a sign
+//
+static inline f32 bitstream_read_coord(Bitstream *stream)
+{
+    const bool has_integer = bitstream_read_bool(stream);
+    const bool has_fraction = bitstream_read_bool(stream);
+
+    if (!has_integer && !has_fraction)
+    {
+        return 0.0f;
+    }
+
+    const bool is_negative = bitstream_read_bool(stream);
+    const u32 integer = (has_integer) ? bitstream_read_u32(stream, BITSTREAM_COORD_INTEGER_BITS) + 1 : 0;
+    const u32 fraction = (has_fraction) ? bitstream_read_u32(stream, BITSTREAM_COORD_FRACTIONAL_BITS) : 0;
+    const f32 value = (f32)integer + (f32)fraction * BITSTREAM_COORD_RESOLUTION;
+
+    return (is_negative) ? -value : value;
+}
+
+//
+// Single component of a unit vector
+//
+static inline f32 bitstream_read_normal(Bitstream *stream)
+{
+    const bool is_negative = bitstream_read_bool(stream);
+    const u32 fraction = bitstream_read_u32(stream, BITSTREAM_NORMAL_FRACTIONAL_BITS);
+    const f32 value = (f32)fraction * BITSTREAM_NORMAL_RESOLUTION;
+
+    return (is_negative) ? -value : value;
+}
+
+//
+// Angle in degrees quantized to bit_count bits
+//
+static inline f32 bitstream_read_angle(Bitstream *stream, u32 bit_count)
+{
+    return (f32)bitstream_read_u32(stream, bit_count) * (360.0f / (f32)(1ull << bit_count));
+}
+
+static inline void bitstream_read_bytes(Bitstream *stream, u8 *out, size_t byte_count)
+{
+    if (bitstream_tell(stream) % 8u == 0 && bitstream_bits_left(stream) >= byte_count * 8u)
+    {
+        //
+        // Byte aligned, copy straight out of the source
+        //
+        const size_t byte_pos = bitstream_tell(stream) / 8u;
+        memcpy(out, stream->data + byte_pos, byte_count);
+        bitstream_skip(stream, byte_count * 8u);
+        return;
+    }
+
+    for (size_t i = 0; i < byte_count; i++)
+    {
+        out[i] = (u8)bitstream_read_u32(stream, 8);
+    }
+}
+
+//
+// Reads a null terminated string. Always terminates out, returns the string length.
+// Characters that don't fit are consumed and dropped
+//
+static inline size_t bitstream_read_string(Bitstream *stream, char *out, size_t out_size)
+{
+    assert(out_size > 0);
+
+    size_t length = 0;
+    while (true)
+    {
+        const char c = (char)bitstream_read_u32(stream, 8);
+        if (c == '\0' || stream->overflowed)
+        {
+            break;
+        }
+        if (length + 1 < out_size)
+        {
+            out[length++] = c;
+        }
+    }
+    out[length] = '\0';
+    return length;
+}
@@ -7,6 +7,9 @@ CC='clang'
 # CFLAGS_DEBUG='-g'
 
 CFLAGS_OPTIMIZE='-O2'
+
+# Per-stage profiling counters behind --stats. Comment out to compile them away entirely
+CFLAGS_STATS='-DPARSE_STATS'
 CFLAGS_STD='-std=c23'
 
 CFLAGS_WARNINGS='-Wextra -Wall -Wpedantic -Wundef -Wshadow -Wpointer-arith -Wstrict-prototypes -Wunreachable-code -Wformat=2 -Wold-style-definition -Wredundant-decls -Wnested-externs -Wmissing-include-dirs'
@@ -18,11 +21,68 @@ PROTO_INC="-I${ROOT_DIR}/ -I${ROOT_DIR}/deps/protobuf-c/"
 PROTO_ROOT_DIR="${ROOT_DIR}/protos"
 PROTO_SRCS="${PROTO_ROOT_DIR}/demo.pb-c.c ${PROTO_ROOT_DIR}/gameevents.pb-c.c ${PROTO_ROOT_DIR}/networkbasetypes.pb-c.c ${PROTO_ROOT_DIR}/network_connection.pb-c.c ${PROTO_ROOT_DIR}/google/protobuf/descriptor.pb-c.c ${PROTO_ROOT_DIR}/netmessages.pb-c.c"
 
-CFLAGS_LIBS="-lrt -lc -lprotobuf-c -lstdc++ ${LIB_SNAPPY_OBJ}"
-CFLAGS="${CFLAGS_STD} ${CFLAGS_DEBUG} ${CFLAGS_OPTIMIZE} ${CFLAGS_WARNINGS}"
+CFLAGS_LIBS="-lrt -lc -lm -lpthread -lprotobuf-c -lstdc++ -lzstd -lz -lbz2 ${LIB_SNAPPY_OBJ}"
+CFLAGS="${CFLAGS_STD} ${CFLAGS_DEBUG} ${CFLAGS_OPTIMIZE} ${CFLAGS_STATS} ${CFLAGS_WARNINGS}"
 CFLAGS_INC="${LIB_SNAPPY_INC} ${PROTO_INC}"
 
-SOURCE_FILES="main.c ${PROTO_SRCS}"
+LIB_SOURCE_FILES="demoparser.c demo.c pipeline.c frame_index.c frame_prescan.c arena.c message_views.c message_dispatch.c entity.c string_table.c game_events.c parallel.c serializer_cache.c string_intern.c log.c arrow_writer.c arrow_export.c ${PROTO_SRCS}"
+CLI_SOURCE_FILES="main.c batch.c batch_reader.c live_file.c archive_file.c parse_stats.c result_cache.c"
 OUT_EXE_NAME='demo_parser'
+OUT_LIB_NAME='libdemoparser'
+
+BENCH_BITSTREAM_SOURCE_FILES="bench/bench_bitstream.c"
+BENCH_BITSTREAM_EXE_NAME='bench_bitstream'
+BENCH_PARSER_SOURCE_FILES="bench/bench_parser.c bench/demo_gen.c"
+BENCH_PARSER_EXE_NAME='bench_parser'
+
+# bench_check fails when a benchmark's throughput drops more than this many percent below bench/baseline.json
+BENCH_BASELINE="${ROOT_DIR}/bench/baseline.json"
+BENCH_THRESHOLD=${BENCH_THRESHOLD:-10}
+
+TARGET=${1:-demo_parser}
 
-time $CC $CFLAGS $CFLAGS_INC $SOURCE_FILES -o $OUT_EXE_NAME $CFLAGS_LIBS
\ No newline at end of file
+case $TARGET in
+    demo_parser)
+        time $CC $CFLAGS $CFLAGS_INC $CLI_SOURCE_FILES $LIB_SOURCE_FILES -o $OUT_EXE_NAME $CFLAGS_LIBS
+        ;;
+    lib)
+        LIB_OBJ_DIR="${ROOT_DIR}/build/lib"
+        mkdir -p $LIB_OBJ_DIR
+        LIB_OBJS=""
+        for SOURCE_FILE in $LIB_SOURCE_FILES; do
+            OBJ_FILE="${LIB_OBJ_DIR}/$(basename ${SOURCE_FILE} .c).o"
+            $CC $CFLAGS $CFLAGS_INC -fPIC -c $SOURCE_FILE -o $OBJ_FILE || exit 1
+            LIB_OBJS="${LIB_OBJS} ${OBJ_FILE}"
+        done
+        ar rcs ${OUT_LIB_NAME}.a $LIB_OBJS
+        $CC -shared $LIB_OBJS -o ${OUT_LIB_NAME}.so $CFLAGS_LIBS
+        ;;
+    bench)
+        time $CC $CFLAGS $BENCH_BITSTREAM_SOURCE_FILES -o $BENCH_BITSTREAM_EXE_NAME || exit 1
+        time $CC $CFLAGS $CFLAGS_INC $BENCH_PARSER_SOURCE_FILES $LIB_SOURCE_FILES -o $BENCH_PARSER_EXE_NAME $CFLAGS_LIBS
+        ;;
+    bench_baseline)
+        $0 bench || exit 1
+        (./$BENCH_BITSTREAM_EXE_NAME --json && ./$BENCH_PARSER_EXE_NAME --json) > $BENCH_BASELINE || exit 1
+        echo "Wrote ${BENCH_BASELINE}"
+        ;;
+    bench_check)
+        if [ ! -f $BENCH_BASELINE ]; then
+            echo "No baseline at ${BENCH_BASELINE}, run ./build.sh bench_baseline first"
+            exit 1
+        fi
+        $0 bench || exit 1
+        ./$BENCH_BITSTREAM_EXE_NAME --baseline $BENCH_BASELINE --threshold $BENCH_THRESHOLD
+        BITSTREAM_RESULT=$?
+        ./$BENCH_PARSER_EXE_NAME --baseline $BENCH_BASELINE --threshold $BENCH_THRESHOLD
+        PARSER_RESULT=$?
+        if [ $BITSTREAM_RESULT -ne 0 ] || [ $PARSER_RESULT -ne 0 ]; then
+            echo "Benchmark regression above ${BENCH_THRESHOLD}%"
+            exit 1
+        fi
+        ;;
+    *)
+        echo "Unknown target: ${TARGET}. Expected demo_parser, lib, bench, bench_baseline or bench_check"
+        exit 1
+        ;;
+esac
\ No newline at end of file
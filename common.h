@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define u8 uint8_t
+#define i8 int8_t
+#define u16 uint16_t
+#define i16 int16_t
+#define u32 uint32_t
+#define i32 int32_t
+#define u64 uint64_t
+#define i64 int64_t
+#define f32 float
+#define f64 double
+
+#define UNUSED(a) (void)a
+
+#define LOG_LEVEL_ERROR 0
+#define LOG_LEVEL_WARN 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_DEBUG 3
+
+typedef void (*LogHandler)(void *user_data, int level, const char *message);
+
+typedef struct
+{
+    LogHandler handler;
+    void *user_data;
+    //
+    // Most verbose level passed on to the handler
+    //
+    int level;
+} LogSink;
+
+//
+// Log destination of the calling thread. The library points it at the handler of the
+// parser being driven for the duration of every call. Without a handler, or below the
+// level, nothing is formatted
+//
+extern thread_local LogSink log_sink;
+
+void log_write(int level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+#define log_at(message_level, ...) ((log_sink.handler && (message_level) <= log_sink.level) ? log_write((message_level), __VA_ARGS__) : (void)0)
+
+#define log_info(...) log_at(LOG_LEVEL_INFO, __VA_ARGS__)
+#define log_err(...) log_at(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define log_warn(...) log_at(LOG_LEVEL_WARN, __VA_ARGS__)
+#define log_debug(...) log_at(LOG_LEVEL_DEBUG, __VA_ARGS__)
@@ -0,0 +1,209 @@
+#include <stdlib.h>
+
+#include <snappy-c.h>
+
+#include "demo.h"
+
+static bool read_varint32_checked(const u8 *data, size_t data_size, size_t *pos, u32 *out_value);
+
+static bool read_varint32_checked(const u8 *data, size_t data_size, size_t *pos, u32 *out_value)
+{
+    u32 result = 0;
+    size_t position = *pos;
+
+    for (u32 shift = 0; shift < 35; shift += 7)
+    {
+        if (position >= data_size)
+        {
+            return false;
+        }
+
+        const u8 tmp = data[position++];
+        result |= (u32)(tmp & 0x7Fu) << shift;
+
+        if (!(tmp & 0x80u))
+        {
+            *pos = position;
+            *out_value = result;
+            return true;
+        }
+    }
+
+    //
+    // More than 5 bytes, not something we can recover from
+    //
+    return false;
+}
+
+int demo_read_frame_header(const u8 *data, size_t data_size, size_t *pos, DemoFrameHeader *out_header)
+{
+    if (*pos >= data_size)
+    {
+        return DEMO_FRAME_HEADER_RET_END;
+    }
+
+    size_t position = *pos;
+    u32 command_raw = 0;
+    u32 tick = 0;
+    u32 size = 0;
+
+    if (!read_varint32_checked(data, data_size, &position, &command_raw) ||
+        !read_varint32_checked(data, data_size, &position, &tick) ||
+        !read_varint32_checked(data, data_size, &position, &size))
+    {
+        return DEMO_FRAME_HEADER_RET_TRUNCATED;
+    }
+
+    if (size > data_size - position)
+    {
+        return DEMO_FRAME_HEADER_RET_TRUNCATED;
+    }
+
+    out_header->command = command_raw & (~DEMO_COMMAND_IS_COMPRESSED);
+    out_header->tick = tick;
+    out_header->size = size;
+    out_header->is_compressed = command_raw & DEMO_COMMAND_IS_COMPRESSED;
+
+    *pos = position;
+
+    return DEMO_FRAME_HEADER_RET_OK;
+}
+
+void demo_frame_filter_init(DemoFrameFilter *filter)
+{
+    filter->tick_min = 0;
+    filter->tick_max = UINT32_MAX;
+    filter->command_mask = DEMO_COMMAND_MASK_ALL;
+    filter->keep_early_frames = false;
+}
+
+int demo_frame_filter_apply(const DemoFrameFilter *filter, const DemoFrameHeader *header)
+{
+    if (demo_command_is_setup(header->command))
+    {
+        return DEMO_FRAME_FILTER_KEEP;
+    }
+
+    if (header->tick > filter->tick_max)
+    {
+        return DEMO_FRAME_FILTER_STOP;
+    }
+
+    //
+    // Commands the format doesn't know yet only pass a filter that keeps everything
+    //
+    const bool is_selected = (header->command < DEMO_COMMAND_MAX) ? (filter->command_mask & DEMO_COMMAND_MASK(header->command)) != 0
+                                                                  : filter->command_mask == DEMO_COMMAND_MASK_ALL;
+    if (!is_selected || (header->tick < filter->tick_min && !filter->keep_early_frames))
+    {
+        return DEMO_FRAME_FILTER_SKIP;
+    }
+
+    return DEMO_FRAME_FILTER_KEEP;
+}
+
+bool demo_command_is_setup(u32 command)
+{
+    switch (command)
+    {
+    case DEMO_COMMAND_STOP:
+    case DEMO_COMMAND_FILE_HEADER:
+    case DEMO_COMMAND_SYNC_TICK:
+    case DEMO_COMMAND_SEND_TABLES:
+    case DEMO_COMMAND_CLASS_INFO:
+    case DEMO_COMMAND_STRING_TABLES:
+    case DEMO_COMMAND_SIGNON_PACKET:
+        return true;
+    default:
+        return false;
+    }
+}
+
+int demo_decompress_frame(const char *compressed_data, size_t compressed_size, char **buffer, size_t *buffer_size, size_t *out_size)
+{
+    size_t required_size = 0;
+    if (snappy_uncompressed_length(compressed_data, compressed_size, &required_size) != SNAPPY_OK)
+    {
+        return DEMO_DECOMPRESS_RET_ERROR;
+    }
+
+    const size_t min_allocation = 1024 * 1024;
+
+    if (!(*buffer) || *buffer_size < required_size)
+    {
+        const size_t alloc_size = (required_size > min_allocation) ? required_size : min_allocation;
+        char *new_buffer = (char *)realloc(*buffer, alloc_size);
+        if (!new_buffer)
+        {
+            return DEMO_DECOMPRESS_RET_OOM;
+        }
+        *buffer = new_buffer;
+        *buffer_size = alloc_size;
+    }
+
+    //
+    // snappy_uncompress validates the input as it goes, no separate validation pass needed
+    //
+    size_t actual_uncompressed_size = *buffer_size;
+    const snappy_status status = snappy_uncompress(compressed_data, compressed_size, *buffer, &actual_uncompressed_size);
+
+    if (status != SNAPPY_OK)
+    {
+        return DEMO_DECOMPRESS_RET_ERROR;
+    }
+
+    *out_size = actual_uncompressed_size;
+
+    return DEMO_DECOMPRESS_RET_OK;
+}
+
+int demo_frame_uncompressed_size(const char *compressed_data, size_t compressed_size, size_t *out_size)
+{
+    return (snappy_uncompressed_length(compressed_data, compressed_size, out_size) == SNAPPY_OK) ? DEMO_DECOMPRESS_RET_OK : DEMO_DECOMPRESS_RET_ERROR;
+}
+
+const char *demo_command_to_string(int command)
+{
+    switch (command)
+    {
+    case DEMO_COMMAND_ERROR:
+        return "Error";
+    case DEMO_COMMAND_STOP:
+        return "Stop";
+    case DEMO_COMMAND_FILE_HEADER:
+        return "File Header";
+    case DEMO_COMMAND_FILE_INFO:
+        return "File Info";
+    case DEMO_COMMAND_SYNC_TICK:
+        return "Sync Tick";
+    case DEMO_COMMAND_SEND_TABLES:
+        return "Send Tables";
+    case DEMO_COMMAND_CLASS_INFO:
+        return "Class Info";
+    case DEMO_COMMAND_STRING_TABLES:
+        return "String Tables";
+    case DEMO_COMMAND_PACKET:
+        return "Packet";
+    case DEMO_COMMAND_SIGNON_PACKET:
+        return "Signon Packet";
+    case DEMO_COMMAND_CONSOLE_CMD:
+        return "Console Command";
+    case DEMO_COMMAND_CUSTOM_DATA:
+        return "Custom Data";
+    case DEMO_COMMAND_CUSTOM_DATA_CALLBACKS:
+        return "Custom Data Callbacks";
+    case DEMO_COMMAND_USER_CMD:
+        return "User Command";
+    case DEMO_COMMAND_FULL_PACKET:
+        return "Full Packet";
+    case DEMO_COMMAND_SAVE_GAME:
+        return "Save Game";
+    case DEMO_COMMAND_MAX:
+        return "Max (Not valid)";
+    default:
+        //
+        // Fall through
+        //
+    }
+    return "Unknown";
+}
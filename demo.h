@@ -0,0 +1,148 @@
+#pragma once
+
+//
+// Frame level layout of a CS2 demo file. A file is a DemoHeader followed by frames,
+// each made of three varints (command, tick, size) and a payload that is snappy
+// compressed when the command has DEMO_COMMAND_IS_COMPRESSED set.
+//
+
+#include "common.h"
+
+#define DEMO_COMMAND_ERROR -1
+#define DEMO_COMMAND_STOP 0
+#define DEMO_COMMAND_FILE_HEADER 1
+#define DEMO_COMMAND_FILE_INFO 2
+#define DEMO_COMMAND_SYNC_TICK 3
+#define DEMO_COMMAND_SEND_TABLES 4
+#define DEMO_COMMAND_CLASS_INFO 5
+#define DEMO_COMMAND_STRING_TABLES 6
+#define DEMO_COMMAND_PACKET 7
+#define DEMO_COMMAND_SIGNON_PACKET 8
+#define DEMO_COMMAND_CONSOLE_CMD 9
+#define DEMO_COMMAND_CUSTOM_DATA 10
+#define DEMO_COMMAND_CUSTOM_DATA_CALLBACKS 11
+#define DEMO_COMMAND_USER_CMD 12
+#define DEMO_COMMAND_FULL_PACKET 13
+#define DEMO_COMMAND_SAVE_GAME 14
+#define DEMO_COMMAND_MAX 15
+#define DEMO_COMMAND_IS_COMPRESSED 112
+
+#define DEMO_COMMAND_MASK(command) (1u << (command))
+#define DEMO_COMMAND_MASK_ALL ((1u << DEMO_COMMAND_MAX) - 1)
+
+//
+// Return codes shared by everything that hands out DemoPackets
+//
+#define PARSER_NEXT_PACKET_RET_OK 0
+#define PARSER_NEXT_PACKET_RET_END 1
+#define PARSER_NEXT_PACKET_RET_DECOMPRESS_ERROR 2
+#define PARSER_NEXT_PACKET_RET_OOM 3
+//
+// The next frame isn't completely in the data yet, when following a demo being recorded
+//
+#define PARSER_NEXT_PACKET_RET_NEED_DATA 4
+
+typedef struct
+{
+    char *data;
+    u32 type;
+    u32 data_size;
+    u32 tick;
+    //
+    // Payload size as stored in the file
+    //
+    u32 stored_size;
+    bool is_compressed;
+    //
+    // Offset of the frame header in the file
+    //
+    size_t offset;
+} DemoPacket;
+
+typedef struct
+{
+    char magic[8];
+    u32 summary_offset;
+    u32 packet_offset;
+} DemoHeader;
+
+typedef struct
+{
+    //
+    // Command with the compressed flag removed
+    //
+    u32 command;
+    u32 tick;
+    //
+    // Size of the payload as stored in the file
+    //
+    u32 size;
+    bool is_compressed;
+} DemoFrameHeader;
+
+#define DEMO_FRAME_HEADER_RET_OK 0
+#define DEMO_FRAME_HEADER_RET_END 1
+#define DEMO_FRAME_HEADER_RET_TRUNCATED 2
+
+//
+// Reads the header of the frame at *pos and checks that its payload is inside the data.
+// On success *pos is left at the start of the payload
+//
+int demo_read_frame_header(const u8 *data, size_t data_size, size_t *pos, DemoFrameHeader *out_header);
+
+#define DEMO_FRAME_FILTER_KEEP 0
+#define DEMO_FRAME_FILTER_SKIP 1
+//
+// The frame and everything after it is past the end of the query
+//
+#define DEMO_FRAME_FILTER_STOP 2
+
+//
+// The frames a query needs, decided from the frame header alone so that every other frame
+// is stepped over without being decompressed. Setup frames (file header, send tables,
+// class info, signon packets, ...) are always kept, tick bounds and the command mask
+// apply to the frames along the timeline
+//
+typedef struct
+{
+    //
+    // Inclusive, the first timeline frame after tick_max ends the demo
+    //
+    u32 tick_min;
+    u32 tick_max;
+    //
+    // DEMO_COMMAND_MASK bits of the timeline frames to keep
+    //
+    u32 command_mask;
+    //
+    // Keep the frames before tick_min anyway, for state the query needs from them
+    //
+    bool keep_early_frames;
+} DemoFrameFilter;
+
+//
+// A filter that keeps every frame
+//
+void demo_frame_filter_init(DemoFrameFilter *filter);
+int demo_frame_filter_apply(const DemoFrameFilter *filter, const DemoFrameHeader *header);
+
+//
+// Frames that set up the demo rather than advance it, parsed whatever the query
+//
+bool demo_command_is_setup(u32 command);
+
+#define DEMO_DECOMPRESS_RET_OK 0
+#define DEMO_DECOMPRESS_RET_ERROR 1
+#define DEMO_DECOMPRESS_RET_OOM 2
+
+//
+// Snappy decompresses a frame payload into *buffer, growing it when required
+//
+int demo_decompress_frame(const char *compressed_data, size_t compressed_size, char **buffer, size_t *buffer_size, size_t *out_size);
+
+//
+// Size a frame payload decompresses to, read from its snappy preamble
+//
+int demo_frame_uncompressed_size(const char *compressed_data, size_t compressed_size, size_t *out_size);
+
+const char *demo_command_to_string(int command);
@@ -0,0 +1,1380 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "demoparser.h"
+#include "message_views.h"
+#include "serializer_cache.h"
+
+#define DEMO_EVENT_QUEUE_MIN_CAPACITY 64
+
+static bool demo_parser_wants(const DemoParser *parser, u32 kind);
+static void demo_parser_emit(DemoParser *parser, const DemoEvent *event);
+static void demo_parser_emit_error(DemoParser *parser, u32 error, i32 code);
+static void demo_parser_emit_net_message(DemoParser *parser, u32 message_id, const u8 *data, u32 size);
+
+static int demo_parser_read_frame(DemoParser *parser, DemoPacket *out_packet);
+static int demo_parser_next_frame(DemoParser *parser, DemoPacket *out_packet);
+static bool demo_parser_apply_seek(DemoParser *parser, size_t pos);
+static void demo_parser_apply_query(DemoParser *parser);
+static int demo_parser_step(DemoParser *parser);
+static int demo_parser_step_frame(DemoParser *parser);
+
+static void demo_parser_process_frame(DemoParser *parser, DemoPacket packet);
+static void demo_parser_process_packet_data(DemoParser *parser, WireBytes packet_data);
+static void demo_parser_process_send_tables(DemoParser *parser, DemoPacket packet);
+
+static int demo_parser_on_net_message(void *user_data, u32 message_id, const u8 *data, u32 size);
+static int demo_parser_on_server_info(void *user_data, u32 message_id, const u8 *data, u32 size);
+static int demo_parser_on_packet_entities(void *user_data, u32 message_id, const u8 *data, u32 size);
+static void demo_parser_on_entity(void *user_data, u32 event, u32 entity_index);
+static int demo_parser_on_create_string_table(void *user_data, u32 message_id, const u8 *data, u32 size);
+static int demo_parser_on_update_string_table(void *user_data, u32 message_id, const u8 *data, u32 size);
+static int demo_parser_on_clear_string_tables(void *user_data, u32 message_id, const u8 *data, u32 size);
+static void demo_parser_on_string_table_entry(void *user_data, const StringTables *tables, u32 table_index, u32 entry_index);
+static void demo_parser_apply_baselines(DemoParser *parser);
+static void demo_parser_load_string_table_snapshot(DemoParser *parser, WireBytes snapshot);
+static int demo_parser_on_game_event_list(void *user_data, u32 message_id, const u8 *data, u32 size);
+static int demo_parser_on_game_event(void *user_data, u32 message_id, const u8 *data, u32 size);
+
+static bool read_varint32_bounded(const u8 *data, size_t data_size, u32 *out_value, u32 *out_read);
+
+void demo_parser_options_init(DemoParserOptions *options)
+{
+    memset(options, 0, sizeof(*options));
+    options->event_mask = DEMO_EVENT_MASK_ALL;
+    options->log_level = LOG_LEVEL_INFO;
+    demo_query_init(&options->query);
+}
+
+void demo_query_init(DemoQuery *query)
+{
+    memset(query, 0, sizeof(*query));
+    query->tick_max = UINT32_MAX;
+    query->command_mask = DEMO_COMMAND_MASK_ALL;
+}
+
+int demo_parser_init(DemoParser *parser, const u8 *data, size_t data_size, const DemoParserOptions *options)
+{
+    memset(parser, 0, sizeof(*parser));
+
+    if (options)
+    {
+        parser->options = *options;
+    }
+    else
+    {
+        demo_parser_options_init(&parser->options);
+    }
+
+    parser->log_sink.handler = parser->options.log_handler;
+    parser->log_sink.user_data = parser->options.log_user_data;
+    parser->log_sink.level = parser->options.log_level;
+
+    if (data_size < sizeof(DemoHeader))
+    {
+        return DEMO_PARSER_RET_INVALID;
+    }
+
+    parser->data = data;
+    parser->data_size = data_size;
+    parser->pos = sizeof(DemoHeader);
+    parser->end_offset = SIZE_MAX;
+    parser->seek_keyframe = DEMO_PARSER_KEYFRAME_NONE;
+
+    if (parser->options.max_frame_size > 0)
+    {
+        parser->uncompressed_buffer = (char *)malloc(parser->options.max_frame_size);
+        if (!parser->uncompressed_buffer)
+        {
+            parser->data = nullptr;
+            return DEMO_PARSER_RET_OOM;
+        }
+        parser->uncompressed_buffer_size = parser->options.max_frame_size;
+    }
+
+    arena_init(&parser->frame_arena, 256 * 1024);
+    parser->frame_allocator = arena_protobuf_allocator(&parser->frame_arena);
+
+    arena_init(&parser->setup_arena, 4 * 1024 * 1024);
+    parser->setup_allocator = arena_protobuf_allocator(&parser->setup_arena);
+
+    message_dispatcher_init(&parser->dispatcher);
+    parser->dispatcher.stats = parser->options.stats;
+    entity_engine_init(&parser->entities);
+    string_tables_init(&parser->string_tables);
+    string_tables_set_change_handler(&parser->string_tables, demo_parser_on_string_table_entry, parser);
+    game_events_init(&parser->game_events);
+
+    demo_parser_apply_query(parser);
+
+    //
+    // Messages are only looked at when somebody wants them, everything else is skipped
+    // by size in the dispatcher
+    //
+    if (demo_parser_wants(parser, DEMO_EVENT_NET_MESSAGE))
+    {
+        for (u32 message_id = 0; message_id < MESSAGE_ID_MAX; message_id++)
+        {
+            if (parser->message_mask[message_id / 64] & (1ull << (message_id % 64)))
+            {
+                message_dispatcher_register(&parser->dispatcher, message_id, demo_parser_on_net_message, parser);
+            }
+        }
+    }
+
+    message_dispatcher_register(&parser->dispatcher, SVC__MESSAGES__svc_ServerInfo, demo_parser_on_server_info, parser);
+
+    //
+    // Deltas can't be applied to entities whose creation was skipped
+    //
+    if (parser->frame_filter.tick_min == 0 || parser->frame_filter.keep_early_frames)
+    {
+        message_dispatcher_register(&parser->dispatcher, SVC__MESSAGES__svc_PacketEntities, demo_parser_on_packet_entities, parser);
+    }
+    message_dispatcher_register(&parser->dispatcher, SVC__MESSAGES__svc_CreateStringTable, demo_parser_on_create_string_table, parser);
+    message_dispatcher_register(&parser->dispatcher, SVC__MESSAGES__svc_UpdateStringTable, demo_parser_on_update_string_table, parser);
+    message_dispatcher_register(&parser->dispatcher, SVC__MESSAGES__svc_ClearAllStringTables, demo_parser_on_clear_string_tables, parser);
+    message_dispatcher_register(&parser->dispatcher, GAME_EVENT_MESSAGE_LIST, demo_parser_on_game_event_list, parser);
+    message_dispatcher_register(&parser->dispatcher, GAME_EVENT_MESSAGE_EVENT, demo_parser_on_game_event, parser);
+
+    if (demo_parser_wants(parser, DEMO_EVENT_ENTITY))
+    {
+        entity_engine_set_event_handler(&parser->entities, demo_parser_on_entity, parser);
+        entity_engine_track_changes(&parser->entities, parser->options.entity_changes);
+    }
+
+    //
+    // The pipeline would have to be told about every append, live demos are parsed as
+    // they're written anyway
+    //
+    if (parser->options.live)
+    {
+        parser->options.thread_count = 0;
+    }
+
+    if (parser->options.thread_count > 0)
+    {
+        const int pipeline_ret_code = packet_pipeline_init(&parser->pipeline, parser->data, parser->data_size, parser->pos, parser->options.thread_count, &parser->frame_filter);
+        if (pipeline_ret_code != PACKET_PIPELINE_INIT_RET_OK)
+        {
+            demo_parser_free(parser);
+            return (pipeline_ret_code == PACKET_PIPELINE_INIT_RET_OOM) ? DEMO_PARSER_RET_OOM : DEMO_PARSER_RET_THREAD_ERROR;
+        }
+        parser->use_pipeline = true;
+    }
+
+    return DEMO_PARSER_RET_OK;
+}
+
+//
+// Turns options.query into the frame filter, the message mask and the entity projection
+//
+static void demo_parser_apply_query(DemoParser *parser)
+{
+    const DemoQuery *query = &parser->options.query;
+
+    demo_frame_filter_init(&parser->frame_filter);
+    parser->frame_filter.tick_min = query->tick_min;
+    parser->frame_filter.tick_max = query->tick_max;
+    parser->frame_filter.command_mask = query->command_mask;
+    parser->frame_filter.keep_early_frames = demo_parser_wants(parser, DEMO_EVENT_ENTITY);
+
+    if (query->message_id_count == 0)
+    {
+        memset(parser->message_mask, 0xFF, sizeof(parser->message_mask));
+    }
+    for (u32 i = 0; i < query->message_id_count; i++)
+    {
+        if (query->message_ids[i] < MESSAGE_ID_MAX)
+        {
+            parser->message_mask[query->message_ids[i] / 64] |= 1ull << (query->message_ids[i] % 64);
+        }
+    }
+
+    entity_engine_set_query(&parser->entities, query->entity_classes, query->entity_class_count, query->entity_fields, query->entity_field_count);
+}
+
+void demo_parser_free(DemoParser *parser)
+{
+    if (parser->use_pipeline)
+    {
+        packet_pipeline_destroy(&parser->pipeline);
+        parser->use_pipeline = false;
+    }
+
+    //
+    // Only set up once the header checked out
+    //
+    if (parser->data)
+    {
+        arena_free(&parser->frame_arena);
+        arena_free(&parser->setup_arena);
+        message_dispatcher_free(&parser->dispatcher);
+        entity_engine_free(&parser->entities);
+        string_tables_free(&parser->string_tables);
+        game_events_free(&parser->game_events);
+    }
+
+    free(parser->uncompressed_buffer);
+    free(parser->queue.events);
+
+    parser->data = nullptr;
+    parser->uncompressed_buffer = nullptr;
+    parser->queue.events = nullptr;
+}
+
+void demo_parser_seek_tick(DemoParser *parser, const FrameIndex *index, u32 tick)
+{
+    parser->seek_index = index;
+    parser->seek_tick = tick;
+    parser->seek_keyframe = DEMO_PARSER_KEYFRAME_NONE;
+    parser->seek_pending = true;
+}
+
+void demo_parser_seek_keyframe(DemoParser *parser, const FrameIndex *index, u32 keyframe)
+{
+    parser->seek_index = index;
+    parser->seek_tick = (keyframe < index->full_packet_count) ? index->entries[index->full_packets[keyframe]].tick : 0;
+    parser->seek_keyframe = keyframe;
+    parser->seek_pending = true;
+}
+
+void demo_parser_set_end_offset(DemoParser *parser, size_t end_offset)
+{
+    parser->end_offset = end_offset;
+}
+
+void demo_parser_set_data(DemoParser *parser, const u8 *data, size_t data_size)
+{
+    parser->data = data;
+    parser->data_size = data_size;
+}
+
+void demo_parser_set_window(DemoParser *parser, const u8 *data, size_t data_size, size_t data_offset)
+{
+    const size_t offset = parser->data_offset + parser->pos;
+    parser->data = data;
+    parser->data_size = data_size;
+    parser->pos = offset - data_offset;
+    parser->data_offset = data_offset;
+}
+
+size_t demo_parser_offset(const DemoParser *parser)
+{
+    return (parser->use_pipeline) ? parser->pipeline.pos : parser->data_offset + parser->pos;
+}
+
+int demo_parser_subscribe_game_event(DemoParser *parser, const char *name)
+{
+    return (game_events_subscribe(&parser->game_events, name) == GAME_EVENT_RET_OK) ? DEMO_PARSER_RET_OK : DEMO_PARSER_RET_OOM;
+}
+
+static bool demo_parser_wants(const DemoParser *parser, u32 kind)
+{
+    return (parser->options.event_mask & DEMO_EVENT_MASK(kind)) != 0;
+}
+
+static void demo_parser_emit(DemoParser *parser, const DemoEvent *event)
+{
+    if (parser->is_quiet)
+    {
+        return;
+    }
+
+    if (parser->push_handler)
+    {
+        if (parser->push_result == 0)
+        {
+            PARSE_STATS_TIMER_START(parser->options.stats, handler_start);
+            parser->push_result = parser->push_handler(parser->push_user_data, event);
+            PARSE_STATS_TIMER_STOP(parser->options.stats, PARSE_STATS_STAGE_EVENTS, handler_start);
+        }
+        return;
+    }
+
+    DemoEventQueue *queue = &parser->queue;
+    if (queue->count == queue->capacity)
+    {
+        const u32 new_capacity = (queue->capacity) ? queue->capacity * 2 : DEMO_EVENT_QUEUE_MIN_CAPACITY;
+        DemoEvent *new_events = (DemoEvent *)realloc(queue->events, new_capacity * sizeof(DemoEvent));
+        if (!new_events)
+        {
+            parser->out_of_memory = true;
+            return;
+        }
+        queue->events = new_events;
+        queue->capacity = new_capacity;
+
+        PARSE_STATS_ADD(parser->options.stats, buffer_reallocations, 1);
+    }
+
+    queue->events[queue->count++] = *event;
+}
+
+static void demo_parser_emit_error(DemoParser *parser, u32 error, i32 code)
+{
+    if (!demo_parser_wants(parser, DEMO_EVENT_ERROR))
+    {
+        return;
+    }
+
+    DemoEvent event;
+    event.kind = DEMO_EVENT_ERROR;
+    event.tick = parser->tick;
+    event.error.error = error;
+    event.error.code = code;
+    demo_parser_emit(parser, &event);
+}
+
+static void demo_parser_emit_net_message(DemoParser *parser, u32 message_id, const u8 *data, u32 size)
+{
+    if (!demo_parser_wants(parser, DEMO_EVENT_NET_MESSAGE) || message_id >= MESSAGE_ID_MAX || !(parser->message_mask[message_id / 64] & (1ull << (message_id % 64))))
+    {
+        return;
+    }
+
+    DemoEvent event;
+    event.kind = DEMO_EVENT_NET_MESSAGE;
+    event.tick = parser->tick;
+    event.net_message.message_id = message_id;
+    event.net_message.size = size;
+    event.net_message.data = data;
+
+    //
+    // The dispatcher only lends payloads for the duration of the handler. Queued events
+    // outlive it, so their payload goes into the frame arena
+    //
+    if (!parser->push_handler && size > 0)
+    {
+        u8 *copy = (u8 *)arena_alloc(&parser->frame_arena, size);
+        if (!copy)
+        {
+            parser->out_of_memory = true;
+            return;
+        }
+        memcpy(copy, data, size);
+        event.net_message.data = copy;
+    }
+
+    demo_parser_emit(parser, &event);
+}
+
+static int demo_parser_read_frame(DemoParser *parser, DemoPacket *out_packet)
+{
+    PARSE_STATS_TIMER_START(parser->options.stats, header_start);
+
+    //
+    // Frames the query doesn't need are stepped over here, before anything looks at
+    // their payload
+    //
+    DemoFrameHeader header;
+    size_t offset;
+    int header_ret_code;
+    int filter_ret_code = DEMO_FRAME_FILTER_SKIP;
+    do
+    {
+        offset = parser->pos;
+        header_ret_code = demo_read_frame_header(parser->data, parser->data_size, &parser->pos, &header);
+        if (header_ret_code != DEMO_FRAME_HEADER_RET_OK)
+        {
+            break;
+        }
+
+        filter_ret_code = demo_frame_filter_apply(&parser->frame_filter, &header);
+        if (filter_ret_code == DEMO_FRAME_FILTER_SKIP)
+        {
+            parser->pos += header.size;
+        }
+    } while (filter_ret_code == DEMO_FRAME_FILTER_SKIP);
+
+    PARSE_STATS_TIMER_STOP(parser->options.stats, PARSE_STATS_STAGE_FRAME_HEADER, header_start);
+
+    if (header_ret_code == DEMO_FRAME_HEADER_RET_OK && filter_ret_code == DEMO_FRAME_FILTER_STOP)
+    {
+        parser->pos = offset;
+        return PARSER_NEXT_PACKET_RET_END;
+    }
+
+    if (header_ret_code != DEMO_FRAME_HEADER_RET_OK)
+    {
+        //
+        // The header and payload are only consumed once complete, so the same frame is
+        // read again from the start with more data
+        //
+        if (parser->options.live)
+        {
+            return PARSER_NEXT_PACKET_RET_NEED_DATA;
+        }
+        if (header_ret_code == DEMO_FRAME_HEADER_RET_TRUNCATED)
+        {
+            log_warn("Truncated frame at offset %zu\n", parser->data_offset + parser->pos);
+        }
+        return PARSER_NEXT_PACKET_RET_END;
+    }
+
+    out_packet->type = header.command;
+    out_packet->tick = header.tick;
+    out_packet->stored_size = header.size;
+    out_packet->is_compressed = header.is_compressed;
+    out_packet->offset = parser->data_offset + offset;
+
+    const char *payload = (const char *)(parser->data + parser->pos);
+
+    //
+    // Step over the payload up front so a frame that fails to decompress is skipped
+    // rather than re-read as a frame header
+    //
+    parser->pos += header.size;
+
+    if (!header.is_compressed)
+    {
+        out_packet->data = (char *)payload;
+        out_packet->data_size = header.size;
+        return PARSER_NEXT_PACKET_RET_OK;
+    }
+
+    if (parser->options.max_frame_size > 0)
+    {
+        size_t required_size = 0;
+        if (demo_frame_uncompressed_size(payload, header.size, &required_size) == DEMO_DECOMPRESS_RET_OK && required_size > parser->options.max_frame_size)
+        {
+            log_err("Frame at tick %u decompresses to %zu bytes, over the limit of %zu\n", header.tick, required_size, parser->options.max_frame_size);
+            out_packet->data = nullptr;
+            out_packet->data_size = 0;
+            return PARSER_NEXT_PACKET_RET_DECOMPRESS_ERROR;
+        }
+    }
+
+    PARSE_STATS_TIMER_START(parser->options.stats, decompress_start);
+#ifdef PARSE_STATS
+    const size_t previous_buffer_size = parser->uncompressed_buffer_size;
+#endif
+
+    size_t uncompressed_size = 0;
+    const int ret_code = demo_decompress_frame(payload, header.size, &parser->uncompressed_buffer, &parser->uncompressed_buffer_size, &uncompressed_size);
+
+    PARSE_STATS_TIMER_STOP(parser->options.stats, PARSE_STATS_STAGE_DECOMPRESS, decompress_start);
+    PARSE_STATS_ADD(parser->options.stats, buffer_reallocations, (parser->uncompressed_buffer_size != previous_buffer_size) ? 1 : 0);
+
+    if (ret_code == DEMO_DECOMPRESS_RET_OOM)
+    {
+        log_err("Failed to allocate uncompressed packet buffer\n");
+        return PARSER_NEXT_PACKET_RET_OOM;
+    }
+
+    if (ret_code != DEMO_DECOMPRESS_RET_OK)
+    {
+        log_err("Failed to decompress frame at tick %u\n", header.tick);
+        out_packet->data = nullptr;
+        out_packet->data_size = 0;
+        return PARSER_NEXT_PACKET_RET_DECOMPRESS_ERROR;
+    }
+
+    out_packet->data = parser->uncompressed_buffer;
+    out_packet->data_size = (u32)uncompressed_size;
+
+    return PARSER_NEXT_PACKET_RET_OK;
+}
+
+static int demo_parser_next_frame(DemoParser *parser, DemoPacket *out_packet)
+{
+    if (!parser->use_pipeline)
+    {
+        return demo_parser_read_frame(parser, out_packet);
+    }
+
+    //
+    // Headers and snappy run on the workers, all the parsing thread sees is the wait
+    //
+    PARSE_STATS_TIMER_START(parser->options.stats, wait_start);
+    const int ret_code = packet_pipeline_next(&parser->pipeline, out_packet);
+    PARSE_STATS_TIMER_STOP(parser->options.stats, PARSE_STATS_STAGE_PIPELINE_WAIT, wait_start);
+
+    return ret_code;
+}
+
+//
+// Setup frames are always processed, the jump happens once pos reached the first packet
+// frame. Returns true when the parser jumped to a keyframe
+//
+static bool demo_parser_apply_seek(DemoParser *parser, size_t pos)
+{
+    if (!parser->seek_pending || pos < parser->seek_index->first_packet_offset)
+    {
+        return false;
+    }
+
+    parser->seek_pending = false;
+
+    DemoEvent event;
+    event.kind = DEMO_EVENT_SEEK;
+    event.tick = parser->tick;
+    event.seek.target_tick = parser->seek_tick;
+    event.seek.keyframe_tick = 0;
+    event.seek.found = false;
+
+    const FrameIndex *index = parser->seek_index;
+    const FrameIndexEntry *keyframe = nullptr;
+    if (parser->seek_keyframe == DEMO_PARSER_KEYFRAME_NONE)
+    {
+        keyframe = frame_index_find_keyframe(index, parser->seek_tick);
+    }
+    else if (parser->seek_keyframe < index->full_packet_count)
+    {
+        keyframe = &index->entries[index->full_packets[parser->seek_keyframe]];
+    }
+    if (keyframe)
+    {
+        parser->pos = keyframe->offset;
+        event.seek.keyframe_tick = keyframe->tick;
+        event.seek.found = true;
+
+        entity_engine_clear(&parser->entities);
+        parser->load_string_table_snapshot = true;
+
+        if (parser->use_pipeline)
+        {
+            packet_pipeline_destroy(&parser->pipeline);
+            if (packet_pipeline_init(&parser->pipeline, parser->data, parser->data_size, parser->pos, parser->options.thread_count, &parser->frame_filter) != PACKET_PIPELINE_INIT_RET_OK)
+            {
+                //
+                // A failed init cleans up after itself, carry on decompressing inline
+                //
+                log_warn("Failed to restart decompression threads\n");
+                parser->use_pipeline = false;
+            }
+        }
+    }
+
+    //
+    // Reported even when it lands among frames parsed quietly for the query
+    //
+    parser->is_quiet = false;
+    if (demo_parser_wants(parser, DEMO_EVENT_SEEK))
+    {
+        demo_parser_emit(parser, &event);
+    }
+
+    return event.seek.found;
+}
+
+//
+// Reads and processes one frame, queueing or pushing its events
+//
+static int demo_parser_step(DemoParser *parser)
+{
+    PARSE_STATS_TIMER_START(parser->options.stats, step_start);
+
+    const int ret_code = demo_parser_step_frame(parser);
+
+#ifdef PARSE_STATS
+    if (parser->options.stats)
+    {
+        parser->options.stats->total_ns += parse_stats_now_ns() - step_start;
+        parser->options.stats->arena_block_allocations = parser->frame_arena.block_allocations + parser->setup_arena.block_allocations;
+    }
+#endif
+
+    return ret_code;
+}
+
+static int demo_parser_step_frame(DemoParser *parser)
+{
+    const size_t pos = demo_parser_offset(parser);
+    if (parser->seek_pending)
+    {
+        demo_parser_apply_seek(parser, pos);
+    }
+
+    if (pos >= parser->end_offset)
+    {
+        return DEMO_PARSER_RET_END;
+    }
+
+    //
+    // Whatever the previous frame unpacked is dead now
+    //
+    arena_reset(&parser->frame_arena);
+
+    DemoPacket packet;
+    int ret_code = demo_parser_next_frame(parser, &packet);
+
+    //
+    // Frames skipped by the query can carry the parser past the first packet frame, or
+    // past the end, without stopping in between
+    //
+    if (ret_code == PARSER_NEXT_PACKET_RET_OK || ret_code == PARSER_NEXT_PACKET_RET_DECOMPRESS_ERROR)
+    {
+        if (parser->seek_pending && demo_parser_apply_seek(parser, packet.offset))
+        {
+            ret_code = demo_parser_next_frame(parser, &packet);
+        }
+        else if (packet.offset >= parser->end_offset)
+        {
+            return DEMO_PARSER_RET_END;
+        }
+    }
+
+    switch (ret_code)
+    {
+    case PARSER_NEXT_PACKET_RET_OK:
+        break;
+    case PARSER_NEXT_PACKET_RET_DECOMPRESS_ERROR:
+        parser->tick = packet.tick;
+        parser->is_quiet = packet.tick < parser->frame_filter.tick_min;
+        demo_parser_emit_error(parser, DEMO_ERROR_DECOMPRESS, 0);
+        return (parser->out_of_memory) ? DEMO_PARSER_RET_OOM : DEMO_PARSER_RET_OK;
+    case PARSER_NEXT_PACKET_RET_OOM:
+        return DEMO_PARSER_RET_OOM;
+    case PARSER_NEXT_PACKET_RET_NEED_DATA:
+        return DEMO_PARSER_RET_NEED_DATA;
+    default:
+        return DEMO_PARSER_RET_END;
+    }
+
+    parser->tick = packet.tick;
+    parser->is_quiet = packet.tick < parser->frame_filter.tick_min && !demo_command_is_setup(packet.type);
+
+#ifdef PARSE_STATS
+    if (parser->options.stats)
+    {
+        ParseStats *stats = parser->options.stats;
+        const u32 command = (packet.type < DEMO_COMMAND_MAX) ? packet.type : PARSE_STATS_COMMAND_OTHER;
+        stats->commands[command].count++;
+        stats->commands[command].bytes += packet.data_size;
+
+        if (packet.is_compressed)
+        {
+            stats->compressed_bytes += packet.stored_size;
+            stats->decompressed_bytes += packet.data_size;
+        }
+        else
+        {
+            stats->uncompressed_bytes += packet.stored_size;
+        }
+    }
+#endif
+
+    const bool is_selected = packet.type >= DEMO_COMMAND_MAX || (parser->frame_filter.command_mask & DEMO_COMMAND_MASK(packet.type)) != 0;
+    if (demo_parser_wants(parser, DEMO_EVENT_FRAME) && is_selected)
+    {
+        DemoEvent event;
+        event.kind = DEMO_EVENT_FRAME;
+        event.tick = packet.tick;
+        event.frame.command = packet.type;
+        event.frame.is_compressed = packet.is_compressed;
+        event.frame.stored_size = packet.stored_size;
+        event.frame.size = packet.data_size;
+        event.frame.end_offset = demo_parser_offset(parser);
+        demo_parser_emit(parser, &event);
+    }
+
+    if (packet.type == DEMO_COMMAND_STOP)
+    {
+        return DEMO_PARSER_RET_END;
+    }
+
+    demo_parser_process_frame(parser, packet);
+
+    return (parser->out_of_memory) ? DEMO_PARSER_RET_OOM : DEMO_PARSER_RET_OK;
+}
+
+int demo_parser_next(DemoParser *parser, DemoEvent *out_event)
+{
+    const LogSink saved_log_sink = log_sink;
+    log_sink = parser->log_sink;
+
+    int ret_code = DEMO_PARSER_RET_OK;
+    DemoEventQueue *queue = &parser->queue;
+
+    while (queue->next == queue->count)
+    {
+        if (parser->finished)
+        {
+            ret_code = DEMO_PARSER_RET_END;
+            break;
+        }
+
+        queue->count = 0;
+        queue->next = 0;
+
+        ret_code = demo_parser_step(parser);
+        if (ret_code == DEMO_PARSER_RET_END)
+        {
+            parser->finished = true;
+            ret_code = DEMO_PARSER_RET_OK;
+        }
+        else if (ret_code == DEMO_PARSER_RET_NEED_DATA)
+        {
+            break;
+        }
+        else if (ret_code != DEMO_PARSER_RET_OK)
+        {
+            parser->finished = true;
+            break;
+        }
+    }
+
+    if (ret_code == DEMO_PARSER_RET_OK)
+    {
+        *out_event = queue->events[queue->next++];
+    }
+
+    log_sink = saved_log_sink;
+
+    return ret_code;
+}
+
+int demo_parser_run(DemoParser *parser, DemoEventHandler handler, void *user_data)
+{
+    const LogSink saved_log_sink = log_sink;
+    log_sink = parser->log_sink;
+
+    parser->push_handler = handler;
+    parser->push_user_data = user_data;
+    parser->push_result = 0;
+
+    int ret_code = DEMO_PARSER_RET_OK;
+    while (!parser->finished && parser->push_result == 0)
+    {
+        ret_code = demo_parser_step(parser);
+        if (ret_code == DEMO_PARSER_RET_NEED_DATA)
+        {
+            break;
+        }
+        if (ret_code != DEMO_PARSER_RET_OK)
+        {
+            parser->finished = true;
+        }
+    }
+
+    parser->push_handler = nullptr;
+    parser->push_user_data = nullptr;
+
+    log_sink = saved_log_sink;
+
+    return (ret_code == DEMO_PARSER_RET_END) ? DEMO_PARSER_RET_OK : ret_code;
+}
+
+static void demo_parser_process_frame(DemoParser *parser, DemoPacket packet)
+{
+    switch (packet.type)
+    {
+    case DEMO_COMMAND_FILE_HEADER:
+    {
+        if (!demo_parser_wants(parser, DEMO_EVENT_FILE_HEADER))
+        {
+            break;
+        }
+
+        PARSE_STATS_TIMER_START(parser->options.stats, unpack_start);
+        CDemoFileHeader *file_header = cdemo_file_header__unpack(&parser->frame_allocator, packet.data_size, (u8 *)packet.data);
+        PARSE_STATS_TIMER_STOP(parser->options.stats, PARSE_STATS_STAGE_UNPACK, unpack_start);
+        if (!file_header)
+        {
+            log_err("Failed to extract CDemoFileHeader\n");
+            demo_parser_emit_error(parser, DEMO_ERROR_MALFORMED_PACKET, (i32)packet.type);
+            break;
+        }
+
+        DemoEvent event;
+        event.kind = DEMO_EVENT_FILE_HEADER;
+        event.tick = packet.tick;
+        event.file_header.client_name = file_header->client_name;
+        event.file_header.demo_file_stamp = file_header->demo_file_stamp;
+        event.file_header.game_directory = file_header->game_directory;
+        event.file_header.map_name = file_header->map_name;
+        event.file_header.server_name = file_header->server_name;
+        demo_parser_emit(parser, &event);
+        break;
+    }
+    case DEMO_COMMAND_FILE_INFO:
+    {
+        if (!demo_parser_wants(parser, DEMO_EVENT_FILE_INFO))
+        {
+            break;
+        }
+
+        PARSE_STATS_TIMER_START(parser->options.stats, unpack_start);
+        CDemoFileInfo *proto = cdemo_file_info__unpack(&parser->frame_allocator, packet.data_size, (u8 *)packet.data);
+        PARSE_STATS_TIMER_STOP(parser->options.stats, PARSE_STATS_STAGE_UNPACK, unpack_start);
+        if (!proto)
+        {
+            log_err("Failed to extract CDemoFileInfo\n");
+            demo_parser_emit_error(parser, DEMO_ERROR_MALFORMED_PACKET, (i32)packet.type);
+            break;
+        }
+
+        DemoEvent event;
+        event.kind = DEMO_EVENT_FILE_INFO;
+        event.tick = packet.tick;
+        event.file_info.has_playback_frames = proto->has_playback_frames;
+        event.file_info.has_playback_ticks = proto->has_playback_ticks;
+        event.file_info.has_playback_time = proto->has_playback_time;
+        event.file_info.playback_frames = proto->playback_frames;
+        event.file_info.playback_ticks = proto->playback_ticks;
+        event.file_info.playback_time = proto->playback_time;
+        event.file_info.round_count = (proto->game_info && proto->game_info->cs) ? (u32)proto->game_info->cs->n_round_start_ticks : 0;
+        demo_parser_emit(parser, &event);
+        break;
+    }
+    case DEMO_COMMAND_PACKET:
+    case DEMO_COMMAND_SIGNON_PACKET:
+    {
+        //
+        // Only the data field is needed, borrow it instead of unpacking the message
+        //
+        WireBytes packet_data;
+        if (!cdemo_packet_view_data((const u8 *)packet.data, packet.data_size, &packet_data))
+        {
+            log_err("Failed to extract CDemoPacket\n");
+            demo_parser_emit_error(parser, DEMO_ERROR_MALFORMED_PACKET, (i32)packet.type);
+            break;
+        }
+
+        demo_parser_process_packet_data(parser, packet_data);
+        break;
+    }
+    case DEMO_COMMAND_FULL_PACKET:
+    {
+        WireBytes string_table;
+        WireBytes full_packet;
+        WireBytes packet_data;
+        if (!cdemo_full_packet_view((const u8 *)packet.data, packet.data_size, &string_table, &full_packet) ||
+            !cdemo_packet_view_data(full_packet.data, full_packet.size, &packet_data))
+        {
+            log_err("Failed to extract CDemoFullPacket\n");
+            demo_parser_emit_error(parser, DEMO_ERROR_MALFORMED_PACKET, (i32)packet.type);
+            break;
+        }
+
+        if (demo_parser_wants(parser, DEMO_EVENT_FULL_PACKET))
+        {
+            DemoEvent event;
+            event.kind = DEMO_EVENT_FULL_PACKET;
+            event.tick = packet.tick;
+            event.full_packet.string_table_size = (u32)string_table.size;
+            demo_parser_emit(parser, &event);
+        }
+
+        if (parser->load_string_table_snapshot)
+        {
+            parser->load_string_table_snapshot = false;
+            demo_parser_load_string_table_snapshot(parser, string_table);
+        }
+
+        demo_parser_process_packet_data(parser, packet_data);
+
+        if (demo_parser_wants(parser, DEMO_EVENT_FULL_PACKET_END))
+        {
+            DemoEvent event;
+            event.kind = DEMO_EVENT_FULL_PACKET_END;
+            event.tick = packet.tick;
+            event.full_packet.string_table_size = (u32)string_table.size;
+            demo_parser_emit(parser, &event);
+        }
+        break;
+    }
+    case DEMO_COMMAND_CLASS_INFO:
+    {
+        PARSE_STATS_TIMER_START(parser->options.stats, unpack_start);
+        CDemoClassInfo *proto = cdemo_class_info__unpack(&parser->setup_allocator, packet.data_size, (u8 *)packet.data);
+        PARSE_STATS_TIMER_STOP(parser->options.stats, PARSE_STATS_STAGE_UNPACK, unpack_start);
+        if (!proto)
+        {
+            log_err("Failed to extract CDemoClassInfo\n");
+            demo_parser_emit_error(parser, DEMO_ERROR_MALFORMED_PACKET, (i32)packet.type);
+            break;
+        }
+
+        if (entity_engine_set_classes(&parser->entities, proto) != ENTITY_RET_OK)
+        {
+            log_err("Failed to set up entity classes\n");
+        }
+
+        //
+        // instancebaseline usually arrives before the classes it refers to
+        //
+        demo_parser_apply_baselines(parser);
+
+        if (demo_parser_wants(parser, DEMO_EVENT_CLASS_INFO))
+        {
+            DemoEvent event;
+            event.kind = DEMO_EVENT_CLASS_INFO;
+            event.tick = packet.tick;
+            event.class_info.class_info = proto;
+            demo_parser_emit(parser, &event);
+        }
+        break;
+    }
+    case DEMO_COMMAND_SEND_TABLES:
+        demo_parser_process_send_tables(parser, packet);
+        break;
+    default:
+        break;
+    }
+}
+
+static void demo_parser_process_packet_data(DemoParser *parser, WireBytes packet_data)
+{
+    if (!packet_data.data)
+    {
+        return;
+    }
+
+    PARSE_STATS_TIMER_START(parser->options.stats, dispatch_start);
+    const int ret_code = message_dispatcher_run(&parser->dispatcher, packet_data.data, packet_data.size);
+    PARSE_STATS_TIMER_STOP(parser->options.stats, PARSE_STATS_STAGE_DISPATCH, dispatch_start);
+    if (ret_code != MESSAGE_DISPATCH_RET_OK)
+    {
+        //
+        // The message stream itself or a message its handler couldn't decode, the rest
+        // of the packet is dropped either way
+        //
+        log_warn("Malformed net message in packet, skipping the rest of it\n");
+        demo_parser_emit_error(parser, DEMO_ERROR_MALFORMED_MESSAGE, ret_code);
+    }
+}
+
+static void demo_parser_process_send_tables(DemoParser *parser, DemoPacket packet)
+{
+    //
+    // The wrapper is only needed to get at the serializer bytes, the serializer itself
+    // is kept around with the rest of the setup data
+    //
+    PARSE_STATS_TIMER_START(parser->options.stats, unpack_start);
+    CDemoSendTables *proto = cdemo_send_tables__unpack(&parser->frame_allocator, packet.data_size, (u8 *)packet.data);
+    PARSE_STATS_TIMER_STOP(parser->options.stats, PARSE_STATS_STAGE_UNPACK, unpack_start);
+    if (!proto || !proto->has_data)
+    {
+        log_err("Failed to extract CDemoSendTables\n");
+        demo_parser_emit_error(parser, DEMO_ERROR_MALFORMED_PACKET, (i32)packet.type);
+        return;
+    }
+
+    u32 data_size = 0;
+    u32 bytes_read = 0;
+    if (!read_varint32_bounded(proto->data.data, proto->data.len, &data_size, &bytes_read) || bytes_read + (size_t)data_size > proto->data.len)
+    {
+        log_err("Truncated send tables\n");
+        demo_parser_emit_error(parser, DEMO_ERROR_MALFORMED_PACKET, (i32)packet.type);
+        return;
+    }
+
+    const u8 *data = proto->data.data + bytes_read;
+
+    DemoEvent event;
+    event.kind = DEMO_EVENT_SEND_TABLES;
+    event.tick = packet.tick;
+    event.send_tables.from_cache = false;
+
+    //
+    // Demos from the same game build share send tables, let the caller hand back what
+    // an earlier demo compiled instead of unpacking the serializer again
+    //
+    const bool has_cache = parser->options.serializer_load || parser->options.serializer_store;
+    const u64 cache_key = (has_cache) ? serializer_cache_key(data, data_size) : 0;
+
+    PARSE_STATS_TIMER_START(parser->options.stats, load_start);
+    const bool loaded = parser->options.serializer_load && parser->options.serializer_load(parser->options.serializer_user_data, cache_key, &parser->entities);
+    PARSE_STATS_TIMER_STOP(parser->options.stats, PARSE_STATS_STAGE_SERIALIZERS, load_start);
+
+    if (loaded)
+    {
+        event.send_tables.from_cache = true;
+    }
+    else
+    {
+        PARSE_STATS_TIMER_START(parser->options.stats, serializer_unpack_start);
+        CSVCMsgFlattenedSerializer *flattened_serializer = csvcmsg__flattened_serializer__unpack(&parser->setup_allocator, data_size, data);
+        PARSE_STATS_TIMER_STOP(parser->options.stats, PARSE_STATS_STAGE_UNPACK, serializer_unpack_start);
+        if (!flattened_serializer)
+        {
+            log_err("Failed to extract flattened serializer\n");
+            demo_parser_emit_error(parser, DEMO_ERROR_MALFORMED_PACKET, (i32)packet.type);
+            return;
+        }
+
+        PARSE_STATS_TIMER_START(parser->options.stats, compile_start);
+        const int compile_ret_code = entity_engine_set_serializers(&parser->entities, flattened_serializer);
+        PARSE_STATS_TIMER_STOP(parser->options.stats, PARSE_STATS_STAGE_SERIALIZERS, compile_start);
+
+        if (compile_ret_code != ENTITY_RET_OK)
+        {
+            log_err("Failed to set up entity serializers\n");
+            demo_parser_emit_error(parser, DEMO_ERROR_ENTITIES, ENTITY_RET_MALFORMED);
+            return;
+        }
+
+        if (parser->options.serializer_store)
+        {
+            parser->options.serializer_store(parser->options.serializer_user_data, cache_key, &parser->entities);
+        }
+    }
+
+    if (demo_parser_wants(parser, DEMO_EVENT_SEND_TABLES))
+    {
+        event.send_tables.field_count = parser->entities.field_count;
+        event.send_tables.serializer_count = parser->entities.serializer_count;
+        demo_parser_emit(parser, &event);
+    }
+}
+
+static int demo_parser_on_net_message(void *user_data, u32 message_id, const u8 *data, u32 size)
+{
+    demo_parser_emit_net_message((DemoParser *)user_data, message_id, data, size);
+    return 0;
+}
+
+static int demo_parser_on_server_info(void *user_data, u32 message_id, const u8 *data, u32 size)
+{
+    DemoParser *parser = (DemoParser *)user_data;
+    demo_parser_emit_net_message(parser, message_id, data, size);
+
+    ServerInfoView server_info;
+    if (!server_info_view_parse(data, size, &server_info))
+    {
+        log_err("Failed to extract CSVCMsg_ServerInfo\n");
+        return MESSAGE_DISPATCH_RET_MALFORMED;
+    }
+
+    entity_engine_set_server_info(&parser->entities, &server_info);
+    return 0;
+}
+
+static int demo_parser_on_packet_entities(void *user_data, u32 message_id, const u8 *data, u32 size)
+{
+    DemoParser *parser = (DemoParser *)user_data;
+    demo_parser_emit_net_message(parser, message_id, data, size);
+
+    PacketEntitiesView packet_entities;
+    if (!packet_entities_view_parse(data, size, &packet_entities))
+    {
+        log_err("Failed to extract CSVCMsg_PacketEntities\n");
+        return MESSAGE_DISPATCH_RET_MALFORMED;
+    }
+
+    PARSE_STATS_TIMER_START(parser->options.stats, entities_start);
+    const int ret_code = entity_engine_apply(&parser->entities, &packet_entities);
+    PARSE_STATS_TIMER_STOP(parser->options.stats, PARSE_STATS_STAGE_ENTITIES, entities_start);
+    if (ret_code != ENTITY_RET_OK)
+    {
+        log_err("Failed to apply packet entities (%d)\n", ret_code);
+        demo_parser_emit_error(parser, DEMO_ERROR_ENTITIES, ret_code);
+    }
+
+    //
+    // Entity errors are reported as events, the rest of the packet is still good
+    //
+    return 0;
+}
+
+static int demo_parser_on_create_string_table(void *user_data, u32 message_id, const u8 *data, u32 size)
+{
+    DemoParser *parser = (DemoParser *)user_data;
+    demo_parser_emit_net_message(parser, message_id, data, size);
+
+    CreateStringTableView create_string_table;
+    if (!create_string_table_view_parse(data, size, &create_string_table))
+    {
+        log_err("Failed to extract CSVCMsg_CreateStringTable\n");
+        return MESSAGE_DISPATCH_RET_MALFORMED;
+    }
+
+    const int ret_code = string_tables_create(&parser->string_tables, &create_string_table);
+    if (ret_code != STRING_TABLE_RET_OK)
+    {
+        log_err("Failed to create string table %.*s (%d)\n", (int)create_string_table.name.size, (const char *)create_string_table.name.data, ret_code);
+        demo_parser_emit_error(parser, DEMO_ERROR_STRING_TABLES, ret_code);
+    }
+    return 0;
+}
+
+static int demo_parser_on_update_string_table(void *user_data, u32 message_id, const u8 *data, u32 size)
+{
+    DemoParser *parser = (DemoParser *)user_data;
+    demo_parser_emit_net_message(parser, message_id, data, size);
+
+    UpdateStringTableView update_string_table;
+    if (!update_string_table_view_parse(data, size, &update_string_table))
+    {
+        log_err("Failed to extract CSVCMsg_UpdateStringTable\n");
+        return MESSAGE_DISPATCH_RET_MALFORMED;
+    }
+
+    const int ret_code = string_tables_update(&parser->string_tables, &update_string_table);
+    if (ret_code != STRING_TABLE_RET_OK)
+    {
+        log_err("Failed to update string table %d (%d)\n", update_string_table.table_id, ret_code);
+        demo_parser_emit_error(parser, DEMO_ERROR_STRING_TABLES, ret_code);
+    }
+    return 0;
+}
+
+static int demo_parser_on_clear_string_tables(void *user_data, u32 message_id, const u8 *data, u32 size)
+{
+    DemoParser *parser = (DemoParser *)user_data;
+    demo_parser_emit_net_message(parser, message_id, data, size);
+    string_tables_clear(&parser->string_tables);
+    return 0;
+}
+
+//
+// instancebaseline keys are class IDs, the values the class's baseline field data
+//
+static void demo_parser_on_string_table_entry(void *user_data, const StringTables *tables, u32 table_index, u32 entry_index)
+{
+    DemoParser *parser = (DemoParser *)user_data;
+    const StringTable *table = &tables->tables[table_index];
+    if (strcmp(table->name, "instancebaseline") != 0 || !parser->entities.classes)
+    {
+        return;
+    }
+
+    const StringTableEntry *entry = &table->entries[entry_index];
+    if (!entry->key || !entry->value)
+    {
+        return;
+    }
+
+    char *end = nullptr;
+    const unsigned long class_id = strtoul(entry->key, &end, 10);
+    if (end == entry->key || *end != '\0' || class_id >= parser->entities.class_count)
+    {
+        log_debug("Ignoring instancebaseline entry %s\n", entry->key);
+        return;
+    }
+
+    if (entity_engine_set_baseline(&parser->entities, (u32)class_id, entry->value, entry->value_size) != ENTITY_RET_OK)
+    {
+        log_err("Failed to set baseline of class %lu\n", class_id);
+    }
+}
+
+static void demo_parser_apply_baselines(DemoParser *parser)
+{
+    const u32 table_index = string_tables_find(&parser->string_tables, "instancebaseline");
+    if (table_index == STRING_TABLE_NONE)
+    {
+        return;
+    }
+
+    const StringTable *table = &parser->string_tables.tables[table_index];
+    for (u32 i = 0; i < table->entry_count; i++)
+    {
+        demo_parser_on_string_table_entry(parser, &parser->string_tables, table_index, i);
+    }
+}
+
+static void demo_parser_load_string_table_snapshot(DemoParser *parser, WireBytes snapshot)
+{
+    if (!snapshot.data)
+    {
+        return;
+    }
+
+    PARSE_STATS_TIMER_START(parser->options.stats, unpack_start);
+    CDemoStringTables *proto = cdemo_string_tables__unpack(&parser->frame_allocator, snapshot.size, snapshot.data);
+    PARSE_STATS_TIMER_STOP(parser->options.stats, PARSE_STATS_STAGE_UNPACK, unpack_start);
+    if (!proto)
+    {
+        log_err("Failed to extract CDemoStringTables\n");
+        demo_parser_emit_error(parser, DEMO_ERROR_MALFORMED_PACKET, DEMO_COMMAND_FULL_PACKET);
+        return;
+    }
+
+    const int ret_code = string_tables_apply_snapshot(&parser->string_tables, proto);
+    if (ret_code != STRING_TABLE_RET_OK)
+    {
+        log_err("Failed to load string table snapshot (%d)\n", ret_code);
+        demo_parser_emit_error(parser, DEMO_ERROR_STRING_TABLES, ret_code);
+    }
+}
+
+static int demo_parser_on_game_event_list(void *user_data, u32 message_id, const u8 *data, u32 size)
+{
+    DemoParser *parser = (DemoParser *)user_data;
+    demo_parser_emit_net_message(parser, message_id, data, size);
+
+    PARSE_STATS_TIMER_START(parser->options.stats, unpack_start);
+    CMsgSource1LegacyGameEventList *list = cmsg_source1_legacy_game_event_list__unpack(&parser->frame_allocator, size, data);
+    PARSE_STATS_TIMER_STOP(parser->options.stats, PARSE_STATS_STAGE_UNPACK, unpack_start);
+    if (!list)
+    {
+        log_err("Failed to extract CMsgSource1LegacyGameEventList\n");
+        return MESSAGE_DISPATCH_RET_MALFORMED;
+    }
+
+    const int ret_code = game_events_load_list(&parser->game_events, list);
+    if (ret_code != GAME_EVENT_RET_OK)
+    {
+        log_err("Failed to load game event descriptors (%d)\n", ret_code);
+        demo_parser_emit_error(parser, DEMO_ERROR_GAME_EVENTS, ret_code);
+        return 0;
+    }
+
+    log_debug("Loaded %zu game event descriptors\n", list->n_descriptors);
+    return 0;
+}
+
+static int demo_parser_on_game_event(void *user_data, u32 message_id, const u8 *data, u32 size)
+{
+    DemoParser *parser = (DemoParser *)user_data;
+    demo_parser_emit_net_message(parser, message_id, data, size);
+
+    if (!game_events_has_subscriptions(&parser->game_events) || !demo_parser_wants(parser, DEMO_EVENT_GAME_EVENT))
+    {
+        return 0;
+    }
+
+    DemoEvent event;
+    event.kind = DEMO_EVENT_GAME_EVENT;
+    event.tick = parser->tick;
+
+    const int ret_code = game_events_decode(&parser->game_events, data, size, &parser->frame_arena, &event.game_event);
+    switch (ret_code)
+    {
+    case GAME_EVENT_RET_OK:
+        demo_parser_emit(parser, &event);
+        break;
+    case GAME_EVENT_RET_SKIPPED:
+        break;
+    case GAME_EVENT_RET_OOM:
+        parser->out_of_memory = true;
+        break;
+    default:
+        log_err("Failed to decode game event (%d)\n", ret_code);
+        demo_parser_emit_error(parser, DEMO_ERROR_GAME_EVENTS, ret_code);
+        break;
+    }
+
+    //
+    // A bad event doesn't affect the rest of the packet
+    //
+    return 0;
+}
+
+static void demo_parser_on_entity(void *user_data, u32 event_kind, u32 entity_index)
+{
+    DemoParser *parser = (DemoParser *)user_data;
+
+    DemoEvent event;
+    event.kind = DEMO_EVENT_ENTITY;
+    event.tick = parser->tick;
+    event.entity.event = event_kind;
+    event.entity.entity_index = entity_index;
+    event.entity.entity_class = entity_engine_class_of(&parser->entities, entity_index);
+    event.entity.row = parser->entities.slots[entity_index].row;
+    event.entity.changed_columns = parser->entities.changed_columns;
+    event.entity.changed_column_count = parser->entities.changed_column_count;
+
+    //
+    // The engine reuses its change list for every entity it decodes. Queued events
+    // outlive it, so their list goes into the frame arena
+    //
+    if (!parser->push_handler && !parser->is_quiet && event.entity.changed_column_count > 0)
+    {
+        const size_t size = event.entity.changed_column_count * sizeof(u32);
+        u32 *copy = (u32 *)arena_alloc(&parser->frame_arena, size);
+        if (!copy)
+        {
+            parser->out_of_memory = true;
+            return;
+        }
+        memcpy(copy, event.entity.changed_columns, size);
+        event.entity.changed_columns = copy;
+    }
+
+    demo_parser_emit(parser, &event);
+}
+
+static bool read_varint32_bounded(const u8 *data, size_t data_size, u32 *out_value, u32 *out_read)
+{
+    u32 result = 0;
+
+    for (u32 i = 0; i < 5 && i < data_size; i++)
+    {
+        result |= (u32)(data[i] & 0x7Fu) << (7u * i);
+        if (!(data[i] & 0x80u))
+        {
+            *out_value = result;
+            *out_read = i + 1;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const char *demo_message_to_string(u32 message_id)
+{
+    switch (message_id)
+    {
+    case SVC__MESSAGES__svc_ServerInfo:
+        return "SVC__MESSAGES__svc_ServerInfo";
+    case SVC__MESSAGES__svc_FlattenedSerializer:
+        return "SVC__MESSAGES__svc_FlattenedSerializer";
+    case SVC__MESSAGES__svc_ClassInfo:
+        return "SVC__MESSAGES__svc_ClassInfo";
+    case SVC__MESSAGES__svc_SetPause:
+        return "SVC__MESSAGES__svc_SetPause";
+    case SVC__MESSAGES__svc_CreateStringTable:
+        return "SVC__MESSAGES__svc_CreateStringTable";
+    case SVC__MESSAGES__svc_UpdateStringTable:
+        return "SVC__MESSAGES__svc_UpdateStringTable";
+    case SVC__MESSAGES__svc_VoiceInit:
+        return "SVC__MESSAGES__svc_VoiceInit";
+    case SVC__MESSAGES__svc_VoiceData:
+        return "SVC__MESSAGES__svc_VoiceData";
+    case SVC__MESSAGES__svc_Print:
+        return "SVC__MESSAGES__svc_Print";
+    case SVC__MESSAGES__svc_Sounds:
+        return "SVC__MESSAGES__svc_Sounds";
+    case SVC__MESSAGES__svc_SetView:
+        return "SVC__MESSAGES__svc_SetView";
+    case SVC__MESSAGES__svc_ClearAllStringTables:
+        return "SVC__MESSAGES__svc_ClearAllStringTables";
+    case SVC__MESSAGES__svc_CmdKeyValues:
+        return "SVC__MESSAGES__svc_CmdKeyValues";
+    case SVC__MESSAGES__svc_BSPDecal:
+        return "SVC__MESSAGES__svc_BSPDecal";
+    case SVC__MESSAGES__svc_SplitScreen:
+        return "SVC__MESSAGES__svc_SplitScreen";
+    case SVC__MESSAGES__svc_PacketEntities:
+        return "SVC__MESSAGES__svc_PacketEntities";
+    case SVC__MESSAGES__svc_Prefetch:
+        return "SVC__MESSAGES__svc_Prefetch";
+    case SVC__MESSAGES__svc_Menu:
+        return "SVC__MESSAGES__svc_Menu";
+    case SVC__MESSAGES__svc_GetCvarValue:
+        return "SVC__MESSAGES__svc_GetCvarValue";
+    case SVC__MESSAGES__svc_StopSound:
+        return "SVC__MESSAGES__svc_StopSound";
+    case SVC__MESSAGES__svc_PeerList:
+        return "SVC__MESSAGES__svc_PeerList";
+    case SVC__MESSAGES__svc_PacketReliable:
+        return "SVC__MESSAGES__svc_PacketReliable";
+    case SVC__MESSAGES__svc_HLTVStatus:
+        return "SVC__MESSAGES__svc_HLTVStatus";
+    case SVC__MESSAGES__svc_ServerSteamID:
+        return "SVC__MESSAGES__svc_ServerSteamID";
+    case SVC__MESSAGES__svc_FullFrameSplit:
+        return "SVC__MESSAGES__svc_FullFrameSplit";
+    case SVC__MESSAGES__svc_RconServerDetails:
+        return "SVC__MESSAGES__svc_RconServerDetails";
+    case SVC__MESSAGES__svc_UserMessage:
+        return "SVC__MESSAGES__svc_UserMessage";
+    case SVC__MESSAGES__svc_Broadcast_Command:
+        return "SVC__MESSAGES__svc_Broadcast_Command";
+    case SVC__MESSAGES__svc_HltvFixupOperatorStatus:
+        return "SVC__MESSAGES__svc_HltvFixupOperatorStatus";
+    case GAME_EVENT_MESSAGE_LIST:
+        return "GE_Source1LegacyGameEventList";
+    case GAME_EVENT_MESSAGE_EVENT:
+        return "GE_Source1LegacyGameEvent";
+    default:
+        return "Unknown";
+    }
+}
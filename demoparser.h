@@ -0,0 +1,449 @@
+#pragma once
+
+//
+// libdemoparser. Parses a CS2 demo held in memory and hands out typed events, either
+// pulled one at a time with demo_parser_next or pushed to a callback by
+// demo_parser_run. The library does no I/O of its own: the caller provides the demo
+// bytes, diagnostics go to an optional log handler and caching of compiled serializers
+// goes through optional load and store hooks. frame_index.h and serializer_cache.h
+// provide file backed implementations for callers that want them.
+//
+// Pointers inside an event stay valid until the parser moves on to the next frame,
+// which for pulled events is the call to demo_parser_next after the last event of the
+// current frame.
+//
+
+#include "common.h"
+#include "demo.h"
+#include "pipeline.h"
+#include "frame_index.h"
+#include "arena.h"
+#include "message_dispatch.h"
+#include "entity.h"
+#include "string_table.h"
+#include "game_events.h"
+#include "parse_stats.h"
+
+#include "protos/demo.pb-c.h"
+#include "protos/netmessages.pb-c.h"
+
+#define DEMO_PARSER_RET_OK 0
+#define DEMO_PARSER_RET_END 1
+#define DEMO_PARSER_RET_INVALID 2
+#define DEMO_PARSER_RET_OOM 3
+#define DEMO_PARSER_RET_THREAD_ERROR 4
+//
+// Live mode only. Everything in the data so far was parsed, call demo_parser_set_data
+// once more of the demo was written and carry on
+//
+#define DEMO_PARSER_RET_NEED_DATA 5
+
+#define DEMO_EVENT_FRAME 0
+#define DEMO_EVENT_FILE_HEADER 1
+#define DEMO_EVENT_FILE_INFO 2
+#define DEMO_EVENT_SEND_TABLES 3
+#define DEMO_EVENT_CLASS_INFO 4
+#define DEMO_EVENT_FULL_PACKET 5
+#define DEMO_EVENT_NET_MESSAGE 6
+#define DEMO_EVENT_ENTITY 7
+#define DEMO_EVENT_SEEK 8
+#define DEMO_EVENT_ERROR 9
+#define DEMO_EVENT_GAME_EVENT 10
+//
+// A full packet was applied, the entities hold the whole state at its tick. Carries the
+// same full_packet as the DEMO_EVENT_FULL_PACKET before its messages
+//
+#define DEMO_EVENT_FULL_PACKET_END 11
+#define DEMO_EVENT_KIND_COUNT 12
+
+#define DEMO_PARSER_KEYFRAME_NONE 0xFFFFFFFFu
+
+#define DEMO_EVENT_MASK(kind) (1u << (kind))
+#define DEMO_EVENT_MASK_ALL ((1u << DEMO_EVENT_KIND_COUNT) - 1)
+
+//
+// Recoverable problems, reported as DEMO_EVENT_ERROR while parsing carries on
+//
+#define DEMO_ERROR_DECOMPRESS 0
+#define DEMO_ERROR_MALFORMED_MESSAGE 1
+#define DEMO_ERROR_MALFORMED_PACKET 2
+#define DEMO_ERROR_ENTITIES 3
+#define DEMO_ERROR_STRING_TABLES 4
+#define DEMO_ERROR_GAME_EVENTS 5
+
+typedef struct
+{
+    u32 command;
+    bool is_compressed;
+    //
+    // Payload size in the file and after decompression
+    //
+    u32 stored_size;
+    u32 size;
+    //
+    // Offset of the next frame, for progress reporting
+    //
+    u64 end_offset;
+} DemoFrameEvent;
+
+typedef struct
+{
+    const char *client_name;
+    const char *demo_file_stamp;
+    const char *game_directory;
+    const char *map_name;
+    const char *server_name;
+} DemoFileHeaderEvent;
+
+typedef struct
+{
+    bool has_playback_frames;
+    bool has_playback_ticks;
+    bool has_playback_time;
+    i32 playback_frames;
+    i32 playback_ticks;
+    f32 playback_time;
+    u32 round_count;
+} DemoFileInfoEvent;
+
+typedef struct
+{
+    u32 field_count;
+    u32 serializer_count;
+    //
+    // Set when the load hook provided the serializers
+    //
+    bool from_cache;
+} DemoSendTablesEvent;
+
+typedef struct
+{
+    const CDemoClassInfo *class_info;
+} DemoClassInfoEvent;
+
+typedef struct
+{
+    u32 string_table_size;
+} DemoFullPacketEvent;
+
+typedef struct
+{
+    u32 message_id;
+    u32 size;
+    const u8 *data;
+} DemoNetMessageEvent;
+
+typedef struct
+{
+    //
+    // One of ENTITY_EVENT_*
+    //
+    u32 event;
+    u32 entity_index;
+    //
+    // Where the entity's values live, see entity_class_column. The row is only valid
+    // inside a push handler: by the time a pulled event is read the rest of its packet
+    // was applied, and a delete swaps another entity into the row. Pulled events read
+    // values through entity_index instead (entity_engine_exists, entity_engine_value),
+    // which gives the state at the end of the frame
+    //
+    const EntityClass *entity_class;
+    u32 row;
+    //
+    // With DemoParserOptions.entity_changes, the columns the update wrote, see
+    // EntityEngine.changed_columns. Empty otherwise
+    //
+    const u32 *changed_columns;
+    u32 changed_column_count;
+} DemoEntityEvent;
+
+typedef struct
+{
+    u32 target_tick;
+    u32 keyframe_tick;
+    bool found;
+} DemoSeekEvent;
+
+typedef struct
+{
+    u32 error;
+    i32 code;
+} DemoErrorEvent;
+
+typedef struct
+{
+    u32 kind;
+    u32 tick;
+    union
+    {
+        DemoFrameEvent frame;
+        DemoFileHeaderEvent file_header;
+        DemoFileInfoEvent file_info;
+        DemoSendTablesEvent send_tables;
+        DemoClassInfoEvent class_info;
+        DemoFullPacketEvent full_packet;
+        DemoNetMessageEvent net_message;
+        DemoEntityEvent entity;
+        DemoSeekEvent seek;
+        DemoErrorEvent error;
+        //
+        // Only events subscribed to with demo_parser_subscribe_game_event
+        //
+        GameEvent game_event;
+    };
+} DemoEvent;
+
+//
+// Returning non-zero from a push handler stops demo_parser_run
+//
+typedef int (*DemoEventHandler)(void *user_data, const DemoEvent *event);
+
+//
+// key identifies the send tables blob (see serializer_cache_key). The load hook returns
+// true when it filled engine with the serializers for key
+//
+typedef bool (*DemoSerializerLoadHook)(void *user_data, u64 key, EntityEngine *engine);
+typedef void (*DemoSerializerStoreHook)(void *user_data, u64 key, const EntityEngine *engine);
+
+//
+// Predicates pushed down into the parse. Frames outside the tick range or of commands
+// outside the mask are stepped over by their header without being decompressed, net
+// messages outside message_ids are skipped by size in the dispatcher, and entity fields
+// outside the projection are skipped by their encoded width. Setup frames are always
+// parsed. Entity state needs every frame from the start, so with DEMO_EVENT_ENTITY the
+// frames before tick_min are parsed without reporting anything; without it entities
+// aren't tracked at all once frames were skipped. String tables only reflect the frames
+// that were parsed.
+//
+typedef struct
+{
+    //
+    // Inclusive tick range
+    //
+    u32 tick_min;
+    u32 tick_max;
+    //
+    // DEMO_COMMAND_MASK bits of the frames to parse
+    //
+    u32 command_mask;
+    //
+    // Net messages reported as DEMO_EVENT_NET_MESSAGE, every message when empty
+    //
+    const u32 *message_ids;
+    u32 message_id_count;
+    //
+    // Entity classes and fields to decode, see entity_engine_set_query. The names are
+    // borrowed and have to outlive the parser
+    //
+    const char *const *entity_classes;
+    u32 entity_class_count;
+    const char *const *entity_fields;
+    u32 entity_field_count;
+} DemoQuery;
+
+typedef struct
+{
+    //
+    // Decompression threads running ahead of the parser, 0 to decompress inline
+    //
+    u32 thread_count;
+    //
+    // DEMO_EVENT_MASK bits of the events to report. Events nobody asked for aren't built
+    //
+    u32 event_mask;
+    //
+    // The demo is still being recorded. Running out of data, or a frame cut short, means
+    // waiting for more rather than the end. Frames are decompressed inline
+    //
+    bool live;
+    //
+    // List the columns each entity update wrote with its DEMO_EVENT_ENTITY, for output
+    // that only wants what changed
+    //
+    bool entity_changes;
+    //
+    // Largest frame decompressed on the parsing thread, 0 for no limit. With a limit the
+    // decompression buffer is allocated once at that size and never grows, larger frames
+    // are skipped with DEMO_ERROR_DECOMPRESS
+    //
+    size_t max_frame_size;
+
+    LogHandler log_handler;
+    void *log_user_data;
+    int log_level;
+
+    DemoSerializerLoadHook serializer_load;
+    DemoSerializerStoreHook serializer_store;
+    void *serializer_user_data;
+
+    //
+    // Filled with profiling counters when the library was built with PARSE_STATS
+    //
+    ParseStats *stats;
+
+    DemoQuery query;
+} DemoParserOptions;
+
+typedef struct
+{
+    DemoEvent *events;
+    u32 count;
+    u32 capacity;
+    u32 next;
+} DemoEventQueue;
+
+typedef struct
+{
+    const u8 *data;
+    size_t data_size;
+    size_t pos;
+    //
+    // Offset of data in the demo, non-zero once a window dropped the bytes before it
+    //
+    size_t data_offset;
+
+    char *uncompressed_buffer;
+    size_t uncompressed_buffer_size;
+
+    PacketPipeline pipeline;
+    bool use_pipeline;
+    //
+    // Frames of the query, and the net messages it reports, one bit per message ID
+    //
+    DemoFrameFilter frame_filter;
+    u64 message_mask[MESSAGE_ID_MAX / 64];
+    //
+    // Set while a frame before the query's first tick is parsed for its state alone,
+    // nothing it raises is reported
+    //
+    bool is_quiet;
+
+    DemoParserOptions options;
+    LogSink log_sink;
+
+    //
+    // Reset after every frame. Holds protobuf messages that are only looked at while
+    // their frame is processed
+    //
+    Arena frame_arena;
+    ProtobufCAllocator frame_allocator;
+    //
+    // Lives as long as the demo. Holds setup messages such as send tables and class info
+    //
+    Arena setup_arena;
+    ProtobufCAllocator setup_allocator;
+    //
+    // Routes the net messages inside packets to whoever registered for them
+    //
+    MessageDispatcher dispatcher;
+    EntityEngine entities;
+    //
+    // userinfo, instancebaseline and the rest, see string_tables_player_info
+    //
+    StringTables string_tables;
+    //
+    // Descriptor table from CMsgSource1LegacyGameEventList and the subscribed event names
+    //
+    GameEvents game_events;
+
+    u32 tick;
+
+    //
+    // Events of the current frame waiting to be pulled
+    //
+    DemoEventQueue queue;
+    DemoEventHandler push_handler;
+    void *push_user_data;
+    int push_result;
+
+    const FrameIndex *seek_index;
+    u32 seek_tick;
+    //
+    // Index into seek_index->full_packets, DEMO_PARSER_KEYFRAME_NONE to look up seek_tick
+    //
+    u32 seek_keyframe;
+    bool seek_pending;
+    //
+    // Parsing ends before the frame at this offset
+    //
+    size_t end_offset;
+    //
+    // Set after a seek, the keyframe's string table snapshot replaces the tables
+    //
+    bool load_string_table_snapshot;
+    bool finished;
+    //
+    // Set when an event couldn't be queued, parsing stops with DEMO_PARSER_RET_OOM
+    //
+    bool out_of_memory;
+} DemoParser;
+
+void demo_parser_options_init(DemoParserOptions *options);
+
+//
+// A query that keeps everything
+//
+void demo_query_init(DemoQuery *query);
+
+//
+// data must start with the DemoHeader and outlive the parser
+//
+int demo_parser_init(DemoParser *parser, const u8 *data, size_t data_size, const DemoParserOptions *options);
+void demo_parser_free(DemoParser *parser);
+
+//
+// Jumps to the last full packet at or before tick once the setup frames were parsed.
+// index has to outlive the parse
+//
+void demo_parser_seek_tick(DemoParser *parser, const FrameIndex *index, u32 tick);
+
+//
+// Same as demo_parser_seek_tick for a given full packet, keyframe indexes
+// index->full_packets
+//
+void demo_parser_seek_keyframe(DemoParser *parser, const FrameIndex *index, u32 keyframe);
+
+//
+// Stops parsing before the frame starting at end_offset, which has to be a frame
+// boundary. Together with a seek this parses a single span of the demo
+//
+void demo_parser_set_end_offset(DemoParser *parser, size_t end_offset);
+
+//
+// Live mode. Points the parser at a longer copy of the demo after DEMO_PARSER_RET_NEED_DATA.
+// data has to start with the bytes parsed so far, it may have moved
+//
+void demo_parser_set_data(DemoParser *parser, const u8 *data, size_t data_size);
+
+//
+// Live mode. Like demo_parser_set_data, but data holds the demo from data_offset on, so
+// the bytes before demo_parser_offset can be dropped and the memory reused. No frame
+// index seeks after that
+//
+void demo_parser_set_window(DemoParser *parser, const u8 *data, size_t data_size, size_t data_offset);
+
+//
+// Offset in the demo of the first byte not parsed yet
+//
+size_t demo_parser_offset(const DemoParser *parser);
+
+//
+// Reports game events called name as DEMO_EVENT_GAME_EVENT. Events nobody subscribed
+// to are dropped after reading their ID
+//
+int demo_parser_subscribe_game_event(DemoParser *parser, const char *name);
+
+//
+// Pull mode. DEMO_PARSER_RET_END after the last event. In live mode
+// DEMO_PARSER_RET_NEED_DATA when the data so far ran out
+//
+int demo_parser_next(DemoParser *parser, DemoEvent *out_event);
+
+//
+// Push mode. Parses to the end, or until handler returns non-zero. In live mode it also
+// returns DEMO_PARSER_RET_NEED_DATA when the data so far ran out, call it again after
+// demo_parser_set_data
+//
+int demo_parser_run(DemoParser *parser, DemoEventHandler handler, void *user_data);
+
+const char *demo_message_to_string(u32 message_id);
@@ -0,0 +1,2508 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "entity.h"
+
+//
+// Field path operations, in the order their Huffman weights are listed
+//
+#define FIELD_PATH_OP_PLUS_ONE 0
+#define FIELD_PATH_OP_PLUS_TWO 1
+#define FIELD_PATH_OP_PLUS_THREE 2
+#define FIELD_PATH_OP_PLUS_FOUR 3
+#define FIELD_PATH_OP_PLUS_N 4
+#define FIELD_PATH_OP_PUSH_ONE_LEFT_DELTA_ZERO_RIGHT_ZERO 5
+#define FIELD_PATH_OP_PUSH_ONE_LEFT_DELTA_ZERO_RIGHT_NON_ZERO 6
+#define FIELD_PATH_OP_PUSH_ONE_LEFT_DELTA_ONE_RIGHT_ZERO 7
+#define FIELD_PATH_OP_PUSH_ONE_LEFT_DELTA_ONE_RIGHT_NON_ZERO 8
+#define FIELD_PATH_OP_PUSH_ONE_LEFT_DELTA_N_RIGHT_ZERO 9
+#define FIELD_PATH_OP_PUSH_ONE_LEFT_DELTA_N_RIGHT_NON_ZERO 10
+#define FIELD_PATH_OP_PUSH_ONE_LEFT_DELTA_N_RIGHT_NON_ZERO_PACK6_BITS 11
+#define FIELD_PATH_OP_PUSH_ONE_LEFT_DELTA_N_RIGHT_NON_ZERO_PACK8_BITS 12
+#define FIELD_PATH_OP_PUSH_TWO_LEFT_DELTA_ZERO 13
+#define FIELD_PATH_OP_PUSH_TWO_PACK5_LEFT_DELTA_ZERO 14
+#define FIELD_PATH_OP_PUSH_THREE_LEFT_DELTA_ZERO 15
+#define FIELD_PATH_OP_PUSH_THREE_PACK5_LEFT_DELTA_ZERO 16
+#define FIELD_PATH_OP_PUSH_TWO_LEFT_DELTA_ONE 17
+#define FIELD_PATH_OP_PUSH_TWO_PACK5_LEFT_DELTA_ONE 18
+#define FIELD_PATH_OP_PUSH_THREE_LEFT_DELTA_ONE 19
+#define FIELD_PATH_OP_PUSH_THREE_PACK5_LEFT_DELTA_ONE 20
+#define FIELD_PATH_OP_PUSH_TWO_LEFT_DELTA_N 21
+#define FIELD_PATH_OP_PUSH_TWO_PACK5_LEFT_DELTA_N 22
+#define FIELD_PATH_OP_PUSH_THREE_LEFT_DELTA_N 23
+#define FIELD_PATH_OP_PUSH_THREE_PACK5_LEFT_DELTA_N 24
+#define FIELD_PATH_OP_PUSH_N 25
+#define FIELD_PATH_OP_PUSH_N_AND_NON_TOPOLOGICAL 26
+#define FIELD_PATH_OP_POP_ONE_PLUS_ONE 27
+#define FIELD_PATH_OP_POP_ONE_PLUS_N 28
+#define FIELD_PATH_OP_POP_ALL_BUT_ONE_PLUS_ONE 29
+#define FIELD_PATH_OP_POP_ALL_BUT_ONE_PLUS_N 30
+#define FIELD_PATH_OP_POP_ALL_BUT_ONE_PLUS_N_PACK3_BITS 31
+#define FIELD_PATH_OP_POP_ALL_BUT_ONE_PLUS_N_PACK6_BITS 32
+#define FIELD_PATH_OP_POP_N_PLUS_ONE 33
+#define FIELD_PATH_OP_POP_N_PLUS_N 34
+#define FIELD_PATH_OP_POP_N_AND_NON_TOPOGRAPHICAL 35
+#define FIELD_PATH_OP_NON_TOPO_COMPLEX 36
+#define FIELD_PATH_OP_NON_TOPO_PENULTIMATE_PLUS_ONE 37
+#define FIELD_PATH_OP_NON_TOPO_COMPLEX_PACK4_BITS 38
+#define FIELD_PATH_OP_FIELD_PATH_ENCODE_FINISH 39
+#define FIELD_PATH_OP_COUNT 40
+
+//
+// How often each operation shows up, the Huffman code is built from these. Zero
+// weights count as one
+//
+static const u32 field_path_op_weights[FIELD_PATH_OP_COUNT] = {
+    36271, 10334, 1375, 646, 4128, 35, 3, 521, 2942, 560, 471, 10530, 251, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 310, 2, 0, 1837, 149, 300, 634, 0, 0, 1, 76, 271, 99, 25474,
+};
+
+//
+// CNetworkedQuantizedFloat encode flags
+//
+#define QUANTIZED_FLOAT_ROUND_DOWN (1u << 0)
+#define QUANTIZED_FLOAT_ROUND_UP (1u << 1)
+#define QUANTIZED_FLOAT_ENCODE_ZERO (1u << 2)
+#define QUANTIZED_FLOAT_ENCODE_INTEGERS (1u << 3)
+
+#define FIELD_TYPE_NAME_MAX 128
+#define ENTITY_STRING_VALUE_MAX 4096
+#define ENTITY_DYNAMIC_FIELDS_INITIAL_CAPACITY 16
+
+typedef struct
+{
+    char base[FIELD_TYPE_NAME_MAX];
+    char generic_base[FIELD_TYPE_NAME_MAX];
+    bool is_pointer;
+    u32 count;
+} FieldType;
+
+//
+// What the flattened serializer says about how a field is encoded
+//
+typedef struct
+{
+    const char *encoder;
+    i32 bit_count;
+    bool has_low_value;
+    f32 low_value;
+    bool has_high_value;
+    f32 high_value;
+    i32 encode_flags;
+} FieldEncoding;
+
+//
+// Serializers of these types are always present, a bool says whether they are in use
+//
+static const char *field_pointer_types[] = {
+    "PhysicsRagdollPose_t",
+    "CBodyComponent",
+    "CEntityIdentity",
+    "CPhysicsComponent",
+    "CRenderComponent",
+    "CPlayerLocalData",
+    "CPlayer_CameraServices",
+};
+
+static void field_path_decoder_init(FieldPathDecoder *decoder);
+static int field_path_read_op(const FieldPathDecoder *decoder, Bitstream *stream);
+static bool field_path_apply_op(FieldPath *path, int op, Bitstream *stream);
+static int entity_read_field_paths(EntityEngine *engine, Bitstream *stream, u32 *out_count);
+
+static void field_type_parse(const char *type, FieldType *out_type);
+static bool field_type_is_pointer_type(const char *base);
+static void quantized_float_init(QuantizedFloat *quantized, const FieldEncoding *encoding);
+static f32 quantized_float_quantize(const QuantizedFloat *quantized, f32 value);
+static void field_decoder_init_float(FieldDecoder *decoder, const FieldEncoding *encoding, u8 *out_kind);
+static void field_decoder_init(FieldDecoder *decoder, const char *base_type, const FieldEncoding *encoding);
+static void field_skip(Bitstream *stream, const FieldDecoder *decoder);
+
+static u32 entity_serializer_column_count(EntitySerializer *serializer);
+static EntitySerializer *entity_engine_find_serializer(EntityEngine *engine, const char *name, i32 version, u32 limit);
+static void entity_engine_release_classes(EntityEngine *engine);
+static int entity_engine_apply_query(EntityEngine *engine);
+static u32 entity_class_find_columns(const EntityClass *entity_class, const char *name, const FieldDecoder **out_decoder, u32 *out_count);
+static void entity_serializer_visit_columns(const EntityClass *entity_class, const EntitySerializer *serializer, u32 first_column, const char *prefix, EntityColumnVisitor visitor, void *user_data);
+
+static int entity_class_table_add_row(EntityClass *entity_class, u32 entity_index, u32 serial, u32 *out_row);
+static void entity_engine_remove_entity(EntityEngine *engine, u32 entity_index);
+static void entity_dynamic_fields_free(EntityDynamicFields *dynamic);
+static bool entity_dynamic_fields_set(EntityDynamicFields **dynamic, const FieldPath *path, EntityValue value);
+
+static const FieldDecoder *entity_resolve_field_path(const EntitySerializer *serializer, const FieldPath *path, u32 *out_column);
+static int entity_read_fields(EntityEngine *engine, Bitstream *stream, EntityClass *entity_class, u32 row);
+static int entity_apply_baseline(EntityEngine *engine, EntityClass *entity_class, u32 row);
+static EntityDynamicFields *entity_dynamic_fields_clone(const EntityDynamicFields *dynamic);
+
+//
+// Field paths
+//
+
+static void field_path_decoder_init(FieldPathDecoder *decoder)
+{
+    u32 weights[128];
+    bool alive[128];
+    u32 node_count = FIELD_PATH_OP_COUNT;
+
+    for (u32 i = 0; i < FIELD_PATH_OP_COUNT; i++)
+    {
+        weights[i] = (field_path_op_weights[i]) ? field_path_op_weights[i] : 1;
+        alive[i] = true;
+    }
+
+    //
+    // Repeatedly join the two lightest nodes. Ties go to the node with the higher
+    // index, which has to match the encoder exactly or every code is off
+    //
+    for (u32 remaining = FIELD_PATH_OP_COUNT; remaining > 1; remaining--)
+    {
+        u32 picked[2];
+        for (u32 p = 0; p < 2; p++)
+        {
+            u32 best = UINT32_MAX;
+            for (u32 i = 0; i < node_count; i++)
+            {
+                if (alive[i] && (best == UINT32_MAX || weights[i] < weights[best] || (weights[i] == weights[best] && i > best)))
+                {
+                    best = i;
+                }
+            }
+            alive[best] = false;
+            picked[p] = best;
+        }
+
+        const u32 node = node_count++;
+        weights[node] = weights[picked[0]] + weights[picked[1]];
+        alive[node] = true;
+        decoder->huffman_left[node] = (u16)picked[0];
+        decoder->huffman_right[node] = (u16)picked[1];
+    }
+
+    decoder->huffman_root = (u16)(node_count - 1);
+
+    //
+    // Bits are read LSB first, so bit i of the lookup index is the i-th branch taken
+    //
+    for (u32 code = 0; code < 256; code++)
+    {
+        u16 node = decoder->huffman_root;
+        decoder->lut_length[code] = 0;
+        decoder->lut_op[code] = 0;
+
+        for (u32 bit = 0; bit < 8; bit++)
+        {
+            node = ((code >> bit) & 1u) ? decoder->huffman_right[node] : decoder->huffman_left[node];
+            if (node < FIELD_PATH_OP_COUNT)
+            {
+                decoder->lut_op[code] = (u8)node;
+                decoder->lut_length[code] = (u8)(bit + 1);
+                break;
+            }
+        }
+
+        decoder->lut_node[code] = node;
+    }
+}
+
+static int field_path_read_op(const FieldPathDecoder *decoder, Bitstream *stream)
+{
+    u16 node = decoder->huffman_root;
+
+    u32 code;
+    if (bitstream_peek_u32(stream, 8, &code))
+    {
+        if (decoder->lut_length[code])
+        {
+            bitstream_skip(stream, decoder->lut_length[code]);
+            return decoder->lut_op[code];
+        }
+        bitstream_skip(stream, 8);
+        node = decoder->lut_node[code];
+    }
+
+    while (true)
+    {
+        node = (bitstream_read_bool(stream)) ? decoder->huffman_right[node] : decoder->huffman_left[node];
+        if (node < FIELD_PATH_OP_COUNT)
+        {
+            return node;
+        }
+        if (stream->overflowed)
+        {
+            return -1;
+        }
+    }
+}
+
+static inline u32 field_path_read_ubitvar(Bitstream *stream)
+{
+    if (bitstream_read_bool(stream))
+    {
+        return bitstream_read_u32(stream, 2);
+    }
+    if (bitstream_read_bool(stream))
+    {
+        return bitstream_read_u32(stream, 4);
+    }
+    if (bitstream_read_bool(stream))
+    {
+        return bitstream_read_u32(stream, 10);
+    }
+    if (bitstream_read_bool(stream))
+    {
+        return bitstream_read_u32(stream, 17);
+    }
+    return bitstream_read_u32(stream, 31);
+}
+
+static inline bool field_path_push(FieldPath *path, i32 value)
+{
+    if (path->last + 1 >= ENTITY_FIELD_PATH_MAX_DEPTH)
+    {
+        return false;
+    }
+    path->last++;
+    path->path[path->last] = value;
+    return true;
+}
+
+static inline bool field_path_pop(FieldPath *path, u32 count)
+{
+    if ((i64)count > (i64)path->last)
+    {
+        return false;
+    }
+    for (u32 i = 0; i < count; i++)
+    {
+        path->path[path->last] = 0;
+        path->last--;
+    }
+    return true;
+}
+
+static bool field_path_apply_op(FieldPath *path, int op, Bitstream *stream)
+{
+    switch (op)
+    {
+    case FIELD_PATH_OP_PLUS_ONE:
+        path->path[path->last] += 1;
+        return true;
+    case FIELD_PATH_OP_PLUS_TWO:
+        path->path[path->last] += 2;
+        return true;
+    case FIELD_PATH_OP_PLUS_THREE:
+        path->path[path->last] += 3;
+        return true;
+    case FIELD_PATH_OP_PLUS_FOUR:
+        path->path[path->last] += 4;
+        return true;
+    case FIELD_PATH_OP_PLUS_N:
+        path->path[path->last] += (i32)field_path_read_ubitvar(stream) + 5;
+        return true;
+    case FIELD_PATH_OP_PUSH_ONE_LEFT_DELTA_ZERO_RIGHT_ZERO:
+        return field_path_push(path, 0);
+    case FIELD_PATH_OP_PUSH_ONE_LEFT_DELTA_ZERO_RIGHT_NON_ZERO:
+        return field_path_push(path, (i32)field_path_read_ubitvar(stream));
+    case FIELD_PATH_OP_PUSH_ONE_LEFT_DELTA_ONE_RIGHT_ZERO:
+        path->path[path->last] += 1;
+        return field_path_push(path, 0);
+    case FIELD_PATH_OP_PUSH_ONE_LEFT_DELTA_ONE_RIGHT_NON_ZERO:
+        path->path[path->last] += 1;
+        return field_path_push(path, (i32)field_path_read_ubitvar(stream));
+    case FIELD_PATH_OP_PUSH_ONE_LEFT_DELTA_N_RIGHT_ZERO:
+        path->path[path->last] += (i32)field_path_read_ubitvar(stream);
+        return field_path_push(path, 0);
+    case FIELD_PATH_OP_PUSH_ONE_LEFT_DELTA_N_RIGHT_NON_ZERO:
+        path->path[path->last] += (i32)field_path_read_ubitvar(stream) + 2;
+        return field_path_push(path, (i32)field_path_read_ubitvar(stream) + 1);
+    case FIELD_PATH_OP_PUSH_ONE_LEFT_DELTA_N_RIGHT_NON_ZERO_PACK6_BITS:
+        path->path[path->last] += (i32)bitstream_read_u32(stream, 3) + 2;
+        return field_path_push(path, (i32)bitstream_read_u32(stream, 3) + 1);
+    case FIELD_PATH_OP_PUSH_ONE_LEFT_DELTA_N_RIGHT_NON_ZERO_PACK8_BITS:
+        path->path[path->last] += (i32)bitstream_read_u32(stream, 4) + 2;
+        return field_path_push(path, (i32)bitstream_read_u32(stream, 4) + 1);
+    case FIELD_PATH_OP_PUSH_TWO_LEFT_DELTA_ZERO:
+        return field_path_push(path, (i32)field_path_read_ubitvar(stream)) &&
+               field_path_push(path, (i32)field_path_read_ubitvar(stream));
+    case FIELD_PATH_OP_PUSH_TWO_PACK5_LEFT_DELTA_ZERO:
+        return field_path_push(path, (i32)bitstream_read_u32(stream, 5)) &&
+               field_path_push(path, (i32)bitstream_read_u32(stream, 5));
+    case FIELD_PATH_OP_PUSH_THREE_LEFT_DELTA_ZERO:
+        return field_path_push(path, (i32)field_path_read_ubitvar(stream)) &&
+               field_path_push(path, (i32)field_path_read_ubitvar(stream)) &&
+               field_path_push(path, (i32)field_path_read_ubitvar(stream));
+    case FIELD_PATH_OP_PUSH_THREE_PACK5_LEFT_DELTA_ZERO:
+        return field_path_push(path, (i32)bitstream_read_u32(stream, 5)) &&
+               field_path_push(path, (i32)bitstream_read_u32(stream, 5)) &&
+               field_path_push(path, (i32)bitstream_read_u32(stream, 5));
+    case FIELD_PATH_OP_PUSH_TWO_LEFT_DELTA_ONE:
+        path->path[path->last] += 1;
+        return field_path_push(path, (i32)field_path_read_ubitvar(stream)) &&
+               field_path_push(path, (i32)field_path_read_ubitvar(stream));
+    case FIELD_PATH_OP_PUSH_TWO_PACK5_LEFT_DELTA_ONE:
+        path->path[path->last] += 1;
+        return field_path_push(path, (i32)bitstream_read_u32(stream, 5)) &&
+               field_path_push(path, (i32)bitstream_read_u32(stream, 5));
+    case FIELD_PATH_OP_PUSH_THREE_LEFT_DELTA_ONE:
+        path->path[path->last] += 1;
+        return field_path_push(path, (i32)field_path_read_ubitvar(stream)) &&
+               field_path_push(path, (i32)field_path_read_ubitvar(stream)) &&
+               field_path_push(path, (i32)field_path_read_ubitvar(stream));
+    case FIELD_PATH_OP_PUSH_THREE_PACK5_LEFT_DELTA_ONE:
+        path->path[path->last] += 1;
+        return field_path_push(path, (i32)bitstream_read_u32(stream, 5)) &&
+               field_path_push(path, (i32)bitstream_read_u32(stream, 5)) &&
+               field_path_push(path, (i32)bitstream_read_u32(stream, 5));
+    case FIELD_PATH_OP_PUSH_TWO_LEFT_DELTA_N:
+        path->path[path->last] += (i32)bitstream_read_ubitvar(stream) + 2;
+        return field_path_push(path, (i32)field_path_read_ubitvar(stream)) &&
+               field_path_push(path, (i32)field_path_read_ubitvar(stream));
+    case FIELD_PATH_OP_PUSH_TWO_PACK5_LEFT_DELTA_N:
+        path->path[path->last] += (i32)bitstream_read_ubitvar(stream) + 2;
+        return field_path_push(path, (i32)bitstream_read_u32(stream, 5)) &&
+               field_path_push(path, (i32)bitstream_read_u32(stream, 5));
+    case FIELD_PATH_OP_PUSH_THREE_LEFT_DELTA_N:
+        path->path[path->last] += (i32)bitstream_read_ubitvar(stream) + 2;
+        return field_path_push(path, (i32)field_path_read_ubitvar(stream)) &&
+               field_path_push(path, (i32)field_path_read_ubitvar(stream)) &&
+               field_path_push(path, (i32)field_path_read_ubitvar(stream));
+    case FIELD_PATH_OP_PUSH_THREE_PACK5_LEFT_DELTA_N:
+        path->path[path->last] += (i32)bitstream_read_ubitvar(stream) + 2;
+        return field_path_push(path, (i32)bitstream_read_u32(stream, 5)) &&
+               field_path_push(path, (i32)bitstream_read_u32(stream, 5)) &&
+               field_path_push(path, (i32)bitstream_read_u32(stream, 5));
+    case FIELD_PATH_OP_PUSH_N:
+    {
+        const u32 count = bitstream_read_ubitvar(stream);
+        path->path[path->last] += (i32)bitstream_read_ubitvar(stream);
+        for (u32 i = 0; i < count; i++)
+        {
+            if (!field_path_push(path, (i32)field_path_read_ubitvar(stream)))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    case FIELD_PATH_OP_PUSH_N_AND_NON_TOPOLOGICAL:
+    {
+        for (i32 i = 0; i <= path->last; i++)
+        {
+            if (bitstream_read_bool(stream))
+            {
+                path->path[i] += bitstream_read_signed_varint32(stream) + 1;
+            }
+        }
+        const u32 count = bitstream_read_ubitvar(stream);
+        for (u32 i = 0; i < count; i++)
+        {
+            if (!field_path_push(path, (i32)field_path_read_ubitvar(stream)))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    case FIELD_PATH_OP_POP_ONE_PLUS_ONE:
+        if (!field_path_pop(path, 1))
+        {
+            return false;
+        }
+        path->path[path->last] += 1;
+        return true;
+    case FIELD_PATH_OP_POP_ONE_PLUS_N:
+        if (!field_path_pop(path, 1))
+        {
+            return false;
+        }
+        path->path[path->last] += (i32)field_path_read_ubitvar(stream) + 1;
+        return true;
+    case FIELD_PATH_OP_POP_ALL_BUT_ONE_PLUS_ONE:
+        field_path_pop(path, (u32)path->last);
+        path->path[0] += 1;
+        return true;
+    case FIELD_PATH_OP_POP_ALL_BUT_ONE_PLUS_N:
+        field_path_pop(path, (u32)path->last);
+        path->path[0] += (i32)field_path_read_ubitvar(stream) + 1;
+        return true;
+    case FIELD_PATH_OP_POP_ALL_BUT_ONE_PLUS_N_PACK3_BITS:
+        field_path_pop(path, (u32)path->last);
+        path->path[0] += (i32)bitstream_read_u32(stream, 3) + 1;
+        return true;
+    case FIELD_PATH_OP_POP_ALL_BUT_ONE_PLUS_N_PACK6_BITS:
+        field_path_pop(path, (u32)path->last);
+        path->path[0] += (i32)bitstream_read_u32(stream, 6) + 1;
+        return true;
+    case FIELD_PATH_OP_POP_N_PLUS_ONE:
+        if (!field_path_pop(path, field_path_read_ubitvar(stream)))
+        {
+            return false;
+        }
+        path->path[path->last] += 1;
+        return true;
+    case FIELD_PATH_OP_POP_N_PLUS_N:
+        if (!field_path_pop(path, field_path_read_ubitvar(stream)))
+        {
+            return false;
+        }
+        path->path[path->last] += bitstream_read_signed_varint32(stream);
+        return true;
+    case FIELD_PATH_OP_POP_N_AND_NON_TOPOGRAPHICAL:
+        if (!field_path_pop(path, field_path_read_ubitvar(stream)))
+        {
+            return false;
+        }
+        for (i32 i = 0; i <= path->last; i++)
+        {
+            if (bitstream_read_bool(stream))
+            {
+                path->path[i] += bitstream_read_signed_varint32(stream);
+            }
+        }
+        return true;
+    case FIELD_PATH_OP_NON_TOPO_COMPLEX:
+        for (i32 i = 0; i <= path->last; i++)
+        {
+            if (bitstream_read_bool(stream))
+            {
+                path->path[i] += bitstream_read_signed_varint32(stream);
+            }
+        }
+        return true;
+    case FIELD_PATH_OP_NON_TOPO_PENULTIMATE_PLUS_ONE:
+        if (path->last < 1)
+        {
+            return false;
+        }
+        path->path[path->last - 1] += 1;
+        return true;
+    case FIELD_PATH_OP_NON_TOPO_COMPLEX_PACK4_BITS:
+        for (i32 i = 0; i <= path->last; i++)
+        {
+            if (bitstream_read_bool(stream))
+            {
+                path->path[i] += (i32)bitstream_read_u32(stream, 4) - 7;
+            }
+        }
+        return true;
+    default:
+        return false;
+    }
+}
+
+static int entity_read_field_paths(EntityEngine *engine, Bitstream *stream, u32 *out_count)
+{
+    FieldPath path;
+    memset(&path, 0, sizeof(path));
+    path.path[0] = -1;
+    path.last = 0;
+
+    u32 count = 0;
+
+    while (true)
+    {
+        const int op = field_path_read_op(&engine->field_paths, stream);
+        if (op < 0 || stream->overflowed)
+        {
+            return ENTITY_RET_MALFORMED;
+        }
+
+        if (op == FIELD_PATH_OP_FIELD_PATH_ENCODE_FINISH)
+        {
+            break;
+        }
+
+        if (!field_path_apply_op(&path, op, stream))
+        {
+            return ENTITY_RET_MALFORMED;
+        }
+
+        if (count == engine->path_capacity)
+        {
+            const u32 new_capacity = (engine->path_capacity) ? engine->path_capacity * 2 : 1024;
+            FieldPath *new_paths = (FieldPath *)realloc(engine->paths, new_capacity * sizeof(FieldPath));
+            if (!new_paths)
+            {
+                return ENTITY_RET_OOM;
+            }
+            engine->paths = new_paths;
+            engine->path_capacity = new_capacity;
+        }
+
+        engine->paths[count++] = path;
+    }
+
+    *out_count = count;
+
+    return ENTITY_RET_OK;
+}
+
+//
+// Field types and decoders
+//
+
+static void field_type_copy_name(char *out, const char *begin, const char *end)
+{
+    size_t length = (size_t)(end - begin);
+    if (length >= FIELD_TYPE_NAME_MAX)
+    {
+        length = FIELD_TYPE_NAME_MAX - 1;
+    }
+    memcpy(out, begin, length);
+    out[length] = '\0';
+}
+
+static const char *field_type_name_end(const char *name)
+{
+    while (*name && *name != '<' && *name != '[' && *name != '*' && *name != ' ')
+    {
+        name++;
+    }
+    return name;
+}
+
+//
+// Splits var_type strings such as "CNetworkUtlVectorBase< CHandle< CBaseEntity > >",
+// "float32[3]" or "CCSPlayer_WeaponServices*"
+//
+static void field_type_parse(const char *type, FieldType *out_type)
+{
+    memset(out_type, 0, sizeof(*out_type));
+
+    const char *cursor = type;
+    const char *base_end = field_type_name_end(cursor);
+    field_type_copy_name(out_type->base, cursor, base_end);
+    cursor = base_end;
+
+    while (*cursor == ' ')
+    {
+        cursor++;
+    }
+
+    if (*cursor == '<')
+    {
+        const char *generic = cursor + 1;
+        while (*generic == ' ')
+        {
+            generic++;
+        }
+        field_type_copy_name(out_type->generic_base, generic, field_type_name_end(generic));
+
+        const char *close = strrchr(cursor, '>');
+        cursor = (close) ? close + 1 : cursor + strlen(cursor);
+    }
+
+    while (*cursor == ' ')
+    {
+        cursor++;
+    }
+
+    if (*cursor == '*')
+    {
+        out_type->is_pointer = true;
+        cursor++;
+    }
+
+    if (*cursor == '[')
+    {
+        char count[FIELD_TYPE_NAME_MAX];
+        const char *count_begin = cursor + 1;
+        const char *count_end = strchr(count_begin, ']');
+        field_type_copy_name(count, count_begin, (count_end) ? count_end : count_begin + strlen(count_begin));
+
+        char *parse_end = nullptr;
+        const unsigned long value = strtoul(count, &parse_end, 10);
+
+        if (parse_end != count && *parse_end == '\0')
+        {
+            out_type->count = (u32)value;
+        }
+        else if (strcmp(count, "MAX_ITEM_STOCKS") == 0)
+        {
+            out_type->count = 8;
+        }
+        else if (strcmp(count, "MAX_ABILITY_DRAFT_ABILITIES") == 0)
+        {
+            out_type->count = 48;
+        }
+        else
+        {
+            out_type->count = 1024;
+        }
+    }
+}
+
+static bool field_type_is_pointer_type(const char *base)
+{
+    for (size_t i = 0; i < sizeof(field_pointer_types) / sizeof(field_pointer_types[0]); i++)
+    {
+        if (strcmp(base, field_pointer_types[i]) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static f32 quantized_float_quantize(const QuantizedFloat *quantized, f32 value)
+{
+    if (value < quantized->low)
+    {
+        return quantized->low;
+    }
+    if (value > quantized->high)
+    {
+        return quantized->high;
+    }
+
+    const u32 step = (u32)((value - quantized->low) * quantized->high_low_mul);
+    return quantized->low + (quantized->high - quantized->low) * ((f32)step * quantized->dec_mul);
+}
+
+static void quantized_float_init(QuantizedFloat *quantized, const FieldEncoding *encoding)
+{
+    quantized->bit_count = (u32)encoding->bit_count;
+    quantized->low = (encoding->has_low_value) ? encoding->low_value : 0.0f;
+    quantized->high = (encoding->has_high_value) ? encoding->high_value : 1.0f;
+    quantized->flags = (u32)encoding->encode_flags;
+    quantized->offset = 0.0f;
+
+    //
+    // Drop flags that can't apply to the range
+    //
+    if ((quantized->low == 0.0f && (quantized->flags & QUANTIZED_FLOAT_ROUND_DOWN)) ||
+        (quantized->high == 0.0f && (quantized->flags & QUANTIZED_FLOAT_ROUND_UP)))
+    {
+        quantized->flags &= ~QUANTIZED_FLOAT_ENCODE_ZERO;
+    }
+    if (quantized->low == 0.0f && (quantized->flags & QUANTIZED_FLOAT_ENCODE_ZERO))
+    {
+        quantized->flags |= QUANTIZED_FLOAT_ROUND_DOWN;
+        quantized->flags &= ~QUANTIZED_FLOAT_ENCODE_ZERO;
+    }
+    if (quantized->high == 0.0f && (quantized->flags & QUANTIZED_FLOAT_ENCODE_ZERO))
+    {
+        quantized->flags |= QUANTIZED_FLOAT_ROUND_UP;
+        quantized->flags &= ~QUANTIZED_FLOAT_ENCODE_ZERO;
+    }
+    if (quantized->low > 0.0f || quantized->high < 0.0f)
+    {
+        quantized->flags &= ~QUANTIZED_FLOAT_ENCODE_ZERO;
+    }
+    if (quantized->flags & QUANTIZED_FLOAT_ENCODE_INTEGERS)
+    {
+        quantized->flags &= ~(QUANTIZED_FLOAT_ROUND_UP | QUANTIZED_FLOAT_ROUND_DOWN | QUANTIZED_FLOAT_ENCODE_ZERO);
+    }
+
+    u64 steps = 1ull << quantized->bit_count;
+
+    if (quantized->flags & QUANTIZED_FLOAT_ROUND_DOWN)
+    {
+        quantized->offset = (quantized->high - quantized->low) / (f32)steps;
+        quantized->high -= quantized->offset;
+    }
+    else if (quantized->flags & QUANTIZED_FLOAT_ROUND_UP)
+    {
+        quantized->offset = (quantized->high - quantized->low) / (f32)steps;
+        quantized->low += quantized->offset;
+    }
+
+    if (quantized->flags & QUANTIZED_FLOAT_ENCODE_INTEGERS)
+    {
+        f32 delta = quantized->high - quantized->low;
+        if (delta < 1.0f)
+        {
+            delta = 1.0f;
+        }
+        const u64 range = 1ull << (u32)ceil(log2((f64)delta));
+
+        u32 bit_count = quantized->bit_count;
+        while ((1ull << bit_count) <= range && bit_count < 32)
+        {
+            bit_count++;
+        }
+        if (bit_count > quantized->bit_count)
+        {
+            quantized->bit_count = bit_count;
+            steps = 1ull << bit_count;
+        }
+
+        quantized->offset = (f32)range / (f32)steps;
+        quantized->high = quantized->low + (f32)range - quantized->offset;
+    }
+
+    //
+    // Multiplier mapping the range onto the integer steps, backed off until the top of
+    // the range doesn't overshoot the largest encodable value
+    //
+    const f32 range = quantized->high - quantized->low;
+    const u32 max_step = (quantized->bit_count == 32) ? 0xFFFFFFFEu : (u32)((1ull << quantized->bit_count) - 1);
+    f32 high_mul = (fabsf(range) <= 0.0f) ? (f32)max_step : (f32)max_step / range;
+
+    if (high_mul * range > (f32)max_step || (f64)(high_mul * range) > (f64)max_step)
+    {
+        static const f32 multipliers[] = { 0.9999f, 0.99f, 0.9f, 0.8f, 0.7f };
+        for (size_t i = 0; i < sizeof(multipliers) / sizeof(multipliers[0]); i++)
+        {
+            high_mul = (f32)max_step / range * multipliers[i];
+            if (!(high_mul * range > (f32)max_step || (f64)(high_mul * range) > (f64)max_step))
+            {
+                break;
+            }
+        }
+    }
+
+    quantized->high_low_mul = high_mul;
+    quantized->dec_mul = 1.0f / (f32)(steps - 1);
+
+    //
+    // Flags whose value quantizes exactly are not sent
+    //
+    if ((quantized->flags & QUANTIZED_FLOAT_ROUND_DOWN) && quantized_float_quantize(quantized, quantized->low) == quantized->low)
+    {
+        quantized->flags &= ~QUANTIZED_FLOAT_ROUND_DOWN;
+    }
+    if ((quantized->flags & QUANTIZED_FLOAT_ROUND_UP) && quantized_float_quantize(quantized, quantized->high) == quantized->high)
+    {
+        quantized->flags &= ~QUANTIZED_FLOAT_ROUND_UP;
+    }
+    if ((quantized->flags & QUANTIZED_FLOAT_ENCODE_ZERO) && quantized_float_quantize(quantized, 0.0f) == 0.0f)
+    {
+        quantized->flags &= ~QUANTIZED_FLOAT_ENCODE_ZERO;
+    }
+}
+
+static inline bool field_encoder_is(const FieldEncoding *encoding, const char *name)
+{
+    return encoding->encoder && strcmp(encoding->encoder, name) == 0;
+}
+
+static void field_decoder_init_float(FieldDecoder *decoder, const FieldEncoding *encoding, u8 *out_kind)
+{
+    if (field_encoder_is(encoding, "coord"))
+    {
+        *out_kind = FIELD_DECODER_FLOAT_COORD;
+    }
+    else if (field_encoder_is(encoding, "simtime"))
+    {
+        *out_kind = FIELD_DECODER_FLOAT_SIMTIME;
+    }
+    else if (field_encoder_is(encoding, "runetime"))
+    {
+        *out_kind = FIELD_DECODER_FLOAT_RUNETIME;
+    }
+    else if (encoding->bit_count <= 0 || encoding->bit_count >= 32)
+    {
+        *out_kind = FIELD_DECODER_FLOAT_NOSCALE;
+    }
+    else
+    {
+        *out_kind = FIELD_DECODER_FLOAT_QUANTIZED;
+        quantized_float_init(&decoder->quantized, encoding);
+    }
+}
+
+static void field_decoder_init(FieldDecoder *decoder, const char *base_type, const FieldEncoding *encoding)
+{
+    memset(decoder, 0, sizeof(*decoder));
+    decoder->bit_count = (encoding->bit_count > 0 && encoding->bit_count <= 32) ? (u8)encoding->bit_count : 0;
+
+    if (strcmp(base_type, "float32") == 0)
+    {
+        field_decoder_init_float(decoder, encoding, &decoder->kind);
+    }
+    else if (strcmp(base_type, "CNetworkedQuantizedFloat") == 0)
+    {
+        if (encoding->bit_count <= 0 || encoding->bit_count >= 32)
+        {
+            decoder->kind = FIELD_DECODER_FLOAT_NOSCALE;
+        }
+        else
+        {
+            decoder->kind = FIELD_DECODER_FLOAT_QUANTIZED;
+            quantized_float_init(&decoder->quantized, encoding);
+        }
+    }
+    else if (strcmp(base_type, "Vector") == 0 || strcmp(base_type, "Vector2D") == 0 ||
+             strcmp(base_type, "Vector4D") == 0 || strcmp(base_type, "Quaternion") == 0)
+    {
+        if (strcmp(base_type, "Vector") == 0 && field_encoder_is(encoding, "normal"))
+        {
+            decoder->kind = FIELD_DECODER_VECTOR_NORMAL;
+        }
+        else
+        {
+            decoder->kind = FIELD_DECODER_VECTOR;
+            decoder->component_count = (strcmp(base_type, "Vector") == 0) ? 3 : (strcmp(base_type, "Vector2D") == 0) ? 2 : 4;
+            field_decoder_init_float(decoder, encoding, &decoder->float_kind);
+        }
+    }
+    else if (strcmp(base_type, "QAngle") == 0)
+    {
+        if (field_encoder_is(encoding, "qangle_pitch_yaw"))
+        {
+            decoder->kind = FIELD_DECODER_QANGLE_PITCH_YAW;
+        }
+        else if (field_encoder_is(encoding, "qangle_precise"))
+        {
+            decoder->kind = FIELD_DECODER_QANGLE_PRECISE;
+        }
+        else if (decoder->bit_count)
+        {
+            decoder->kind = FIELD_DECODER_QANGLE_FIXED;
+        }
+        else
+        {
+            decoder->kind = FIELD_DECODER_QANGLE_COORD;
+        }
+    }
+    else if (strcmp(base_type, "uint64") == 0)
+    {
+        decoder->kind = (field_encoder_is(encoding, "fixed64")) ? FIELD_DECODER_FIXED64 : FIELD_DECODER_UNSIGNED64;
+    }
+    else if (strcmp(base_type, "CStrongHandle") == 0)
+    {
+        decoder->kind = FIELD_DECODER_UNSIGNED64;
+    }
+    else if (strcmp(base_type, "bool") == 0 || strcmp(base_type, "CBodyComponent") == 0 ||
+             strcmp(base_type, "CPhysicsComponent") == 0 || strcmp(base_type, "CRenderComponent") == 0)
+    {
+        decoder->kind = FIELD_DECODER_BOOL;
+    }
+    else if (strcmp(base_type, "char") == 0 || strcmp(base_type, "CUtlString") == 0 || strcmp(base_type, "CUtlSymbolLarge") == 0)
+    {
+        decoder->kind = FIELD_DECODER_STRING;
+    }
+    else if (strcmp(base_type, "int8") == 0 || strcmp(base_type, "int16") == 0 || strcmp(base_type, "int32") == 0)
+    {
+        decoder->kind = FIELD_DECODER_SIGNED;
+    }
+    else if (strcmp(base_type, "int64") == 0)
+    {
+        decoder->kind = FIELD_DECODER_SIGNED64;
+    }
+    else if (strcmp(base_type, "GameTime_t") == 0)
+    {
+        decoder->kind = FIELD_DECODER_FLOAT_NOSCALE;
+    }
+    else
+    {
+        //
+        // Integers, handles, enums and everything else unknown are plain varints
+        //
+        decoder->kind = FIELD_DECODER_UNSIGNED;
+    }
+
+    field_decoder_compile(decoder);
+}
+
+static f32 entity_decode_float(EntityEngine *engine, Bitstream *stream, const FieldDecoder *decoder, u8 kind)
+{
+    switch (kind)
+    {
+    case FIELD_DECODER_FLOAT_COORD:
+        return bitstream_read_coord(stream);
+    case FIELD_DECODER_FLOAT_SIMTIME:
+        return (f32)bitstream_read_varint32(stream) * engine->tick_interval;
+    case FIELD_DECODER_FLOAT_RUNETIME:
+    {
+        const u32 bits = bitstream_read_u32(stream, 4);
+        f32 result;
+        memcpy(&result, &bits, sizeof(result));
+        return result;
+    }
+    case FIELD_DECODER_FLOAT_QUANTIZED:
+    {
+        const QuantizedFloat *quantized = &decoder->quantized;
+        if ((quantized->flags & QUANTIZED_FLOAT_ROUND_DOWN) && bitstream_read_bool(stream))
+        {
+            return quantized->low;
+        }
+        if ((quantized->flags & QUANTIZED_FLOAT_ROUND_UP) && bitstream_read_bool(stream))
+        {
+            return quantized->high;
+        }
+        if ((quantized->flags & QUANTIZED_FLOAT_ENCODE_ZERO) && bitstream_read_bool(stream))
+        {
+            return 0.0f;
+        }
+        const u32 step = bitstream_read_u32(stream, quantized->bit_count);
+        return quantized->low + (quantized->high - quantized->low) * (f32)step * quantized->dec_mul;
+    }
+    default:
+        return bitstream_read_noscale_float(stream);
+    }
+}
+
+static EntityValue field_decode_bool(EntityEngine *engine, Bitstream *stream, const FieldDecoder *decoder)
+{
+    UNUSED(engine);
+    UNUSED(decoder);
+
+    EntityValue value = { 0 };
+    value.bool_value = bitstream_read_bool(stream);
+    return value;
+}
+
+static EntityValue field_decode_unsigned(EntityEngine *engine, Bitstream *stream, const FieldDecoder *decoder)
+{
+    UNUSED(engine);
+    UNUSED(decoder);
+
+    EntityValue value = { 0 };
+    value.uint_value = bitstream_read_varint32(stream);
+    return value;
+}
+
+static EntityValue field_decode_unsigned64(EntityEngine *engine, Bitstream *stream, const FieldDecoder *decoder)
+{
+    UNUSED(engine);
+    UNUSED(decoder);
+
+    EntityValue value = { 0 };
+    value.uint_value = bitstream_read_varint64(stream);
+    return value;
+}
+
+static EntityValue field_decode_fixed64(EntityEngine *engine, Bitstream *stream, const FieldDecoder *decoder)
+{
+    UNUSED(engine);
+    UNUSED(decoder);
+
+    EntityValue value = { 0 };
+    value.uint_value = bitstream_read_u64(stream, 64);
+    return value;
+}
+
+static EntityValue field_decode_signed(EntityEngine *engine, Bitstream *stream, const FieldDecoder *decoder)
+{
+    UNUSED(engine);
+    UNUSED(decoder);
+
+    EntityValue value = { 0 };
+    value.int_value = bitstream_read_signed_varint32(stream);
+    return value;
+}
+
+static EntityValue field_decode_signed64(EntityEngine *engine, Bitstream *stream, const FieldDecoder *decoder)
+{
+    UNUSED(engine);
+    UNUSED(decoder);
+
+    EntityValue value = { 0 };
+    value.int_value = bitstream_read_signed_varint64(stream);
+    return value;
+}
+
+static EntityValue field_decode_string(EntityEngine *engine, Bitstream *stream, const FieldDecoder *decoder)
+{
+    UNUSED(decoder);
+
+    char buffer[ENTITY_STRING_VALUE_MAX];
+    const size_t length = bitstream_read_string(stream, buffer, sizeof(buffer));
+
+    EntityValue value = { 0 };
+    value.string = string_intern_get(&engine->strings, buffer, length);
+    return value;
+}
+
+static EntityValue field_decode_float(EntityEngine *engine, Bitstream *stream, const FieldDecoder *decoder)
+{
+    EntityValue value = { 0 };
+    value.float_value = entity_decode_float(engine, stream, decoder, decoder->kind);
+    return value;
+}
+
+static EntityValue field_decode_vector(EntityEngine *engine, Bitstream *stream, const FieldDecoder *decoder)
+{
+    EntityValue value = { 0 };
+    for (u32 i = 0; i < decoder->component_count; i++)
+    {
+        value.vector[i] = entity_decode_float(engine, stream, decoder, decoder->float_kind);
+    }
+    return value;
+}
+
+static EntityValue field_decode_vector_normal(EntityEngine *engine, Bitstream *stream, const FieldDecoder *decoder)
+{
+    UNUSED(engine);
+    UNUSED(decoder);
+
+    EntityValue value = { 0 };
+
+    const bool has_x = bitstream_read_bool(stream);
+    const bool has_y = bitstream_read_bool(stream);
+    if (has_x)
+    {
+        value.vector[0] = bitstream_read_normal(stream);
+    }
+    if (has_y)
+    {
+        value.vector[1] = bitstream_read_normal(stream);
+    }
+    const bool is_z_negative = bitstream_read_bool(stream);
+    const f32 xy_squared = value.vector[0] * value.vector[0] + value.vector[1] * value.vector[1];
+    value.vector[2] = (xy_squared < 1.0f) ? sqrtf(1.0f - xy_squared) : 0.0f;
+    if (is_z_negative)
+    {
+        value.vector[2] = -value.vector[2];
+    }
+    return value;
+}
+
+static EntityValue field_decode_qangle_pitch_yaw(EntityEngine *engine, Bitstream *stream, const FieldDecoder *decoder)
+{
+    UNUSED(engine);
+
+    EntityValue value = { 0 };
+    value.vector[0] = bitstream_read_angle(stream, decoder->bit_count);
+    value.vector[1] = bitstream_read_angle(stream, decoder->bit_count);
+    return value;
+}
+
+static EntityValue field_decode_qangle_precise(EntityEngine *engine, Bitstream *stream, const FieldDecoder *decoder)
+{
+    UNUSED(engine);
+    UNUSED(decoder);
+
+    EntityValue value = { 0 };
+    const bool has_component[3] = { bitstream_read_bool(stream), bitstream_read_bool(stream), bitstream_read_bool(stream) };
+    for (u32 i = 0; i < 3; i++)
+    {
+        if (has_component[i])
+        {
+            value.vector[i] = bitstream_read_angle(stream, 20) - 180.0f;
+        }
+    }
+    return value;
+}
+
+static EntityValue field_decode_qangle_fixed(EntityEngine *engine, Bitstream *stream, const FieldDecoder *decoder)
+{
+    UNUSED(engine);
+
+    EntityValue value = { 0 };
+    for (u32 i = 0; i < 3; i++)
+    {
+        value.vector[i] = bitstream_read_angle(stream, decoder->bit_count);
+    }
+    return value;
+}
+
+static EntityValue field_decode_qangle_coord(EntityEngine *engine, Bitstream *stream, const FieldDecoder *decoder)
+{
+    UNUSED(engine);
+    UNUSED(decoder);
+
+    EntityValue value = { 0 };
+    const bool has_component[3] = { bitstream_read_bool(stream), bitstream_read_bool(stream), bitstream_read_bool(stream) };
+    for (u32 i = 0; i < 3; i++)
+    {
+        if (has_component[i])
+        {
+            value.vector[i] = bitstream_read_coord(stream);
+        }
+    }
+    return value;
+}
+
+static const FieldDecodeFunction field_decode_functions[FIELD_DECODER_KIND_COUNT] = {
+    [FIELD_DECODER_BOOL] = field_decode_bool,
+    [FIELD_DECODER_UNSIGNED] = field_decode_unsigned,
+    [FIELD_DECODER_UNSIGNED64] = field_decode_unsigned64,
+    [FIELD_DECODER_FIXED64] = field_decode_fixed64,
+    [FIELD_DECODER_SIGNED] = field_decode_signed,
+    [FIELD_DECODER_SIGNED64] = field_decode_signed64,
+    [FIELD_DECODER_STRING] = field_decode_string,
+    [FIELD_DECODER_FLOAT_NOSCALE] = field_decode_float,
+    [FIELD_DECODER_FLOAT_QUANTIZED] = field_decode_float,
+    [FIELD_DECODER_FLOAT_COORD] = field_decode_float,
+    [FIELD_DECODER_FLOAT_SIMTIME] = field_decode_float,
+    [FIELD_DECODER_FLOAT_RUNETIME] = field_decode_float,
+    [FIELD_DECODER_VECTOR] = field_decode_vector,
+    [FIELD_DECODER_VECTOR_NORMAL] = field_decode_vector_normal,
+    [FIELD_DECODER_QANGLE_PITCH_YAW] = field_decode_qangle_pitch_yaw,
+    [FIELD_DECODER_QANGLE_PRECISE] = field_decode_qangle_precise,
+    [FIELD_DECODER_QANGLE_FIXED] = field_decode_qangle_fixed,
+    [FIELD_DECODER_QANGLE_COORD] = field_decode_qangle_coord,
+};
+
+void field_decoder_compile(FieldDecoder *decoder)
+{
+    decoder->decode = (decoder->kind < FIELD_DECODER_KIND_COUNT) ? field_decode_functions[decoder->kind] : field_decode_unsigned;
+}
+
+//
+// Stepping over values outside a query's projection. Only what the width of the value
+// depends on is read, nothing is converted or interned
+//
+
+static void field_skip_coord(Bitstream *stream)
+{
+    const bool has_integer = bitstream_read_bool(stream);
+    const bool has_fraction = bitstream_read_bool(stream);
+
+    if (has_integer || has_fraction)
+    {
+        bitstream_skip(stream, 1 + ((has_integer) ? BITSTREAM_COORD_INTEGER_BITS : 0) + ((has_fraction) ? BITSTREAM_COORD_FRACTIONAL_BITS : 0));
+    }
+}
+
+static void field_skip_float(Bitstream *stream, const FieldDecoder *decoder, u8 kind)
+{
+    switch (kind)
+    {
+    case FIELD_DECODER_FLOAT_COORD:
+        field_skip_coord(stream);
+        break;
+    case FIELD_DECODER_FLOAT_SIMTIME:
+        bitstream_read_varint32(stream);
+        break;
+    case FIELD_DECODER_FLOAT_RUNETIME:
+        bitstream_skip(stream, 4);
+        break;
+    case FIELD_DECODER_FLOAT_QUANTIZED:
+    {
+        const QuantizedFloat *quantized = &decoder->quantized;
+        if ((quantized->flags & QUANTIZED_FLOAT_ROUND_DOWN) && bitstream_read_bool(stream))
+        {
+            break;
+        }
+        if ((quantized->flags & QUANTIZED_FLOAT_ROUND_UP) && bitstream_read_bool(stream))
+        {
+            break;
+        }
+        if ((quantized->flags & QUANTIZED_FLOAT_ENCODE_ZERO) && bitstream_read_bool(stream))
+        {
+            break;
+        }
+        bitstream_skip(stream, quantized->bit_count);
+        break;
+    }
+    default:
+        bitstream_skip(stream, 32);
+        break;
+    }
+}
+
+static void field_skip(Bitstream *stream, const FieldDecoder *decoder)
+{
+    switch (decoder->kind)
+    {
+    case FIELD_DECODER_BOOL:
+        bitstream_skip(stream, 1);
+        break;
+    case FIELD_DECODER_UNSIGNED64:
+    case FIELD_DECODER_SIGNED64:
+        bitstream_read_varint64(stream);
+        break;
+    case FIELD_DECODER_FIXED64:
+        bitstream_skip(stream, 64);
+        break;
+    case FIELD_DECODER_STRING:
+        while (bitstream_read_u32(stream, 8) != 0 && !stream->overflowed)
+        {
+        }
+        break;
+    case FIELD_DECODER_FLOAT_NOSCALE:
+    case FIELD_DECODER_FLOAT_QUANTIZED:
+    case FIELD_DECODER_FLOAT_COORD:
+    case FIELD_DECODER_FLOAT_SIMTIME:
+    case FIELD_DECODER_FLOAT_RUNETIME:
+        field_skip_float(stream, decoder, decoder->kind);
+        break;
+    case FIELD_DECODER_VECTOR:
+        for (u32 i = 0; i < decoder->component_count; i++)
+        {
+            field_skip_float(stream, decoder, decoder->float_kind);
+        }
+        break;
+    case FIELD_DECODER_VECTOR_NORMAL:
+    {
+        const bool has_x = bitstream_read_bool(stream);
+        const bool has_y = bitstream_read_bool(stream);
+        bitstream_skip(stream, ((u32)has_x + (u32)has_y) * (1 + BITSTREAM_NORMAL_FRACTIONAL_BITS) + 1);
+        break;
+    }
+    case FIELD_DECODER_QANGLE_PITCH_YAW:
+        bitstream_skip(stream, 2u * decoder->bit_count);
+        break;
+    case FIELD_DECODER_QANGLE_PRECISE:
+    {
+        const u32 component_count = (u32)bitstream_read_bool(stream) + (u32)bitstream_read_bool(stream) + (u32)bitstream_read_bool(stream);
+        bitstream_skip(stream, component_count * 20u);
+        break;
+    }
+    case FIELD_DECODER_QANGLE_FIXED:
+        bitstream_skip(stream, 3u * decoder->bit_count);
+        break;
+    case FIELD_DECODER_QANGLE_COORD:
+    {
+        const bool has_component[3] = { bitstream_read_bool(stream), bitstream_read_bool(stream), bitstream_read_bool(stream) };
+        for (u32 i = 0; i < 3; i++)
+        {
+            if (has_component[i])
+            {
+                field_skip_coord(stream);
+            }
+        }
+        break;
+    }
+    default:
+        //
+        // Signed and unsigned varints, and whatever field_decoder_compile decodes as one
+        //
+        bitstream_read_varint32(stream);
+        break;
+    }
+}
+
+//
+// Serializers and classes
+//
+
+void entity_engine_init(EntityEngine *engine)
+{
+    arena_init(&engine->arena, 1024 * 1024);
+    string_intern_init(&engine->strings);
+    field_path_decoder_init(&engine->field_paths);
+
+    engine->fields = nullptr;
+    engine->field_count = 0;
+    engine->serializers = nullptr;
+    engine->serializer_count = 0;
+    engine->classes = nullptr;
+    engine->class_count = 0;
+    engine->class_id_bits = 0;
+    engine->tick_interval = 1.0f / 64.0f;
+
+    for (u32 i = 0; i < ENTITY_MAX_COUNT; i++)
+    {
+        engine->slots[i].class_id = ENTITY_CLASS_NONE;
+        engine->slots[i].row = 0;
+    }
+    engine->entity_count = 0;
+
+    engine->paths = nullptr;
+    engine->path_capacity = 0;
+
+    engine->event_handler = nullptr;
+    engine->event_user_data = nullptr;
+
+    engine->track_changes = false;
+    engine->changed_columns = nullptr;
+    engine->changed_column_count = 0;
+    engine->changed_column_capacity = 0;
+}
+
+void entity_engine_free(EntityEngine *engine)
+{
+    entity_engine_release_classes(engine);
+    arena_free(&engine->arena);
+    string_intern_free(&engine->strings);
+    free(engine->paths);
+    free(engine->changed_columns);
+
+    engine->paths = nullptr;
+    engine->path_capacity = 0;
+    engine->changed_columns = nullptr;
+    engine->changed_column_count = 0;
+    engine->changed_column_capacity = 0;
+    engine->fields = nullptr;
+    engine->field_count = 0;
+    engine->serializers = nullptr;
+    engine->serializer_count = 0;
+}
+
+static void entity_engine_release_classes(EntityEngine *engine)
+{
+    entity_engine_clear(engine);
+
+    for (u32 i = 0; i < engine->class_count; i++)
+    {
+        EntityClassTable *table = &engine->classes[i].table;
+        free(table->values);
+        free(table->entity_indices);
+        free(table->serials);
+        free(table->active);
+        free(table->dynamic);
+        free(engine->classes[i].baseline_values);
+        free(engine->classes[i].projection);
+        entity_dynamic_fields_free(engine->classes[i].baseline_dynamic);
+    }
+
+    free(engine->classes);
+    engine->classes = nullptr;
+    engine->class_count = 0;
+}
+
+static EntitySerializer *entity_engine_find_serializer(EntityEngine *engine, const char *name, i32 version, u32 limit)
+{
+    //
+    // Names are interned, so comparing pointers is enough
+    //
+    for (u32 i = 0; i < limit; i++)
+    {
+        if (engine->serializers[i].name == name && engine->serializers[i].version == version)
+        {
+            return &engine->serializers[i];
+        }
+    }
+    return nullptr;
+}
+
+static const char *entity_engine_symbol(EntityEngine *engine, const CSVCMsgFlattenedSerializer *flattened_serializer, bool has_symbol, i32 symbol)
+{
+    if (!has_symbol || symbol < 0 || (size_t)symbol >= flattened_serializer->n_symbols)
+    {
+        return nullptr;
+    }
+    const char *string = flattened_serializer->symbols[symbol];
+    return string_intern_get(&engine->strings, string, strlen(string));
+}
+
+static u32 entity_serializer_column_count(EntitySerializer *serializer)
+{
+    if (serializer->column_count != ENTITY_COLUMN_NONE)
+    {
+        return serializer->column_count;
+    }
+
+    //
+    // Zero while in progress, a serializer that contains itself adds no columns
+    //
+    serializer->column_count = 0;
+
+    u32 columns = 0;
+    for (u32 i = 0; i < serializer->field_count; i++)
+    {
+        const EntityField *field = serializer->fields[i];
+        serializer->field_columns[i] = columns;
+
+        switch (field->model)
+        {
+        case FIELD_MODEL_FIXED_ARRAY:
+            columns += field->array_count;
+            break;
+        case FIELD_MODEL_FIXED_TABLE:
+            columns += 1 + ((field->serializer) ? entity_serializer_column_count(field->serializer) : 0);
+            break;
+        default:
+            columns += 1;
+            break;
+        }
+    }
+
+    serializer->column_count = columns;
+    return columns;
+}
+
+void entity_engine_reset_serializers(EntityEngine *engine)
+{
+    entity_engine_release_classes(engine);
+    arena_reset(&engine->arena);
+
+    engine->fields = nullptr;
+    engine->field_count = 0;
+    engine->serializers = nullptr;
+    engine->serializer_count = 0;
+}
+
+int entity_engine_set_serializers(EntityEngine *engine, const CSVCMsgFlattenedSerializer *flattened_serializer)
+{
+    entity_engine_reset_serializers(engine);
+
+    const size_t field_count = flattened_serializer->n_fields;
+    const size_t serializer_count = flattened_serializer->n_serializers;
+
+    EntityField *fields = (EntityField *)arena_alloc(&engine->arena, (field_count + 1) * sizeof(EntityField));
+    EntitySerializer *serializers = (EntitySerializer *)arena_alloc(&engine->arena, (serializer_count + 1) * sizeof(EntitySerializer));
+    if (!fields || !serializers)
+    {
+        return ENTITY_RET_OOM;
+    }
+
+    engine->fields = fields;
+    engine->field_count = (u32)field_count;
+    engine->serializers = serializers;
+
+    for (size_t i = 0; i < serializer_count; i++)
+    {
+        const ProtoFlattenedSerializerT *proto = flattened_serializer->serializers[i];
+        EntitySerializer *serializer = &serializers[i];
+
+        serializer->name = entity_engine_symbol(engine, flattened_serializer, proto->has_serializer_name_sym, proto->serializer_name_sym);
+        serializer->version = (proto->has_serializer_version) ? proto->serializer_version : 0;
+        serializer->field_count = 0;
+        serializer->column_count = ENTITY_COLUMN_NONE;
+        serializer->fields = (EntityField **)arena_alloc(&engine->arena, (proto->n_fields_index + 1) * sizeof(EntityField *));
+        serializer->field_columns = (u32 *)arena_alloc(&engine->arena, (proto->n_fields_index + 1) * sizeof(u32));
+        if (!serializer->fields || !serializer->field_columns)
+        {
+            return ENTITY_RET_OOM;
+        }
+
+        for (size_t f = 0; f < proto->n_fields_index; f++)
+        {
+            const i32 field_index = proto->fields_index[f];
+            if (field_index < 0 || (size_t)field_index >= field_count)
+            {
+                return ENTITY_RET_MALFORMED;
+            }
+            serializer->fields[serializer->field_count++] = &fields[field_index];
+        }
+    }
+
+    engine->serializer_count = (u32)serializer_count;
+
+    for (size_t i = 0; i < field_count; i++)
+    {
+        const ProtoFlattenedSerializerFieldT *proto = flattened_serializer->fields[i];
+        EntityField *field = &fields[i];
+        memset(field, 0, sizeof(*field));
+
+        field->name = entity_engine_symbol(engine, flattened_serializer, proto->has_var_name_sym, proto->var_name_sym);
+        field->type = entity_engine_symbol(engine, flattened_serializer, proto->has_var_type_sym, proto->var_type_sym);
+        if (!field->name)
+        {
+            field->name = "";
+        }
+        if (!field->type)
+        {
+            field->type = "";
+        }
+
+        const FieldEncoding encoding = {
+            .encoder = entity_engine_symbol(engine, flattened_serializer, proto->has_var_encoder_sym, proto->var_encoder_sym),
+            .bit_count = (proto->has_bit_count) ? proto->bit_count : 0,
+            .has_low_value = proto->has_low_value,
+            .low_value = proto->low_value,
+            .has_high_value = proto->has_high_value,
+            .high_value = proto->high_value,
+            .encode_flags = (proto->has_encode_flags) ? proto->encode_flags : 0,
+        };
+
+        FieldType type;
+        field_type_parse(field->type, &type);
+
+        const char *serializer_name = entity_engine_symbol(engine, flattened_serializer, proto->has_field_serializer_name_sym, proto->field_serializer_name_sym);
+
+        if (serializer_name)
+        {
+            const i32 version = (proto->has_field_serializer_version) ? proto->field_serializer_version : 0;
+            field->serializer = entity_engine_find_serializer(engine, serializer_name, version, engine->serializer_count);
+            if (!field->serializer)
+            {
+                log_warn("Field %s references unknown serializer %s (%d)\n", field->name, serializer_name, version);
+            }
+
+            field->model = (type.is_pointer || field_type_is_pointer_type(type.base)) ? FIELD_MODEL_FIXED_TABLE : FIELD_MODEL_VARIABLE_TABLE;
+            field_decoder_init(&field->base_decoder, (field->model == FIELD_MODEL_FIXED_TABLE) ? "bool" : "uint32", &encoding);
+        }
+        else if (type.count > 0 && strcmp(type.base, "char") != 0)
+        {
+            field->model = FIELD_MODEL_FIXED_ARRAY;
+            field->array_count = type.count;
+            field_decoder_init(&field->decoder, type.base, &encoding);
+        }
+        else if (strcmp(type.base, "CUtlVector") == 0 || strcmp(type.base, "CNetworkUtlVectorBase") == 0)
+        {
+            field->model = FIELD_MODEL_VARIABLE_ARRAY;
+            field_decoder_init(&field->base_decoder, "uint32", &encoding);
+            field_decoder_init(&field->decoder, type.generic_base, &encoding);
+        }
+        else
+        {
+            field->model = FIELD_MODEL_SIMPLE;
+            field_decoder_init(&field->decoder, type.base, &encoding);
+        }
+    }
+
+    for (u32 i = 0; i < engine->serializer_count; i++)
+    {
+        entity_serializer_column_count(&serializers[i]);
+    }
+
+    return ENTITY_RET_OK;
+}
+
+int entity_engine_set_classes(EntityEngine *engine, const CDemoClassInfo *class_info)
+{
+    entity_engine_release_classes(engine);
+
+    u32 class_count = 0;
+    for (size_t i = 0; i < class_info->n_classes; i++)
+    {
+        const CDemoClassInfo__ClassT *proto = class_info->classes[i];
+        if (proto->has_class_id && proto->class_id >= 0 && (u32)proto->class_id + 1 > class_count)
+        {
+            class_count = (u32)proto->class_id + 1;
+        }
+    }
+
+    engine->classes = (EntityClass *)calloc(class_count + 1, sizeof(EntityClass));
+    if (!engine->classes)
+    {
+        return ENTITY_RET_OOM;
+    }
+    engine->class_count = class_count;
+
+    for (u32 i = 0; i < class_count; i++)
+    {
+        engine->classes[i].id = i;
+    }
+
+    for (size_t i = 0; i < class_info->n_classes; i++)
+    {
+        const CDemoClassInfo__ClassT *proto = class_info->classes[i];
+        if (!proto->has_class_id || proto->class_id < 0 || !proto->network_name)
+        {
+            continue;
+        }
+
+        EntityClass *entity_class = &engine->classes[proto->class_id];
+        entity_class->name = string_intern_get(&engine->strings, proto->network_name, strlen(proto->network_name));
+
+        //
+        // Classes use the newest serializer with their name
+        //
+        for (u32 s = 0; s < engine->serializer_count; s++)
+        {
+            EntitySerializer *serializer = &engine->serializers[s];
+            if (serializer->name == entity_class->name && (!entity_class->serializer || serializer->version > entity_class->serializer->version))
+            {
+                entity_class->serializer = serializer;
+            }
+        }
+
+        if (!entity_class->serializer)
+        {
+            log_warn("No serializer for class %s\n", entity_class->name);
+        }
+    }
+
+    return entity_engine_apply_query(engine);
+}
+
+void entity_engine_set_query(EntityEngine *engine, const char *const *class_names, u32 class_count, const char *const *field_names, u32 field_count)
+{
+    engine->query_classes = class_names;
+    engine->query_class_count = class_count;
+    engine->query_fields = field_names;
+    engine->query_field_count = field_count;
+}
+
+//
+// Marks the classes outside the query and builds the column projection of the others.
+// Field names a class doesn't have are ignored, so one field list can span classes
+//
+static int entity_engine_apply_query(EntityEngine *engine)
+{
+    if (engine->query_class_count == 0 && engine->query_field_count == 0)
+    {
+        return ENTITY_RET_OK;
+    }
+
+    for (u32 i = 0; i < engine->class_count; i++)
+    {
+        EntityClass *entity_class = &engine->classes[i];
+        if (!entity_class->serializer)
+        {
+            continue;
+        }
+
+        if (engine->query_class_count > 0)
+        {
+            entity_class->is_excluded = true;
+            for (u32 q = 0; q < engine->query_class_count; q++)
+            {
+                if (strcmp(engine->query_classes[q], entity_class->name) == 0)
+                {
+                    entity_class->is_excluded = false;
+                    break;
+                }
+            }
+        }
+
+        if (!entity_class->is_excluded && engine->query_field_count == 0)
+        {
+            continue;
+        }
+
+        const u32 column_count = entity_class->serializer->column_count;
+        entity_class->projection = (u64 *)calloc(column_count / 64 + 1, sizeof(u64));
+        if (!entity_class->projection)
+        {
+            return ENTITY_RET_OOM;
+        }
+
+        if (entity_class->is_excluded)
+        {
+            continue;
+        }
+
+        for (u32 q = 0; q < engine->query_field_count; q++)
+        {
+            u32 count = 0;
+            const u32 first = entity_class_find_columns(entity_class, engine->query_fields[q], nullptr, &count);
+            if (first == ENTITY_COLUMN_NONE)
+            {
+                continue;
+            }
+            for (u32 column = first; column < first + count && column < column_count; column++)
+            {
+                entity_class->projection[column / 64] |= 1ull << (column % 64);
+            }
+        }
+    }
+
+    return ENTITY_RET_OK;
+}
+
+void entity_engine_set_server_info(EntityEngine *engine, const ServerInfoView *server_info)
+{
+    //
+    // Class IDs are sent with floor(log2(max_classes)) + 1 bits
+    //
+    u32 bits = 0;
+    while (bits < 32 && (1ull << bits) <= (u64)server_info->max_classes)
+    {
+        bits++;
+    }
+    engine->class_id_bits = bits;
+
+    if (server_info->tick_interval > 0.0f)
+    {
+        engine->tick_interval = server_info->tick_interval;
+    }
+}
+
+int entity_engine_set_baseline(EntityEngine *engine, u32 class_id, const u8 *data, size_t size)
+{
+    if (class_id >= engine->class_count)
+    {
+        return ENTITY_RET_UNKNOWN_CLASS;
+    }
+
+    u8 *copy = (u8 *)arena_alloc(&engine->arena, size + 1);
+    if (!copy)
+    {
+        return ENTITY_RET_OOM;
+    }
+    memcpy(copy, data, size);
+
+    EntityClass *entity_class = &engine->classes[class_id];
+    entity_class->baseline = copy;
+    entity_class->baseline_size = size;
+
+    entity_dynamic_fields_free(entity_class->baseline_dynamic);
+    entity_class->baseline_dynamic = nullptr;
+    entity_class->baseline_decoded = false;
+
+    return ENTITY_RET_OK;
+}
+
+void entity_engine_set_event_handler(EntityEngine *engine, EntityEventHandler handler, void *user_data)
+{
+    engine->event_handler = handler;
+    engine->event_user_data = user_data;
+}
+
+void entity_engine_track_changes(EntityEngine *engine, bool enabled)
+{
+    engine->track_changes = enabled;
+    engine->changed_column_count = 0;
+}
+
+//
+// Class tables
+//
+
+static int entity_class_table_add_row(EntityClass *entity_class, u32 entity_index, u32 serial, u32 *out_row)
+{
+    EntityClassTable *table = &entity_class->table;
+    const u32 column_count = entity_class->serializer->column_count;
+
+    if (table->row_count == table->row_capacity)
+    {
+        const u32 new_capacity = (table->row_capacity) ? table->row_capacity * 2 : 8;
+
+        EntityValue *new_values = (EntityValue *)calloc((size_t)column_count * new_capacity + 1, sizeof(EntityValue));
+        u32 *new_entity_indices = (u32 *)realloc(table->entity_indices, new_capacity * sizeof(u32));
+        if (new_entity_indices)
+        {
+            table->entity_indices = new_entity_indices;
+        }
+        u32 *new_serials = (u32 *)realloc(table->serials, new_capacity * sizeof(u32));
+        if (new_serials)
+        {
+            table->serials = new_serials;
+        }
+        bool *new_active = (bool *)realloc(table->active, new_capacity * sizeof(bool));
+        if (new_active)
+        {
+            table->active = new_active;
+        }
+        EntityDynamicFields **new_dynamic = (EntityDynamicFields **)realloc(table->dynamic, new_capacity * sizeof(EntityDynamicFields *));
+        if (new_dynamic)
+        {
+            table->dynamic = new_dynamic;
+        }
+
+        if (!new_values || !new_entity_indices || !new_serials || !new_active || !new_dynamic)
+        {
+            free(new_values);
+            return ENTITY_RET_OOM;
+        }
+
+        for (u32 column = 0; column < column_count && table->row_count; column++)
+        {
+            memcpy(&new_values[(size_t)column * new_capacity], &table->values[(size_t)column * table->row_capacity], table->row_count * sizeof(EntityValue));
+        }
+
+        free(table->values);
+        table->values = new_values;
+        table->row_capacity = new_capacity;
+    }
+
+    const u32 row = table->row_count++;
+    for (u32 column = 0; column < column_count; column++)
+    {
+        memset(&table->values[(size_t)column * table->row_capacity + row], 0, sizeof(EntityValue));
+    }
+    table->entity_indices[row] = entity_index;
+    table->serials[row] = serial;
+    table->active[row] = true;
+    table->dynamic[row] = nullptr;
+
+    *out_row = row;
+
+    return ENTITY_RET_OK;
+}
+
+static void entity_engine_remove_entity(EntityEngine *engine, u32 entity_index)
+{
+    EntitySlot *slot = &engine->slots[entity_index];
+    EntityClass *entity_class = &engine->classes[slot->class_id];
+    EntityClassTable *table = &entity_class->table;
+    const u32 column_count = entity_class->serializer->column_count;
+    const u32 row = slot->row;
+    const u32 last = table->row_count - 1;
+
+    entity_dynamic_fields_free(table->dynamic[row]);
+
+    //
+    // Swap-remove keeps the live rows packed at the front of every column
+    //
+    if (row != last)
+    {
+        for (u32 column = 0; column < column_count; column++)
+        {
+            EntityValue *values = &table->values[(size_t)column * table->row_capacity];
+            values[row] = values[last];
+        }
+        table->entity_indices[row] = table->entity_indices[last];
+        table->serials[row] = table->serials[last];
+        table->active[row] = table->active[last];
+        table->dynamic[row] = table->dynamic[last];
+
+        engine->slots[table->entity_indices[row]].row = row;
+    }
+
+    table->row_count--;
+    slot->class_id = ENTITY_CLASS_NONE;
+    slot->row = 0;
+    engine->entity_count--;
+}
+
+void entity_engine_clear(EntityEngine *engine)
+{
+    for (u32 i = 0; i < engine->class_count; i++)
+    {
+        EntityClassTable *table = &engine->classes[i].table;
+        for (u32 row = 0; row < table->row_count; row++)
+        {
+            entity_dynamic_fields_free(table->dynamic[row]);
+            engine->slots[table->entity_indices[row]].class_id = ENTITY_CLASS_NONE;
+        }
+        table->row_count = 0;
+    }
+    engine->entity_count = 0;
+}
+
+//
+// Variable length elements
+//
+
+static u32 field_path_hash(const FieldPath *path)
+{
+    u32 hash = 2166136261u ^ (u32)path->last;
+    for (i32 i = 0; i <= path->last; i++)
+    {
+        hash = (hash ^ (u32)path->path[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool field_path_equal(const FieldPath *a, const FieldPath *b)
+{
+    return a->last == b->last && memcmp(a->path, b->path, (size_t)(a->last + 1) * sizeof(i32)) == 0;
+}
+
+static void entity_dynamic_fields_free(EntityDynamicFields *dynamic)
+{
+    if (dynamic)
+    {
+        free(dynamic->fields);
+        free(dynamic);
+    }
+}
+
+static EntityDynamicFields *entity_dynamic_fields_clone(const EntityDynamicFields *dynamic)
+{
+    EntityDynamicFields *clone = (EntityDynamicFields *)malloc(sizeof(EntityDynamicFields));
+    if (!clone)
+    {
+        return nullptr;
+    }
+
+    clone->fields = (EntityDynamicField *)malloc(dynamic->capacity * sizeof(EntityDynamicField));
+    if (!clone->fields)
+    {
+        free(clone);
+        return nullptr;
+    }
+    memcpy(clone->fields, dynamic->fields, dynamic->capacity * sizeof(EntityDynamicField));
+    clone->capacity = dynamic->capacity;
+    clone->count = dynamic->count;
+
+    return clone;
+}
+
+static bool entity_dynamic_fields_grow(EntityDynamicFields *dynamic)
+{
+    const u32 new_capacity = (dynamic->capacity) ? dynamic->capacity * 2 : ENTITY_DYNAMIC_FIELDS_INITIAL_CAPACITY;
+    EntityDynamicField *new_fields = (EntityDynamicField *)malloc(new_capacity * sizeof(EntityDynamicField));
+    if (!new_fields)
+    {
+        return false;
+    }
+
+    for (u32 i = 0; i < new_capacity; i++)
+    {
+        new_fields[i].path.last = -1;
+    }
+
+    for (u32 i = 0; i < dynamic->capacity; i++)
+    {
+        const EntityDynamicField *field = &dynamic->fields[i];
+        if (field->path.last < 0)
+        {
+            continue;
+        }
+
+        u32 slot = field_path_hash(&field->path) & (new_capacity - 1);
+        while (new_fields[slot].path.last >= 0)
+        {
+            slot = (slot + 1) & (new_capacity - 1);
+        }
+        new_fields[slot] = *field;
+    }
+
+    free(dynamic->fields);
+    dynamic->fields = new_fields;
+    dynamic->capacity = new_capacity;
+
+    return true;
+}
+
+static bool entity_dynamic_fields_set(EntityDynamicFields **dynamic_ref, const FieldPath *path, EntityValue value)
+{
+    EntityDynamicFields *dynamic = *dynamic_ref;
+    if (!dynamic)
+    {
+        dynamic = (EntityDynamicFields *)calloc(1, sizeof(EntityDynamicFields));
+        if (!dynamic)
+        {
+            return false;
+        }
+        *dynamic_ref = dynamic;
+    }
+
+    if ((dynamic->count + 1) * 2 > dynamic->capacity && !entity_dynamic_fields_grow(dynamic))
+    {
+        return false;
+    }
+
+    u32 slot = field_path_hash(path) & (dynamic->capacity - 1);
+    while (dynamic->fields[slot].path.last >= 0)
+    {
+        if (field_path_equal(&dynamic->fields[slot].path, path))
+        {
+            dynamic->fields[slot].value = value;
+            return true;
+        }
+        slot = (slot + 1) & (dynamic->capacity - 1);
+    }
+
+    dynamic->fields[slot].path = *path;
+    dynamic->fields[slot].value = value;
+    dynamic->count++;
+
+    return true;
+}
+
+const EntityValue *entity_engine_dynamic_value(const EntityEngine *engine, u32 entity_index, const FieldPath *path)
+{
+    if (!entity_engine_exists(engine, entity_index))
+    {
+        return nullptr;
+    }
+
+    const EntitySlot *slot = &engine->slots[entity_index];
+    const EntityDynamicFields *dynamic = engine->classes[slot->class_id].table.dynamic[slot->row];
+    if (!dynamic)
+    {
+        return nullptr;
+    }
+
+    u32 index = field_path_hash(path) & (dynamic->capacity - 1);
+    while (dynamic->fields[index].path.last >= 0)
+    {
+        if (field_path_equal(&dynamic->fields[index].path, path))
+        {
+            return &dynamic->fields[index].value;
+        }
+        index = (index + 1) & (dynamic->capacity - 1);
+    }
+
+    return nullptr;
+}
+
+//
+// Decoding
+//
+
+//
+// Walks a field path down the serializer tree. Returns the decoder for the value and
+// its column, or ENTITY_COLUMN_NONE when the path lands inside a variable length array
+// or table
+//
+static const FieldDecoder *entity_resolve_field_path(const EntitySerializer *serializer, const FieldPath *path, u32 *out_column)
+{
+    u32 column = 0;
+    bool is_dynamic = false;
+    i32 depth = 0;
+
+    while (depth <= path->last)
+    {
+        const i32 index = path->path[depth];
+        if (index < 0 || (u32)index >= serializer->field_count)
+        {
+            return nullptr;
+        }
+
+        const EntityField *field = serializer->fields[index];
+        column += serializer->field_columns[index];
+        const bool is_last = (depth == path->last);
+
+        switch (field->model)
+        {
+        case FIELD_MODEL_SIMPLE:
+            *out_column = (is_dynamic) ? ENTITY_COLUMN_NONE : column;
+            return &field->decoder;
+        case FIELD_MODEL_FIXED_ARRAY:
+        {
+            const i32 element = (is_last) ? 0 : path->path[depth + 1];
+            if (element < 0 || (u32)element >= field->array_count)
+            {
+                return nullptr;
+            }
+            *out_column = (is_dynamic) ? ENTITY_COLUMN_NONE : column + (u32)element;
+            return &field->decoder;
+        }
+        case FIELD_MODEL_FIXED_TABLE:
+            if (is_last)
+            {
+                *out_column = (is_dynamic) ? ENTITY_COLUMN_NONE : column;
+                return &field->base_decoder;
+            }
+            if (!field->serializer)
+            {
+                return nullptr;
+            }
+            serializer = field->serializer;
+            column += 1;
+            depth += 1;
+            break;
+        case FIELD_MODEL_VARIABLE_ARRAY:
+            if (is_last)
+            {
+                *out_column = (is_dynamic) ? ENTITY_COLUMN_NONE : column;
+                return &field->base_decoder;
+            }
+            *out_column = ENTITY_COLUMN_NONE;
+            return &field->decoder;
+        case FIELD_MODEL_VARIABLE_TABLE:
+            if (is_last)
+            {
+                *out_column = (is_dynamic) ? ENTITY_COLUMN_NONE : column;
+                return &field->base_decoder;
+            }
+            if (depth + 1 == path->last)
+            {
+                *out_column = ENTITY_COLUMN_NONE;
+                return &field->base_decoder;
+            }
+            if (!field->serializer)
+            {
+                return nullptr;
+            }
+            serializer = field->serializer;
+            is_dynamic = true;
+            depth += 2;
+            break;
+        default:
+            return nullptr;
+        }
+    }
+
+    return nullptr;
+}
+
+static int entity_read_fields(EntityEngine *engine, Bitstream *stream, EntityClass *entity_class, u32 row)
+{
+    //
+    // Every changed field path comes first, followed by the values in the same order
+    //
+    u32 path_count = 0;
+    const int ret_code = entity_read_field_paths(engine, stream, &path_count);
+    if (ret_code != ENTITY_RET_OK)
+    {
+        return ret_code;
+    }
+
+    EntityClassTable *table = &entity_class->table;
+
+    //
+    // A create decodes the baseline and its own fields into the same list
+    //
+    if (engine->track_changes && engine->changed_column_count + path_count > engine->changed_column_capacity)
+    {
+        const u32 new_capacity = engine->changed_column_count + path_count;
+        u32 *new_columns = (u32 *)realloc(engine->changed_columns, new_capacity * sizeof(u32));
+        if (!new_columns)
+        {
+            return ENTITY_RET_OOM;
+        }
+        engine->changed_columns = new_columns;
+        engine->changed_column_capacity = new_capacity;
+    }
+
+    for (u32 i = 0; i < path_count; i++)
+    {
+        const FieldPath *path = &engine->paths[i];
+
+        u32 column;
+        const FieldDecoder *decoder = entity_resolve_field_path(entity_class->serializer, path, &column);
+        if (!decoder || (column != ENTITY_COLUMN_NONE && column >= entity_class->serializer->column_count))
+        {
+            return ENTITY_RET_MALFORMED;
+        }
+
+        if (entity_class->projection && (column == ENTITY_COLUMN_NONE || !(entity_class->projection[column / 64] & (1ull << (column % 64)))))
+        {
+            field_skip(stream, decoder);
+            continue;
+        }
+
+        const EntityValue value = decoder->decode(engine, stream, decoder);
+
+        if (column != ENTITY_COLUMN_NONE)
+        {
+            table->values[(size_t)column * table->row_capacity + row] = value;
+            if (engine->track_changes)
+            {
+                engine->changed_columns[engine->changed_column_count++] = column;
+            }
+        }
+        else if (!entity_dynamic_fields_set(&table->dynamic[row], path, value))
+        {
+            return ENTITY_RET_OOM;
+        }
+    }
+
+    return (stream->overflowed) ? ENTITY_RET_MALFORMED : ENTITY_RET_OK;
+}
+
+//
+// Fills a new row with the class baseline. Decoded once, then copied
+//
+static int entity_apply_baseline(EntityEngine *engine, EntityClass *entity_class, u32 row)
+{
+    if (!entity_class->baseline)
+    {
+        return ENTITY_RET_OK;
+    }
+
+    EntityClassTable *table = &entity_class->table;
+    const u32 column_count = entity_class->serializer->column_count;
+
+    if (entity_class->baseline_decoded)
+    {
+        for (u32 column = 0; column < column_count; column++)
+        {
+            table->values[(size_t)column * table->row_capacity + row] = entity_class->baseline_values[column];
+        }
+        if (entity_class->baseline_dynamic)
+        {
+            table->dynamic[row] = entity_dynamic_fields_clone(entity_class->baseline_dynamic);
+            if (!table->dynamic[row])
+            {
+                return ENTITY_RET_OOM;
+            }
+        }
+        return ENTITY_RET_OK;
+    }
+
+    Bitstream baseline = bitstream_create(entity_class->baseline, entity_class->baseline_size);
+    const int ret_code = entity_read_fields(engine, &baseline, entity_class, row);
+    if (ret_code != ENTITY_RET_OK)
+    {
+        return ret_code;
+    }
+
+    if (!entity_class->baseline_values)
+    {
+        entity_class->baseline_values = (EntityValue *)malloc((column_count + 1) * sizeof(EntityValue));
+        if (!entity_class->baseline_values)
+        {
+            //
+            // The row is fine, the next create just decodes the baseline again
+            //
+            return ENTITY_RET_OK;
+        }
+    }
+
+    for (u32 column = 0; column < column_count; column++)
+    {
+        entity_class->baseline_values[column] = table->values[(size_t)column * table->row_capacity + row];
+    }
+
+    if (table->dynamic[row])
+    {
+        entity_class->baseline_dynamic = entity_dynamic_fields_clone(table->dynamic[row]);
+        if (!entity_class->baseline_dynamic)
+        {
+            return ENTITY_RET_OK;
+        }
+    }
+
+    entity_class->baseline_decoded = true;
+    return ENTITY_RET_OK;
+}
+
+static inline void entity_engine_notify(EntityEngine *engine, u32 event, u32 entity_index)
+{
+    if (engine->event_handler && !entity_engine_class_of(engine, entity_index)->is_excluded)
+    {
+        engine->event_handler(engine->event_user_data, event, entity_index);
+    }
+}
+
+static int entity_engine_create(EntityEngine *engine, Bitstream *stream, u32 entity_index)
+{
+    const u32 class_id = bitstream_read_u32(stream, engine->class_id_bits);
+    const u32 serial = bitstream_read_u32(stream, ENTITY_SERIAL_BITS);
+    bitstream_read_varint32(stream);
+
+    if (class_id >= engine->class_count || !engine->classes[class_id].serializer)
+    {
+        return ENTITY_RET_UNKNOWN_CLASS;
+    }
+
+    if (entity_engine_exists(engine, entity_index))
+    {
+        entity_engine_notify(engine, ENTITY_EVENT_DELETED, entity_index);
+        entity_engine_remove_entity(engine, entity_index);
+    }
+
+    EntityClass *entity_class = &engine->classes[class_id];
+
+    u32 row;
+    int ret_code = entity_class_table_add_row(entity_class, entity_index, serial, &row);
+    if (ret_code != ENTITY_RET_OK)
+    {
+        return ret_code;
+    }
+
+    engine->slots[entity_index].class_id = class_id;
+    engine->slots[entity_index].row = row;
+    engine->entity_count++;
+
+    ret_code = entity_apply_baseline(engine, entity_class, row);
+    if (ret_code != ENTITY_RET_OK)
+    {
+        return ret_code;
+    }
+
+    ret_code = entity_read_fields(engine, stream, entity_class, row);
+    if (ret_code != ENTITY_RET_OK)
+    {
+        return ret_code;
+    }
+
+    entity_engine_notify(engine, ENTITY_EVENT_CREATED, entity_index);
+
+    return ENTITY_RET_OK;
+}
+
+int entity_engine_apply(EntityEngine *engine, const PacketEntitiesView *packet_entities)
+{
+    if (!engine->classes || engine->class_id_bits == 0)
+    {
+        return ENTITY_RET_NOT_READY;
+    }
+
+    if (!packet_entities->is_delta && engine->entity_count > 0)
+    {
+        return ENTITY_RET_OK;
+    }
+
+    Bitstream stream = bitstream_create(packet_entities->entity_data.data, packet_entities->entity_data.size);
+
+    i32 entity_index = -1;
+    for (i32 i = 0; i < packet_entities->updated_entries; i++)
+    {
+        entity_index += (i32)bitstream_read_ubitvar(&stream) + 1;
+        if (entity_index >= ENTITY_MAX_COUNT || stream.overflowed)
+        {
+            return ENTITY_RET_MALFORMED;
+        }
+
+        //
+        // Bit 0 set means the entity leaves the update, bit 1 picks create or delete
+        //
+        const u32 command = bitstream_read_u32(&stream, 2);
+        const u32 index = (u32)entity_index;
+        engine->changed_column_count = 0;
+
+        switch (command)
+        {
+        case 0:
+        {
+            if (!entity_engine_exists(engine, index))
+            {
+                return ENTITY_RET_MALFORMED;
+            }
+            EntityClass *entity_class = entity_engine_class_of(engine, index);
+            const u32 row = engine->slots[index].row;
+            entity_class->table.active[row] = true;
+
+            const int ret_code = entity_read_fields(engine, &stream, entity_class, row);
+            if (ret_code != ENTITY_RET_OK)
+            {
+                return ret_code;
+            }
+            entity_engine_notify(engine, ENTITY_EVENT_UPDATED, index);
+            break;
+        }
+        case 2:
+        {
+            const int ret_code = entity_engine_create(engine, &stream, index);
+            if (ret_code != ENTITY_RET_OK)
+            {
+                return ret_code;
+            }
+            break;
+        }
+        case 1:
+            if (entity_engine_exists(engine, index))
+            {
+                entity_engine_class_of(engine, index)->table.active[engine->slots[index].row] = false;
+                entity_engine_notify(engine, ENTITY_EVENT_LEFT_PVS, index);
+            }
+            break;
+        default:
+            if (entity_engine_exists(engine, index))
+            {
+                entity_engine_notify(engine, ENTITY_EVENT_DELETED, index);
+                entity_engine_remove_entity(engine, index);
+            }
+            break;
+        }
+    }
+
+    return ENTITY_RET_OK;
+}
+
+//
+// Lookups
+//
+
+EntityClass *entity_engine_find_class(EntityEngine *engine, const char *name)
+{
+    for (u32 i = 0; i < engine->class_count; i++)
+    {
+        if (engine->classes[i].name && strcmp(engine->classes[i].name, name) == 0)
+        {
+            return &engine->classes[i];
+        }
+    }
+    return nullptr;
+}
+
+u32 entity_class_find_column(const EntityClass *entity_class, const char *name)
+{
+    u32 count;
+    return entity_class_find_columns(entity_class, name, nullptr, &count);
+}
+
+u32 entity_class_find_field(const EntityClass *entity_class, const char *name, const FieldDecoder **out_decoder)
+{
+    u32 count;
+    return entity_class_find_columns(entity_class, name, out_decoder, &count);
+}
+
+//
+// First column of the field path and how many columns the field spans, all elements of
+// a fixed array or the presence flag and every column of a fixed table
+//
+static u32 entity_class_find_columns(const EntityClass *entity_class, const char *name, const FieldDecoder **out_decoder, u32 *out_count)
+{
+    const EntitySerializer *serializer = entity_class->serializer;
+    u32 column = 0;
+
+    while (serializer)
+    {
+        const char *segment_end = strchr(name, '.');
+        const size_t segment_length = (segment_end) ? (size_t)(segment_end - name) : strlen(name);
+
+        u32 index = 0;
+        while (index < serializer->field_count)
+        {
+            const char *field_name = serializer->fields[index]->name;
+            if (strncmp(field_name, name, segment_length) == 0 && field_name[segment_length] == '\0')
+            {
+                break;
+            }
+            index++;
+        }
+
+        if (index == serializer->field_count)
+        {
+            return ENTITY_COLUMN_NONE;
+        }
+
+        const EntityField *field = serializer->fields[index];
+        column += serializer->field_columns[index];
+
+        if (!segment_end)
+        {
+            switch (field->model)
+            {
+            case FIELD_MODEL_FIXED_ARRAY:
+                *out_count = field->array_count;
+                break;
+            case FIELD_MODEL_FIXED_TABLE:
+                *out_count = 1 + ((field->serializer) ? field->serializer->column_count : 0);
+                break;
+            default:
+                *out_count = 1;
+                break;
+            }
+            if (out_decoder)
+            {
+                *out_decoder = (field->model == FIELD_MODEL_SIMPLE || field->model == FIELD_MODEL_FIXED_ARRAY) ? &field->decoder : &field->base_decoder;
+            }
+            return column;
+        }
+        name = segment_end + 1;
+
+        switch (field->model)
+        {
+        case FIELD_MODEL_FIXED_ARRAY:
+        {
+            char *parse_end = nullptr;
+            const unsigned long element = strtoul(name, &parse_end, 10);
+            if (parse_end == name || *parse_end != '\0' || element >= field->array_count)
+            {
+                return ENTITY_COLUMN_NONE;
+            }
+            *out_count = 1;
+            if (out_decoder)
+            {
+                *out_decoder = &field->decoder;
+            }
+            return column + (u32)element;
+        }
+        case FIELD_MODEL_FIXED_TABLE:
+            serializer = field->serializer;
+            column += 1;
+            break;
+        default:
+            //
+            // Nothing below simple fields, and variable length elements have no column
+            //
+            return ENTITY_COLUMN_NONE;
+        }
+    }
+
+    return ENTITY_COLUMN_NONE;
+}
+
+void entity_class_visit_columns(const EntityClass *entity_class, EntityColumnVisitor visitor, void *user_data)
+{
+    if (entity_class->serializer)
+    {
+        entity_serializer_visit_columns(entity_class, entity_class->serializer, 0, "", visitor, user_data);
+    }
+}
+
+static void entity_serializer_visit_columns(const EntityClass *entity_class, const EntitySerializer *serializer, u32 first_column, const char *prefix, EntityColumnVisitor visitor, void *user_data)
+{
+    for (u32 i = 0; i < serializer->field_count; i++)
+    {
+        const EntityField *field = serializer->fields[i];
+        const u32 column = first_column + serializer->field_columns[i];
+
+        char name[256];
+        snprintf(name, sizeof(name), "%s%s", prefix, field->name);
+
+        if (field->model == FIELD_MODEL_FIXED_TABLE)
+        {
+            //
+            // The presence flag isn't reported, only the fields of the table
+            //
+            if (field->serializer)
+            {
+                char nested_prefix[264];
+                snprintf(nested_prefix, sizeof(nested_prefix), "%s.", name);
+                entity_serializer_visit_columns(entity_class, field->serializer, column + 1, nested_prefix, visitor, user_data);
+            }
+            continue;
+        }
+
+        const u32 column_count = (field->model == FIELD_MODEL_FIXED_ARRAY) ? field->array_count : 1;
+        for (u32 element = 0; element < column_count; element++)
+        {
+            const u32 element_column = column + element;
+            if (entity_class->projection && !(entity_class->projection[element_column / 64] & (1ull << (element_column % 64))))
+            {
+                continue;
+            }
+
+            if (field->model == FIELD_MODEL_FIXED_ARRAY)
+            {
+                char element_name[280];
+                snprintf(element_name, sizeof(element_name), "%s.%u", name, element);
+                visitor(user_data, element_name, element_column, &field->decoder);
+            }
+            else
+            {
+                visitor(user_data, name, element_column, (field->model == FIELD_MODEL_SIMPLE) ? &field->decoder : &field->base_decoder);
+            }
+        }
+    }
+}
@@ -0,0 +1,381 @@
+#pragma once
+
+//
+// Entity state engine. Serializers from DEMO_COMMAND_SEND_TABLES describe how every
+// networked class is encoded, DEMO_COMMAND_CLASS_INFO maps class IDs to them, and
+// svc_PacketEntities carries create, update, leave and delete commands whose field
+// values are decoded against those serializers.
+//
+// State is kept per class in structure-of-arrays tables. Every fixed position field
+// of a class (simple fields, fixed array elements, fields of fixed sub-tables) gets a
+// column, stored column-major so scanning one field across every live entity of a
+// class walks contiguous memory. Elements of variable length arrays and tables live in
+// a small per-row side table since their count changes from update to update.
+//
+// A query can narrow decoding down to some classes and some of their fields. Entities
+// of other classes are still tracked, since their updates have to be stepped over, but
+// none of their values are decoded. Fields outside the projection are skipped by their
+// encoded width.
+//
+
+#include "common.h"
+#include "arena.h"
+#include "bitstream.h"
+#include "message_views.h"
+#include "string_intern.h"
+
+#include "protos/demo.pb-c.h"
+#include "protos/netmessages.pb-c.h"
+
+#define ENTITY_MAX_COUNT (1 << 14)
+#define ENTITY_SERIAL_BITS 17
+#define ENTITY_FIELD_PATH_MAX_DEPTH 7
+#define ENTITY_COLUMN_NONE 0xFFFFFFFFu
+#define ENTITY_CLASS_NONE 0xFFFFFFFFu
+
+#define ENTITY_RET_OK 0
+#define ENTITY_RET_OOM 1
+#define ENTITY_RET_MALFORMED 2
+#define ENTITY_RET_UNKNOWN_CLASS 3
+#define ENTITY_RET_NOT_READY 4
+
+#define ENTITY_EVENT_CREATED 0
+#define ENTITY_EVENT_UPDATED 1
+#define ENTITY_EVENT_LEFT_PVS 2
+#define ENTITY_EVENT_DELETED 3
+
+#define FIELD_MODEL_SIMPLE 0
+#define FIELD_MODEL_FIXED_ARRAY 1
+#define FIELD_MODEL_FIXED_TABLE 2
+#define FIELD_MODEL_VARIABLE_ARRAY 3
+#define FIELD_MODEL_VARIABLE_TABLE 4
+
+#define FIELD_DECODER_BOOL 0
+#define FIELD_DECODER_UNSIGNED 1
+#define FIELD_DECODER_UNSIGNED64 2
+#define FIELD_DECODER_FIXED64 3
+#define FIELD_DECODER_SIGNED 4
+#define FIELD_DECODER_SIGNED64 5
+#define FIELD_DECODER_STRING 6
+#define FIELD_DECODER_FLOAT_NOSCALE 7
+#define FIELD_DECODER_FLOAT_QUANTIZED 8
+#define FIELD_DECODER_FLOAT_COORD 9
+#define FIELD_DECODER_FLOAT_SIMTIME 10
+#define FIELD_DECODER_FLOAT_RUNETIME 11
+#define FIELD_DECODER_VECTOR 12
+#define FIELD_DECODER_VECTOR_NORMAL 13
+#define FIELD_DECODER_QANGLE_PITCH_YAW 14
+#define FIELD_DECODER_QANGLE_PRECISE 15
+#define FIELD_DECODER_QANGLE_FIXED 16
+#define FIELD_DECODER_QANGLE_COORD 17
+#define FIELD_DECODER_KIND_COUNT 18
+
+//
+// Decoded field value. Vectors and angles fill the first 2-4 floats, strings point
+// into the engine's string store
+//
+typedef union
+{
+    u64 uint_value;
+    i64 int_value;
+    f32 float_value;
+    f32 vector[4];
+    bool bool_value;
+    const char *string;
+} EntityValue;
+
+static_assert(sizeof(EntityValue) == 16, "EntityValue is expected to be 16 bytes");
+
+typedef struct
+{
+    f32 low;
+    f32 high;
+    f32 high_low_mul;
+    f32 dec_mul;
+    f32 offset;
+    u32 bit_count;
+    u32 flags;
+} QuantizedFloat;
+
+typedef struct EntityEngine EntityEngine;
+typedef struct FieldDecoder FieldDecoder;
+
+typedef EntityValue (*FieldDecodeFunction)(EntityEngine *engine, Bitstream *stream, const FieldDecoder *decoder);
+
+struct FieldDecoder
+{
+    //
+    // Bound from kind by field_decoder_compile, so decoding a value is one indirect call
+    //
+    FieldDecodeFunction decode;
+    u8 kind;
+    //
+    // Component decoder and count of FIELD_DECODER_VECTOR
+    //
+    u8 float_kind;
+    u8 component_count;
+    u8 bit_count;
+    QuantizedFloat quantized;
+};
+
+typedef struct EntitySerializer EntitySerializer;
+
+typedef struct
+{
+    const char *name;
+    const char *type;
+    u8 model;
+    //
+    // Simple fields, fixed array elements and variable array elements
+    //
+    FieldDecoder decoder;
+    //
+    // Fixed table presence flag, variable array and table lengths
+    //
+    FieldDecoder base_decoder;
+    EntitySerializer *serializer;
+    u32 array_count;
+} EntityField;
+
+struct EntitySerializer
+{
+    const char *name;
+    i32 version;
+    EntityField **fields;
+    //
+    // First column of each field, relative to the first column of the serializer
+    //
+    u32 *field_columns;
+    u32 field_count;
+    u32 column_count;
+};
+
+typedef struct
+{
+    i32 path[ENTITY_FIELD_PATH_MAX_DEPTH];
+    i32 last;
+} FieldPath;
+
+typedef struct
+{
+    FieldPath path;
+    EntityValue value;
+} EntityDynamicField;
+
+//
+// Variable array and table elements of one entity, open addressing on the field path.
+// Free slots have a path.last of -1
+//
+typedef struct
+{
+    EntityDynamicField *fields;
+    u32 capacity;
+    u32 count;
+} EntityDynamicFields;
+
+typedef struct
+{
+    u32 row_count;
+    u32 row_capacity;
+    //
+    // column_count * row_capacity values, column-major
+    //
+    EntityValue *values;
+    u32 *entity_indices;
+    u32 *serials;
+    bool *active;
+    EntityDynamicFields **dynamic;
+} EntityClassTable;
+
+typedef struct
+{
+    u32 id;
+    const char *name;
+    EntitySerializer *serializer;
+    EntityClassTable table;
+    const u8 *baseline;
+    size_t baseline_size;
+    //
+    // The baseline decoded by the first create after it was set, copied into every
+    // entity created after that instead of decoding the bytes again
+    //
+    EntityValue *baseline_values;
+    EntityDynamicFields *baseline_dynamic;
+    bool baseline_decoded;
+    //
+    // Columns decoded under the query, one bit each. nullptr decodes every column,
+    // variable length elements are only decoded then
+    //
+    u64 *projection;
+    //
+    // Outside the query's classes, its entities raise no events
+    //
+    bool is_excluded;
+} EntityClass;
+
+typedef struct
+{
+    u32 class_id;
+    u32 row;
+} EntitySlot;
+
+typedef void (*EntityEventHandler)(void *user_data, u32 event, u32 entity_index);
+typedef void (*EntityColumnVisitor)(void *user_data, const char *name, u32 column, const FieldDecoder *decoder);
+
+typedef struct
+{
+    //
+    // Huffman tree over the field path operations. Nodes below FIELD_PATH_OP_COUNT
+    // are leaves, 8 bit codes are resolved in one lookup
+    //
+    u16 huffman_left[128];
+    u16 huffman_right[128];
+    u16 huffman_root;
+    u8 lut_op[256];
+    u8 lut_length[256];
+    u16 lut_node[256];
+} FieldPathDecoder;
+
+struct EntityEngine
+{
+    Arena arena;
+    StringIntern strings;
+    FieldPathDecoder field_paths;
+
+    //
+    // Compiled serializers. Fields are shared between serializers
+    //
+    EntityField *fields;
+    u32 field_count;
+    EntitySerializer *serializers;
+    u32 serializer_count;
+
+    EntityClass *classes;
+    u32 class_count;
+    u32 class_id_bits;
+    f32 tick_interval;
+
+    EntitySlot slots[ENTITY_MAX_COUNT];
+    u32 entity_count;
+
+    //
+    // Field paths of the entity being decoded
+    //
+    FieldPath *paths;
+    u32 path_capacity;
+
+    EntityEventHandler event_handler;
+    void *event_user_data;
+
+    //
+    // With track_changes set, the columns the update of the entity being notified wrote,
+    // in decode order. Columns outside the projection aren't decoded and aren't listed
+    //
+    bool track_changes;
+    u32 *changed_columns;
+    u32 changed_column_count;
+    u32 changed_column_capacity;
+
+    //
+    // Query applied to the classes as they're set up, see entity_engine_set_query
+    //
+    const char *const *query_classes;
+    u32 query_class_count;
+    const char *const *query_fields;
+    u32 query_field_count;
+};
+
+void entity_engine_init(EntityEngine *engine);
+void entity_engine_free(EntityEngine *engine);
+
+int entity_engine_set_serializers(EntityEngine *engine, const CSVCMsgFlattenedSerializer *flattened_serializer);
+
+//
+// Drops the serializers along with every class and entity built on them
+//
+void entity_engine_reset_serializers(EntityEngine *engine);
+
+//
+// Binds the decode function of a decoder whose kind and parameters are set
+//
+void field_decoder_compile(FieldDecoder *decoder);
+int entity_engine_set_classes(EntityEngine *engine, const CDemoClassInfo *class_info);
+void entity_engine_set_server_info(EntityEngine *engine, const ServerInfoView *server_info);
+
+//
+// Raw instancebaseline string table value for a class. The bytes are copied
+//
+int entity_engine_set_baseline(EntityEngine *engine, u32 class_id, const u8 *data, size_t size);
+
+//
+// Drops every entity, used before jumping to a full packet
+//
+void entity_engine_clear(EntityEngine *engine);
+
+//
+// Applies one svc_PacketEntities. A snapshot (is_delta false) is only applied to an
+// empty engine, after that the deltas already keep the state current
+//
+int entity_engine_apply(EntityEngine *engine, const PacketEntitiesView *packet_entities);
+
+void entity_engine_set_event_handler(EntityEngine *engine, EntityEventHandler handler, void *user_data);
+
+//
+// Lists the columns each update wrote in changed_columns, for handlers that only want
+// what changed rather than every value of the entity
+//
+void entity_engine_track_changes(EntityEngine *engine, bool enabled);
+
+//
+// Only decodes the entities of class_names, and of those only the field_names (dotted
+// names as for entity_class_find_column, a fixed table or array name takes all of its
+// columns). An empty list keeps everything. Takes effect with the next
+// entity_engine_set_classes, the names are borrowed for the life of the engine
+//
+void entity_engine_set_query(EntityEngine *engine, const char *const *class_names, u32 class_count, const char *const *field_names, u32 field_count);
+
+EntityClass *entity_engine_find_class(EntityEngine *engine, const char *name);
+
+//
+// Column of a field path written as dotted names, e.g. "CBodyComponent.m_cellX" or
+// "m_iAmmo.0002" for an array element. ENTITY_COLUMN_NONE if there is no such column
+//
+u32 entity_class_find_column(const EntityClass *entity_class, const char *name);
+
+//
+// Same as entity_class_find_column, along with the decoder of the values in the column
+//
+u32 entity_class_find_field(const EntityClass *entity_class, const char *name, const FieldDecoder **out_decoder);
+
+//
+// Calls visitor for every column of the class in column order, with its dotted name as
+// entity_class_find_column takes it. Only the projected columns when the class has a
+// projection. Variable length arrays and tables show up as their length column
+//
+void entity_class_visit_columns(const EntityClass *entity_class, EntityColumnVisitor visitor, void *user_data);
+
+static inline bool entity_engine_exists(const EntityEngine *engine, u32 entity_index)
+{
+    return entity_index < ENTITY_MAX_COUNT && engine->slots[entity_index].class_id != ENTITY_CLASS_NONE;
+}
+
+static inline EntityClass *entity_engine_class_of(const EntityEngine *engine, u32 entity_index)
+{
+    return &engine->classes[engine->slots[entity_index].class_id];
+}
+
+static inline const EntityValue *entity_class_column(const EntityClass *entity_class, u32 column)
+{
+    return &entity_class->table.values[(size_t)column * entity_class->table.row_capacity];
+}
+
+static inline const EntityValue *entity_engine_value(const EntityEngine *engine, u32 entity_index, u32 column)
+{
+    const EntitySlot *slot = &engine->slots[entity_index];
+    return &entity_class_column(&engine->classes[slot->class_id], column)[slot->row];
+}
+
+//
+// Element of a variable length array or table, nullptr if it was never sent
+//
+const EntityValue *entity_engine_dynamic_value(const EntityEngine *engine, u32 entity_index, const FieldPath *path);
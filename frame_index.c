@@ -0,0 +1,395 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "frame_index.h"
+#include "demo.h"
+#include "frame_prescan.h"
+
+//
+// Sidecar layout: a fixed header followed by one record per frame, each record
+// being varint(offset delta), varint(zigzag tick delta) and a byte holding the
+// command with the compressed flag in the top bit. Typically ~4 bytes a frame
+//
+#define FRAME_INDEX_MAGIC "DEMIDX01"
+#define FRAME_INDEX_COMPRESSED_FLAG 0x80u
+
+//
+// Headers decoded per frame_prescan call while building
+//
+#define FRAME_INDEX_PRESCAN_BATCH 256
+
+typedef struct
+{
+    char magic[8];
+    u64 file_size;
+    u64 file_mtime_ns;
+    u64 first_packet_offset;
+    u32 entry_count;
+    u32 records_size;
+} FrameIndexFileHeader;
+
+static int frame_index_push(FrameIndex *index, FrameIndexEntry entry);
+static int frame_index_finalize(FrameIndex *index);
+static size_t write_varint64(u8 *out, u64 value);
+static bool read_varint64(const u8 *data, size_t data_size, size_t *pos, u64 *out_value);
+
+void frame_index_init(FrameIndex *index)
+{
+    memset(index, 0, sizeof(*index));
+    index->first_packet_offset = UINT64_MAX;
+}
+
+void frame_index_free(FrameIndex *index)
+{
+    free(index->entries);
+    free(index->full_packets);
+    frame_index_init(index);
+}
+
+static int frame_index_push(FrameIndex *index, FrameIndexEntry entry)
+{
+    if (index->entry_count == index->entry_capacity)
+    {
+        const u32 new_capacity = (index->entry_capacity) ? index->entry_capacity * 2 : 4096;
+        FrameIndexEntry *new_entries = (FrameIndexEntry *)realloc(index->entries, new_capacity * sizeof(FrameIndexEntry));
+        if (!new_entries)
+        {
+            return FRAME_INDEX_RET_OOM;
+        }
+        index->entries = new_entries;
+        index->entry_capacity = new_capacity;
+    }
+
+    index->entries[index->entry_count++] = entry;
+
+    return FRAME_INDEX_RET_OK;
+}
+
+//
+// Derives the keyframe list and first packet offset from the entries
+//
+static int frame_index_finalize(FrameIndex *index)
+{
+    u32 full_packet_count = 0;
+    for (u32 i = 0; i < index->entry_count; i++)
+    {
+        full_packet_count += (index->entries[i].command == DEMO_COMMAND_FULL_PACKET);
+    }
+
+    free(index->full_packets);
+    index->full_packets = nullptr;
+    index->full_packet_count = 0;
+
+    if (full_packet_count > 0)
+    {
+        index->full_packets = (u32 *)malloc(full_packet_count * sizeof(u32));
+        if (!index->full_packets)
+        {
+            return FRAME_INDEX_RET_OOM;
+        }
+    }
+
+    index->first_packet_offset = UINT64_MAX;
+
+    for (u32 i = 0; i < index->entry_count; i++)
+    {
+        const FrameIndexEntry *entry = &index->entries[i];
+
+        if (entry->command == DEMO_COMMAND_FULL_PACKET)
+        {
+            index->full_packets[index->full_packet_count++] = i;
+        }
+
+        if ((entry->command == DEMO_COMMAND_PACKET || entry->command == DEMO_COMMAND_FULL_PACKET) &&
+            index->first_packet_offset == UINT64_MAX)
+        {
+            index->first_packet_offset = entry->offset;
+        }
+    }
+
+    return FRAME_INDEX_RET_OK;
+}
+
+int frame_index_build(FrameIndex *index, const u8 *data, size_t data_size, size_t start_pos)
+{
+    frame_index_free(index);
+
+    index->file_size = data_size;
+
+    size_t pos = start_pos;
+    FramePrescanRecord records[FRAME_INDEX_PRESCAN_BATCH];
+
+    while (true)
+    {
+        u32 record_count = 0;
+        const int prescan_ret_code = frame_prescan(data, data_size, &pos, records, FRAME_INDEX_PRESCAN_BATCH, &record_count);
+
+        for (u32 i = 0; i < record_count; i++)
+        {
+            const FrameIndexEntry entry = {
+                .offset = records[i].offset,
+                .tick = records[i].tick,
+                .command = records[i].command,
+                .is_compressed = records[i].is_compressed,
+            };
+
+            const int ret_code = frame_index_push(index, entry);
+            if (ret_code != FRAME_INDEX_RET_OK)
+            {
+                return ret_code;
+            }
+        }
+
+        if (prescan_ret_code != FRAME_PRESCAN_RET_OK)
+        {
+            break;
+        }
+    }
+
+    return frame_index_finalize(index);
+}
+
+static size_t write_varint64(u8 *out, u64 value)
+{
+    size_t length = 0;
+    while (value >= 0x80u)
+    {
+        out[length++] = (u8)(value | 0x80u);
+        value >>= 7;
+    }
+    out[length++] = (u8)value;
+    return length;
+}
+
+static bool read_varint64(const u8 *data, size_t data_size, size_t *pos, u64 *out_value)
+{
+    u64 result = 0;
+    for (u32 shift = 0; shift < 70; shift += 7)
+    {
+        if (*pos >= data_size)
+        {
+            return false;
+        }
+        const u8 byte = data[(*pos)++];
+        result |= (u64)(byte & 0x7Fu) << shift;
+        if (!(byte & 0x80u))
+        {
+            *out_value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+int frame_index_write(const FrameIndex *index, const char *path)
+{
+    //
+    // Worst case 10 + 10 + 1 bytes a record
+    //
+    u8 *records = (u8 *)malloc((size_t)index->entry_count * 21u + 1u);
+    if (!records)
+    {
+        return FRAME_INDEX_RET_OOM;
+    }
+
+    size_t records_size = 0;
+    u64 previous_offset = 0;
+    u32 previous_tick = 0;
+
+    for (u32 i = 0; i < index->entry_count; i++)
+    {
+        const FrameIndexEntry *entry = &index->entries[i];
+        const i64 tick_delta = (i64)(i32)(entry->tick - previous_tick);
+        const u64 tick_zigzag = ((u64)tick_delta << 1) ^ (u64)(tick_delta >> 63);
+
+        records_size += write_varint64(records + records_size, entry->offset - previous_offset);
+        records_size += write_varint64(records + records_size, tick_zigzag);
+        records[records_size++] = entry->command | ((entry->is_compressed) ? FRAME_INDEX_COMPRESSED_FLAG : 0u);
+
+        previous_offset = entry->offset;
+        previous_tick = entry->tick;
+    }
+
+    FrameIndexFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FRAME_INDEX_MAGIC, sizeof(header.magic));
+    header.file_size = index->file_size;
+    header.file_mtime_ns = index->file_mtime_ns;
+    header.first_packet_offset = index->first_packet_offset;
+    header.entry_count = index->entry_count;
+    header.records_size = (u32)records_size;
+
+    //
+    // Write to a temporary and rename so a concurrent reader never sees half an index.
+    // The temporary is unique so processes indexing the same demo don't write into one
+    //
+    const size_t path_length = strlen(path);
+    char *temp_path = (char *)malloc(path_length + 8);
+    if (!temp_path)
+    {
+        free(records);
+        return FRAME_INDEX_RET_OOM;
+    }
+    memcpy(temp_path, path, path_length);
+    memcpy(temp_path + path_length, ".XXXXXX", 8);
+
+    const int fd = mkstemp(temp_path);
+    if (fd < 0)
+    {
+        free(temp_path);
+        free(records);
+        return FRAME_INDEX_RET_IO_ERROR;
+    }
+
+    //
+    // mkstemp creates the file private to the user, like the demo the index is for others too
+    //
+    fchmod(fd, 0644);
+
+    FILE *file = fdopen(fd, "wb");
+    if (!file)
+    {
+        close(fd);
+        remove(temp_path);
+        free(temp_path);
+        free(records);
+        return FRAME_INDEX_RET_IO_ERROR;
+    }
+
+    const bool write_ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                          (records_size == 0 || fwrite(records, records_size, 1, file) == 1);
+    const bool close_ok = fclose(file) == 0;
+
+    free(records);
+
+    if (!write_ok || !close_ok || rename(temp_path, path) != 0)
+    {
+        remove(temp_path);
+        free(temp_path);
+        return FRAME_INDEX_RET_IO_ERROR;
+    }
+
+    free(temp_path);
+
+    return FRAME_INDEX_RET_OK;
+}
+
+int frame_index_read(FrameIndex *index, const char *path, u64 expected_file_size, u64 expected_mtime_ns)
+{
+    frame_index_free(index);
+
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        return FRAME_INDEX_RET_IO_ERROR;
+    }
+
+    FrameIndexFileHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, FRAME_INDEX_MAGIC, sizeof(header.magic)) != 0)
+    {
+        fclose(file);
+        return FRAME_INDEX_RET_INVALID;
+    }
+
+    if (header.file_size != expected_file_size || header.file_mtime_ns != expected_mtime_ns)
+    {
+        fclose(file);
+        return FRAME_INDEX_RET_STALE;
+    }
+
+    u8 *records = (u8 *)malloc((size_t)header.records_size + 1u);
+    index->entries = (FrameIndexEntry *)malloc(((size_t)header.entry_count + 1u) * sizeof(FrameIndexEntry));
+
+    if (!records || !index->entries)
+    {
+        free(records);
+        fclose(file);
+        frame_index_free(index);
+        return FRAME_INDEX_RET_OOM;
+    }
+
+    index->entry_capacity = header.entry_count + 1u;
+
+    const bool read_ok = header.records_size == 0 || fread(records, header.records_size, 1, file) == 1;
+    fclose(file);
+
+    if (!read_ok)
+    {
+        free(records);
+        frame_index_free(index);
+        return FRAME_INDEX_RET_INVALID;
+    }
+
+    size_t pos = 0;
+    u64 offset = 0;
+    u32 tick = 0;
+
+    for (u32 i = 0; i < header.entry_count; i++)
+    {
+        u64 offset_delta = 0;
+        u64 tick_zigzag = 0;
+
+        if (!read_varint64(records, header.records_size, &pos, &offset_delta) ||
+            !read_varint64(records, header.records_size, &pos, &tick_zigzag) ||
+            pos >= header.records_size)
+        {
+            free(records);
+            frame_index_free(index);
+            return FRAME_INDEX_RET_INVALID;
+        }
+
+        const i64 tick_delta = (i64)(tick_zigzag >> 1) ^ -(i64)(tick_zigzag & 1u);
+        const u8 command = records[pos++];
+
+        offset += offset_delta;
+        tick += (u32)tick_delta;
+
+        index->entries[i].offset = offset;
+        index->entries[i].tick = tick;
+        index->entries[i].command = command & (u8)~FRAME_INDEX_COMPRESSED_FLAG;
+        index->entries[i].is_compressed = (command & FRAME_INDEX_COMPRESSED_FLAG) != 0;
+    }
+
+    free(records);
+
+    index->entry_count = header.entry_count;
+    index->file_size = header.file_size;
+    index->file_mtime_ns = header.file_mtime_ns;
+
+    return frame_index_finalize(index);
+}
+
+const FrameIndexEntry *frame_index_find_keyframe(const FrameIndex *index, u32 tick)
+{
+    //
+    // Binary search for the last full packet whose tick is <= tick
+    //
+    u32 low = 0;
+    u32 high = index->full_packet_count;
+
+    while (low < high)
+    {
+        const u32 middle = low + (high - low) / 2;
+        const u32 middle_tick = index->entries[index->full_packets[middle]].tick;
+
+        if (middle_tick != FRAME_INDEX_TICK_NONE && middle_tick <= tick)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    if (low == 0)
+    {
+        return nullptr;
+    }
+
+    return &index->entries[index->full_packets[low - 1]];
+}
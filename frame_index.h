@@ -0,0 +1,64 @@
+#pragma once
+
+//
+// Tick to file offset index over the frames of a demo, built from the frame headers
+// alone. Lets the parser jump to the nearest DEMO_COMMAND_FULL_PACKET before a tick
+// instead of decoding everything in front of it. Can be persisted to a sidecar file
+// next to the demo so later runs skip the scan entirely.
+//
+
+#include "common.h"
+
+//
+// Ticks of frames written before the first server tick (signon data)
+//
+#define FRAME_INDEX_TICK_NONE 0xFFFFFFFFu
+
+typedef struct
+{
+    u64 offset;
+    u32 tick;
+    u8 command;
+    bool is_compressed;
+} FrameIndexEntry;
+
+typedef struct
+{
+    FrameIndexEntry *entries;
+    u32 entry_count;
+    u32 entry_capacity;
+    //
+    // Indices into entries of the DEMO_COMMAND_FULL_PACKET frames, in file order
+    //
+    u32 *full_packets;
+    u32 full_packet_count;
+    //
+    // Offset of the first DEMO_COMMAND_PACKET or DEMO_COMMAND_FULL_PACKET frame.
+    // Everything before it is setup data that has to be processed before seeking
+    //
+    u64 first_packet_offset;
+    //
+    // Identity of the demo the index was built from, used to reject stale sidecars
+    //
+    u64 file_size;
+    u64 file_mtime_ns;
+} FrameIndex;
+
+#define FRAME_INDEX_RET_OK 0
+#define FRAME_INDEX_RET_OOM 1
+#define FRAME_INDEX_RET_IO_ERROR 2
+#define FRAME_INDEX_RET_INVALID 3
+#define FRAME_INDEX_RET_STALE 4
+
+void frame_index_init(FrameIndex *index);
+void frame_index_free(FrameIndex *index);
+
+int frame_index_build(FrameIndex *index, const u8 *data, size_t data_size, size_t start_pos);
+
+int frame_index_write(const FrameIndex *index, const char *path);
+int frame_index_read(FrameIndex *index, const char *path, u64 expected_file_size, u64 expected_mtime_ns);
+
+//
+// Last full packet at or before tick, or nullptr if tick is before the first one
+//
+const FrameIndexEntry *frame_index_find_keyframe(const FrameIndex *index, u32 tick);
@@ -0,0 +1,115 @@
+#include "frame_prescan.h"
+#include "demo.h"
+
+//
+// The longest header is three 5 byte varints. With at least this much data left the
+// header is decoded without checking every byte against the end
+//
+#define FRAME_PRESCAN_WINDOW_BYTES 15
+
+static inline bool frame_prescan_decode_header(const u8 *window, u32 *out_values, u32 *out_header_size);
+
+int frame_prescan(const u8 *data, size_t data_size, size_t *pos, FramePrescanRecord *records, u32 max_records, u32 *out_count)
+{
+    size_t position = *pos;
+    u32 count = 0;
+    int ret_code = FRAME_PRESCAN_RET_OK;
+
+    while (count < max_records)
+    {
+        u32 values[3];
+        u32 header_size = 0;
+        u32 command;
+        bool is_compressed;
+
+        if (position + FRAME_PRESCAN_WINDOW_BYTES <= data_size && frame_prescan_decode_header(data + position, values, &header_size))
+        {
+            if (values[2] > data_size - position - header_size)
+            {
+                ret_code = FRAME_PRESCAN_RET_TRUNCATED;
+                break;
+            }
+            command = values[0] & (~DEMO_COMMAND_IS_COMPRESSED);
+            is_compressed = (values[0] & DEMO_COMMAND_IS_COMPRESSED) != 0;
+        }
+        else
+        {
+            //
+            // Near the end of the data, or a varint longer than 5 bytes which the checked
+            // reader then reports as truncated
+            //
+            size_t payload_pos = position;
+            DemoFrameHeader header;
+            const int header_ret_code = demo_read_frame_header(data, data_size, &payload_pos, &header);
+            if (header_ret_code != DEMO_FRAME_HEADER_RET_OK)
+            {
+                ret_code = (header_ret_code == DEMO_FRAME_HEADER_RET_END) ? FRAME_PRESCAN_RET_END : FRAME_PRESCAN_RET_TRUNCATED;
+                break;
+            }
+            header_size = (u32)(payload_pos - position);
+            command = header.command;
+            is_compressed = header.is_compressed;
+            values[1] = header.tick;
+            values[2] = header.size;
+        }
+
+        records[count++] = (FramePrescanRecord){
+            .offset = position,
+            .tick = values[1],
+            .size = values[2],
+            .command = (u8)command,
+            .is_compressed = is_compressed,
+            .header_size = (u8)header_size,
+        };
+
+        position += header_size + (size_t)values[2];
+
+        if (command == DEMO_COMMAND_STOP)
+        {
+            ret_code = FRAME_PRESCAN_RET_STOP;
+            break;
+        }
+    }
+
+    *pos = position;
+    *out_count = count;
+
+    return ret_code;
+}
+
+//
+// Decodes command, tick and size from a window of FRAME_PRESCAN_WINDOW_BYTES. The
+// lengths are found by branching on every byte on purpose: the branches predict well
+// since the varint lengths rarely change from one frame to the next, which lets the CPU
+// run ahead to the next header. Finding them from a mask of the continuation bits puts
+// the mask and bit scans on the dependency chain from one header to the next instead,
+// and was measured to be slower
+//
+static inline bool frame_prescan_decode_header(const u8 *window, u32 *out_values, u32 *out_header_size)
+{
+    u32 position = 0;
+
+    for (u32 i = 0; i < 3; i++)
+    {
+        u32 result = 0;
+        for (u32 shift = 0;; shift += 7)
+        {
+            if (shift == 35)
+            {
+                return false;
+            }
+
+            const u8 byte = window[position++];
+            result |= (u32)(byte & 0x7Fu) << shift;
+
+            if (!(byte & 0x80u))
+            {
+                break;
+            }
+        }
+        out_values[i] = result;
+    }
+
+    *out_header_size = position;
+    return true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+//
+// Walks the frame headers of a demo without touching the payloads, for everything that
+// needs the layout of the whole file up front (the frame index, seeking, splitting a
+// demo into parallel spans). Headers are decoded in batches into a flat record array,
+// without a call or an end of data check per byte. Headers too close to the end of the
+// data go through demo_read_frame_header, so both give the same frames.
+//
+
+#include "common.h"
+
+typedef struct
+{
+    //
+    // Offset of the frame header, the payload starts header_size bytes later
+    //
+    u64 offset;
+    u32 tick;
+    //
+    // Size of the payload as stored in the file
+    //
+    u32 size;
+    //
+    // Command with the compressed flag removed
+    //
+    u8 command;
+    bool is_compressed;
+    u8 header_size;
+} FramePrescanRecord;
+
+//
+// Records ran out, call again from *pos for more
+//
+#define FRAME_PRESCAN_RET_OK 0
+//
+// The data ends exactly after the last frame
+//
+#define FRAME_PRESCAN_RET_END 1
+//
+// A DEMO_COMMAND_STOP frame was reached, it is the last record
+//
+#define FRAME_PRESCAN_RET_STOP 2
+//
+// The last header or payload runs past the end of the data, *pos is left at its header
+//
+#define FRAME_PRESCAN_RET_TRUNCATED 3
+
+//
+// Decodes frame headers from *pos until max_records were written or the frames end.
+// *pos is left after the last recorded frame's payload
+//
+int frame_prescan(const u8 *data, size_t data_size, size_t *pos, FramePrescanRecord *records, u32 max_records, u32 *out_count);
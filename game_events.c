@@ -0,0 +1,314 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "game_events.h"
+#include "wire.h"
+
+static void game_events_resolve_subscription(GameEvents *events, u32 name_id);
+static int game_event_decode_key(const u8 *data, size_t size, Arena *arena, GameEventValue *out_value);
+
+void game_events_init(GameEvents *events)
+{
+    memset(events, 0, sizeof(*events));
+    arena_init(&events->arena, 64 * 1024);
+    string_intern_init(&events->strings);
+}
+
+void game_events_free(GameEvents *events)
+{
+    arena_free(&events->arena);
+    string_intern_free(&events->strings);
+    free(events->subscriptions);
+    events->subscriptions = nullptr;
+    events->descriptors = nullptr;
+    events->descriptor_count = 0;
+    events->subscription_count = 0;
+    events->subscription_capacity = 0;
+}
+
+int game_events_load_list(GameEvents *events, const CMsgSource1LegacyGameEventList *list)
+{
+    arena_reset(&events->arena);
+    events->descriptors = nullptr;
+    events->descriptor_count = 0;
+
+    u32 descriptor_count = 0;
+    for (size_t i = 0; i < list->n_descriptors; i++)
+    {
+        const CMsgSource1LegacyGameEventList__DescriptorT *source = list->descriptors[i];
+        if (!source->has_eventid || source->eventid < 0 || source->eventid >= GAME_EVENT_MAX_ID)
+        {
+            return GAME_EVENT_RET_MALFORMED;
+        }
+        if ((u32)source->eventid >= descriptor_count)
+        {
+            descriptor_count = (u32)source->eventid + 1;
+        }
+    }
+
+    if (descriptor_count == 0)
+    {
+        return GAME_EVENT_RET_OK;
+    }
+
+    GameEventDescriptor *descriptors = (GameEventDescriptor *)arena_alloc(&events->arena, descriptor_count * sizeof(GameEventDescriptor));
+    if (!descriptors)
+    {
+        return GAME_EVENT_RET_OOM;
+    }
+    memset(descriptors, 0, descriptor_count * sizeof(GameEventDescriptor));
+
+    for (size_t i = 0; i < list->n_descriptors; i++)
+    {
+        const CMsgSource1LegacyGameEventList__DescriptorT *source = list->descriptors[i];
+        GameEventDescriptor *descriptor = &descriptors[source->eventid];
+        const char *name = (source->name) ? source->name : "";
+
+        descriptor->event_id = (u32)source->eventid;
+        descriptor->name_id = string_intern_id(&events->strings, name, strlen(name));
+        if (descriptor->name_id == STRING_INTERN_ID_NONE)
+        {
+            return GAME_EVENT_RET_OOM;
+        }
+        descriptor->name = string_intern_string(&events->strings, descriptor->name_id);
+
+        if (source->n_keys == 0)
+        {
+            continue;
+        }
+
+        descriptor->keys = (GameEventKey *)arena_alloc(&events->arena, source->n_keys * sizeof(GameEventKey));
+        if (!descriptor->keys)
+        {
+            return GAME_EVENT_RET_OOM;
+        }
+
+        for (size_t k = 0; k < source->n_keys; k++)
+        {
+            const CMsgSource1LegacyGameEventList__KeyT *source_key = source->keys[k];
+            const char *key_name = (source_key->name) ? source_key->name : "";
+            GameEventKey *key = &descriptor->keys[k];
+
+            key->name_id = string_intern_id(&events->strings, key_name, strlen(key_name));
+            if (key->name_id == STRING_INTERN_ID_NONE)
+            {
+                return GAME_EVENT_RET_OOM;
+            }
+            key->name = string_intern_string(&events->strings, key->name_id);
+            key->type = (source_key->has_type) ? (u32)source_key->type : 0;
+        }
+        descriptor->key_count = (u32)source->n_keys;
+    }
+
+    events->descriptors = descriptors;
+    events->descriptor_count = descriptor_count;
+
+    for (u32 i = 0; i < events->subscription_count; i++)
+    {
+        game_events_resolve_subscription(events, events->subscriptions[i]);
+    }
+
+    return GAME_EVENT_RET_OK;
+}
+
+int game_events_subscribe(GameEvents *events, const char *name)
+{
+    const u32 name_id = string_intern_id(&events->strings, name, strlen(name));
+    if (name_id == STRING_INTERN_ID_NONE)
+    {
+        return GAME_EVENT_RET_OOM;
+    }
+
+    for (u32 i = 0; i < events->subscription_count; i++)
+    {
+        if (events->subscriptions[i] == name_id)
+        {
+            return GAME_EVENT_RET_OK;
+        }
+    }
+
+    if (events->subscription_count == events->subscription_capacity)
+    {
+        const u32 new_capacity = (events->subscription_capacity) ? events->subscription_capacity * 2 : 16;
+        u32 *subscriptions = (u32 *)realloc(events->subscriptions, new_capacity * sizeof(u32));
+        if (!subscriptions)
+        {
+            return GAME_EVENT_RET_OOM;
+        }
+        events->subscriptions = subscriptions;
+        events->subscription_capacity = new_capacity;
+    }
+
+    events->subscriptions[events->subscription_count++] = name_id;
+    game_events_resolve_subscription(events, name_id);
+
+    return GAME_EVENT_RET_OK;
+}
+
+//
+// Only a handful of subscriptions and a few hundred descriptors, matched once per list
+//
+static void game_events_resolve_subscription(GameEvents *events, u32 name_id)
+{
+    for (u32 i = 0; i < events->descriptor_count; i++)
+    {
+        if (events->descriptors[i].name && events->descriptors[i].name_id == name_id)
+        {
+            events->descriptors[i].subscribed = true;
+        }
+    }
+}
+
+int game_events_decode(const GameEvents *events, const u8 *data, size_t size, Arena *arena, GameEvent *out_event)
+{
+    memset(out_event, 0, sizeof(*out_event));
+
+    WireReader reader = wire_reader_create(data, size);
+    WireField field;
+    const GameEventDescriptor *descriptor = nullptr;
+
+    //
+    // Fields are written in number order, so the ID comes before any of the keys and
+    // unsubscribed events stop here
+    //
+    while (wire_reader_next(&reader, &field))
+    {
+        if (field.number != CMSG_GAME_EVENT_FIELD_EVENTID || field.wire_type != WIRE_TYPE_VARINT)
+        {
+            continue;
+        }
+
+        if (field.value >= events->descriptor_count || !events->descriptors[field.value].name)
+        {
+            return GAME_EVENT_RET_UNKNOWN_EVENT;
+        }
+
+        descriptor = &events->descriptors[field.value];
+        if (!descriptor->subscribed)
+        {
+            return GAME_EVENT_RET_SKIPPED;
+        }
+        break;
+    }
+
+    if (reader.malformed)
+    {
+        return GAME_EVENT_RET_MALFORMED;
+    }
+    if (!descriptor)
+    {
+        return GAME_EVENT_RET_UNKNOWN_EVENT;
+    }
+
+    GameEventValue *values = nullptr;
+    if (descriptor->key_count > 0)
+    {
+        values = (GameEventValue *)arena_alloc(arena, descriptor->key_count * sizeof(GameEventValue));
+        if (!values)
+        {
+            return GAME_EVENT_RET_OOM;
+        }
+        memset(values, 0, descriptor->key_count * sizeof(GameEventValue));
+    }
+
+    //
+    // Keys are positional. Extra keys beyond the descriptor are ignored and missing ones
+    // stay GAME_EVENT_VALUE_NONE
+    //
+    u32 key_index = 0;
+    reader = wire_reader_create(data, size);
+    while (wire_reader_next(&reader, &field))
+    {
+        if (field.number != CMSG_GAME_EVENT_FIELD_KEYS || field.wire_type != WIRE_TYPE_LENGTH_DELIMITED)
+        {
+            continue;
+        }
+
+        if (key_index < descriptor->key_count)
+        {
+            const int ret_code = game_event_decode_key(field.bytes.data, field.bytes.size, arena, &values[key_index]);
+            if (ret_code != GAME_EVENT_RET_OK)
+            {
+                return ret_code;
+            }
+        }
+        key_index++;
+    }
+
+    if (reader.malformed)
+    {
+        return GAME_EVENT_RET_MALFORMED;
+    }
+
+    out_event->descriptor = descriptor;
+    out_event->event_id = descriptor->event_id;
+    out_event->name = descriptor->name;
+    out_event->values = values;
+    out_event->value_count = descriptor->key_count;
+
+    return GAME_EVENT_RET_OK;
+}
+
+//
+// Strings are copied and terminated, the message buffer is only lent to the dispatcher's
+// handlers
+//
+static int game_event_decode_key(const u8 *data, size_t size, Arena *arena, GameEventValue *out_value)
+{
+    WireReader reader = wire_reader_create(data, size);
+    WireField field;
+
+    while (wire_reader_next(&reader, &field))
+    {
+        switch (field.number)
+        {
+        case CMSG_GAME_EVENT_KEY_FIELD_VAL_STRING:
+        {
+            out_value->kind = GAME_EVENT_VALUE_STRING;
+            char *string = (char *)arena_alloc(arena, field.bytes.size + 1);
+            if (!string)
+            {
+                return GAME_EVENT_RET_OOM;
+            }
+            memcpy(string, field.bytes.data, field.bytes.size);
+            string[field.bytes.size] = '\0';
+            out_value->string_value = string;
+            break;
+        }
+        case CMSG_GAME_EVENT_KEY_FIELD_VAL_FLOAT:
+            out_value->kind = GAME_EVENT_VALUE_FLOAT;
+            out_value->float_value = wire_value_to_f32(field.value);
+            break;
+        case CMSG_GAME_EVENT_KEY_FIELD_VAL_LONG:
+        case CMSG_GAME_EVENT_KEY_FIELD_VAL_SHORT:
+        case CMSG_GAME_EVENT_KEY_FIELD_VAL_BYTE:
+            out_value->kind = GAME_EVENT_VALUE_INT;
+            out_value->int_value = (i32)field.value;
+            break;
+        case CMSG_GAME_EVENT_KEY_FIELD_VAL_BOOL:
+            out_value->kind = GAME_EVENT_VALUE_BOOL;
+            out_value->bool_value = field.value != 0;
+            break;
+        case CMSG_GAME_EVENT_KEY_FIELD_VAL_UINT64:
+            out_value->kind = GAME_EVENT_VALUE_UINT64;
+            out_value->uint64_value = field.value;
+            break;
+        default:
+            break;
+        }
+    }
+
+    return (reader.malformed) ? GAME_EVENT_RET_MALFORMED : GAME_EVENT_RET_OK;
+}
+
+u32 game_event_descriptor_find_key(const GameEventDescriptor *descriptor, const char *name)
+{
+    for (u32 i = 0; i < descriptor->key_count; i++)
+    {
+        if (strcmp(descriptor->keys[i].name, name) == 0)
+        {
+            return i;
+        }
+    }
+    return GAME_EVENT_KEY_NONE;
+}
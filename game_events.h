@@ -0,0 +1,183 @@
+#pragma once
+
+//
+// Source 1 style game events (player_death, round_end, bomb_planted, ...). The server
+// sends CMsgSource1LegacyGameEventList once per demo, describing every event it may
+// fire: its ID, name and the names and types of its keys. Each event fired is then a
+// CMsgSource1LegacyGameEvent carrying only the event ID and key values, positionally.
+//
+// The list is turned into a dense table indexed by event ID. Consumers subscribe by
+// event name, before or after the list arrived. An incoming event is scanned up to its
+// ID and dropped right there unless somebody subscribed to it, so the hundreds of
+// events nobody asked for never have their key lists decoded. Subscribed events are
+// decoded into a flat record of typed values in descriptor key order.
+//
+
+#include "common.h"
+#include "arena.h"
+#include "string_intern.h"
+
+#include "protos/gameevents.pb-c.h"
+
+//
+// EBaseGameEvents
+//
+#define GAME_EVENT_MESSAGE_LIST 205
+#define GAME_EVENT_MESSAGE_EVENT 207
+
+//
+// CMsgSource1LegacyGameEvent
+//
+#define CMSG_GAME_EVENT_FIELD_EVENT_NAME 1
+#define CMSG_GAME_EVENT_FIELD_EVENTID 2
+#define CMSG_GAME_EVENT_FIELD_KEYS 3
+
+//
+// CMsgSource1LegacyGameEvent.key_t
+//
+#define CMSG_GAME_EVENT_KEY_FIELD_TYPE 1
+#define CMSG_GAME_EVENT_KEY_FIELD_VAL_STRING 2
+#define CMSG_GAME_EVENT_KEY_FIELD_VAL_FLOAT 3
+#define CMSG_GAME_EVENT_KEY_FIELD_VAL_LONG 4
+#define CMSG_GAME_EVENT_KEY_FIELD_VAL_SHORT 5
+#define CMSG_GAME_EVENT_KEY_FIELD_VAL_BYTE 6
+#define CMSG_GAME_EVENT_KEY_FIELD_VAL_BOOL 7
+#define CMSG_GAME_EVENT_KEY_FIELD_VAL_UINT64 8
+
+//
+// Key types of the descriptor list. CS2 adds a few entity handle types past these,
+// which arrive as val_long or val_short and decode as integers
+//
+#define GAME_EVENT_KEY_TYPE_STRING 1
+#define GAME_EVENT_KEY_TYPE_FLOAT 2
+#define GAME_EVENT_KEY_TYPE_LONG 3
+#define GAME_EVENT_KEY_TYPE_SHORT 4
+#define GAME_EVENT_KEY_TYPE_BYTE 5
+#define GAME_EVENT_KEY_TYPE_BOOL 6
+#define GAME_EVENT_KEY_TYPE_UINT64 7
+
+//
+// What a decoded value holds, picked from the val_* field that was present
+//
+#define GAME_EVENT_VALUE_NONE 0
+#define GAME_EVENT_VALUE_STRING 1
+#define GAME_EVENT_VALUE_FLOAT 2
+#define GAME_EVENT_VALUE_INT 3
+#define GAME_EVENT_VALUE_BOOL 4
+#define GAME_EVENT_VALUE_UINT64 5
+
+//
+// Event IDs are small and dense in practice, larger ones are taken as corruption
+//
+#define GAME_EVENT_MAX_ID 4096
+
+#define GAME_EVENT_KEY_NONE 0xFFFFFFFFu
+
+#define GAME_EVENT_RET_OK 0
+#define GAME_EVENT_RET_OOM 1
+#define GAME_EVENT_RET_MALFORMED 2
+#define GAME_EVENT_RET_SKIPPED 3
+#define GAME_EVENT_RET_UNKNOWN_EVENT 4
+
+typedef struct
+{
+    const char *name;
+    u32 name_id;
+    //
+    // One of GAME_EVENT_KEY_TYPE_*
+    //
+    u32 type;
+} GameEventKey;
+
+typedef struct
+{
+    //
+    // nullptr for IDs the list didn't describe
+    //
+    const char *name;
+    u32 name_id;
+    u32 event_id;
+    GameEventKey *keys;
+    u32 key_count;
+    bool subscribed;
+} GameEventDescriptor;
+
+typedef struct
+{
+    //
+    // One of GAME_EVENT_VALUE_*
+    //
+    u32 kind;
+    union
+    {
+        const char *string_value;
+        f32 float_value;
+        i32 int_value;
+        bool bool_value;
+        u64 uint64_value;
+    };
+} GameEventValue;
+
+//
+// values[i] belongs to descriptor->keys[i]
+//
+typedef struct
+{
+    const GameEventDescriptor *descriptor;
+    u32 event_id;
+    const char *name;
+    const GameEventValue *values;
+    u32 value_count;
+} GameEvent;
+
+typedef struct
+{
+    //
+    // Descriptors and their keys, reset when a new list arrives
+    //
+    Arena arena;
+    //
+    // Event and key names. Subscriptions are kept as name IDs so they survive a new list
+    //
+    StringIntern strings;
+
+    //
+    // Indexed by event ID
+    //
+    GameEventDescriptor *descriptors;
+    u32 descriptor_count;
+
+    u32 *subscriptions;
+    u32 subscription_count;
+    u32 subscription_capacity;
+} GameEvents;
+
+void game_events_init(GameEvents *events);
+void game_events_free(GameEvents *events);
+
+//
+// Builds the descriptor table, replacing a previous one, and resolves subscriptions
+//
+int game_events_load_list(GameEvents *events, const CMsgSource1LegacyGameEventList *list);
+
+//
+// Subscribing to a name the list doesn't have isn't an error, it's just never delivered
+//
+int game_events_subscribe(GameEvents *events, const char *name);
+
+static inline bool game_events_has_subscriptions(const GameEvents *events)
+{
+    return events->subscription_count > 0;
+}
+
+//
+// Decodes a CMsgSource1LegacyGameEvent into out_event. Values and strings are allocated
+// from arena. Returns GAME_EVENT_RET_SKIPPED without touching the keys when nobody
+// subscribed to the event
+//
+int game_events_decode(const GameEvents *events, const u8 *data, size_t size, Arena *arena, GameEvent *out_event);
+
+//
+// Index of the key called name, GAME_EVENT_KEY_NONE when the event has none
+//
+u32 game_event_descriptor_find_key(const GameEventDescriptor *descriptor, const char *name);
@@ -0,0 +1,119 @@
+#pragma once
+
+//
+// XXH64. Used to key on-disk caches by the content they were built from
+//
+
+#include <string.h>
+
+#include "common.h"
+
+#define HASH_XXH64_PRIME1 11400714785074694791ull
+#define HASH_XXH64_PRIME2 14029467366897019727ull
+#define HASH_XXH64_PRIME3 1609587929392839161ull
+#define HASH_XXH64_PRIME4 9650029242287828579ull
+#define HASH_XXH64_PRIME5 2870177450012600261ull
+
+static inline u64 hash_rotl64(u64 value, u32 bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline u64 hash_read_u64(const u8 *data)
+{
+    u64 value;
+    memcpy(&value, data, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap64(value);
+#endif
+    return value;
+}
+
+static inline u32 hash_read_u32(const u8 *data)
+{
+    u32 value;
+    memcpy(&value, data, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap32(value);
+#endif
+    return value;
+}
+
+static inline u64 hash_xxh64_round(u64 accumulator, u64 input)
+{
+    accumulator += input * HASH_XXH64_PRIME2;
+    accumulator = hash_rotl64(accumulator, 31);
+    return accumulator * HASH_XXH64_PRIME1;
+}
+
+static inline u64 hash_xxh64_merge(u64 accumulator, u64 value)
+{
+    accumulator ^= hash_xxh64_round(0, value);
+    return accumulator * HASH_XXH64_PRIME1 + HASH_XXH64_PRIME4;
+}
+
+static inline u64 hash_xxh64(const void *input, size_t size, u64 seed)
+{
+    const u8 *data = (const u8 *)input;
+    const u8 *end = data + size;
+    u64 hash;
+
+    if (size >= 32)
+    {
+        u64 v1 = seed + HASH_XXH64_PRIME1 + HASH_XXH64_PRIME2;
+        u64 v2 = seed + HASH_XXH64_PRIME2;
+        u64 v3 = seed;
+        u64 v4 = seed - HASH_XXH64_PRIME1;
+
+        const u8 *limit = end - 32;
+        do
+        {
+            v1 = hash_xxh64_round(v1, hash_read_u64(data));
+            v2 = hash_xxh64_round(v2, hash_read_u64(data + 8));
+            v3 = hash_xxh64_round(v3, hash_read_u64(data + 16));
+            v4 = hash_xxh64_round(v4, hash_read_u64(data + 24));
+            data += 32;
+        } while (data <= limit);
+
+        hash = hash_rotl64(v1, 1) + hash_rotl64(v2, 7) + hash_rotl64(v3, 12) + hash_rotl64(v4, 18);
+        hash = hash_xxh64_merge(hash, v1);
+        hash = hash_xxh64_merge(hash, v2);
+        hash = hash_xxh64_merge(hash, v3);
+        hash = hash_xxh64_merge(hash, v4);
+    }
+    else
+    {
+        hash = seed + HASH_XXH64_PRIME5;
+    }
+
+    hash += (u64)size;
+
+    while (end - data >= 8)
+    {
+        hash ^= hash_xxh64_round(0, hash_read_u64(data));
+        hash = hash_rotl64(hash, 27) * HASH_XXH64_PRIME1 + HASH_XXH64_PRIME4;
+        data += 8;
+    }
+
+    if (end - data >= 4)
+    {
+        hash ^= (u64)hash_read_u32(data) * HASH_XXH64_PRIME1;
+        hash = hash_rotl64(hash, 23) * HASH_XXH64_PRIME2 + HASH_XXH64_PRIME3;
+        data += 4;
+    }
+
+    while (data < end)
+    {
+        hash ^= (u64)(*data) * HASH_XXH64_PRIME5;
+        hash = hash_rotl64(hash, 11) * HASH_XXH64_PRIME1;
+        data++;
+    }
+
+    hash ^= hash >> 33;
+    hash *= HASH_XXH64_PRIME2;
+    hash ^= hash >> 29;
+    hash *= HASH_XXH64_PRIME3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
@@ -0,0 +1,246 @@
+#define _GNU_SOURCE
+
+#include <stdalign.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+#include "live_file.h"
+
+#define LIVE_FILE_MIN_ALLOCATION (16 * 1024 * 1024)
+#define LIVE_FILE_MIN_READ (64 * 1024)
+
+static int live_file_append(LiveFile *file);
+static bool live_file_reserve(LiveFile *file, size_t free_size);
+
+int live_file_open(LiveFile *file, const char *path)
+{
+    memset(file, 0, sizeof(*file));
+    file->fd = -1;
+    file->inotify_fd = -1;
+
+    const bool is_stdin = (strcmp(path, "-") == 0);
+    file->fd = is_stdin ? STDIN_FILENO : open(path, O_RDONLY | O_CLOEXEC);
+    if (file->fd < 0)
+    {
+        return LIVE_FILE_RET_OPEN_ERROR;
+    }
+
+    struct stat file_stat;
+    if (fstat(file->fd, &file_stat) != 0)
+    {
+        live_file_close(file);
+        return LIVE_FILE_RET_OPEN_ERROR;
+    }
+
+    file->is_stream = !S_ISREG(file_stat.st_mode);
+
+    if (!file->is_stream)
+    {
+        //
+        // Without inotify the file is polled, which only costs latency
+        //
+        file->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (file->inotify_fd >= 0 && inotify_add_watch(file->inotify_fd, path, IN_MODIFY | IN_CLOSE_WRITE) < 0)
+        {
+            close(file->inotify_fd);
+            file->inotify_fd = -1;
+        }
+    }
+
+    return LIVE_FILE_RET_OK;
+}
+
+void live_file_close(LiveFile *file)
+{
+    if (file->inotify_fd >= 0)
+    {
+        close(file->inotify_fd);
+    }
+    if (file->fd >= 0 && file->fd != STDIN_FILENO)
+    {
+        close(file->fd);
+    }
+    free(file->data);
+
+    file->fd = -1;
+    file->inotify_fd = -1;
+    file->data = nullptr;
+    file->data_size = 0;
+    file->data_capacity = 0;
+}
+
+int live_file_read(LiveFile *file)
+{
+    if (!file->is_stream)
+    {
+        return live_file_append(file);
+    }
+
+    //
+    // A read on a pipe with nothing in it would block, only read what poll says is there
+    //
+    while (!file->is_closed && !(file->window_size > 0 && file->data_size == file->data_capacity))
+    {
+        struct pollfd poll_fd = { .fd = file->fd, .events = POLLIN };
+        const int poll_ret = poll(&poll_fd, 1, 0);
+        if (poll_ret < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (poll_ret <= 0)
+        {
+            return (poll_ret == 0) ? LIVE_FILE_RET_OK : LIVE_FILE_RET_READ_ERROR;
+        }
+
+        const int ret_code = live_file_append(file);
+        if (ret_code != LIVE_FILE_RET_OK)
+        {
+            return ret_code;
+        }
+    }
+
+    return LIVE_FILE_RET_OK;
+}
+
+int live_file_set_window(LiveFile *file, size_t window_size)
+{
+    u8 *data = (u8 *)realloc(file->data, window_size);
+    if (!data)
+    {
+        return LIVE_FILE_RET_OOM;
+    }
+
+    file->data = data;
+    file->data_capacity = window_size;
+    file->window_size = window_size;
+    return LIVE_FILE_RET_OK;
+}
+
+void live_file_discard(LiveFile *file, size_t size)
+{
+    memmove(file->data, file->data + size, file->data_size - size);
+    file->data_size -= size;
+    file->data_offset += size;
+}
+
+int live_file_wait(LiveFile *file, int timeout_ms)
+{
+    if (file->is_closed)
+    {
+        return LIVE_FILE_RET_CLOSED;
+    }
+
+    const int wait_fd = (file->is_stream) ? file->fd : file->inotify_fd;
+
+    if (wait_fd < 0)
+    {
+        const int sleep_ms = (timeout_ms < LIVE_FILE_POLL_INTERVAL_MS) ? timeout_ms : LIVE_FILE_POLL_INTERVAL_MS;
+        const struct timespec sleep_time = { sleep_ms / 1000, (long)(sleep_ms % 1000) * 1000000L };
+        nanosleep(&sleep_time, nullptr);
+        return LIVE_FILE_RET_OK;
+    }
+
+    struct pollfd poll_fd = { .fd = wait_fd, .events = POLLIN };
+    const int poll_ret = poll(&poll_fd, 1, timeout_ms);
+    if (poll_ret < 0)
+    {
+        return (errno == EINTR) ? LIVE_FILE_RET_OK : LIVE_FILE_RET_READ_ERROR;
+    }
+    if (poll_ret == 0)
+    {
+        return LIVE_FILE_RET_TIMEOUT;
+    }
+
+    //
+    // Only the wakeup matters, the events themselves are drained and dropped
+    //
+    if (!file->is_stream)
+    {
+        alignas(struct inotify_event) char events[4096];
+        while (read(file->inotify_fd, events, sizeof(events)) > 0)
+        {
+        }
+    }
+
+    return LIVE_FILE_RET_OK;
+}
+
+//
+// Reads until the current end of a regular file, or once from a pipe
+//
+static int live_file_append(LiveFile *file)
+{
+    while (true)
+    {
+        if (file->window_size > 0)
+        {
+            if (file->data_size == file->data_capacity)
+            {
+                return LIVE_FILE_RET_OK;
+            }
+        }
+        else if (!live_file_reserve(file, LIVE_FILE_MIN_READ))
+        {
+            return LIVE_FILE_RET_OOM;
+        }
+
+        const ssize_t ret = read(file->fd, file->data + file->data_size, file->data_capacity - file->data_size);
+
+        if (ret == 0)
+        {
+            //
+            // End of a regular file is only where the writer currently is
+            //
+            file->is_closed = file->is_stream;
+            return LIVE_FILE_RET_OK;
+        }
+
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return LIVE_FILE_RET_READ_ERROR;
+        }
+
+        file->data_size += (size_t)ret;
+
+        if (file->is_stream)
+        {
+            return LIVE_FILE_RET_OK;
+        }
+    }
+}
+
+static bool live_file_reserve(LiveFile *file, size_t free_size)
+{
+    if (file->data_capacity - file->data_size >= free_size)
+    {
+        return true;
+    }
+
+    size_t new_capacity = (file->data_capacity) ? file->data_capacity * 2 : LIVE_FILE_MIN_ALLOCATION;
+    while (new_capacity - file->data_size < free_size)
+    {
+        new_capacity *= 2;
+    }
+
+    u8 *data = (u8 *)realloc(file->data, new_capacity);
+    if (!data)
+    {
+        return false;
+    }
+
+    file->data = data;
+    file->data_capacity = new_capacity;
+    return true;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+//
+// Follows a demo file while the server is still recording it. The bytes written so far
+// are kept in one growing heap buffer and each read only appends what was written
+// since the previous one, so nothing is read or parsed twice. Waiting for more uses
+// inotify on regular files, with polling as the fallback, and poll on pipes.
+//
+// With a window the buffer is allocated once and reads stop while it's full. The caller
+// discards what it's done with to make room, so memory stays the same however long the
+// demo gets.
+//
+
+#include "common.h"
+
+#define LIVE_FILE_RET_OK 0
+#define LIVE_FILE_RET_OPEN_ERROR 1
+#define LIVE_FILE_RET_READ_ERROR 2
+#define LIVE_FILE_RET_OOM 3
+#define LIVE_FILE_RET_TIMEOUT 4
+//
+// The writer closed the pipe, nothing more will arrive
+//
+#define LIVE_FILE_RET_CLOSED 5
+
+//
+// Interval of the fallback when inotify isn't available
+//
+#define LIVE_FILE_POLL_INTERVAL_MS 20
+
+typedef struct
+{
+    int fd;
+    bool is_stream;
+    bool is_closed;
+    //
+    // -1 when not watching with inotify
+    //
+    int inotify_fd;
+
+    u8 *data;
+    size_t data_size;
+    size_t data_capacity;
+    //
+    // 0 to grow data with the file. Offset of data in the file once bytes were discarded
+    //
+    size_t window_size;
+    u64 data_offset;
+} LiveFile;
+
+//
+// path "-" follows stdin
+//
+int live_file_open(LiveFile *file, const char *path);
+void live_file_close(LiveFile *file);
+
+//
+// Appends whatever was written since the last call, without blocking. data may move
+//
+int live_file_read(LiveFile *file);
+
+//
+// Reads into a window_size buffer from now on, call before the first read
+//
+int live_file_set_window(LiveFile *file, size_t window_size);
+
+//
+// Drops the first size bytes of data, moving the rest to the front
+//
+void live_file_discard(LiveFile *file, size_t size);
+
+//
+// Blocks until the file may have grown or timeout_ms passed, LIVE_FILE_RET_TIMEOUT then
+//
+int live_file_wait(LiveFile *file, int timeout_ms);
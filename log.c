@@ -0,0 +1,17 @@
+#include <stdarg.h>
+
+#include "common.h"
+
+thread_local LogSink log_sink = { nullptr, nullptr, LOG_LEVEL_INFO };
+
+void log_write(int level, const char *format, ...)
+{
+    char message[1024];
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    log_sink.handler(log_sink.user_data, level, message);
+}
@@ -1,119 +1,277 @@
+#define _GNU_SOURCE
+
+//
+// Command line front end of libdemoparser. Maps or reads the demo, decompresses it
+// when it's a .zst, .gz or .bz2 archive, drives the parser in push mode and prints its
+// events as text.
+//
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <assert.h>
 #include <string.h>
-#include <byteswap.h>
-
-#include <snappy-c.h>
-
-#include "protos/demo.pb-c.h"
-#include "protos/netmessages.pb-c.h"
-
-#define u8 uint8_t
-#define i8 int8_t
-#define u16 uint16_t
-#define i16 int16_t
-#define u32 uint32_t
-#define i32 int32_t
-#define u64 uint64_t
-#define i64 int64_t
-
-#define DEMO_COMMAND_ERROR -1
-#define DEMO_COMMAND_STOP 0
-#define DEMO_COMMAND_FILE_HEADER 1
-#define DEMO_COMMAND_FILE_INFO 2
-#define DEMO_COMMAND_SYNC_TICK 3
-#define DEMO_COMMAND_SEND_TABLES 4
-#define DEMO_COMMAND_CLASS_INFO 5
-#define DEMO_COMMAND_STRING_TABLES 6
-#define DEMO_COMMAND_PACKET 7
-#define DEMO_COMMAND_SIGNON_PACKET 8
-#define DEMO_COMMAND_CONSOLE_CMD 9
-#define DEMO_COMMAND_CUSTOM_DATA 10
-#define DEMO_COMMAND_CUSTOM_DATA_CALLBACKS 11
-#define DEMO_COMMAND_USER_CMD 12
-#define DEMO_COMMAND_FULL_PACKET 13
-#define DEMO_COMMAND_SAVE_GAME 14
-#define DEMO_COMMAND_MAX 15
-#define DEMO_COMMAND_IS_COMPRESSED 112
-
-#define UNUSED(a) (void)a
-
-#define log_info printf
-#define log_err printf
-#define log_warn printf
-#define log_debug printf
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "demoparser.h"
+#include "serializer_cache.h"
+#include "batch.h"
+#include "parallel.h"
+#include "live_file.h"
+#include "archive_file.h"
+#include "arrow_export.h"
+#include "result_cache.h"
+#include "hash.h"
 
 #define APP_NAME "demo_parser"
 
-typedef struct
-{
-    char *data;
-    u32 type;
-    u32 data_size;
-} DemoPacket;
+#define MAX_GAME_EVENTS 64
+#define MAX_QUERY_NAMES 64
+
+//
+// --memory-budget is split between the read window and the frame decompression buffer,
+// a quarter and an eighth of it. The rest is for the parser's state, which grows with
+// the game rather than the length of the demo
+//
+#define MEMORY_BUDGET_MIN (32 * 1024 * 1024)
+#define MEMORY_BUDGET_WINDOW_DIVISOR 4
+#define MEMORY_BUDGET_FRAME_DIVISOR 8
+
+//
+// Part of the key of every --result-cache entry. Bump it whenever the printed output
+// changes, so entries stored by older builds stop matching
+//
+#define RESULT_CONFIG_VERSION 2
 
+#define STATS_FORMAT_NONE 0
+#define STATS_FORMAT_TEXT 1
+#define STATS_FORMAT_JSON 2
+
+//
+// Backing storage for a demo. Regular files are memory mapped read-only so that
+// packets can point directly into the page cache. Pipes and stdin can't be mapped
+// and are streamed into a heap buffer instead. In batch mode the demo may already
+// have been read ahead into a buffer the batch keeps ownership of. Archives are opened
+// the same way and decompressed from this buffer.
+//
 typedef struct
 {
     u8 *data;
     size_t data_size;
-    size_t pos;
-
-    // DemoPacket packet;
-    char *uncompressed_buffer;
-    size_t uncompressed_buffer_size;
-} Parser;
+    //
+    // Zero when streamed
+    //
+    u64 mtime_ns;
+    bool is_mapped;
+    bool is_borrowed;
+} DemoFile;
 
 typedef struct
 {
-    char magic[8];
-    u32 summary_offset;
-    u32 packet_offset;
-} DemoHeader;
+    //
+    // Decompression threads per demo, 0 to decompress on the parsing thread
+    //
+    u32 thread_count;
+    bool write_index;
+    bool has_seek_tick;
+    u32 seek_tick;
+    const char *serializer_cache_directory;
+    //
+    // Game events to print, split out of the comma separated --game-events list
+    //
+    const char *game_events[MAX_GAME_EVENTS];
+    u32 game_event_count;
+    //
+    // Parse spans between full packets on thread_count threads
+    //
+    bool parallel;
+    //
+    // Follow a demo that is still being recorded. Gives up after follow_idle_seconds
+    // without new data, 0 to wait for the stop frame however long it takes
+    //
+    bool follow;
+    u32 follow_idle_seconds;
+    //
+    // One of STATS_FORMAT_*
+    //
+    u32 stats_format;
+    //
+    // Predicates pushed down into the parser, from --ticks, --commands, --messages,
+    // --entity-classes and --fields. The lists below back the query's pointers
+    //
+    DemoQuery query;
+    u32 message_ids[MAX_QUERY_NAMES];
+    const char *entity_classes[MAX_QUERY_NAMES];
+    const char *entity_fields[MAX_QUERY_NAMES];
+    //
+    // Write events as Arrow tables into this directory instead of printing them. With
+    // export_changes, entity fields as a change log with keyframes at full packets
+    //
+    const char *export_directory;
+    bool export_changes;
+    //
+    // Bytes per demo, 0 for no budget. Demos are streamed through a fixed window rather
+    // than mapped or read whole
+    //
+    size_t memory_budget;
+    //
+    // Answer demos parsed before from the cache, directory nullptr for none. The config
+    // hash covers every option that shapes the output, see hash_result_config
+    //
+    ResultCache result_cache;
+    u64 result_config_hash;
+} ParseOptions;
 
+//
+// A demo parsed while it's still arriving, either a file the server is recording or an
+// archive being decompressed on another thread. Exactly one of the sources is set
+//
 typedef struct
 {
-    u8 *data;
+    LiveFile *live_file;
+    ArchiveFile *archive_file;
+    u32 idle_seconds;
     //
-    // Size in bits
+    // The file is already complete, its end is the end of the demo
     //
-    size_t size;
+    bool is_complete;
     //
-    // Position in bits
+    // Everything that arrived so far, may move whenever more arrives. With a window,
+    // what arrived from data_offset on
     //
-    size_t pos;
-} Bitstream;
+    const u8 *data;
+    size_t data_size;
+    size_t data_offset;
+    size_t window_size;
+} DemoStream;
 
+#define DEMO_STREAM_RET_OK 0
 //
-// Forward declarations
+// Nothing more will arrive
 //
+#define DEMO_STREAM_RET_END 1
+#define DEMO_STREAM_RET_TIMEOUT 2
+#define DEMO_STREAM_RET_OOM 3
+#define DEMO_STREAM_RET_ERROR 4
 
-static void print_usage();
-
-static void parser_init(Parser *parser);
-
-#define PARSER_NEXT_PACKET_RET_OK 0
-#define PARSER_NEXT_PACKET_RET_END 1
-#define PARSER_NEXT_PACKET_RET_DECOMPRESS_ERROR 2
-#define PARSER_NEXT_PACKET_RET_OOM 3
+//
+// What print_entity_column needs to print one value of an entity event
+//
+typedef struct
+{
+    FILE *output;
+    const DemoEntityEvent *entity_event;
+} EntityPrintContext;
 
-static int parser_next_packet(Parser *parser, DemoPacket *out_packet);
-static u32 parser_read_varint32(Parser *parser);
+//
+// Text output of one span of a --parallel parse
+//
+typedef struct
+{
+    FILE *stream;
+    char *text;
+    size_t text_size;
+} SpanOutput;
 
-static u32 read_varint32(const u8 *data, u32 *read);
-static const char *demo_command_to_string(int command);
+//
+// Merge state of a --parallel parse
+//
+typedef struct
+{
+    FILE *output;
+    //
+    // Result of the first span that failed, DEMO_PARSER_RET_OK while none did
+    //
+    int result;
+} ParallelMerge;
 
-static void demo_header_to_string(DemoHeader header);
+typedef struct
+{
+    ParseOptions parse_options;
+    //
+    // Where the per-demo logs go, nullptr to write them next to the demos
+    //
+    const char *output_directory;
+    //
+    // One of BATCH_READ_*
+    //
+    int read_mode;
+} BatchOptions;
 
-static void bitstream_init(Bitstream *bitstream, u8 *data, size_t data_size_bytes);
-static Bitstream bitstream_create(u8 *data, size_t data_size_bytes);
-static u32 bitstream_read_u32(Bitstream *stream, size_t bit_count);
+//
+// Forward declarations
+//
 
-static u32 read_valve_var_uint(Bitstream *stream);
+static void print_usage();
 
-static int process_demo_packet(DemoPacket packet);
-static int handle_packet(u32 packet_id);
+#define DEMO_FILE_OPEN_RET_OK 0
+#define DEMO_FILE_OPEN_RET_OPEN_ERROR 1
+#define DEMO_FILE_OPEN_RET_READ_ERROR 2
+#define DEMO_FILE_OPEN_RET_OOM 3
+
+static int demo_file_open(DemoFile *demo_file, const char *path);
+static int demo_file_read_stream(DemoFile *demo_file, int fd);
+static void demo_file_close(DemoFile *demo_file);
+
+static int load_frame_index(FrameIndex *index, const DemoFile *demo_file, const char *demo_path, bool read_sidecar, bool write_sidecar, FILE *output);
+
+static void print_log_message(void *user_data, int level, const char *message);
+static int print_event(void *user_data, const DemoEvent *event);
+static void print_game_event(FILE *output, u32 tick, const GameEvent *game_event);
+static void print_entity_event(FILE *output, u32 tick, const DemoEntityEvent *entity_event);
+static void print_entity_column(void *user_data, const char *name, u32 column, const FieldDecoder *decoder);
+static void print_entity_value(FILE *output, const char *name, const EntityValue *value, const FieldDecoder *decoder);
+static u32 split_names(char *names, const char **out_names, u32 max_count);
+
+static void set_parser_query(DemoParserOptions *parser_options, const ParseOptions *options);
+static bool wants_entity_events(const ParseOptions *options);
+static bool parse_tick_range(const char *text, DemoQuery *query);
+static bool parse_command_mask(char *text, DemoQuery *query);
+static bool parse_message_ids(char *text, ParseOptions *options);
+static bool query_name_equal(const char *a, const char *b);
+
+static void start_parallel_span(void *user_data, DemoSpan *span, DemoParserOptions *parser_options);
+static int print_parallel_span_event(void *user_data, DemoSpan *span, const DemoEvent *event);
+static int merge_parallel_span(void *user_data, DemoSpan *span);
+static bool load_cached_serializers(void *user_data, u64 key, EntityEngine *engine);
+static void store_cached_serializers(void *user_data, u64 key, const EntityEngine *engine);
+
+#define PARSE_DEMO_RET_OK 0
+#define PARSE_DEMO_RET_OPEN_ERROR 1
+#define PARSE_DEMO_RET_INVALID 2
+#define PARSE_DEMO_RET_OOM 3
+#define PARSE_DEMO_RET_THREAD_ERROR 4
+
+static int parse_demo(const char *demo_path, const ParseOptions *options, FILE *output);
+static int parse_demo_cached(const char *demo_path, const BatchJob *job, const ParseOptions *options, FILE *output);
+static int parse_demo_source(const char *demo_path, const BatchJob *job, const ParseOptions *options, FILE *output);
+static u64 hash_result_config(const ParseOptions *options);
+static int parse_demo_file(DemoFile *demo_file, const char *demo_path, const ParseOptions *options, FILE *output);
+static int parse_demo_archive(DemoFile *demo_file, int archive_format, const char *demo_path, const ParseOptions *options, FILE *output);
+static int parse_demo_live(const char *demo_path, const ParseOptions *options, FILE *output);
+static int parse_demo_stream(DemoStream *stream, const ParseOptions *options, FILE *output);
+static int parse_demo_result(int parser_ret_code);
+static int wait_for_demo_data(DemoStream *stream);
+static int wait_for_live_data(DemoStream *stream);
+static int wait_for_archive_data(DemoStream *stream);
+static void discard_demo_data(DemoStream *stream, size_t offset);
+static void print_peak_memory(size_t budget, FILE *output);
+static void print_parse_stats(const ParseStats *stats, u32 stats_format, FILE *output);
+static ArrowExport *open_export(const ParseOptions *options, const EntityEngine *entities, FILE *output);
+static int close_export(ArrowExport *arrow_export, FILE *output);
+static int parse_demo_parallel(const DemoFile *demo_file, const FrameIndex *frame_index, const ParseOptions *options, FILE *output);
+static int parse_batch_demo(void *user_data, u32 worker_index, BatchJob *job);
+static int run_batch(char **paths, u32 path_count, u32 thread_count, const BatchOptions *batch_options);
 
 static size_t min_uint(size_t a, size_t b);
 static size_t max_uint(size_t a, size_t b);
@@ -122,598 +280,1919 @@ static size_t max_uint(size_t a, size_t b);
 // Implementations
 //
 
-static void demo_header_to_string(DemoHeader header)
-{
-    log_debug("Magic:          %s\n", header.magic);
-    log_debug("Summary offset: %u\n", header.summary_offset);
-    log_debug("Packet offset:  %u\n", header.packet_offset);
-}
-
-static void bitstream_init(Bitstream *bitstream, u8 *data, size_t data_size_bytes)
-{
-    bitstream->data = data;
-    bitstream->size = data_size_bytes * 8;
-    bitstream->pos = 0;
-}
-
-static Bitstream bitstream_create(u8 *data, size_t data_size_bytes)
+static int demo_file_open(DemoFile *demo_file, const char *path)
 {
-    Bitstream result = {
-        data,
-        data_size_bytes * 8,
-        0};
-    return result;
-}
+    demo_file->data = nullptr;
+    demo_file->data_size = 0;
+    demo_file->mtime_ns = 0;
+    demo_file->is_mapped = false;
+    demo_file->is_borrowed = false;
 
-static u32 bitstream_read_u32(Bitstream *stream, size_t bit_count)
-{
-    assert(bit_count <= 32);
+    const bool is_stdin = (strcmp(path, "-") == 0);
+    const int fd = is_stdin ? STDIN_FILENO : open(path, O_RDONLY | O_CLOEXEC);
 
-    size_t byte_pos = stream->pos / 8u;
-    size_t bit_pos = stream->pos % 8u;
-    size_t dst_i = 0;
-    u32 result = 0;
+    if (fd < 0)
+    {
+        return DEMO_FILE_OPEN_RET_OPEN_ERROR;
+    }
 
-    for (size_t i = 0; i < bit_count; i++)
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0)
     {
-        const u32 bit_mask = 1 << bit_pos;
-        const u32 set_bit = ((u32)stream->data[byte_pos]) & bit_mask;
-        result |= (set_bit << dst_i);
-        dst_i++;
-        //
-        // TODO: Remove branch
-        //
-        if (bit_pos == 7)
+        if (!is_stdin)
         {
-            bit_pos = 0;
-            byte_pos++;
+            close(fd);
         }
-        else
+        return DEMO_FILE_OPEN_RET_OPEN_ERROR;
+    }
+
+    if (!S_ISREG(file_stat.st_mode) || file_stat.st_size == 0)
+    {
+        const int ret_code = demo_file_read_stream(demo_file, fd);
+        if (!is_stdin)
         {
-            bit_pos++;
+            close(fd);
         }
-        assert(bit_pos <= 7);
+        return ret_code;
     }
 
-    stream->pos += bit_count;
+    const size_t file_size = (size_t)file_stat.st_size;
+    void *mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
 
-    return result;
-}
-
-static u32 read_valve_var_uint(Bitstream *stream)
-{
-    u32 id = bitstream_read_u32(stream, 6);
-    switch (id & 0x30)
+    if (mapping == MAP_FAILED)
     {
-    case 16:
-        id = (id & 15) | (bitstream_read_u32(stream, 4) << 4);
-        break;
-    case 32:
-        id = (id & 15) | (bitstream_read_u32(stream, 8) << 4);
-        break;
-    case 48:
-        id = (id & 15) | (bitstream_read_u32(stream, 28) << 4);
-        break;
+        //
+        // Some filesystems don't support mmap, read it like a pipe instead
+        //
+        const int ret_code = demo_file_read_stream(demo_file, fd);
+        if (!is_stdin)
+        {
+            close(fd);
+        }
+        return ret_code;
     }
-    return id;
-}
 
-static u32 read_varint32(const u8 *data, u32 *read)
-{
-    uint32_t result = 0;
-    u8 tmp;
-    (*read) = 0;
-    size_t position = 0;
+    //
+    // Packets are consumed front to back exactly once. Ask for aggressive readahead and
+    // kick off I/O for the start of the file so the first packets don't fault on every page
+    //
+    const size_t willneed_size = min_uint(file_size, 8 * 1024 * 1024);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    madvise(mapping, file_size, MADV_SEQUENTIAL);
+    madvise(mapping, willneed_size, MADV_WILLNEED);
 
-    do
+    //
+    // The mapping holds its own reference to the file
+    //
+    if (!is_stdin)
     {
-        assert((*read) < 5);
+        close(fd);
+    }
 
-        tmp = data[position++];
-        result |= (uint32_t)(tmp & 0x7F) << (7 * (*read));
-        ++(*read);
-    } while (tmp & 0x80);
+    demo_file->data = (u8 *)mapping;
+    demo_file->data_size = file_size;
+    demo_file->mtime_ns = (u64)file_stat.st_mtim.tv_sec * 1000000000ull + (u64)file_stat.st_mtim.tv_nsec;
+    demo_file->is_mapped = true;
 
-    return result;
+    return DEMO_FILE_OPEN_RET_OK;
 }
 
-static void parser_init(Parser *parser)
+static int demo_file_read_stream(DemoFile *demo_file, int fd)
 {
-    parser->data = nullptr;
-    parser->data_size = 0;
-    parser->pos = 0;
-    parser->uncompressed_buffer = nullptr;
-    parser->uncompressed_buffer_size = 0;
-}
+    const size_t min_allocation = 16 * 1024 * 1024;
 
-static u32 parser_read_varint32(Parser *parser)
-{
-    u32 result = 0;
-    u32 bytes_read = 0;
+    u8 *buffer = nullptr;
+    size_t buffer_size = 0;
+    size_t bytes_read = 0;
 
     while (true)
     {
-        assert(bytes_read < 5);
-
-        const u8 tmp = parser->data[parser->pos];
-        result |= (u32)(tmp & 0x7Fu) << (7u * bytes_read);
+        if (bytes_read == buffer_size)
+        {
+            const size_t alloc_size = max_uint(buffer_size * 2, min_allocation);
+            u8 *new_buffer = (u8 *)realloc(buffer, alloc_size);
+            if (!new_buffer)
+            {
+                free(buffer);
+                return DEMO_FILE_OPEN_RET_OOM;
+            }
+            buffer = new_buffer;
+            buffer_size = alloc_size;
+        }
 
-        ++bytes_read;
-        ++(parser->pos);
+        const ssize_t ret = read(fd, buffer + bytes_read, buffer_size - bytes_read);
 
-        if (!(tmp & 0x80u))
+        if (ret == 0)
         {
             break;
         }
+
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            free(buffer);
+            return DEMO_FILE_OPEN_RET_READ_ERROR;
+        }
+
+        bytes_read += (size_t)ret;
     }
 
-    return result;
+    demo_file->data = buffer;
+    demo_file->data_size = bytes_read;
+    demo_file->is_mapped = false;
+
+    return DEMO_FILE_OPEN_RET_OK;
 }
 
-static int parser_next_packet(Parser *parser, DemoPacket *out_packet)
+static void demo_file_close(DemoFile *demo_file)
 {
-    if (parser->pos >= parser->data_size)
+    if (demo_file->is_mapped)
     {
-        log_debug("Reached end of stream");
-        return PARSER_NEXT_PACKET_RET_END;
+        munmap(demo_file->data, demo_file->data_size);
+    }
+    else if (!demo_file->is_borrowed)
+    {
+        free(demo_file->data);
     }
 
-    const u32 demo_cmd_raw = parser_read_varint32(parser);
-    const u32 demo_cmd = demo_cmd_raw & (~DEMO_COMMAND_IS_COMPRESSED);
-    assert(!(demo_cmd & DEMO_COMMAND_IS_COMPRESSED));
-    const u32 tick = parser_read_varint32(parser);
-    const u32 size = parser_read_varint32(parser);
-    const bool is_compressed = demo_cmd_raw & DEMO_COMMAND_IS_COMPRESSED;
-    const char *is_compressed_string = (is_compressed) ? "true" : "false";
-
-    log_debug("Type:       %s (%d)\n", demo_command_to_string(demo_cmd), demo_cmd);
-    log_debug("Compressed: %s\n", is_compressed_string);
-    log_debug("Size:       %u\n", size);
-    log_debug("Tick:       %u\n", tick);
+    demo_file->data = nullptr;
+    demo_file->data_size = 0;
+    demo_file->is_mapped = false;
+}
 
-    out_packet->type = demo_cmd;
+//
+// Loads <demo_path>.idx if it matches the demo and read_sidecar is set, otherwise scans
+// the frame headers and optionally writes the sidecar for next time
+//
+static int load_frame_index(FrameIndex *index, const DemoFile *demo_file, const char *demo_path, bool read_sidecar, bool write_sidecar, FILE *output)
+{
+    const bool is_stdin = (strcmp(demo_path, "-") == 0);
+    char sidecar_path[4096];
+    snprintf(sidecar_path, sizeof(sidecar_path), "%s.idx", demo_path);
 
-    if (is_compressed)
+    if (read_sidecar && !is_stdin && demo_file->mtime_ns != 0)
     {
-        char *compressed_data = (char *)(parser->data + parser->pos);
-        //
-        // TODO: Reuse decompression buffer, resize
-        //
-        log_debug("Decompressing packet...\n");
-
-        assert(snappy_validate_compressed_buffer(compressed_data, size) == SNAPPY_OK);
-
-        size_t required_size = 0;
-        if (snappy_uncompressed_length(compressed_data, size, &required_size) != SNAPPY_OK)
+        const int read_ret_code = frame_index_read(index, sidecar_path, demo_file->data_size, demo_file->mtime_ns);
+        if (read_ret_code == FRAME_INDEX_RET_OK)
         {
-            log_err("Failed to calculate decompressed size\n");
-            return PARSER_NEXT_PACKET_RET_DECOMPRESS_ERROR;
+            fprintf(output, "Loaded frame index from %s\n", sidecar_path);
+            return FRAME_INDEX_RET_OK;
         }
+    }
+
+    const int build_ret_code = frame_index_build(index, demo_file->data, demo_file->data_size, sizeof(DemoHeader));
+    if (build_ret_code != FRAME_INDEX_RET_OK)
+    {
+        return build_ret_code;
+    }
 
-        log_debug("Uncompressed size: %zu\n", required_size);
+    index->file_mtime_ns = demo_file->mtime_ns;
 
-        const size_t min_allocation = 1024 * 1024;
+    fprintf(output, "Indexed %u frames (%u full packets)\n", index->entry_count, index->full_packet_count);
 
-        if (!parser->uncompressed_buffer)
+    if (write_sidecar && !is_stdin)
+    {
+        if (frame_index_write(index, sidecar_path) != FRAME_INDEX_RET_OK)
         {
-            const size_t alloc_size = max_uint(required_size, min_allocation);
-            log_debug("Allocating %zu for uncompressed buffer\n", alloc_size);
-            parser->uncompressed_buffer = (char *)malloc(alloc_size);
-            if (!parser->uncompressed_buffer)
-            {
-                log_err("Failed to allocate uncompressed packet buffer\n");
-                return PARSER_NEXT_PACKET_RET_OOM;
-            }
-            parser->uncompressed_buffer_size = alloc_size;
+            fprintf(output, "Failed to write frame index to %s\n", sidecar_path);
         }
+    }
 
-        if (parser->uncompressed_buffer_size < required_size)
-        {
-            const size_t alloc_size = max_uint(required_size, min_allocation);
-            log_debug("Reallocating uncompressed buffer from %zu to %zu\n", parser->uncompressed_buffer_size, alloc_size);
-            parser->uncompressed_buffer = (char *)realloc(parser->uncompressed_buffer, alloc_size);
-            if (!parser->uncompressed_buffer)
-            {
-                log_err("Failed to reallocate uncompressed packet buffer\n");
-                return PARSER_NEXT_PACKET_RET_OOM;
-            }
-            parser->uncompressed_buffer_size = alloc_size;
-        }
+    return FRAME_INDEX_RET_OK;
+}
 
-        size_t actual_uncompressed_size = parser->uncompressed_buffer_size;
-        const snappy_status status = snappy_uncompress(compressed_data, size, parser->uncompressed_buffer, &actual_uncompressed_size);
+static size_t min_uint(size_t a, size_t b)
+{
+    return (a < b) ? a : b;
+}
 
-        if (status != SNAPPY_OK)
-        {
-            log_err("Failed to decompresss data. Status: %d\n", status);
-            return PARSER_NEXT_PACKET_RET_DECOMPRESS_ERROR;
-        }
+static size_t max_uint(size_t a, size_t b)
+{
+    return (a > b) ? a : b;
+}
 
-        out_packet->data = parser->uncompressed_buffer;
-        out_packet->data_size = actual_uncompressed_size;
-    }
-    else
-    {
-        out_packet->data = (char *)(parser->data + parser->pos);
-        out_packet->data_size = size;
-    }
-
-    parser->pos += size;
-
-    return PARSER_NEXT_PACKET_RET_OK;
-}
-
-static const char *demo_command_to_string(int command)
-{
-    switch (command)
-    {
-    case DEMO_COMMAND_ERROR:
-        return "Error";
-    case DEMO_COMMAND_STOP:
-        return "Stop";
-    case DEMO_COMMAND_FILE_HEADER:
-        return "File Header";
-    case DEMO_COMMAND_FILE_INFO:
-        return "File Info";
-    case DEMO_COMMAND_SYNC_TICK:
-        return "Sync Tick";
-    case DEMO_COMMAND_SEND_TABLES:
-        return "Send Tables";
-    case DEMO_COMMAND_CLASS_INFO:
-        return "Class Info";
-    case DEMO_COMMAND_STRING_TABLES:
-        return "String Tables";
-    case DEMO_COMMAND_PACKET:
-        return "Packet";
-    case DEMO_COMMAND_SIGNON_PACKET:
-        return "Signon Packet";
-    case DEMO_COMMAND_CONSOLE_CMD:
-        return "Console Command";
-    case DEMO_COMMAND_CUSTOM_DATA:
-        return "Custom Data";
-    case DEMO_COMMAND_CUSTOM_DATA_CALLBACKS:
-        return "Custom Data Callbacks";
-    case DEMO_COMMAND_USER_CMD:
-        return "User Command";
-    case DEMO_COMMAND_FULL_PACKET:
-        return "Full Packet";
-    case DEMO_COMMAND_SAVE_GAME:
-        return "Save Game";
-    case DEMO_COMMAND_MAX:
-        return "Max (Not valid)";
-    default:
-        //
-        // Fall through
-        //
-    }
-    return "Unknown";
+
+static void print_log_message(void *user_data, int level, const char *message)
+{
+    UNUSED(level);
+    fputs(message, (FILE *)user_data);
 }
 
-static int handle_packet(u32 packet_id)
+static int print_event(void *user_data, const DemoEvent *event)
 {
-    switch (packet_id)
+    FILE *output = (FILE *)user_data;
+
+    switch (event->kind)
     {
-    case SVC__MESSAGES__svc_ServerInfo:
-        log_info("SVC__MESSAGES__svc_ServerInfo\n");
-        break;
-    case SVC__MESSAGES__svc_FlattenedSerializer:
-        log_info("SVC__MESSAGES__svc_FlattenedSerializer\n");
-        break;
-    case SVC__MESSAGES__svc_ClassInfo:
-        log_info("SVC__MESSAGES__svc_ClassInfo\n");
+    case DEMO_EVENT_FRAME:
+        fprintf(output, "Frame: %s (%u) at tick %u, %u bytes%s\n", demo_command_to_string((int)event->frame.command), event->frame.command, event->tick, event->frame.size, (event->frame.is_compressed) ? " (compressed)" : "");
         break;
-    case SVC__MESSAGES__svc_SetPause:
-        log_info("SVC__MESSAGES__svc_SetPause\n");
+    case DEMO_EVENT_FILE_HEADER:
+        fprintf(output, "File header:\n");
+        fprintf(output, "  Client name: %s\n", event->file_header.client_name);
+        fprintf(output, "  Demo file stamp: %s\n", event->file_header.demo_file_stamp);
+        fprintf(output, "  Game directory: %s\n", event->file_header.game_directory);
+        fprintf(output, "  Map name: %s\n", event->file_header.map_name);
+        fprintf(output, "  Server name: %s\n", event->file_header.server_name);
         break;
-    case SVC__MESSAGES__svc_CreateStringTable:
-        log_info("SVC__MESSAGES__svc_CreateStringTable\n");
-        break;
-    case SVC__MESSAGES__svc_UpdateStringTable:
-        log_info("SVC__MESSAGES__svc_UpdateStringTable\n");
-        break;
-    case SVC__MESSAGES__svc_VoiceInit:
-        log_info("SVC__MESSAGES__svc_VoiceInit\n");
-        break;
-    case SVC__MESSAGES__svc_VoiceData:
-        log_info("SVC__MESSAGES__svc_VoiceData\n");
-        break;
-    case SVC__MESSAGES__svc_Print:
-        log_info("SVC__MESSAGES__svc_Print\n");
-        break;
-    case SVC__MESSAGES__svc_Sounds:
-        log_info("SVC__MESSAGES__svc_Sounds\n");
-        break;
-    case SVC__MESSAGES__svc_SetView:
-        log_info("SVC__MESSAGES__svc_SetView\n");
-        break;
-    case SVC__MESSAGES__svc_ClearAllStringTables:
-        log_info("SVC__MESSAGES__svc_ClearAllStringTables\n");
-        break;
-    case SVC__MESSAGES__svc_CmdKeyValues:
-        log_info("SVC__MESSAGES__svc_CmdKeyValues\n");
-        break;
-    case SVC__MESSAGES__svc_BSPDecal:
-        log_info("SVC__MESSAGES__svc_BSPDecal\n");
-        break;
-    case SVC__MESSAGES__svc_SplitScreen:
-        log_info("SVC__MESSAGES__svc_SplitScreen\n");
-        break;
-    case SVC__MESSAGES__svc_PacketEntities:
-        log_info("SVC__MESSAGES__svc_PacketEntities\n");
-        break;
-    case SVC__MESSAGES__svc_Prefetch:
-        log_info("SVC__MESSAGES__svc_Prefetch\n");
-        break;
-    case SVC__MESSAGES__svc_Menu:
-        log_info("SVC__MESSAGES__svc_Menu\n");
-        break;
-    case SVC__MESSAGES__svc_GetCvarValue:
-        log_info("SVC__MESSAGES__svc_GetCvarValue\n");
-        break;
-    case SVC__MESSAGES__svc_StopSound:
-        log_info("SVC__MESSAGES__svc_StopSound\n");
-        break;
-    case SVC__MESSAGES__svc_PeerList:
-        log_info("SVC__MESSAGES__svc_PeerList\n");
+    case DEMO_EVENT_FILE_INFO:
+        fprintf(output, "File info:\n");
+        if (event->file_info.has_playback_frames)
+        {
+            fprintf(output, "  Playback frames: %d\n", event->file_info.playback_frames);
+        }
+        if (event->file_info.has_playback_ticks)
+        {
+            fprintf(output, "  Playback ticks: %d\n", event->file_info.playback_ticks);
+        }
+        if (event->file_info.has_playback_time)
+        {
+            fprintf(output, "  Playback time: %f\n", (f64)event->file_info.playback_time);
+        }
+        fprintf(output, "  Rounds count: %u\n", event->file_info.round_count);
         break;
-    case SVC__MESSAGES__svc_PacketReliable:
-        log_info("SVC__MESSAGES__svc_PacketReliable\n");
+    case DEMO_EVENT_SEND_TABLES:
+        fprintf(output, "Send Tables:%s\n", (event->send_tables.from_cache) ? " (from serializer cache)" : "");
+        fprintf(output, "  Field count:      %u\n", event->send_tables.field_count);
+        fprintf(output, "  Serializer count: %u\n", event->send_tables.serializer_count);
         break;
-    case SVC__MESSAGES__svc_HLTVStatus:
-        log_info("SVC__MESSAGES__svc_HLTVStatus\n");
+    case DEMO_EVENT_CLASS_INFO:
+    {
+        const CDemoClassInfo *class_info = event->class_info.class_info;
+        fprintf(output, "Class Info:\n");
+        for (size_t i = 0; i < class_info->n_classes; i++)
+        {
+            const CDemoClassInfo__ClassT *entry = class_info->classes[i];
+            fprintf(output, "  Class #%zu\n", i);
+            if (entry->has_class_id)
+            {
+                fprintf(output, "    Class ID: %d\n", entry->class_id);
+            }
+            fprintf(output, "    Network name: %s\n", entry->network_name);
+            fprintf(output, "    Table name: %s\n", entry->table_name);
+        }
         break;
-    case SVC__MESSAGES__svc_ServerSteamID:
-        log_info("SVC__MESSAGES__svc_ServerSteamID\n");
+    }
+    case DEMO_EVENT_FULL_PACKET:
+        fprintf(output, "Full packet:\n");
+        fprintf(output, "  String table snapshot: %u bytes\n", event->full_packet.string_table_size);
         break;
-    case SVC__MESSAGES__svc_FullFrameSplit:
-        log_info("SVC__MESSAGES__svc_FullFrameSplit\n");
+    case DEMO_EVENT_NET_MESSAGE:
+        fprintf(output, "  %s (%u bytes)\n", demo_message_to_string(event->net_message.message_id), event->net_message.size);
         break;
-    case SVC__MESSAGES__svc_RconServerDetails:
-        log_info("SVC__MESSAGES__svc_RconServerDetails\n");
+    case DEMO_EVENT_SEEK:
+        if (event->seek.found)
+        {
+            fprintf(output, "Seeked to full packet at tick %u for tick %u\n", event->seek.keyframe_tick, event->seek.target_tick);
+        }
+        else
+        {
+            fprintf(output, "No full packet at or before tick %u, parsing from the start\n", event->seek.target_tick);
+        }
         break;
-    case SVC__MESSAGES__svc_UserMessage:
-        log_info("SVC__MESSAGES__svc_UserMessage\n");
+    case DEMO_EVENT_ERROR:
+        fprintf(output, "Error %u (%d) at tick %u\n", event->error.error, event->error.code, event->tick);
         break;
-    case SVC__MESSAGES__svc_Broadcast_Command:
-        log_info("SVC__MESSAGES__svc_Broadcast_Command\n");
+    case DEMO_EVENT_GAME_EVENT:
+        print_game_event(output, event->tick, &event->game_event);
         break;
-    case SVC__MESSAGES__svc_HltvFixupOperatorStatus:
-        log_info("SVC__MESSAGES__svc_HltvFixupOperatorStatus\n");
+    case DEMO_EVENT_ENTITY:
+        print_entity_event(output, event->tick, &event->entity);
         break;
     default:
-        log_info("Unknown packet ID\n");
         break;
     }
+
     return 0;
 }
 
-int process_demo_packet(DemoPacket packet)
+static void print_game_event(FILE *output, u32 tick, const GameEvent *game_event)
 {
-    log_debug("Processing packet..\n");
-    switch (packet.type)
-    {
-    case DEMO_COMMAND_FILE_HEADER:
+    fprintf(output, "Game event: %s at tick %u\n", game_event->name, tick);
+
+    for (u32 i = 0; i < game_event->value_count; i++)
     {
-        CDemoFileHeader *file_header = cdemo_file_header__unpack(nullptr, packet.data_size, (u8 *)packet.data);
-        if (file_header)
-        {
-            log_info("File header:\n");
-            log_info("  Client name: %s\n", file_header->client_name);
-            log_info("  Demo file stamp: %s\n", file_header->demo_file_stamp);
-            log_info("  Game directory: %s\n", file_header->game_directory);
-            log_info("  Map name: %s\n", file_header->map_name);
-            log_info("  Server name: %s\n", file_header->server_name);
-            cdemo_file_header__free_unpacked(file_header, nullptr);
-        }
-        else
+        const char *key_name = game_event->descriptor->keys[i].name;
+        const GameEventValue *value = &game_event->values[i];
+
+        switch (value->kind)
         {
-            log_err("Failed to extract CDemoFileHeader\n");
+        case GAME_EVENT_VALUE_STRING:
+            fprintf(output, "  %s: %s\n", key_name, value->string_value);
+            break;
+        case GAME_EVENT_VALUE_FLOAT:
+            fprintf(output, "  %s: %f\n", key_name, (f64)value->float_value);
+            break;
+        case GAME_EVENT_VALUE_INT:
+            fprintf(output, "  %s: %d\n", key_name, value->int_value);
+            break;
+        case GAME_EVENT_VALUE_BOOL:
+            fprintf(output, "  %s: %s\n", key_name, (value->bool_value) ? "true" : "false");
+            break;
+        case GAME_EVENT_VALUE_UINT64:
+            fprintf(output, "  %s: %llu\n", key_name, (unsigned long long)value->uint64_value);
+            break;
+        default:
+            fprintf(output, "  %s: (none)\n", key_name);
+            break;
         }
-        break;
     }
-    case DEMO_COMMAND_FILE_INFO:
-    {
-        CDemoFileInfo *proto = cdemo_file_info__unpack(nullptr, packet.data_size, (u8 *)packet.data);
-        if (proto)
-        {
-            if (proto->has_playback_frames)
-            {
-                const i32 playback_frames = proto->playback_frames;
-                log_info("  Playback frames: %d\n", playback_frames);
-            }
+}
 
-            if (proto->has_playback_ticks)
-            {
-                const i32 playback_ticks = proto->playback_ticks;
-                log_info("  Playback ticks: %d\n", playback_ticks);
-            }
+//
+// Only entities of the queried classes are reported. With --fields, every projected
+// column of the class is printed along with the event
+//
+static void print_entity_event(FILE *output, u32 tick, const DemoEntityEvent *entity_event)
+{
+    static const char *event_names[] = { "created", "updated", "left PVS", "deleted" };
 
-            if (proto->has_playback_time)
-            {
-                const i32 playback_time = proto->playback_time;
-                log_info("  Playback time: %d\n", playback_time);
-            }
+    const EntityClass *entity_class = entity_event->entity_class;
+    const char *event_name = (entity_event->event < sizeof(event_names) / sizeof(event_names[0])) ? event_names[entity_event->event] : "changed";
+    fprintf(output, "Entity %u (%s) %s at tick %u\n", entity_event->entity_index, entity_class->name, event_name, tick);
 
-            const CGameInfo *game_info = proto->game_info;
-            if (game_info)
-            {
-                log_info("  Game info:\n");
-                log_info("    Rounds count: %zu", game_info->cs->n_round_start_ticks);
-            }
-        }
-        else
-        {
-            log_err("Failed to extract CDemoFileInfo\n");
-        }
-        break;
-    }
-    case DEMO_COMMAND_PACKET:
+    if (entity_class->projection && entity_event->event != ENTITY_EVENT_DELETED)
     {
-        CDemoPacket *proto = cdemo_packet__unpack(nullptr, packet.data_size, (u8 *)packet.data);
-        log_info("Packet:\n");
-        log_info("  Has data: %s\n", proto->has_data ? "true" : "false");
-        cdemo_packet__free_unpacked(proto, nullptr);
+        EntityPrintContext context = { .output = output, .entity_event = entity_event };
+        entity_class_visit_columns(entity_class, print_entity_column, &context);
+    }
+}
+
+static void print_entity_column(void *user_data, const char *name, u32 column, const FieldDecoder *decoder)
+{
+    const EntityPrintContext *context = (const EntityPrintContext *)user_data;
+    const EntityValue *value = &entity_class_column(context->entity_event->entity_class, column)[context->entity_event->row];
+    print_entity_value(context->output, name, value, decoder);
+}
 
-        Bitstream bitstream = bitstream_create(proto->data.data, proto->data.len);
-        const u32 packet_id = read_valve_var_uint(&bitstream);
-        log_info("Packet ID: %u\n", packet_id);
-        handle_packet(packet_id);
+static void print_entity_value(FILE *output, const char *name, const EntityValue *value, const FieldDecoder *decoder)
+{
+    switch (decoder->kind)
+    {
+    case FIELD_DECODER_BOOL:
+        fprintf(output, "  %s: %s\n", name, (value->bool_value) ? "true" : "false");
         break;
-    }
-    case DEMO_COMMAND_CLASS_INFO:
+    case FIELD_DECODER_SIGNED:
+    case FIELD_DECODER_SIGNED64:
+        fprintf(output, "  %s: %lld\n", name, (long long)value->int_value);
+        break;
+    case FIELD_DECODER_STRING:
+        fprintf(output, "  %s: %s\n", name, (value->string) ? value->string : "");
+        break;
+    case FIELD_DECODER_FLOAT_NOSCALE:
+    case FIELD_DECODER_FLOAT_QUANTIZED:
+    case FIELD_DECODER_FLOAT_COORD:
+    case FIELD_DECODER_FLOAT_SIMTIME:
+    case FIELD_DECODER_FLOAT_RUNETIME:
+        fprintf(output, "  %s: %f\n", name, (f64)value->float_value);
+        break;
+    case FIELD_DECODER_VECTOR:
+    case FIELD_DECODER_VECTOR_NORMAL:
+    case FIELD_DECODER_QANGLE_PITCH_YAW:
+    case FIELD_DECODER_QANGLE_PRECISE:
+    case FIELD_DECODER_QANGLE_FIXED:
+    case FIELD_DECODER_QANGLE_COORD:
     {
-        CDemoClassInfo *proto = cdemo_class_info__unpack(nullptr, packet.data_size, (u8 *)packet.data);
-        log_info("Class Info:\n");
-        for (size_t i = 0; i < proto->n_classes; i++)
+        const u32 component_count = (decoder->kind == FIELD_DECODER_VECTOR) ? decoder->component_count : 3;
+        fprintf(output, "  %s:", name);
+        for (u32 i = 0; i < component_count; i++)
         {
-            log_info("  Class #%zu\n", i);
-            const CDemoClassInfo__ClassT *class_info = proto->classes[i];
-            if (class_info->has_class_id)
-            {
-                log_info("    Class ID: %d\n", class_info->class_id);
-            }
-            log_info("    Network name: %s\n", class_info->network_name);
-            log_info("    Table name: %s\n", class_info->table_name);
+            fprintf(output, " %f", (f64)value->vector[i]);
         }
+        fprintf(output, "\n");
         break;
     }
-    case DEMO_COMMAND_SEND_TABLES:
-    {
-        CDemoSendTables *proto = cdemo_send_tables__unpack(nullptr, packet.data_size, (u8 *)packet.data);
-
-        u32 bytes_read = 0;
-        const u32 data_size = read_varint32(proto->data.data, &bytes_read);
-        const u8 *data = proto->data.data + bytes_read;
+    default:
+        fprintf(output, "  %s: %llu\n", name, (unsigned long long)value->uint_value);
+        break;
+    }
+}
 
-        CSVCMsgFlattenedSerializer *flattened_serializer = csvcmsg__flattened_serializer__unpack(nullptr, data_size, data);
+//
+// Splits names in place at the commas
+//
+static u32 split_names(char *names, const char **out_names, u32 max_count)
+{
+    u32 count = 0;
+    char *save = nullptr;
+    for (char *name = strtok_r(names, ",", &save); name && count < max_count; name = strtok_r(nullptr, ",", &save))
+    {
+        out_names[count++] = name;
+    }
+    return count;
+}
 
-        log_info("Send Tables:\n");
+//
+// Each span prints into its own memory stream, merged into the real output in span order
+//
+static void start_parallel_span(void *user_data, DemoSpan *span, DemoParserOptions *parser_options)
+{
+    UNUSED(user_data);
 
-        if (flattened_serializer)
+    SpanOutput *span_output = (SpanOutput *)calloc(1, sizeof(SpanOutput));
+    if (span_output)
+    {
+        span_output->stream = open_memstream(&span_output->text, &span_output->text_size);
+        if (!span_output->stream)
+        {
+            free(span_output);
+            span_output = nullptr;
+        }
+    }
+
+    span->user_data = span_output;
+    parser_options->log_user_data = (span_output) ? span_output->stream : nullptr;
+    if (!span_output)
+    {
+        parser_options->log_handler = nullptr;
+    }
+}
+
+static int print_parallel_span_event(void *user_data, DemoSpan *span, const DemoEvent *event)
+{
+    UNUSED(user_data);
+
+    const SpanOutput *span_output = (const SpanOutput *)span->user_data;
+    if (!span_output)
+    {
+        return 1;
+    }
+    return print_event(span_output->stream, event);
+}
+
+static int merge_parallel_span(void *user_data, DemoSpan *span)
+{
+    ParallelMerge *merge = (ParallelMerge *)user_data;
+    FILE *output = merge->output;
+    SpanOutput *span_output = (SpanOutput *)span->user_data;
+    int result = span->result;
+
+    if (span_output)
+    {
+        fclose(span_output->stream);
+        fwrite(span_output->text, 1, span_output->text_size, output);
+        free(span_output->text);
+        free(span_output);
+        span->user_data = nullptr;
+    }
+    else if (result == DEMO_PARSER_RET_END)
+    {
+        //
+        // Spans skipped after an earlier one stopped the run never got their output,
+        // they're left with DEMO_PARSER_RET_END
+        //
+        return 0;
+    }
+    else if (result == DEMO_PARSER_RET_OK)
+    {
+        //
+        // Without its output the span stopped at its first event
+        //
+        result = DEMO_PARSER_RET_OOM;
+    }
+
+    if (parse_demo_result(result) == PARSE_DEMO_RET_OK)
+    {
+        return 0;
+    }
+
+    if (result == DEMO_PARSER_RET_OOM)
+    {
+        fprintf(output, "Out of memory in span %u. Stopping\n", span->index);
+    }
+    else
+    {
+        fprintf(output, "Failed to parse span %u (%d). Stopping\n", span->index, result);
+    }
+
+    if (merge->result == DEMO_PARSER_RET_OK)
+    {
+        merge->result = result;
+    }
+    return 1;
+}
+
+static bool load_cached_serializers(void *user_data, u64 key, EntityEngine *engine)
+{
+    char cache_path[4096];
+    return serializer_cache_path((const char *)user_data, key, cache_path, sizeof(cache_path)) == SERIALIZER_CACHE_RET_OK &&
+           serializer_cache_read(engine, cache_path, key) == SERIALIZER_CACHE_RET_OK;
+}
+
+static void store_cached_serializers(void *user_data, u64 key, const EntityEngine *engine)
+{
+    char cache_path[4096];
+    if (serializer_cache_path((const char *)user_data, key, cache_path, sizeof(cache_path)) != SERIALIZER_CACHE_RET_OK ||
+        serializer_cache_write(engine, cache_path, key) != SERIALIZER_CACHE_RET_OK)
+    {
+        log_warn("Failed to write serializer cache for %016llx\n", (unsigned long long)key);
+    }
+}
+
+static int parse_demo(const char *demo_path, const ParseOptions *options, FILE *output)
+{
+    if (options->follow || (options->memory_budget > 0 && strcmp(demo_path, "-") == 0))
+    {
+        return parse_demo_live(demo_path, options, output);
+    }
+
+    DemoFile demo_file;
+    const int open_ret_code = demo_file_open(&demo_file, demo_path);
+
+    switch (open_ret_code)
+    {
+    case DEMO_FILE_OPEN_RET_OK:
+        break;
+    case DEMO_FILE_OPEN_RET_OPEN_ERROR:
+        fprintf(output, "Failed to open demo file\n");
+        return PARSE_DEMO_RET_OPEN_ERROR;
+    case DEMO_FILE_OPEN_RET_READ_ERROR:
+        fprintf(output, "Failed to read demo file\n");
+        return PARSE_DEMO_RET_OPEN_ERROR;
+    case DEMO_FILE_OPEN_RET_OOM:
+        fprintf(output, "Out of memory while reading demo file\n");
+        return PARSE_DEMO_RET_OOM;
+    default:
+        return PARSE_DEMO_RET_OPEN_ERROR;
+    }
+
+    //
+    // Under a budget only archives are decompressed from the mapping, plain demos are
+    // read through the window instead of faulting the whole file in
+    //
+    if (options->memory_budget > 0 && archive_detect_format(demo_file.data, demo_file.data_size) == ARCHIVE_FORMAT_NONE)
+    {
+        demo_file_close(&demo_file);
+        return parse_demo_live(demo_path, options, output);
+    }
+
+    return parse_demo_file(&demo_file, demo_path, options, output);
+}
+
+//
+// Parses an opened demo and closes it
+//
+static int parse_demo_file(DemoFile *demo_file, const char *demo_path, const ParseOptions *options, FILE *output)
+{
+    const int archive_format = archive_detect_format(demo_file->data, demo_file->data_size);
+    if (archive_format != ARCHIVE_FORMAT_NONE)
+    {
+        return parse_demo_archive(demo_file, archive_format, demo_path, options, output);
+    }
+
+    if (demo_file->data_size < sizeof(DemoHeader))
+    {
+        fprintf(output, "Demo file is too small to contain a header\n");
+        demo_file_close(demo_file);
+        return PARSE_DEMO_RET_INVALID;
+    }
+
+    DemoHeader demo_header;
+    memcpy(&demo_header, demo_file->data, sizeof(DemoHeader));
+    fprintf(output, "Magic:          %.8s\n", demo_header.magic);
+    fprintf(output, "Summary offset: %u\n", demo_header.summary_offset);
+    fprintf(output, "Packet offset:  %u\n", demo_header.packet_offset);
+
+    FrameIndex frame_index;
+    frame_index_init(&frame_index);
+
+    if (options->write_index || options->has_seek_tick || options->parallel)
+    {
+        //
+        // Whether the sidecar was there shows in the output, which the result cache
+        // keys on the demo alone
+        //
+        const bool read_sidecar = !options->result_cache.directory;
+        if (load_frame_index(&frame_index, demo_file, demo_path, read_sidecar, options->write_index, output) != FRAME_INDEX_RET_OK)
+        {
+            fprintf(output, "Failed to index demo file\n");
+            demo_file_close(demo_file);
+            return PARSE_DEMO_RET_INVALID;
+        }
+    }
+
+    if (options->parallel)
+    {
+        const int ret_code = parse_demo_parallel(demo_file, &frame_index, options, output);
+        frame_index_free(&frame_index);
+        demo_file_close(demo_file);
+        return ret_code;
+    }
+
+    DemoParserOptions parser_options;
+    demo_parser_options_init(&parser_options);
+    parser_options.thread_count = options->thread_count;
+    parser_options.event_mask = DEMO_EVENT_MASK_ALL & ~DEMO_EVENT_MASK(DEMO_EVENT_ENTITY);
+    parser_options.log_handler = print_log_message;
+    parser_options.log_user_data = output;
+    parser_options.log_level = LOG_LEVEL_DEBUG;
+    set_parser_query(&parser_options, options);
+
+    if (options->serializer_cache_directory)
+    {
+        parser_options.serializer_load = load_cached_serializers;
+        parser_options.serializer_store = store_cached_serializers;
+        parser_options.serializer_user_data = (void *)options->serializer_cache_directory;
+    }
+
+    ParseStats *stats = nullptr;
+    if (options->stats_format != STATS_FORMAT_NONE)
+    {
+        stats = (ParseStats *)calloc(1, sizeof(ParseStats));
+        parser_options.stats = stats;
+    }
+
+    DemoParser parser;
+    const int init_ret_code = demo_parser_init(&parser, demo_file->data, demo_file->data_size, &parser_options);
+    if (init_ret_code != DEMO_PARSER_RET_OK)
+    {
+        fprintf(output, "Failed to start the parser (%d)\n", init_ret_code);
+        free(stats);
+        frame_index_free(&frame_index);
+        demo_file_close(demo_file);
+        return (init_ret_code == DEMO_PARSER_RET_OOM) ? PARSE_DEMO_RET_OOM : PARSE_DEMO_RET_THREAD_ERROR;
+    }
+
+    for (u32 i = 0; i < options->game_event_count; i++)
+    {
+        if (demo_parser_subscribe_game_event(&parser, options->game_events[i]) != DEMO_PARSER_RET_OK)
+        {
+            fprintf(output, "Out of memory while subscribing to game events\n");
+            demo_parser_free(&parser);
+            free(stats);
+            frame_index_free(&frame_index);
+            demo_file_close(demo_file);
+            return PARSE_DEMO_RET_OOM;
+        }
+    }
+
+    ArrowExport *arrow_export = nullptr;
+    if (options->export_directory)
+    {
+        arrow_export = open_export(options, &parser.entities, output);
+        if (!arrow_export)
+        {
+            demo_parser_free(&parser);
+            free(stats);
+            frame_index_free(&frame_index);
+            demo_file_close(demo_file);
+            return PARSE_DEMO_RET_OPEN_ERROR;
+        }
+    }
+
+    if (options->has_seek_tick)
+    {
+        demo_parser_seek_tick(&parser, &frame_index, options->seek_tick);
+    }
+
+    const int run_ret_code = (arrow_export) ? demo_parser_run(&parser, arrow_export_event, arrow_export) : demo_parser_run(&parser, print_event, output);
+    if (run_ret_code == DEMO_PARSER_RET_OOM)
+    {
+        fprintf(output, "Out of memory. Stopping\n");
+    }
+
+    const int export_ret_code = (arrow_export) ? close_export(arrow_export, output) : ARROW_EXPORT_RET_OK;
+
+    fprintf(output, "Entities: %u live across %u classes\n", parser.entities.entity_count, parser.entities.class_count);
+
+    if (stats)
+    {
+        print_parse_stats(stats, options->stats_format, output);
+        free(stats);
+    }
+
+    demo_parser_free(&parser);
+    frame_index_free(&frame_index);
+    demo_file_close(demo_file);
+
+    if (export_ret_code != ARROW_EXPORT_RET_OK)
+    {
+        return (export_ret_code == ARROW_EXPORT_RET_OOM) ? PARSE_DEMO_RET_OOM : PARSE_DEMO_RET_OPEN_ERROR;
+    }
+
+    return parse_demo_result(run_ret_code);
+}
+
+//
+// Decompresses an archive opened as demo_file and parses the demo inside, then closes
+// demo_file. Frames are parsed as soon as their chunk was decompressed, unless the
+// options need the frame index, which needs the whole demo first
+//
+static int parse_demo_archive(DemoFile *demo_file, int archive_format, const char *demo_path, const ParseOptions *options, FILE *output)
+{
+    ArchiveFile archive_file;
+    const size_t window_size = options->memory_budget / MEMORY_BUDGET_WINDOW_DIVISOR;
+    const int open_ret_code = archive_file_open(&archive_file, demo_file->data, demo_file->data_size, archive_format, window_size);
+    if (open_ret_code != ARCHIVE_FILE_RET_OK)
+    {
+        fprintf(output, "Failed to start decompressing the demo (%d)\n", open_ret_code);
+        demo_file_close(demo_file);
+        return (open_ret_code == ARCHIVE_FILE_RET_OOM) ? PARSE_DEMO_RET_OOM : PARSE_DEMO_RET_THREAD_ERROR;
+    }
+
+    fprintf(output, "Archive:        %s\n", archive_format_to_string(archive_format));
+
+    if (options->write_index || options->has_seek_tick || options->parallel)
+    {
+        int read_ret_code;
+        while ((read_ret_code = archive_file_read(&archive_file)) == ARCHIVE_FILE_RET_OK)
+        {
+            archive_file_wait(&archive_file);
+        }
+
+        if (read_ret_code != ARCHIVE_FILE_RET_END)
+        {
+            fprintf(output, "Failed to decompress the demo (%d)\n", read_ret_code);
+            archive_file_close(&archive_file);
+            demo_file_close(demo_file);
+            return (read_ret_code == ARCHIVE_FILE_RET_OOM) ? PARSE_DEMO_RET_OOM : PARSE_DEMO_RET_INVALID;
+        }
+
+        //
+        // The sidecar index is matched against the archive's mtime and the decompressed size
+        //
+        DemoFile decompressed_file = { .mtime_ns = demo_file->mtime_ns };
+        decompressed_file.data = archive_file_take_data(&archive_file, &decompressed_file.data_size);
+
+        archive_file_close(&archive_file);
+        demo_file_close(demo_file);
+
+        return parse_demo_file(&decompressed_file, demo_path, options, output);
+    }
+
+    DemoStream stream = {
+        .archive_file = &archive_file,
+        .window_size = window_size,
+    };
+    const int ret_code = parse_demo_stream(&stream, options, output);
+
+    archive_file_close(&archive_file);
+    demo_file_close(demo_file);
+
+    return ret_code;
+}
+
+//
+// Parses the demo as the server writes it, handing every frame to print_event as soon
+// as it's complete. Output is flushed whenever the parser catches up with the writer.
+// Without --follow the demo is complete and only streamed to stay in the memory budget
+//
+static int parse_demo_live(const char *demo_path, const ParseOptions *options, FILE *output)
+{
+    LiveFile live_file;
+    if (live_file_open(&live_file, demo_path) != LIVE_FILE_RET_OK)
+    {
+        fprintf(output, "Failed to open demo file\n");
+        return PARSE_DEMO_RET_OPEN_ERROR;
+    }
+
+    const size_t window_size = options->memory_budget / MEMORY_BUDGET_WINDOW_DIVISOR;
+    if (window_size > 0 && live_file_set_window(&live_file, window_size) != LIVE_FILE_RET_OK)
+    {
+        fprintf(output, "Out of memory while allocating the read window\n");
+        live_file_close(&live_file);
+        return PARSE_DEMO_RET_OOM;
+    }
+
+    DemoStream stream = {
+        .live_file = &live_file,
+        .idle_seconds = options->follow_idle_seconds,
+        .is_complete = !options->follow,
+        .window_size = window_size,
+    };
+    const int ret_code = parse_demo_stream(&stream, options, output);
+
+    live_file_close(&live_file);
+
+    return ret_code;
+}
+
+//
+// Parses a demo in live mode, waiting for more of the stream whenever the parser runs
+// out of data
+//
+static int parse_demo_stream(DemoStream *stream, const ParseOptions *options, FILE *output)
+{
+    while (stream->data_size < sizeof(DemoHeader))
+    {
+        const int wait_ret_code = wait_for_demo_data(stream);
+        if (wait_ret_code != DEMO_STREAM_RET_OK)
+        {
+            fprintf(output, "Demo ended before its header (%d)\n", wait_ret_code);
+            return (wait_ret_code == DEMO_STREAM_RET_OOM) ? PARSE_DEMO_RET_OOM : PARSE_DEMO_RET_INVALID;
+        }
+    }
+
+    if (stream->live_file && archive_detect_format(stream->data, stream->data_size) != ARCHIVE_FORMAT_NONE)
+    {
+        fprintf(output, (stream->is_complete) ? "Compressed demos can only be streamed from a file\n" : "Compressed demos can't be followed\n");
+        return PARSE_DEMO_RET_INVALID;
+    }
+
+    DemoHeader demo_header;
+    memcpy(&demo_header, stream->data, sizeof(DemoHeader));
+    fprintf(output, "Magic:          %.8s\n", demo_header.magic);
+    fprintf(output, "Summary offset: %u\n", demo_header.summary_offset);
+    fprintf(output, "Packet offset:  %u\n", demo_header.packet_offset);
+
+    DemoParserOptions parser_options;
+    demo_parser_options_init(&parser_options);
+    parser_options.live = true;
+    parser_options.max_frame_size = options->memory_budget / MEMORY_BUDGET_FRAME_DIVISOR;
+    parser_options.event_mask = DEMO_EVENT_MASK_ALL & ~DEMO_EVENT_MASK(DEMO_EVENT_ENTITY);
+    parser_options.log_handler = print_log_message;
+    parser_options.log_user_data = output;
+    parser_options.log_level = LOG_LEVEL_DEBUG;
+    set_parser_query(&parser_options, options);
+
+    if (options->serializer_cache_directory)
+    {
+        parser_options.serializer_load = load_cached_serializers;
+        parser_options.serializer_store = store_cached_serializers;
+        parser_options.serializer_user_data = (void *)options->serializer_cache_directory;
+    }
+
+    ParseStats *stats = nullptr;
+    if (options->stats_format != STATS_FORMAT_NONE)
+    {
+        stats = (ParseStats *)calloc(1, sizeof(ParseStats));
+        parser_options.stats = stats;
+    }
+
+    DemoParser parser;
+    const int init_ret_code = demo_parser_init(&parser, stream->data, stream->data_size, &parser_options);
+    if (init_ret_code != DEMO_PARSER_RET_OK)
+    {
+        fprintf(output, "Failed to start the parser (%d)\n", init_ret_code);
+        free(stats);
+        return PARSE_DEMO_RET_OOM;
+    }
+
+    for (u32 i = 0; i < options->game_event_count; i++)
+    {
+        if (demo_parser_subscribe_game_event(&parser, options->game_events[i]) != DEMO_PARSER_RET_OK)
+        {
+            fprintf(output, "Out of memory while subscribing to game events\n");
+            demo_parser_free(&parser);
+            free(stats);
+            return PARSE_DEMO_RET_OOM;
+        }
+    }
+
+    ArrowExport *arrow_export = nullptr;
+    if (options->export_directory)
+    {
+        arrow_export = open_export(options, &parser.entities, output);
+        if (!arrow_export)
         {
-            log_info("  Field count:      %zu\n", flattened_serializer->n_fields);
-            log_info("  Serializer count: %zu\n", flattened_serializer->n_serializers);
-            log_info("  Symbol count:     %zu\n", flattened_serializer->n_symbols);
+            demo_parser_free(&parser);
+            free(stats);
+            return PARSE_DEMO_RET_OPEN_ERROR;
+        }
+    }
 
-            for (size_t i = 0; i < flattened_serializer->n_serializers; i++)
+    int ret_code = PARSE_DEMO_RET_OK;
+
+    while (true)
+    {
+        const int run_ret_code = (arrow_export) ? demo_parser_run(&parser, arrow_export_event, arrow_export) : demo_parser_run(&parser, print_event, output);
+        if (run_ret_code != DEMO_PARSER_RET_NEED_DATA)
+        {
+            if (run_ret_code == DEMO_PARSER_RET_OOM)
             {
-                ProtoFlattenedSerializerT *serializer = flattened_serializer->serializers[i];
-                if (serializer->has_serializer_name_sym)
-                {
-                    log_info("  serializer_name_sym: %d\n", serializer->serializer_name_sym);
-                }
-                if (serializer->has_serializer_version)
-                {
-                    log_info("  serializer_version: %d\n", serializer->serializer_version);
-                }
+                fprintf(output, "Out of memory. Stopping\n");
             }
+            ret_code = parse_demo_result(run_ret_code);
+            break;
         }
-        else
+
+        if (stream->live_file && !stream->is_complete)
         {
-            log_err("Failed to extract flattened serializer\n");
+            fflush(output);
         }
-        break;
+
+        //
+        // Everything before the frame the parser stopped in was parsed, the window only
+        // has to hold the rest
+        //
+        if (stream->window_size > 0)
+        {
+            discard_demo_data(stream, demo_parser_offset(&parser));
+            if (stream->data_size == stream->window_size)
+            {
+                fprintf(output, "A frame at offset %zu doesn't fit the %zu byte read window\n", stream->data_offset, stream->window_size);
+                ret_code = PARSE_DEMO_RET_OOM;
+                break;
+            }
+        }
+
+        const int wait_ret_code = wait_for_demo_data(stream);
+        if (wait_ret_code != DEMO_STREAM_RET_OK)
+        {
+            fprintf(output, "Stopped reading the demo before its end (%d)\n", wait_ret_code);
+            ret_code = (wait_ret_code == DEMO_STREAM_RET_OOM) ? PARSE_DEMO_RET_OOM : PARSE_DEMO_RET_INVALID;
+            break;
+        }
+
+        demo_parser_set_window(&parser, stream->data, stream->data_size, stream->data_offset);
+    }
+
+    if (arrow_export)
+    {
+        const int export_ret_code = close_export(arrow_export, output);
+        if (export_ret_code != ARROW_EXPORT_RET_OK && ret_code == PARSE_DEMO_RET_OK)
+        {
+            ret_code = (export_ret_code == ARROW_EXPORT_RET_OOM) ? PARSE_DEMO_RET_OOM : PARSE_DEMO_RET_OPEN_ERROR;
+        }
+    }
+
+    fprintf(output, "Entities: %u live across %u classes\n", parser.entities.entity_count, parser.entities.class_count);
+
+    if (stats)
+    {
+        print_parse_stats(stats, options->stats_format, output);
+        free(stats);
+    }
+
+    demo_parser_free(&parser);
+
+    return ret_code;
+}
+
+//
+// PARSE_DEMO_RET_* of a finished demo_parser_run
+//
+static int parse_demo_result(int parser_ret_code)
+{
+    switch (parser_ret_code)
+    {
+    case DEMO_PARSER_RET_OK:
+    case DEMO_PARSER_RET_END:
+        return PARSE_DEMO_RET_OK;
+    case DEMO_PARSER_RET_OOM:
+        return PARSE_DEMO_RET_OOM;
+    case DEMO_PARSER_RET_THREAD_ERROR:
+        return PARSE_DEMO_RET_THREAD_ERROR;
+    default:
+        return PARSE_DEMO_RET_INVALID;
+    }
+}
+
+//
+// Returns once the stream grew, DEMO_STREAM_RET_END when nothing more will arrive
+//
+static int wait_for_demo_data(DemoStream *stream)
+{
+    return (stream->archive_file) ? wait_for_archive_data(stream) : wait_for_live_data(stream);
+}
+
+//
+// Gives up with DEMO_STREAM_RET_TIMEOUT after idle_seconds without growth
+//
+static int wait_for_live_data(DemoStream *stream)
+{
+    LiveFile *live_file = stream->live_file;
+    const size_t previous_size = live_file->data_size;
+    struct timespec idle_start;
+    clock_gettime(CLOCK_MONOTONIC, &idle_start);
+
+    while (true)
+    {
+        const int read_ret_code = live_file_read(live_file);
+        if (read_ret_code != LIVE_FILE_RET_OK)
+        {
+            return (read_ret_code == LIVE_FILE_RET_OOM) ? DEMO_STREAM_RET_OOM : DEMO_STREAM_RET_ERROR;
+        }
+        if (live_file->data_size > previous_size)
+        {
+            stream->data = live_file->data;
+            stream->data_size = live_file->data_size;
+            return DEMO_STREAM_RET_OK;
+        }
+        if (live_file->is_closed || stream->is_complete)
+        {
+            return DEMO_STREAM_RET_END;
+        }
+
+        if (stream->idle_seconds > 0)
+        {
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            if ((u64)(now.tv_sec - idle_start.tv_sec) >= stream->idle_seconds)
+            {
+                return DEMO_STREAM_RET_TIMEOUT;
+            }
+        }
+
+        const int wait_ret_code = live_file_wait(live_file, 1000);
+        if (wait_ret_code != LIVE_FILE_RET_OK && wait_ret_code != LIVE_FILE_RET_TIMEOUT)
+        {
+            return (wait_ret_code == LIVE_FILE_RET_CLOSED) ? DEMO_STREAM_RET_END : DEMO_STREAM_RET_ERROR;
+        }
+    }
+}
+
+//
+// Takes every chunk decompressed so far, blocking only when none is ready yet
+//
+static int wait_for_archive_data(DemoStream *stream)
+{
+    ArchiveFile *archive_file = stream->archive_file;
+    const size_t previous_size = archive_file->data_size;
+
+    while (true)
+    {
+        const int read_ret_code = archive_file_read(archive_file);
+        if (archive_file->data_size > previous_size)
+        {
+            stream->data = archive_file->data;
+            stream->data_size = archive_file->data_size;
+            return DEMO_STREAM_RET_OK;
+        }
+
+        switch (read_ret_code)
+        {
+        case ARCHIVE_FILE_RET_OK:
+            break;
+        case ARCHIVE_FILE_RET_END:
+            return DEMO_STREAM_RET_END;
+        case ARCHIVE_FILE_RET_OOM:
+            return DEMO_STREAM_RET_OOM;
+        default:
+            return DEMO_STREAM_RET_ERROR;
+        }
+
+        archive_file_wait(archive_file);
+    }
+}
+
+//
+// Creates the --export directory and the tables in it. Returns nullptr after printing why
+// it couldn't
+//
+static ArrowExport *open_export(const ParseOptions *options, const EntityEngine *entities, FILE *output)
+{
+    const char *directory = options->export_directory;
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST)
+    {
+        fprintf(output, "Failed to create export directory %s\n", directory);
+        return nullptr;
+    }
+
+    ArrowExport *arrow_export = (ArrowExport *)malloc(sizeof(ArrowExport));
+    if (!arrow_export)
+    {
+        fprintf(output, "Out of memory while starting the export\n");
+        return nullptr;
+    }
+
+    //
+    // Keyframes only list the entities the query asked for events of, all of them for a
+    // change log without one
+    //
+    const bool wants_entities = wants_entity_events(options);
+    const u32 entity_mode = (options->export_changes) ? ARROW_EXPORT_ENTITIES_CHANGES : ARROW_EXPORT_ENTITIES_SNAPSHOT;
+
+    const int ret_code = arrow_export_open(arrow_export, directory, 0, entity_mode, (wants_entities) ? entities : nullptr);
+    if (ret_code != ARROW_EXPORT_RET_OK)
+    {
+        fprintf(output, "Failed to start the export (%d)\n", ret_code);
+        free(arrow_export);
+        return nullptr;
+    }
+
+    return arrow_export;
+}
+
+//
+// Finishes and frees the export, printing how many rows each table got
+//
+static int close_export(ArrowExport *arrow_export, FILE *output)
+{
+    const int ret_code = arrow_export_close(arrow_export);
+    if (ret_code == ARROW_EXPORT_RET_OK)
+    {
+        fprintf(output, "Exported:       %llu frames, %llu messages, %llu game event rows, %llu entity rows\n",
+                (unsigned long long)arrow_export->tables[ARROW_EXPORT_TABLE_FRAMES].total_rows,
+                (unsigned long long)arrow_export->tables[ARROW_EXPORT_TABLE_MESSAGES].total_rows,
+                (unsigned long long)arrow_export->tables[ARROW_EXPORT_TABLE_GAME_EVENTS].total_rows,
+                (unsigned long long)arrow_export->tables[ARROW_EXPORT_TABLE_ENTITIES].total_rows);
+    }
+    else
+    {
+        fprintf(output, "Failed to write the export (%d)\n", ret_code);
+    }
+
+    free(arrow_export);
+
+    return ret_code;
+}
+
+//
+// Drops the bytes of a windowed stream before offset, the parser is done with them
+//
+static void discard_demo_data(DemoStream *stream, size_t offset)
+{
+    const size_t size = offset - stream->data_offset;
+    if (stream->archive_file)
+    {
+        archive_file_discard(stream->archive_file, size);
+        stream->data = stream->archive_file->data;
+        stream->data_size = stream->archive_file->data_size;
+    }
+    else
+    {
+        live_file_discard(stream->live_file, size);
+        stream->data = stream->live_file->data;
+        stream->data_size = stream->live_file->data_size;
+    }
+    stream->data_offset = offset;
+}
+
+//
+// High-water mark of the whole process, against the budget it was given
+//
+static void print_peak_memory(size_t budget, FILE *output)
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return;
+    }
+
+    //
+    // ru_maxrss is in KiB on Linux
+    //
+    const u64 peak = (u64)usage.ru_maxrss * 1024;
+    fprintf(output, "Peak RSS:       %.1f MiB of a %.1f MiB budget%s\n", (f64)peak / (1024.0 * 1024.0), (f64)budget / (1024.0 * 1024.0),
+            (peak > budget) ? ", over budget" : "");
+}
+
+static void print_parse_stats(const ParseStats *stats, u32 stats_format, FILE *output)
+{
+    if (stats_format == STATS_FORMAT_JSON)
+    {
+        parse_stats_print_json(stats, output);
+    }
+    else
+    {
+        parse_stats_print(stats, output);
+    }
+}
+
+//
+// Splits the demo at its full packets and parses the spans concurrently. Output is the
+// same as a sequential parse, apart from the per-demo summary lines
+//
+static int parse_demo_parallel(const DemoFile *demo_file, const FrameIndex *frame_index, const ParseOptions *options, FILE *output)
+{
+    DemoParallelOptions parallel_options;
+    demo_parallel_options_init(&parallel_options);
+    parallel_options.parser_options.event_mask = DEMO_EVENT_MASK_ALL & ~DEMO_EVENT_MASK(DEMO_EVENT_ENTITY);
+    parallel_options.parser_options.log_handler = print_log_message;
+    parallel_options.parser_options.log_level = LOG_LEVEL_DEBUG;
+    set_parser_query(&parallel_options.parser_options, options);
+    parallel_options.game_events = options->game_events;
+    parallel_options.game_event_count = options->game_event_count;
+    parallel_options.thread_count = options->thread_count;
+    parallel_options.start = start_parallel_span;
+    parallel_options.handler = print_parallel_span_event;
+    parallel_options.merge = merge_parallel_span;
+
+    ParallelMerge merge;
+    merge.output = output;
+    merge.result = DEMO_PARSER_RET_OK;
+    parallel_options.user_data = &merge;
+
+    if (parallel_options.thread_count == 0)
+    {
+        const long online_count = sysconf(_SC_NPROCESSORS_ONLN);
+        parallel_options.thread_count = (online_count > 0) ? (u32)online_count : 1;
+    }
+
+    if (options->serializer_cache_directory)
+    {
+        parallel_options.parser_options.serializer_load = load_cached_serializers;
+        parallel_options.parser_options.serializer_store = store_cached_serializers;
+        parallel_options.parser_options.serializer_user_data = (void *)options->serializer_cache_directory;
+    }
+
+    if (options->stats_format != STATS_FORMAT_NONE)
+    {
+        fprintf(output, "--stats isn't supported with --parallel\n");
+    }
+
+    DemoParallelStats stats;
+    const int ret_code = demo_parallel_run(demo_file->data, demo_file->data_size, frame_index, &parallel_options, &stats);
+    if (ret_code == DEMO_PARALLEL_RET_OOM)
+    {
+        fprintf(output, "Out of memory while splitting the demo\n");
+        return PARSE_DEMO_RET_OOM;
+    }
+
+    fprintf(output, "Parsed %u spans on %u threads in %.3fs\n", stats.span_count, stats.thread_count, stats.seconds);
+
+    //
+    // The run only stops when a span failed, merge kept the first result
+    //
+    return parse_demo_result(merge.result);
+}
+
+//
+// Batch job, parses one demo with its output going to its own file
+//
+static int parse_batch_demo(void *user_data, u32 worker_index, BatchJob *job)
+{
+    UNUSED(worker_index);
+
+    const BatchOptions *batch_options = (const BatchOptions *)user_data;
+
+    //
+    // Demos of the same name from different directories would share a log in the output
+    // directory, the second and later get <demo>.<n>.log
+    //
+    char output_path[4096];
+    const char *file_name = strrchr(job->path, '/');
+    file_name = (file_name) ? file_name + 1 : job->path;
+    const int length = (!batch_options->output_directory) ? snprintf(output_path, sizeof(output_path), "%s.log", job->path)
+                       : (job->name_index > 0)
+                           ? snprintf(output_path, sizeof(output_path), "%s/%s.%u.log", batch_options->output_directory, file_name, job->name_index)
+                           : snprintf(output_path, sizeof(output_path), "%s/%s.log", batch_options->output_directory, file_name);
+
+    if (length < 0 || (size_t)length >= sizeof(output_path))
+    {
+        return PARSE_DEMO_RET_OPEN_ERROR;
     }
-    default:
-        log_debug("Unsupported packet type. Skipping\n");
+
+    FILE *output = fopen(output_path, "w");
+    if (!output)
+    {
+        return PARSE_DEMO_RET_OPEN_ERROR;
     }
-    return 0;
+
+    const int ret_code = parse_demo_cached(job->path, job, &batch_options->parse_options, output);
+
+    fclose(output);
+
+    return ret_code;
 }
 
-static size_t min_uint(size_t a, size_t b)
+//
+// Answers from the result cache when the demo was parsed with the same options before.
+// Otherwise the parse writes into the cache and its output is copied out once it's done,
+// only successful parses are kept. job is the batch job of the demo, nullptr outside a
+// batch
+//
+static int parse_demo_cached(const char *demo_path, const BatchJob *job, const ParseOptions *options, FILE *output)
 {
-    return (a < b) ? a : b;
+    const ResultCache *cache = &options->result_cache;
+
+    if (!cache->directory || strcmp(demo_path, "-") == 0)
+    {
+        return parse_demo_source(demo_path, job, options, output);
+    }
+
+    //
+    // A demo read ahead by the batch is hashed in place, anything else is hashed from
+    // the file a block at a time so a memory budget holds
+    //
+    u64 demo_hash;
+    if (job && job->data)
+    {
+        demo_hash = result_cache_hash_data(job->data, job->data_size);
+    }
+    else if (result_cache_hash_file(demo_path, &demo_hash) != RESULT_CACHE_RET_OK)
+    {
+        return parse_demo_source(demo_path, job, options, output);
+    }
+
+    const int lookup_ret_code = result_cache_lookup(cache, demo_hash, options->result_config_hash, output);
+    if (lookup_ret_code == RESULT_CACHE_RET_OK)
+    {
+        return PARSE_DEMO_RET_OK;
+    }
+    if (lookup_ret_code != RESULT_CACHE_RET_MISS)
+    {
+        log_warn("Failed to read result cache entry for %s\n", demo_path);
+    }
+
+    ResultCacheWriter writer;
+    if (result_cache_begin(cache, demo_hash, options->result_config_hash, &writer) != RESULT_CACHE_RET_OK)
+    {
+        log_warn("Failed to create result cache entry for %s\n", demo_path);
+        return parse_demo_source(demo_path, job, options, output);
+    }
+
+    const int ret_code = parse_demo_source(demo_path, job, options, writer.file);
+
+    if (result_cache_end(cache, &writer, ret_code == PARSE_DEMO_RET_OK, output) != RESULT_CACHE_RET_OK)
+    {
+        log_warn("Failed to store result cache entry for %s\n", demo_path);
+    }
+
+    return ret_code;
 }
 
-static size_t max_uint(size_t a, size_t b)
+//
+// Parses the demo the batch read ahead for job, or the file at demo_path
+//
+static int parse_demo_source(const char *demo_path, const BatchJob *job, const ParseOptions *options, FILE *output)
 {
-    return (a < b) ? a : b;
+    if (job && job->data)
+    {
+        DemoFile demo_file = {
+            .data = (u8 *)job->data,
+            .data_size = job->data_size,
+            .mtime_ns = job->mtime_ns,
+            .is_mapped = false,
+            .is_borrowed = true,
+        };
+        return parse_demo_file(&demo_file, demo_path, options, output);
+    }
+
+    return parse_demo(demo_path, options, output);
 }
 
-static void print_usage()
+//
+// Hash of every option that changes what gets printed for a demo. Lists are hashed in
+// the order given, the same names in another order only cost a second entry
+//
+static u64 hash_result_config(const ParseOptions *options)
 {
-    printf("Usage: " APP_NAME " <input_demo_file>\n");
+    const DemoQuery *query = &options->query;
+
+    char config[512];
+    const int length = snprintf(config, sizeof(config), "v%u seek=%d:%u parallel=%d:%u budget=%zu ticks=%u-%u commands=%08x", RESULT_CONFIG_VERSION,
+                                options->has_seek_tick, options->seek_tick, options->parallel,
+                                (options->parallel) ? options->thread_count : 0, options->memory_budget, query->tick_min, query->tick_max, query->command_mask);
+
+    u64 hash = hash_xxh64(config, (size_t)length, 0);
+
+    //
+    // Counts go in with the names so lists can't run into each other
+    //
+    const u32 counts[4] = { options->game_event_count, query->message_id_count, query->entity_class_count, query->entity_field_count };
+    hash = hash_xxh64(counts, sizeof(counts), hash);
+    if (query->message_id_count > 0)
+    {
+        hash = hash_xxh64(query->message_ids, query->message_id_count * sizeof(u32), hash);
+    }
+
+    for (u32 i = 0; i < options->game_event_count; i++)
+    {
+        hash = hash_xxh64(options->game_events[i], strlen(options->game_events[i]) + 1, hash);
+    }
+    for (u32 i = 0; i < query->entity_class_count; i++)
+    {
+        hash = hash_xxh64(query->entity_classes[i], strlen(query->entity_classes[i]) + 1, hash);
+    }
+    for (u32 i = 0; i < query->entity_field_count; i++)
+    {
+        hash = hash_xxh64(query->entity_fields[i], strlen(query->entity_fields[i]) + 1, hash);
+    }
+
+    return hash;
 }
 
-int main(int argc, char *argv[])
+static int run_batch(char **paths, u32 path_count, u32 thread_count, const BatchOptions *batch_options)
 {
-    if (argc != 2)
+    if (batch_options->output_directory && mkdir(batch_options->output_directory, 0755) != 0 && errno != EEXIST)
     {
-        print_usage();
+        printf("Failed to create output directory %s\n", batch_options->output_directory);
         return 1;
     }
 
-    const char *demo_path = argv[1];
-    FILE *demo_file = fopen(demo_path, "rb");
+    BatchJobList jobs;
+    batch_job_list_init(&jobs);
+
+    for (u32 i = 0; i < path_count; i++)
+    {
+        if (batch_job_list_add(&jobs, paths[i]) != BATCH_RET_OK)
+        {
+            printf("Failed to add %s to the batch\n", paths[i]);
+            batch_job_list_free(&jobs);
+            return 1;
+        }
+    }
+
+    if (thread_count == 0)
+    {
+        const long online_count = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = (online_count > 0) ? (u32)online_count : 1;
+    }
 
-    if (!demo_file)
+    BatchStats stats;
+    if (batch_run(&jobs, thread_count, batch_options->read_mode, parse_batch_demo, (void *)batch_options, &stats) != BATCH_RET_OK)
     {
-        printf("Failed to open demo file\n");
+        printf("Out of memory while starting the batch\n");
+        batch_job_list_free(&jobs);
         return 1;
     }
 
-    fseek(demo_file, 0, SEEK_END);
-    const long file_size = ftell(demo_file);
-    fseek(demo_file, 0, SEEK_SET);
+    for (u32 i = 0; i < jobs.job_count; i++)
+    {
+        if (jobs.jobs[i].result != PARSE_DEMO_RET_OK)
+        {
+            printf("Failed: %s (%d)\n", jobs.jobs[i].path, jobs.jobs[i].result);
+        }
+    }
+
+    const u32 worker_count = (u32)min_uint(thread_count, max_uint(stats.demo_count, 1));
+    const f64 seconds = (stats.seconds > 0.0) ? stats.seconds : 1e-9;
+    printf("Parsed %u demos (%u failed) on %u threads in %.3fs\n", stats.demo_count, stats.failed_count, worker_count, stats.seconds);
+    printf("Throughput: %.2f demos/sec, %.2f MB/sec\n", (f64)stats.demo_count / seconds, ((f64)stats.byte_count / (1024.0 * 1024.0)) / seconds);
+
+    if (stats.read_mode != BATCH_READ_NONE)
+    {
+        printf("Read ahead with %s, workers waited %.3fs for reads in total\n", (stats.read_mode == BATCH_READ_IO_URING) ? "io_uring" : "pread",
+               stats.read_wait_seconds);
+    }
 
-    u8 *buffer = (u8 *)malloc(file_size);
+    if (batch_options->parse_options.memory_budget > 0)
+    {
+        print_peak_memory(batch_options->parse_options.memory_budget * worker_count, stdout);
+    }
+
+    const bool any_failed = stats.failed_count > 0;
+    batch_job_list_free(&jobs);
+
+    return (any_failed) ? 1 : 0;
+}
 
-    if (fread(buffer, file_size, 1, demo_file) != 1)
+//
+// Entity classes or fields ask for entity events, nothing else reports them
+//
+static void set_parser_query(DemoParserOptions *parser_options, const ParseOptions *options)
+{
+    parser_options->query = options->query;
+    parser_options->entity_changes = options->export_changes;
+    if (wants_entity_events(options))
     {
-        printf("Failed to read demo file\n");
+        parser_options->event_mask |= DEMO_EVENT_MASK(DEMO_EVENT_ENTITY);
     }
+}
 
-    fclose(demo_file);
+//
+// A query for entity classes or fields asks for their events. A change log without one
+// covers every entity, otherwise it would only ever hold keyframes
+//
+static bool wants_entity_events(const ParseOptions *options)
+{
+    return options->query.entity_class_count > 0 || options->query.entity_field_count > 0 || options->export_changes;
+}
 
-    DemoHeader *demo_header = (DemoHeader *)buffer;
-    demo_header_to_string(*demo_header);
+//
+// <first>-<last>, either side may be left out, or a single tick
+//
+static bool parse_tick_range(const char *text, DemoQuery *query)
+{
+    char *end = nullptr;
+    const char *dash = strchr(text, '-');
 
-    Parser parser;
-    parser_init(&parser);
+    if (!dash)
+    {
+        query->tick_min = (u32)strtoul(text, &end, 10);
+        query->tick_max = query->tick_min;
+        return end != text && *end == '\0';
+    }
 
-    parser.data = buffer;
-    parser.data_size = file_size;
-    parser.pos = sizeof(DemoHeader);
+    if (dash != text)
+    {
+        query->tick_min = (u32)strtoul(text, &end, 10);
+        if (end != dash)
+        {
+            return false;
+        }
+    }
 
-    int ret_code = PARSER_NEXT_PACKET_RET_END;
-    do
+    if (dash[1] != '\0')
     {
-        DemoPacket packet;
-        ret_code = parser_next_packet(&parser, &packet);
+        query->tick_max = (u32)strtoul(dash + 1, &end, 10);
+        if (end == dash + 1 || *end != '\0')
+        {
+            return false;
+        }
+    }
+
+    return query->tick_min <= query->tick_max;
+}
 
-        const double percent = (((double)parser.pos / (double)parser.data_size)) * 100.0;
-        log_debug("== %zu / %zu (%f%%) ==\n", parser.pos, parser.data_size, percent);
+//
+// Comma separated command numbers or names, e.g. packet,full-packet,5
+//
+static bool parse_command_mask(char *text, DemoQuery *query)
+{
+    const char *names[DEMO_COMMAND_MAX + 1];
+    const u32 name_count = split_names(text, names, DEMO_COMMAND_MAX + 1);
 
-        switch (ret_code)
+    query->command_mask = 0;
+    for (u32 i = 0; i < name_count; i++)
+    {
+        char *end = nullptr;
+        u32 command = (u32)strtoul(names[i], &end, 10);
+        if (end == names[i] || *end != '\0')
         {
-        case PARSER_NEXT_PACKET_RET_OK:
-            log_info("Packet parsed. Type: %s (%d)\n", demo_command_to_string(packet.type), packet.type);
-            if (packet.type == DEMO_COMMAND_STOP)
+            command = DEMO_COMMAND_MAX;
+            for (u32 c = 0; c < DEMO_COMMAND_MAX; c++)
             {
-                log_info("Reached STOP message\n");
-                ret_code = PARSER_NEXT_PACKET_RET_END;
-                break;
+                if (query_name_equal(names[i], demo_command_to_string((int)c)))
+                {
+                    command = c;
+                    break;
+                }
+            }
+        }
+        if (command >= DEMO_COMMAND_MAX)
+        {
+            printf("Unknown demo command: %s\n", names[i]);
+            return false;
+        }
+        query->command_mask |= DEMO_COMMAND_MASK(command);
+    }
+
+    return query->command_mask != 0;
+}
+
+//
+// Comma separated message IDs or names, with or without their enum prefix, e.g.
+// svc_PacketEntities,GE_Source1LegacyGameEvent
+//
+static bool parse_message_ids(char *text, ParseOptions *options)
+{
+    const char *names[MAX_QUERY_NAMES];
+    const u32 name_count = split_names(text, names, MAX_QUERY_NAMES);
+
+    for (u32 i = 0; i < name_count; i++)
+    {
+        char *end = nullptr;
+        u32 message_id = (u32)strtoul(names[i], &end, 10);
+        if (end == names[i] || *end != '\0')
+        {
+            message_id = MESSAGE_ID_MAX;
+            for (u32 m = 0; m < MESSAGE_ID_MAX; m++)
+            {
+                //
+                // Names are the full enum names, the part after the last "__" will do
+                //
+                const char *message_name = demo_message_to_string(m);
+                const char *short_name = message_name;
+                for (const char *separator = strstr(short_name, "__"); separator; separator = strstr(short_name, "__"))
+                {
+                    short_name = separator + 2;
+                }
+                if (strcmp(names[i], message_name) == 0 || strcmp(names[i], short_name) == 0)
+                {
+                    message_id = m;
+                    break;
+                }
+            }
+        }
+        if (message_id >= MESSAGE_ID_MAX)
+        {
+            printf("Unknown net message: %s\n", names[i]);
+            return false;
+        }
+        options->message_ids[i] = message_id;
+    }
+
+    options->query.message_ids = options->message_ids;
+    options->query.message_id_count = name_count;
+    return name_count > 0;
+}
+
+//
+// Case, spaces, dashes and underscores don't matter, "full-packet" names "Full Packet"
+//
+static bool query_name_equal(const char *a, const char *b)
+{
+    while (true)
+    {
+        while (*a == ' ' || *a == '-' || *a == '_')
+        {
+            a++;
+        }
+        while (*b == ' ' || *b == '-' || *b == '_')
+        {
+            b++;
+        }
+        if (*a == '\0' || *b == '\0')
+        {
+            return *a == *b;
+        }
+        if (tolower((unsigned char)*a) != tolower((unsigned char)*b))
+        {
+            return false;
+        }
+        a++;
+        b++;
+    }
+}
+
+static void print_usage()
+{
+    printf("Usage: " APP_NAME " [options] <input_demo_file>\n");
+    printf("       " APP_NAME " --batch [options] <demo_file_or_directory>...\n");
+    printf("       Pass '-' to read the demo from stdin\n");
+    printf("\n");
+    printf("Options:\n");
+    printf("  -j, --threads <count>  Decompress frames on <count> worker threads ahead of the parser.\n");
+    printf("                         In batch mode, parse <count> demos at once (default: one per CPU)\n");
+    printf("                         With --parallel, parse <count> pieces of the demo at once\n");
+    printf("  -i, --index            Write a <input_demo_file>.idx frame index for fast seeking\n");
+    printf("  -s, --seek-tick <tick> Start at the last full packet before <tick>, uses the index\n");
+    printf("  -c, --serializer-cache <dir>\n");
+    printf("                         Reuse entity serializers compiled by earlier demos of the same build\n");
+    printf("  -e, --game-events <names>\n");
+    printf("                         Print the comma separated game events, e.g. player_death,round_end\n");
+    printf("  -p, --parallel         Split the demo at its full packets and parse the pieces on the -j threads\n");
+    printf("                         (default: one per CPU)\n");
+    printf("  -f, --follow[=<secs>]  Follow a demo that is still being recorded, parsing frames as they're written.\n");
+    printf("                         Gives up after <secs> without new data (default: wait for the end)\n");
+    printf("  -b, --batch            Parse every listed demo, and every *.dem in listed directories\n");
+    printf("  -o, --output-dir <dir> Batch mode output directory for <demo>.log files (default: next to each demo)\n");
+    printf("      --batch-io <mode>  How batch mode reads demos: uring (default, pread where unavailable), pread,\n");
+    printf("                         or mmap to have every worker map its own demo\n");
+    printf("      --stats[=json]     Print where the time went per stage, and counts per command and message\n");
+    printf("      --memory-budget <MiB>\n");
+    printf("                         Stream demos through a fixed read window to keep each parse within <MiB>,\n");
+    printf("                         however long the demo. Prints the peak RSS. Not with -i, -s or -p\n");
+    printf("      --export <dir>     Write frames, messages, game events and entity fields as Arrow IPC tables\n");
+    printf("                         into <dir> instead of printing them\n");
+    printf("      --changes          With --export, only write the entity fields each update changed, with every\n");
+    printf("                         field of every entity again at each full packet\n");
+    printf("      --result-cache <dir>\n");
+    printf("                         Print the stored output of demos parsed before with the same options instead\n");
+    printf("                         of parsing them again. Not with --follow, --export, --stats, -i or -c\n");
+    printf("      --result-cache-size <MiB>\n");
+    printf("                         Remove the least recently used outputs past <MiB> (default: 1024)\n");
+    printf("\n");
+    printf("Query options, frames and values outside them are skipped rather than parsed:\n");
+    printf("      --ticks <first>-<last>\n");
+    printf("                         Only parse frames in the tick range, either end may be left out\n");
+    printf("      --commands <list>  Only parse these frame commands, by number or name, e.g. packet,full-packet\n");
+    printf("      --messages <list>  Only print these net messages, by ID or name, e.g. svc_PacketEntities\n");
+    printf("      --entity-classes <list>\n");
+    printf("                         Print the entities of these classes, e.g. CCSPlayerPawn\n");
+    printf("      --fields <list>    Only decode these entity fields and print their values,\n");
+    printf("                         e.g. m_iHealth,CBodyComponent.m_cellX\n");
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option long_options[] = {
+        { "threads", required_argument, nullptr, 'j' },
+        { "index", no_argument, nullptr, 'i' },
+        { "seek-tick", required_argument, nullptr, 's' },
+        { "serializer-cache", required_argument, nullptr, 'c' },
+        { "game-events", required_argument, nullptr, 'e' },
+        { "parallel", no_argument, nullptr, 'p' },
+        { "follow", optional_argument, nullptr, 'f' },
+        { "batch", no_argument, nullptr, 'b' },
+        { "output-dir", required_argument, nullptr, 'o' },
+        { "batch-io", required_argument, nullptr, 'I' },
+        { "stats", optional_argument, nullptr, 'S' },
+        { "memory-budget", required_argument, nullptr, 'B' },
+        { "ticks", required_argument, nullptr, 'T' },
+        { "commands", required_argument, nullptr, 'C' },
+        { "messages", required_argument, nullptr, 'M' },
+        { "entity-classes", required_argument, nullptr, 'E' },
+        { "fields", required_argument, nullptr, 'F' },
+        { "export", required_argument, nullptr, 'X' },
+        { "changes", no_argument, nullptr, 'D' },
+        { "result-cache", required_argument, nullptr, 'R' },
+        { "result-cache-size", required_argument, nullptr, 'Z' },
+        { "help", no_argument, nullptr, 'h' },
+        { nullptr, 0, nullptr, 0 },
+    };
+
+    u32 thread_count = 0;
+    bool batch_mode = false;
+    const char *result_cache_directory = nullptr;
+    u64 result_cache_size = RESULT_CACHE_DEFAULT_MAX_SIZE;
+
+    BatchOptions batch_options;
+    memset(&batch_options, 0, sizeof(batch_options));
+    ParseOptions *options = &batch_options.parse_options;
+    batch_options.read_mode = BATCH_READ_IO_URING;
+    demo_query_init(&options->query);
+
+    int option;
+    while ((option = getopt_long(argc, argv, "j:is:c:e:pf::bo:h", long_options, nullptr)) != -1)
+    {
+        switch (option)
+        {
+        case 'j':
+            thread_count = (u32)strtoul(optarg, nullptr, 10);
+            break;
+        case 'i':
+            options->write_index = true;
+            break;
+        case 's':
+            options->has_seek_tick = true;
+            options->seek_tick = (u32)strtoul(optarg, nullptr, 10);
+            break;
+        case 'c':
+            options->serializer_cache_directory = optarg;
+            break;
+        case 'e':
+            options->game_event_count = split_names(optarg, options->game_events, MAX_GAME_EVENTS);
+            break;
+        case 'p':
+            options->parallel = true;
+            break;
+        case 'f':
+            options->follow = true;
+            options->follow_idle_seconds = (optarg) ? (u32)strtoul(optarg, nullptr, 10) : 0;
+            break;
+        case 'b':
+            batch_mode = true;
+            break;
+        case 'o':
+            batch_options.output_directory = optarg;
+            break;
+        case 'I':
+            if (strcmp(optarg, "uring") == 0)
+            {
+                batch_options.read_mode = BATCH_READ_IO_URING;
+            }
+            else if (strcmp(optarg, "pread") == 0)
+            {
+                batch_options.read_mode = BATCH_READ_PREAD;
+            }
+            else if (strcmp(optarg, "mmap") == 0)
+            {
+                batch_options.read_mode = BATCH_READ_NONE;
             }
             else
             {
-                process_demo_packet(packet);
+                print_usage();
+                return 1;
+            }
+            break;
+        case 'S':
+            if (optarg && strcmp(optarg, "json") != 0)
+            {
+                print_usage();
+                return 1;
+            }
+#ifndef PARSE_STATS
+            printf("Built without PARSE_STATS, --stats has nothing to report\n");
+#endif
+            options->stats_format = (optarg) ? STATS_FORMAT_JSON : STATS_FORMAT_TEXT;
+            break;
+        case 'B':
+            options->memory_budget = (size_t)strtoull(optarg, nullptr, 10) * 1024 * 1024;
+            if (options->memory_budget < MEMORY_BUDGET_MIN)
+            {
+                printf("--memory-budget needs at least %u MiB\n", MEMORY_BUDGET_MIN / (1024 * 1024));
+                return 1;
+            }
+            break;
+        case 'T':
+            if (!parse_tick_range(optarg, &options->query))
+            {
+                print_usage();
+                return 1;
+            }
+            break;
+        case 'C':
+            if (!parse_command_mask(optarg, &options->query))
+            {
+                print_usage();
+                return 1;
+            }
+            break;
+        case 'M':
+            if (!parse_message_ids(optarg, options))
+            {
+                print_usage();
+                return 1;
             }
             break;
-        case PARSER_NEXT_PACKET_RET_DECOMPRESS_ERROR:
-            log_err("Failed to decompress demo packet. Skipping\n");
+        case 'E':
+            options->query.entity_class_count = split_names(optarg, options->entity_classes, MAX_QUERY_NAMES);
+            options->query.entity_classes = options->entity_classes;
+            break;
+        case 'F':
+            options->query.entity_field_count = split_names(optarg, options->entity_fields, MAX_QUERY_NAMES);
+            options->query.entity_fields = options->entity_fields;
+            break;
+        case 'X':
+            options->export_directory = optarg;
             break;
-        case PARSER_NEXT_PACKET_RET_OOM:
-            log_err("Out of memory. Terminating process\n");
-            exit(EXIT_FAILURE);
+        case 'D':
+            options->export_changes = true;
             break;
+        case 'R':
+            result_cache_directory = optarg;
+            break;
+        case 'Z':
+            result_cache_size = (u64)strtoull(optarg, nullptr, 10) * 1024 * 1024;
+            break;
+        case 'h':
+            print_usage();
+            return 0;
         default:
-            //
-            // Fall through
-            //
+            print_usage();
+            return 1;
         }
-    } while (ret_code != PARSER_NEXT_PACKET_RET_END);
+    }
 
-    free(buffer);
+    //
+    // Entities need their state from before the first tick. With the frame index the
+    // parse starts at the last full packet before it instead of the start of the demo
+    //
+    const bool wants_entities = wants_entity_events(options);
+    if (wants_entities && options->query.tick_min > 0 && !options->has_seek_tick && options->memory_budget == 0)
+    {
+        options->has_seek_tick = true;
+        options->seek_tick = options->query.tick_min;
+    }
 
-    return 0;
+    //
+    // The export is one set of tables written in event order, batch mode would need one
+    // per demo and parallel spans would interleave their rows
+    //
+    if (options->export_directory && (batch_mode || options->parallel))
+    {
+        printf("--export can't be combined with --batch or --parallel\n");
+        return 1;
+    }
+    //
+    // Those need the whole demo in memory
+    //
+    if (options->memory_budget > 0 && (options->write_index || options->has_seek_tick || options->parallel))
+    {
+        printf("--memory-budget can't be combined with --index, --seek-tick or --parallel\n");
+        return 1;
+    }
+    if (options->export_changes && !options->export_directory)
+    {
+        printf("--changes needs --export\n");
+        return 1;
+    }
+    //
+    // Followed demos are still changing, exports go to their own files and the stats
+    // are timings, none of which a stored output can stand in for. -i writes a sidecar
+    // next to the demo and -c reports whether the serializer cache had it, a hit would
+    // skip the first and replay the second from another run
+    //
+    if (result_cache_directory && (options->follow || options->export_directory || options->stats_format != STATS_FORMAT_NONE || options->write_index ||
+                                   options->serializer_cache_directory))
+    {
+        printf("--result-cache can't be combined with --follow, --export, --stats, --index or --serializer-cache\n");
+        return 1;
+    }
+    if (result_cache_directory && result_cache_open(&options->result_cache, result_cache_directory, result_cache_size) != RESULT_CACHE_RET_OK)
+    {
+        printf("Failed to create result cache directory %s\n", result_cache_directory);
+        return 1;
+    }
+
+    if (batch_mode)
+    {
+        if (optind >= argc)
+        {
+            print_usage();
+            return 1;
+        }
+
+        //
+        // Workers parse whole demos, decompressing frames ahead of each one or splitting
+        // it would only oversubscribe the CPUs
+        //
+        options->thread_count = 0;
+        options->parallel = false;
+        options->follow = false;
+        //
+        // Workers stream their own demos, reading them ahead whole would break the budget
+        //
+        if (options->memory_budget > 0)
+        {
+            batch_options.read_mode = BATCH_READ_NONE;
+        }
+        options->result_config_hash = hash_result_config(options);
+        return run_batch(&argv[optind], (u32)(argc - optind), thread_count, &batch_options);
+    }
+
+    if (optind != argc - 1)
+    {
+        print_usage();
+        return 1;
+    }
+
+    options->thread_count = thread_count;
+    options->result_config_hash = hash_result_config(options);
+
+    const int ret_code = parse_demo_cached(argv[optind], nullptr, options, stdout);
+
+    if (options->memory_budget > 0)
+    {
+        print_peak_memory(options->memory_budget, stdout);
+    }
+
+    return (ret_code == PARSE_DEMO_RET_OK) ? 0 : 1;
 }
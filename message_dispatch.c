@@ -0,0 +1,121 @@
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "message_dispatch.h"
+#include "bitstream.h"
+#include "parse_stats.h"
+
+static bool message_dispatcher_reserve_scratch(MessageDispatcher *dispatcher, size_t size);
+
+void message_dispatcher_init(MessageDispatcher *dispatcher)
+{
+    memset(dispatcher->handlers, 0, sizeof(dispatcher->handlers));
+    dispatcher->scratch = nullptr;
+    dispatcher->scratch_size = 0;
+    dispatcher->stats = nullptr;
+}
+
+void message_dispatcher_free(MessageDispatcher *dispatcher)
+{
+    free(dispatcher->scratch);
+    dispatcher->scratch = nullptr;
+    dispatcher->scratch_size = 0;
+}
+
+void message_dispatcher_register(MessageDispatcher *dispatcher, u32 message_id, MessageHandler handler, void *user_data)
+{
+    assert(message_id < MESSAGE_ID_MAX);
+
+    dispatcher->handlers[message_id].handler = handler;
+    dispatcher->handlers[message_id].user_data = user_data;
+}
+
+static bool message_dispatcher_reserve_scratch(MessageDispatcher *dispatcher, size_t size)
+{
+    if (dispatcher->scratch_size >= size)
+    {
+        return true;
+    }
+
+    const size_t min_allocation = 64 * 1024;
+    const size_t alloc_size = (size > min_allocation) ? size : min_allocation;
+    u8 *new_scratch = (u8 *)realloc(dispatcher->scratch, alloc_size);
+    if (!new_scratch)
+    {
+        return false;
+    }
+
+    dispatcher->scratch = new_scratch;
+    dispatcher->scratch_size = alloc_size;
+
+    PARSE_STATS_ADD(dispatcher->stats, buffer_reallocations, 1);
+
+    return true;
+}
+
+int message_dispatcher_run(MessageDispatcher *dispatcher, const u8 *data, size_t size)
+{
+    Bitstream bitstream = bitstream_create(data, size);
+
+    //
+    // The shortest message is 14 bits (6 bit type, 8 bit size). Anything less is padding
+    //
+    while (bitstream_bits_left(&bitstream) >= 14)
+    {
+        const u32 message_id = bitstream_read_ubitvar(&bitstream);
+        const u32 message_size = bitstream_read_varint32(&bitstream);
+
+        if (bitstream.overflowed || (size_t)message_size * 8u > bitstream_bits_left(&bitstream))
+        {
+            return MESSAGE_DISPATCH_RET_MALFORMED;
+        }
+
+        const MessageHandlerEntry *entry = (message_id < MESSAGE_ID_MAX) ? &dispatcher->handlers[message_id] : nullptr;
+
+#ifdef PARSE_STATS
+        if (entry)
+        {
+            PARSE_STATS_COUNT(dispatcher->stats, messages[message_id], message_size);
+        }
+        else
+        {
+            PARSE_STATS_COUNT(dispatcher->stats, other_messages, message_size);
+        }
+#endif
+
+        if (!entry || !entry->handler)
+        {
+            bitstream_skip(&bitstream, (size_t)message_size * 8u);
+            continue;
+        }
+
+        const size_t bit_pos = bitstream_tell(&bitstream);
+        const u8 *payload = nullptr;
+
+        if (bit_pos % 8u == 0)
+        {
+            payload = data + bit_pos / 8u;
+            bitstream_skip(&bitstream, (size_t)message_size * 8u);
+        }
+        else
+        {
+            if (!message_dispatcher_reserve_scratch(dispatcher, message_size))
+            {
+                return MESSAGE_DISPATCH_RET_OOM;
+            }
+            bitstream_read_bytes(&bitstream, dispatcher->scratch, message_size);
+            payload = dispatcher->scratch;
+        }
+
+        const int handler_result = entry->handler(entry->user_data, message_id, payload, message_size);
+        if (handler_result != 0)
+        {
+            return handler_result;
+        }
+    }
+
+    return MESSAGE_DISPATCH_RET_OK;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+//
+// Demultiplexes the net messages embedded in a packet's data. Every message is a
+// UBitVar type, a varint size and the payload. Handlers are looked up in a table
+// indexed by message type; messages nobody registered for are skipped by size
+// without being looked at.
+//
+
+#include "common.h"
+
+//
+// Covers the NET_, SVC_, user message, game event and CS user message ranges
+//
+#define MESSAGE_ID_MAX 1024
+
+//
+// data is only valid for the duration of the call. Returning non-zero stops the walk,
+// MESSAGE_DISPATCH_RET_MALFORMED for a message the handler couldn't decode
+//
+typedef int (*MessageHandler)(void *user_data, u32 message_id, const u8 *data, u32 size);
+
+typedef struct
+{
+    MessageHandler handler;
+    void *user_data;
+} MessageHandlerEntry;
+
+typedef struct ParseStats ParseStats;
+
+typedef struct
+{
+    MessageHandlerEntry handlers[MESSAGE_ID_MAX];
+    //
+    // Payloads that don't start on a byte boundary are copied here before being handed out
+    //
+    u8 *scratch;
+    size_t scratch_size;
+    //
+    // Per message counts go here when set, see parse_stats.h
+    //
+    ParseStats *stats;
+} MessageDispatcher;
+
+#define MESSAGE_DISPATCH_RET_OK 0
+#define MESSAGE_DISPATCH_RET_MALFORMED 1
+#define MESSAGE_DISPATCH_RET_OOM 2
+
+void message_dispatcher_init(MessageDispatcher *dispatcher);
+void message_dispatcher_free(MessageDispatcher *dispatcher);
+
+//
+// Replaces any handler already registered for message_id. Pass nullptr to unregister
+//
+void message_dispatcher_register(MessageDispatcher *dispatcher, u32 message_id, MessageHandler handler, void *user_data);
+
+//
+// Walks every message in a packet and calls the registered handlers in order. Stops at
+// the first handler returning non-zero and returns its result
+//
+int message_dispatcher_run(MessageDispatcher *dispatcher, const u8 *data, size_t size);
@@ -0,0 +1,249 @@
+#include <string.h>
+
+#include "message_views.h"
+
+bool cdemo_packet_view_data(const u8 *data, size_t size, WireBytes *out_data)
+{
+    out_data->data = nullptr;
+    out_data->size = 0;
+
+    WireReader reader = wire_reader_create(data, size);
+    WireField field;
+
+    while (wire_reader_next(&reader, &field))
+    {
+        if (field.number == CDEMO_PACKET_FIELD_DATA && field.wire_type == WIRE_TYPE_LENGTH_DELIMITED)
+        {
+            *out_data = field.bytes;
+        }
+    }
+
+    return !reader.malformed;
+}
+
+bool cdemo_full_packet_view(const u8 *data, size_t size, WireBytes *out_string_table, WireBytes *out_packet)
+{
+    memset(out_string_table, 0, sizeof(*out_string_table));
+    memset(out_packet, 0, sizeof(*out_packet));
+
+    WireReader reader = wire_reader_create(data, size);
+    WireField field;
+
+    while (wire_reader_next(&reader, &field))
+    {
+        if (field.wire_type != WIRE_TYPE_LENGTH_DELIMITED)
+        {
+            continue;
+        }
+
+        switch (field.number)
+        {
+        case CDEMO_FULL_PACKET_FIELD_STRING_TABLE:
+            *out_string_table = field.bytes;
+            break;
+        case CDEMO_FULL_PACKET_FIELD_PACKET:
+            *out_packet = field.bytes;
+            break;
+        default:
+            break;
+        }
+    }
+
+    return !reader.malformed;
+}
+
+bool server_info_view_parse(const u8 *data, size_t size, ServerInfoView *out_view)
+{
+    memset(out_view, 0, sizeof(*out_view));
+    out_view->player_slot = -1;
+
+    WireReader reader = wire_reader_create(data, size);
+    WireField field;
+
+    while (wire_reader_next(&reader, &field))
+    {
+        switch (field.number)
+        {
+        case CSVCMSG_SERVER_INFO_FIELD_MAX_CLIENTS:
+            out_view->max_clients = (i32)field.value;
+            break;
+        case CSVCMSG_SERVER_INFO_FIELD_MAX_CLASSES:
+            out_view->max_classes = (i32)field.value;
+            break;
+        case CSVCMSG_SERVER_INFO_FIELD_PLAYER_SLOT:
+            out_view->player_slot = (i32)field.value;
+            break;
+        case CSVCMSG_SERVER_INFO_FIELD_TICK_INTERVAL:
+            out_view->tick_interval = wire_value_to_f32(field.value);
+            break;
+        case CSVCMSG_SERVER_INFO_FIELD_MAP_NAME:
+            out_view->map_name = field.bytes;
+            break;
+        default:
+            break;
+        }
+    }
+
+    return !reader.malformed;
+}
+
+bool packet_entities_view_parse(const u8 *data, size_t size, PacketEntitiesView *out_view)
+{
+    memset(out_view, 0, sizeof(*out_view));
+    out_view->delta_from = -1;
+
+    WireReader reader = wire_reader_create(data, size);
+    WireField field;
+
+    while (wire_reader_next(&reader, &field))
+    {
+        switch (field.number)
+        {
+        case CSVCMSG_PACKET_ENTITIES_FIELD_MAX_ENTRIES:
+            out_view->max_entries = (i32)field.value;
+            break;
+        case CSVCMSG_PACKET_ENTITIES_FIELD_UPDATED_ENTRIES:
+            out_view->updated_entries = (i32)field.value;
+            break;
+        case CSVCMSG_PACKET_ENTITIES_FIELD_IS_DELTA:
+            out_view->is_delta = field.value != 0;
+            break;
+        case CSVCMSG_PACKET_ENTITIES_FIELD_UPDATE_BASELINE:
+            out_view->update_baseline = field.value != 0;
+            break;
+        case CSVCMSG_PACKET_ENTITIES_FIELD_BASELINE:
+            out_view->baseline = (i32)field.value;
+            break;
+        case CSVCMSG_PACKET_ENTITIES_FIELD_DELTA_FROM:
+            out_view->delta_from = (i32)field.value;
+            break;
+        case CSVCMSG_PACKET_ENTITIES_FIELD_ENTITY_DATA:
+            out_view->entity_data = field.bytes;
+            break;
+        case CSVCMSG_PACKET_ENTITIES_FIELD_PENDING_FULL_FRAME:
+            out_view->pending_full_frame = field.value != 0;
+            break;
+        case CSVCMSG_PACKET_ENTITIES_FIELD_SERVER_TICK:
+            out_view->server_tick = (u32)field.value;
+            break;
+        default:
+            break;
+        }
+    }
+
+    return !reader.malformed;
+}
+
+bool create_string_table_view_parse(const u8 *data, size_t size, CreateStringTableView *out_view)
+{
+    memset(out_view, 0, sizeof(*out_view));
+
+    WireReader reader = wire_reader_create(data, size);
+    WireField field;
+
+    while (wire_reader_next(&reader, &field))
+    {
+        switch (field.number)
+        {
+        case CSVCMSG_CREATE_STRING_TABLE_FIELD_NAME:
+            out_view->name = field.bytes;
+            break;
+        case CSVCMSG_CREATE_STRING_TABLE_FIELD_NUM_ENTRIES:
+            out_view->num_entries = (i32)field.value;
+            break;
+        case CSVCMSG_CREATE_STRING_TABLE_FIELD_USER_DATA_FIXED_SIZE:
+            out_view->user_data_fixed_size = field.value != 0;
+            break;
+        case CSVCMSG_CREATE_STRING_TABLE_FIELD_USER_DATA_SIZE:
+            out_view->user_data_size = (i32)field.value;
+            break;
+        case CSVCMSG_CREATE_STRING_TABLE_FIELD_USER_DATA_SIZE_BITS:
+            out_view->user_data_size_bits = (i32)field.value;
+            break;
+        case CSVCMSG_CREATE_STRING_TABLE_FIELD_FLAGS:
+            out_view->flags = (i32)field.value;
+            break;
+        case CSVCMSG_CREATE_STRING_TABLE_FIELD_STRING_DATA:
+            out_view->string_data = field.bytes;
+            break;
+        case CSVCMSG_CREATE_STRING_TABLE_FIELD_UNCOMPRESSED_SIZE:
+            out_view->uncompressed_size = (i32)field.value;
+            break;
+        case CSVCMSG_CREATE_STRING_TABLE_FIELD_DATA_COMPRESSED:
+            out_view->data_compressed = field.value != 0;
+            break;
+        case CSVCMSG_CREATE_STRING_TABLE_FIELD_USING_VARINT_BITCOUNTS:
+            out_view->using_varint_bitcounts = field.value != 0;
+            break;
+        default:
+            break;
+        }
+    }
+
+    return !reader.malformed;
+}
+
+bool update_string_table_view_parse(const u8 *data, size_t size, UpdateStringTableView *out_view)
+{
+    memset(out_view, 0, sizeof(*out_view));
+
+    WireReader reader = wire_reader_create(data, size);
+    WireField field;
+
+    while (wire_reader_next(&reader, &field))
+    {
+        switch (field.number)
+        {
+        case CSVCMSG_UPDATE_STRING_TABLE_FIELD_TABLE_ID:
+            out_view->table_id = (i32)field.value;
+            break;
+        case CSVCMSG_UPDATE_STRING_TABLE_FIELD_NUM_CHANGED_ENTRIES:
+            out_view->num_changed_entries = (i32)field.value;
+            break;
+        case CSVCMSG_UPDATE_STRING_TABLE_FIELD_STRING_DATA:
+            out_view->string_data = field.bytes;
+            break;
+        default:
+            break;
+        }
+    }
+
+    return !reader.malformed;
+}
+
+bool player_info_view_parse(const u8 *data, size_t size, PlayerInfoView *out_view)
+{
+    memset(out_view, 0, sizeof(*out_view));
+
+    WireReader reader = wire_reader_create(data, size);
+    WireField field;
+
+    while (wire_reader_next(&reader, &field))
+    {
+        switch (field.number)
+        {
+        case CMSG_PLAYER_INFO_FIELD_NAME:
+            out_view->name = field.bytes;
+            break;
+        case CMSG_PLAYER_INFO_FIELD_XUID:
+            out_view->xuid = field.value;
+            break;
+        case CMSG_PLAYER_INFO_FIELD_USERID:
+            out_view->user_id = (i32)field.value;
+            break;
+        case CMSG_PLAYER_INFO_FIELD_STEAMID:
+            out_view->steam_id = field.value;
+            break;
+        case CMSG_PLAYER_INFO_FIELD_FAKEPLAYER:
+            out_view->fake_player = field.value != 0;
+            break;
+        case CMSG_PLAYER_INFO_FIELD_ISHLTV:
+            out_view->is_hltv = field.value != 0;
+            break;
+        default:
+            break;
+        }
+    }
+
+    return !reader.malformed;
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+//
+// Zero-copy views over the demo and net messages the parser touches on every frame.
+// Each view scans the wire format once and keeps borrowed pointers for its bytes
+// fields; nothing is allocated. Messages that are needed in full can still be
+// materialized with the matching protobuf-c *__unpack call.
+//
+
+#include "common.h"
+#include "wire.h"
+
+//
+// CDemoPacket
+//
+#define CDEMO_PACKET_FIELD_DATA 3
+
+//
+// CDemoFullPacket
+//
+#define CDEMO_FULL_PACKET_FIELD_STRING_TABLE 1
+#define CDEMO_FULL_PACKET_FIELD_PACKET 2
+
+//
+// CSVCMsg_ServerInfo
+//
+#define CSVCMSG_SERVER_INFO_FIELD_MAX_CLIENTS 10
+#define CSVCMSG_SERVER_INFO_FIELD_MAX_CLASSES 11
+#define CSVCMSG_SERVER_INFO_FIELD_PLAYER_SLOT 12
+#define CSVCMSG_SERVER_INFO_FIELD_TICK_INTERVAL 13
+#define CSVCMSG_SERVER_INFO_FIELD_MAP_NAME 15
+
+//
+// CSVCMsg_PacketEntities
+//
+#define CSVCMSG_PACKET_ENTITIES_FIELD_MAX_ENTRIES 1
+#define CSVCMSG_PACKET_ENTITIES_FIELD_UPDATED_ENTRIES 2
+#define CSVCMSG_PACKET_ENTITIES_FIELD_IS_DELTA 3
+#define CSVCMSG_PACKET_ENTITIES_FIELD_UPDATE_BASELINE 4
+#define CSVCMSG_PACKET_ENTITIES_FIELD_BASELINE 5
+#define CSVCMSG_PACKET_ENTITIES_FIELD_DELTA_FROM 6
+#define CSVCMSG_PACKET_ENTITIES_FIELD_ENTITY_DATA 7
+#define CSVCMSG_PACKET_ENTITIES_FIELD_PENDING_FULL_FRAME 8
+#define CSVCMSG_PACKET_ENTITIES_FIELD_SERVER_TICK 12
+
+//
+// CSVCMsg_CreateStringTable
+//
+#define CSVCMSG_CREATE_STRING_TABLE_FIELD_NAME 1
+#define CSVCMSG_CREATE_STRING_TABLE_FIELD_NUM_ENTRIES 2
+#define CSVCMSG_CREATE_STRING_TABLE_FIELD_USER_DATA_FIXED_SIZE 3
+#define CSVCMSG_CREATE_STRING_TABLE_FIELD_USER_DATA_SIZE 4
+#define CSVCMSG_CREATE_STRING_TABLE_FIELD_USER_DATA_SIZE_BITS 5
+#define CSVCMSG_CREATE_STRING_TABLE_FIELD_FLAGS 6
+#define CSVCMSG_CREATE_STRING_TABLE_FIELD_STRING_DATA 7
+#define CSVCMSG_CREATE_STRING_TABLE_FIELD_UNCOMPRESSED_SIZE 8
+#define CSVCMSG_CREATE_STRING_TABLE_FIELD_DATA_COMPRESSED 9
+#define CSVCMSG_CREATE_STRING_TABLE_FIELD_USING_VARINT_BITCOUNTS 10
+
+//
+// CSVCMsg_UpdateStringTable
+//
+#define CSVCMSG_UPDATE_STRING_TABLE_FIELD_TABLE_ID 1
+#define CSVCMSG_UPDATE_STRING_TABLE_FIELD_NUM_CHANGED_ENTRIES 2
+#define CSVCMSG_UPDATE_STRING_TABLE_FIELD_STRING_DATA 3
+
+//
+// CMsgPlayerInfo, the value of a userinfo string table entry
+//
+#define CMSG_PLAYER_INFO_FIELD_NAME 1
+#define CMSG_PLAYER_INFO_FIELD_XUID 2
+#define CMSG_PLAYER_INFO_FIELD_USERID 3
+#define CMSG_PLAYER_INFO_FIELD_STEAMID 4
+#define CMSG_PLAYER_INFO_FIELD_FAKEPLAYER 5
+#define CMSG_PLAYER_INFO_FIELD_ISHLTV 6
+
+typedef struct
+{
+    i32 max_clients;
+    i32 max_classes;
+    i32 player_slot;
+    f32 tick_interval;
+    WireBytes map_name;
+} ServerInfoView;
+
+typedef struct
+{
+    i32 max_entries;
+    i32 updated_entries;
+    bool is_delta;
+    bool update_baseline;
+    i32 baseline;
+    i32 delta_from;
+    bool pending_full_frame;
+    u32 server_tick;
+    WireBytes entity_data;
+} PacketEntitiesView;
+
+typedef struct
+{
+    WireBytes name;
+    i32 num_entries;
+    bool user_data_fixed_size;
+    i32 user_data_size;
+    i32 user_data_size_bits;
+    i32 flags;
+    WireBytes string_data;
+    i32 uncompressed_size;
+    bool data_compressed;
+    bool using_varint_bitcounts;
+} CreateStringTableView;
+
+typedef struct
+{
+    i32 table_id;
+    i32 num_changed_entries;
+    WireBytes string_data;
+} UpdateStringTableView;
+
+typedef struct
+{
+    WireBytes name;
+    u64 xuid;
+    i32 user_id;
+    u64 steam_id;
+    bool fake_player;
+    bool is_hltv;
+} PlayerInfoView;
+
+//
+// The embedded net message stream of a CDemoPacket
+//
+bool cdemo_packet_view_data(const u8 *data, size_t size, WireBytes *out_data);
+
+//
+// The string table snapshot and packet of a CDemoFullPacket, either may be missing
+//
+bool cdemo_full_packet_view(const u8 *data, size_t size, WireBytes *out_string_table, WireBytes *out_packet);
+
+bool server_info_view_parse(const u8 *data, size_t size, ServerInfoView *out_view);
+bool packet_entities_view_parse(const u8 *data, size_t size, PacketEntitiesView *out_view);
+bool create_string_table_view_parse(const u8 *data, size_t size, CreateStringTableView *out_view);
+bool update_string_table_view_parse(const u8 *data, size_t size, UpdateStringTableView *out_view);
+bool player_info_view_parse(const u8 *data, size_t size, PlayerInfoView *out_view);
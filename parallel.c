@@ -0,0 +1,351 @@
+#define _GNU_SOURCE
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "parallel.h"
+
+typedef struct
+{
+    const u8 *data;
+    size_t data_size;
+    const FrameIndex *index;
+    const DemoParallelOptions *options;
+
+    DemoSpan *spans;
+    bool *finished;
+    u32 span_count;
+
+    //
+    // Guards next_span and finished
+    //
+    pthread_mutex_t mutex;
+    pthread_cond_t span_finished;
+    u32 next_span;
+    //
+    // Set when a merge hook asked to stop. Checked by the workers on every event
+    //
+    atomic_bool stop;
+} DemoParallelRun;
+
+//
+// Per span state behind the parser's push handler and log handler
+//
+typedef struct
+{
+    DemoParallelRun *run;
+    DemoSpan *span;
+    //
+    // Cleared until the parser jumped to the span's keyframe. Events and logs of the
+    // setup frames were already reported by the first span
+    //
+    bool started;
+    bool wants_seek;
+    LogHandler log_handler;
+    void *log_user_data;
+} DemoSpanContext;
+
+static u32 demo_parallel_plan_spans(DemoSpan *spans, u32 max_span_count, const FrameIndex *index, size_t data_size);
+static void *demo_parallel_worker_run(void *user_data);
+static void demo_parallel_parse_span(DemoParallelRun *run, DemoSpan *span);
+static int demo_parallel_on_event(void *user_data, const DemoEvent *event);
+static void demo_parallel_on_log(void *user_data, int level, const char *message);
+
+void demo_parallel_options_init(DemoParallelOptions *options)
+{
+    memset(options, 0, sizeof(*options));
+    demo_parser_options_init(&options->parser_options);
+}
+
+int demo_parallel_run(const u8 *data, size_t data_size, const FrameIndex *index, const DemoParallelOptions *options, DemoParallelStats *out_stats)
+{
+    u32 thread_count = (options->thread_count > 0) ? options->thread_count : 1;
+    u32 max_span_count = (options->span_count > 0) ? options->span_count : thread_count * DEMO_PARALLEL_SPANS_PER_THREAD;
+    if (max_span_count > index->full_packet_count + 1)
+    {
+        max_span_count = index->full_packet_count + 1;
+    }
+
+    DemoParallelRun run;
+    memset(&run, 0, sizeof(run));
+    atomic_init(&run.stop, false);
+    run.data = data;
+    run.data_size = data_size;
+    run.index = index;
+    run.options = options;
+    run.spans = (DemoSpan *)calloc(max_span_count, sizeof(DemoSpan));
+    run.finished = (bool *)calloc(max_span_count, sizeof(bool));
+
+    if (!run.spans || !run.finished)
+    {
+        free(run.spans);
+        free(run.finished);
+        return DEMO_PARALLEL_RET_OOM;
+    }
+
+    run.span_count = demo_parallel_plan_spans(run.spans, max_span_count, index, data_size);
+    if (thread_count > run.span_count)
+    {
+        thread_count = run.span_count;
+    }
+
+    pthread_t *threads = (pthread_t *)calloc(thread_count, sizeof(pthread_t));
+    if (!threads)
+    {
+        free(run.spans);
+        free(run.finished);
+        return DEMO_PARALLEL_RET_OOM;
+    }
+
+    pthread_mutex_init(&run.mutex, nullptr);
+    pthread_cond_init(&run.span_finished, nullptr);
+
+    struct timespec start_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+    u32 started_count = 0;
+    for (u32 i = 0; i < thread_count; i++)
+    {
+        if (pthread_create(&threads[i], nullptr, demo_parallel_worker_run, &run) != 0)
+        {
+            break;
+        }
+        started_count++;
+    }
+
+    //
+    // Without any worker the calling thread parses every span before merging them
+    //
+    if (started_count == 0)
+    {
+        demo_parallel_worker_run(&run);
+    }
+
+    int ret_code = DEMO_PARALLEL_RET_OK;
+
+    for (u32 i = 0; i < run.span_count; i++)
+    {
+        pthread_mutex_lock(&run.mutex);
+        while (!run.finished[i])
+        {
+            pthread_cond_wait(&run.span_finished, &run.mutex);
+        }
+        pthread_mutex_unlock(&run.mutex);
+
+        if (options->merge && options->merge(options->user_data, &run.spans[i]) != 0 && ret_code == DEMO_PARALLEL_RET_OK)
+        {
+            ret_code = DEMO_PARALLEL_RET_STOPPED;
+            atomic_store(&run.stop, true);
+        }
+    }
+
+    for (u32 i = 0; i < started_count; i++)
+    {
+        pthread_join(threads[i], nullptr);
+    }
+
+    struct timespec end_time;
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+
+    if (out_stats)
+    {
+        out_stats->span_count = run.span_count;
+        out_stats->thread_count = (started_count > 0) ? started_count : 1;
+        out_stats->seconds = (f64)(end_time.tv_sec - start_time.tv_sec) + (f64)(end_time.tv_nsec - start_time.tv_nsec) / 1e9;
+    }
+
+    pthread_cond_destroy(&run.span_finished);
+    pthread_mutex_destroy(&run.mutex);
+    free(threads);
+    free(run.spans);
+    free(run.finished);
+
+    return ret_code;
+}
+
+//
+// Cuts at the first keyframe after each even byte split of the packet data, so spans
+// cost about the same even when full packets aren't evenly spaced
+//
+static u32 demo_parallel_plan_spans(DemoSpan *spans, u32 max_span_count, const FrameIndex *index, size_t data_size)
+{
+    const u64 first_offset = index->first_packet_offset;
+    const u64 packet_bytes = (data_size > first_offset) ? data_size - first_offset : 0;
+
+    spans[0].index = 0;
+    spans[0].keyframe = DEMO_PARSER_KEYFRAME_NONE;
+    spans[0].start_tick = 0;
+    spans[0].start_offset = first_offset;
+    spans[0].result = DEMO_PARSER_RET_END;
+
+    u32 span_count = 1;
+    u32 keyframe = 0;
+
+    for (u32 s = 1; s < max_span_count; s++)
+    {
+        const u64 target_offset = first_offset + packet_bytes * s / max_span_count;
+        while (keyframe < index->full_packet_count && index->entries[index->full_packets[keyframe]].offset < target_offset)
+        {
+            keyframe++;
+        }
+        if (keyframe == index->full_packet_count)
+        {
+            break;
+        }
+
+        const FrameIndexEntry *entry = &index->entries[index->full_packets[keyframe]];
+        if (entry->offset <= spans[span_count - 1].start_offset)
+        {
+            keyframe++;
+            continue;
+        }
+
+        DemoSpan *span = &spans[span_count];
+        span->index = span_count;
+        span->keyframe = keyframe;
+        span->start_tick = entry->tick;
+        span->start_offset = entry->offset;
+        span->result = DEMO_PARSER_RET_END;
+        span_count++;
+        keyframe++;
+    }
+
+    for (u32 i = 0; i + 1 < span_count; i++)
+    {
+        spans[i].end_offset = spans[i + 1].start_offset;
+    }
+    spans[span_count - 1].end_offset = data_size;
+
+    return span_count;
+}
+
+static void *demo_parallel_worker_run(void *user_data)
+{
+    DemoParallelRun *run = (DemoParallelRun *)user_data;
+
+    while (true)
+    {
+        pthread_mutex_lock(&run->mutex);
+        const u32 span_index = run->next_span;
+        if (span_index < run->span_count)
+        {
+            run->next_span++;
+        }
+        pthread_mutex_unlock(&run->mutex);
+
+        if (span_index >= run->span_count)
+        {
+            break;
+        }
+
+        DemoSpan *span = &run->spans[span_index];
+        if (!atomic_load(&run->stop))
+        {
+            demo_parallel_parse_span(run, span);
+        }
+
+        pthread_mutex_lock(&run->mutex);
+        run->finished[span_index] = true;
+        pthread_cond_broadcast(&run->span_finished);
+        pthread_mutex_unlock(&run->mutex);
+    }
+
+    return nullptr;
+}
+
+static void demo_parallel_parse_span(DemoParallelRun *run, DemoSpan *span)
+{
+    const DemoParallelOptions *options = run->options;
+
+    DemoParserOptions parser_options = options->parser_options;
+    parser_options.thread_count = 0;
+    if (options->start)
+    {
+        options->start(options->user_data, span, &parser_options);
+    }
+
+    DemoSpanContext context;
+    context.run = run;
+    context.span = span;
+    context.started = (span->keyframe == DEMO_PARSER_KEYFRAME_NONE);
+    context.wants_seek = (parser_options.event_mask & DEMO_EVENT_MASK(DEMO_EVENT_SEEK)) != 0;
+    context.log_handler = parser_options.log_handler;
+    context.log_user_data = parser_options.log_user_data;
+
+    //
+    // The seek event marks the end of the setup frames
+    //
+    parser_options.event_mask |= DEMO_EVENT_MASK(DEMO_EVENT_SEEK);
+    if (parser_options.log_handler)
+    {
+        parser_options.log_handler = demo_parallel_on_log;
+        parser_options.log_user_data = &context;
+    }
+
+    DemoParser parser;
+    span->result = demo_parser_init(&parser, run->data, run->data_size, &parser_options);
+    if (span->result != DEMO_PARSER_RET_OK)
+    {
+        demo_parser_free(&parser);
+        return;
+    }
+
+    for (u32 i = 0; i < options->game_event_count; i++)
+    {
+        if (demo_parser_subscribe_game_event(&parser, options->game_events[i]) != DEMO_PARSER_RET_OK)
+        {
+            span->result = DEMO_PARSER_RET_OOM;
+            demo_parser_free(&parser);
+            return;
+        }
+    }
+
+    if (span->keyframe != DEMO_PARSER_KEYFRAME_NONE)
+    {
+        demo_parser_seek_keyframe(&parser, run->index, span->keyframe);
+    }
+    demo_parser_set_end_offset(&parser, (size_t)span->end_offset);
+
+    span->result = demo_parser_run(&parser, demo_parallel_on_event, &context);
+
+    demo_parser_free(&parser);
+}
+
+static int demo_parallel_on_event(void *user_data, const DemoEvent *event)
+{
+    DemoSpanContext *context = (DemoSpanContext *)user_data;
+
+    if (event->kind == DEMO_EVENT_SEEK)
+    {
+        const bool was_started = context->started;
+        context->started = true;
+        if (!was_started || !context->wants_seek)
+        {
+            return 0;
+        }
+    }
+
+    if (!context->started)
+    {
+        return 0;
+    }
+
+    if (atomic_load_explicit(&context->run->stop, memory_order_relaxed))
+    {
+        return 1;
+    }
+
+    const DemoParallelOptions *options = context->run->options;
+    return (options->handler) ? options->handler(options->user_data, context->span, event) : 0;
+}
+
+static void demo_parallel_on_log(void *user_data, int level, const char *message)
+{
+    const DemoSpanContext *context = (const DemoSpanContext *)user_data;
+    if (context->started)
+    {
+        context->log_handler(context->log_user_data, level, message);
+    }
+}
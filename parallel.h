@@ -0,0 +1,109 @@
+#pragma once
+
+//
+// Parses a single demo on several threads. DEMO_COMMAND_FULL_PACKET frames carry the
+// complete entity and string table state, so the demo is cut into spans that each start
+// at one of them and every span gets its own parser: it processes the setup frames,
+// jumps to its keyframe, seeds its state from the snapshot and stops where the next
+// span starts. Spans are handed to the workers in file order and merged on the calling
+// thread in the same order, so the merged output is in tick order while later spans
+// are still being parsed.
+//
+// Entities that already existed when a keyframe is reached are reported as created by
+// the span starting there, where a sequential parse reports them as updated.
+//
+
+#include <pthread.h>
+
+#include "common.h"
+#include "demoparser.h"
+#include "frame_index.h"
+
+#define DEMO_PARALLEL_RET_OK 0
+#define DEMO_PARALLEL_RET_OOM 1
+#define DEMO_PARALLEL_RET_STOPPED 2
+
+//
+// Spans per worker when the caller doesn't choose. A few more spans than workers keeps
+// them all busy when spans differ in cost, each extra span parses the setup frames again
+//
+#define DEMO_PARALLEL_SPANS_PER_THREAD 2
+
+typedef struct
+{
+    u32 index;
+    //
+    // Index into FrameIndex.full_packets of the keyframe the span starts at,
+    // DEMO_PARSER_KEYFRAME_NONE for the first span which starts at the beginning
+    //
+    u32 keyframe;
+    u32 start_tick;
+    u64 start_offset;
+    u64 end_offset;
+    //
+    // demo_parser_run result, set once the span was parsed
+    //
+    int result;
+    //
+    // Left to the caller, typically set in the start hook and released in merge
+    //
+    void *user_data;
+} DemoSpan;
+
+//
+// Called on the worker before the span's parser is created. Adjusts the parser options
+// of this span only, e.g. to point logs at a per-span buffer
+//
+typedef void (*DemoSpanStartHook)(void *user_data, DemoSpan *span, DemoParserOptions *parser_options);
+
+//
+// Called on the worker for every event of the span. Spans run concurrently, so this
+// must only touch per-span state. Returning non-zero stops the span
+//
+typedef int (*DemoSpanEventHandler)(void *user_data, DemoSpan *span, const DemoEvent *event);
+
+//
+// Called on the calling thread once per span, in span order, after the span finished.
+// Returning non-zero stops the run, spans not started yet are skipped but still merged
+// with a result of DEMO_PARSER_RET_END
+//
+typedef int (*DemoSpanMergeHook)(void *user_data, DemoSpan *span);
+
+typedef struct
+{
+    //
+    // Used for every span. thread_count is ignored, spans decompress inline
+    //
+    DemoParserOptions parser_options;
+    //
+    // Game events every span's parser subscribes to
+    //
+    const char *const *game_events;
+    u32 game_event_count;
+
+    u32 thread_count;
+    //
+    // Upper bound, 0 for thread_count * DEMO_PARALLEL_SPANS_PER_THREAD. There are never
+    // more spans than full packets plus one
+    //
+    u32 span_count;
+
+    DemoSpanStartHook start;
+    DemoSpanEventHandler handler;
+    DemoSpanMergeHook merge;
+    void *user_data;
+} DemoParallelOptions;
+
+typedef struct
+{
+    u32 span_count;
+    u32 thread_count;
+    f64 seconds;
+} DemoParallelStats;
+
+void demo_parallel_options_init(DemoParallelOptions *options);
+
+//
+// data and index have to describe the same demo. Blocks until every span was merged
+//
+int demo_parallel_run(const u8 *data, size_t data_size, const FrameIndex *index, const DemoParallelOptions *options, DemoParallelStats *out_stats);
@@ -0,0 +1,128 @@
+#define _GNU_SOURCE
+
+#include "parse_stats.h"
+#include "demoparser.h"
+
+static f64 parse_stats_ms(u64 ns);
+
+static f64 parse_stats_ms(u64 ns)
+{
+    return (f64)ns / 1e6;
+}
+
+const char *parse_stats_stage_to_string(u32 stage)
+{
+    switch (stage)
+    {
+    case PARSE_STATS_STAGE_FRAME_HEADER:
+        return "frame_header";
+    case PARSE_STATS_STAGE_DECOMPRESS:
+        return "decompress";
+    case PARSE_STATS_STAGE_PIPELINE_WAIT:
+        return "pipeline_wait";
+    case PARSE_STATS_STAGE_UNPACK:
+        return "protobuf_unpack";
+    case PARSE_STATS_STAGE_SERIALIZERS:
+        return "serializers";
+    case PARSE_STATS_STAGE_DISPATCH:
+        return "message_dispatch";
+    case PARSE_STATS_STAGE_ENTITIES:
+        return "entities";
+    case PARSE_STATS_STAGE_EVENTS:
+        return "event_handlers";
+    default:
+        return "unknown";
+    }
+}
+
+void parse_stats_print(const ParseStats *stats, FILE *output)
+{
+    const f64 total_ms = parse_stats_ms(stats->total_ns);
+
+    fprintf(output, "Stats:\n");
+    fprintf(output, "  Total: %.3f ms\n", total_ms);
+    fprintf(output, "  Stages (message_dispatch includes entities and event_handlers):\n");
+    for (u32 stage = 0; stage < PARSE_STATS_STAGE_COUNT; stage++)
+    {
+        if (stats->stage_calls[stage] == 0)
+        {
+            continue;
+        }
+        const f64 stage_ms = parse_stats_ms(stats->stage_ns[stage]);
+        const f64 percent = (total_ms > 0.0) ? stage_ms / total_ms * 100.0 : 0.0;
+        fprintf(output, "    %-18s %12.3f ms %6.2f%% %12llu calls\n", parse_stats_stage_to_string(stage), stage_ms, percent, (unsigned long long)stats->stage_calls[stage]);
+    }
+
+    fprintf(output, "  Commands:\n");
+    for (u32 command = 0; command <= DEMO_COMMAND_MAX; command++)
+    {
+        const ParseStatsCounter *counter = &stats->commands[command];
+        if (counter->count == 0)
+        {
+            continue;
+        }
+        const char *name = (command == PARSE_STATS_COMMAND_OTHER) ? "Other" : demo_command_to_string((int)command);
+        fprintf(output, "    %-32s %10llu frames %14llu bytes\n", name, (unsigned long long)counter->count, (unsigned long long)counter->bytes);
+    }
+
+    fprintf(output, "  Net messages:\n");
+    for (u32 message_id = 0; message_id < MESSAGE_ID_MAX; message_id++)
+    {
+        const ParseStatsCounter *counter = &stats->messages[message_id];
+        if (counter->count == 0)
+        {
+            continue;
+        }
+        fprintf(output, "    %4u %-42s %10llu messages %14llu bytes\n", message_id, demo_message_to_string(message_id), (unsigned long long)counter->count, (unsigned long long)counter->bytes);
+    }
+    if (stats->other_messages.count > 0)
+    {
+        fprintf(output, "    Out of range IDs %10llu messages %14llu bytes\n", (unsigned long long)stats->other_messages.count, (unsigned long long)stats->other_messages.bytes);
+    }
+
+    const f64 ratio = (stats->compressed_bytes > 0) ? (f64)stats->decompressed_bytes / (f64)stats->compressed_bytes : 0.0;
+    fprintf(output, "  Compressed frames:   %llu bytes -> %llu bytes (%.2fx)\n", (unsigned long long)stats->compressed_bytes, (unsigned long long)stats->decompressed_bytes, ratio);
+    fprintf(output, "  Uncompressed frames: %llu bytes\n", (unsigned long long)stats->uncompressed_bytes);
+    fprintf(output, "  Buffer reallocations: %llu\n", (unsigned long long)stats->buffer_reallocations);
+    fprintf(output, "  Arena block allocations: %llu\n", (unsigned long long)stats->arena_block_allocations);
+}
+
+void parse_stats_print_json(const ParseStats *stats, FILE *output)
+{
+    fprintf(output, "{\"total_ns\":%llu,\"stages\":{", (unsigned long long)stats->total_ns);
+    for (u32 stage = 0; stage < PARSE_STATS_STAGE_COUNT; stage++)
+    {
+        fprintf(output, "%s\"%s\":{\"ns\":%llu,\"calls\":%llu}", (stage) ? "," : "", parse_stats_stage_to_string(stage), (unsigned long long)stats->stage_ns[stage], (unsigned long long)stats->stage_calls[stage]);
+    }
+
+    fprintf(output, "},\"commands\":[");
+    bool first = true;
+    for (u32 command = 0; command <= DEMO_COMMAND_MAX; command++)
+    {
+        const ParseStatsCounter *counter = &stats->commands[command];
+        if (counter->count == 0)
+        {
+            continue;
+        }
+        const char *name = (command == PARSE_STATS_COMMAND_OTHER) ? "Other" : demo_command_to_string((int)command);
+        fprintf(output, "%s{\"id\":%u,\"name\":\"%s\",\"count\":%llu,\"bytes\":%llu}", (first) ? "" : ",", command, name, (unsigned long long)counter->count, (unsigned long long)counter->bytes);
+        first = false;
+    }
+
+    fprintf(output, "],\"messages\":[");
+    first = true;
+    for (u32 message_id = 0; message_id < MESSAGE_ID_MAX; message_id++)
+    {
+        const ParseStatsCounter *counter = &stats->messages[message_id];
+        if (counter->count == 0)
+        {
+            continue;
+        }
+        fprintf(output, "%s{\"id\":%u,\"name\":\"%s\",\"count\":%llu,\"bytes\":%llu}", (first) ? "" : ",", message_id, demo_message_to_string(message_id), (unsigned long long)counter->count, (unsigned long long)counter->bytes);
+        first = false;
+    }
+
+    fprintf(output, "],\"other_messages\":{\"count\":%llu,\"bytes\":%llu}", (unsigned long long)stats->other_messages.count, (unsigned long long)stats->other_messages.bytes);
+    fprintf(output, ",\"compressed_bytes\":%llu,\"decompressed_bytes\":%llu,\"uncompressed_bytes\":%llu", (unsigned long long)stats->compressed_bytes, (unsigned long long)stats->decompressed_bytes, (unsigned long long)stats->uncompressed_bytes);
+    fprintf(output, ",\"buffer_reallocations\":%llu,\"arena_block_allocations\":%llu}\n", (unsigned long long)stats->buffer_reallocations, (unsigned long long)stats->arena_block_allocations);
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+//
+// Profiling counters for the parse loop: wall time per stage, frames and bytes per
+// DEMO_COMMAND_*, messages and bytes per net message ID, compression ratio and buffer
+// growth. Only compiled in when PARSE_STATS is defined, every PARSE_STATS_* macro
+// expands to nothing otherwise. When compiled in, counting only happens for parsers
+// given a ParseStats to fill.
+//
+
+#include <time.h>
+
+#include "common.h"
+#include "demo.h"
+#include "message_dispatch.h"
+
+#define PARSE_STATS_STAGE_FRAME_HEADER 0
+#define PARSE_STATS_STAGE_DECOMPRESS 1
+#define PARSE_STATS_STAGE_PIPELINE_WAIT 2
+#define PARSE_STATS_STAGE_UNPACK 3
+#define PARSE_STATS_STAGE_SERIALIZERS 4
+#define PARSE_STATS_STAGE_DISPATCH 5
+#define PARSE_STATS_STAGE_ENTITIES 6
+#define PARSE_STATS_STAGE_EVENTS 7
+#define PARSE_STATS_STAGE_COUNT 8
+
+//
+// Bucket for commands above DEMO_COMMAND_MAX
+//
+#define PARSE_STATS_COMMAND_OTHER DEMO_COMMAND_MAX
+
+typedef struct
+{
+    u64 count;
+    u64 bytes;
+} ParseStatsCounter;
+
+struct ParseStats
+{
+    //
+    // Stages nest: entities and events run inside dispatch, which is reported inclusive
+    //
+    u64 stage_ns[PARSE_STATS_STAGE_COUNT];
+    u64 stage_calls[PARSE_STATS_STAGE_COUNT];
+    u64 total_ns;
+
+    //
+    // Bytes are after decompression
+    //
+    ParseStatsCounter commands[DEMO_COMMAND_MAX + 1];
+    ParseStatsCounter messages[MESSAGE_ID_MAX];
+    ParseStatsCounter other_messages;
+
+    //
+    // Stored and decompressed size of compressed frames, stored size of the others
+    //
+    u64 compressed_bytes;
+    u64 decompressed_bytes;
+    u64 uncompressed_bytes;
+
+    //
+    // Growth of the decompression, message scratch and event buffers, and blocks the
+    // arenas had to allocate
+    //
+    u64 buffer_reallocations;
+    u64 arena_block_allocations;
+};
+
+typedef struct ParseStats ParseStats;
+
+#ifdef PARSE_STATS
+
+//
+// clock_gettime needs _GNU_SOURCE in every file including this header, directly or
+// through demoparser.h
+//
+static inline u64 parse_stats_now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (u64)now.tv_sec * 1000000000ull + (u64)now.tv_nsec;
+}
+
+#define PARSE_STATS_TIMER_START(stats, name) const u64 name = (stats) ? parse_stats_now_ns() : 0
+
+#define PARSE_STATS_TIMER_STOP(stats, stage, name)                      \
+    do                                                                  \
+    {                                                                   \
+        if (stats)                                                      \
+        {                                                               \
+            (stats)->stage_ns[(stage)] += parse_stats_now_ns() - (name); \
+            (stats)->stage_calls[(stage)]++;                            \
+        }                                                               \
+    } while (0)
+
+#define PARSE_STATS_ADD(stats, field, value) \
+    do                                       \
+    {                                        \
+        if (stats)                           \
+        {                                    \
+            (stats)->field += (value);       \
+        }                                    \
+    } while (0)
+
+#define PARSE_STATS_SET(stats, field, value) \
+    do                                       \
+    {                                        \
+        if (stats)                           \
+        {                                    \
+            (stats)->field = (value);        \
+        }                                    \
+    } while (0)
+
+#define PARSE_STATS_COUNT(stats, counter, byte_count) \
+    do                                                \
+    {                                                 \
+        if (stats)                                    \
+        {                                             \
+            (stats)->counter.count++;                 \
+            (stats)->counter.bytes += (byte_count);   \
+        }                                             \
+    } while (0)
+
+#else
+
+#define PARSE_STATS_TIMER_START(stats, name)
+#define PARSE_STATS_TIMER_STOP(stats, stage, name)
+#define PARSE_STATS_ADD(stats, field, value)
+#define PARSE_STATS_SET(stats, field, value)
+#define PARSE_STATS_COUNT(stats, counter, byte_count)
+
+#endif
+
+const char *parse_stats_stage_to_string(u32 stage);
+
+//
+// Human readable breakdown, or one JSON object
+//
+void parse_stats_print(const ParseStats *stats, FILE *output);
+void parse_stats_print_json(const ParseStats *stats, FILE *output);
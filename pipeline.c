@@ -0,0 +1,242 @@
+#include <stdlib.h>
+
+#include "pipeline.h"
+
+//
+// Frames a worker may run ahead of the consumer, per worker
+//
+#define PACKET_PIPELINE_SLOTS_PER_THREAD 4
+
+static void *packet_pipeline_worker(void *user_data);
+static void packet_pipeline_decode_slot(PacketPipelineSlot *slot);
+
+int packet_pipeline_init(PacketPipeline *pipeline, const u8 *data, size_t data_size, size_t start_pos, u32 thread_count, const DemoFrameFilter *filter)
+{
+    if (thread_count == 0)
+    {
+        thread_count = 1;
+    }
+
+    pipeline->data = data;
+    pipeline->data_size = data_size;
+    pipeline->scan_pos = start_pos;
+    pipeline->pos = start_pos;
+    pipeline->next_scan_sequence = 0;
+    pipeline->next_consume_sequence = 0;
+    pipeline->scan_finished = false;
+    pipeline->end_sequence = 0;
+    pipeline->has_outstanding_slot = false;
+    pipeline->shutdown = false;
+
+    if (filter)
+    {
+        pipeline->filter = *filter;
+    }
+    else
+    {
+        demo_frame_filter_init(&pipeline->filter);
+    }
+
+    pipeline->slot_count = thread_count * PACKET_PIPELINE_SLOTS_PER_THREAD;
+    pipeline->slots = (PacketPipelineSlot *)calloc(pipeline->slot_count, sizeof(PacketPipelineSlot));
+    pipeline->threads = (pthread_t *)calloc(thread_count, sizeof(pthread_t));
+    pipeline->thread_count = 0;
+
+    if (!pipeline->slots || !pipeline->threads)
+    {
+        free(pipeline->slots);
+        free(pipeline->threads);
+        return PACKET_PIPELINE_INIT_RET_OOM;
+    }
+
+    pthread_mutex_init(&pipeline->mutex, nullptr);
+    pthread_cond_init(&pipeline->slot_ready, nullptr);
+    pthread_cond_init(&pipeline->slot_free, nullptr);
+
+    for (u32 i = 0; i < thread_count; i++)
+    {
+        if (pthread_create(&pipeline->threads[i], nullptr, packet_pipeline_worker, pipeline) != 0)
+        {
+            packet_pipeline_destroy(pipeline);
+            return PACKET_PIPELINE_INIT_RET_THREAD_ERROR;
+        }
+        pipeline->thread_count++;
+    }
+
+    return PACKET_PIPELINE_INIT_RET_OK;
+}
+
+static void packet_pipeline_decode_slot(PacketPipelineSlot *slot)
+{
+    if (!slot->header.is_compressed)
+    {
+        slot->data_size = slot->header.size;
+        slot->result = PARSER_NEXT_PACKET_RET_OK;
+        return;
+    }
+
+    const int ret_code = demo_decompress_frame((const char *)slot->payload, slot->header.size, &slot->buffer, &slot->buffer_size, &slot->data_size);
+
+    switch (ret_code)
+    {
+    case DEMO_DECOMPRESS_RET_OK:
+        slot->result = PARSER_NEXT_PACKET_RET_OK;
+        break;
+    case DEMO_DECOMPRESS_RET_OOM:
+        slot->result = PARSER_NEXT_PACKET_RET_OOM;
+        break;
+    default:
+        slot->result = PARSER_NEXT_PACKET_RET_DECOMPRESS_ERROR;
+        break;
+    }
+}
+
+static void *packet_pipeline_worker(void *user_data)
+{
+    PacketPipeline *pipeline = (PacketPipeline *)user_data;
+
+    pthread_mutex_lock(&pipeline->mutex);
+
+    while (true)
+    {
+        //
+        // Frames are claimed in file order. A frame can only go into its slot once the
+        // consumer has released the frame that used the slot one lap earlier, which is
+        // what bounds how far ahead of the consumer the workers run
+        //
+        PacketPipelineSlot *slot = &pipeline->slots[pipeline->next_scan_sequence % pipeline->slot_count];
+        while (!pipeline->shutdown && !pipeline->scan_finished && slot->state != PACKET_PIPELINE_SLOT_FREE)
+        {
+            pthread_cond_wait(&pipeline->slot_free, &pipeline->mutex);
+            slot = &pipeline->slots[pipeline->next_scan_sequence % pipeline->slot_count];
+        }
+
+        if (pipeline->shutdown || pipeline->scan_finished)
+        {
+            break;
+        }
+
+        const size_t offset = pipeline->scan_pos;
+        DemoFrameHeader header;
+        const int header_ret_code = demo_read_frame_header(pipeline->data, pipeline->data_size, &pipeline->scan_pos, &header);
+        const int filter_ret_code = (header_ret_code == DEMO_FRAME_HEADER_RET_OK) ? demo_frame_filter_apply(&pipeline->filter, &header) : DEMO_FRAME_FILTER_STOP;
+
+        if (filter_ret_code == DEMO_FRAME_FILTER_SKIP)
+        {
+            pipeline->scan_pos += header.size;
+            continue;
+        }
+
+        if (filter_ret_code == DEMO_FRAME_FILTER_STOP)
+        {
+            pipeline->scan_finished = true;
+            pipeline->end_sequence = pipeline->next_scan_sequence;
+            pthread_cond_broadcast(&pipeline->slot_ready);
+            pthread_cond_broadcast(&pipeline->slot_free);
+            break;
+        }
+
+        slot->sequence = pipeline->next_scan_sequence++;
+        slot->state = PACKET_PIPELINE_SLOT_CLAIMED;
+        slot->header = header;
+        slot->offset = offset;
+        slot->payload = pipeline->data + pipeline->scan_pos;
+        pipeline->scan_pos += header.size;
+        slot->end_pos = pipeline->scan_pos;
+
+        if (header.command == DEMO_COMMAND_STOP)
+        {
+            pipeline->scan_finished = true;
+            pipeline->end_sequence = pipeline->next_scan_sequence;
+            pthread_cond_broadcast(&pipeline->slot_free);
+        }
+
+        pthread_mutex_unlock(&pipeline->mutex);
+
+        packet_pipeline_decode_slot(slot);
+
+        pthread_mutex_lock(&pipeline->mutex);
+        slot->state = PACKET_PIPELINE_SLOT_READY;
+        pthread_cond_broadcast(&pipeline->slot_ready);
+    }
+
+    pthread_mutex_unlock(&pipeline->mutex);
+
+    return nullptr;
+}
+
+int packet_pipeline_next(PacketPipeline *pipeline, DemoPacket *out_packet)
+{
+    pthread_mutex_lock(&pipeline->mutex);
+
+    if (pipeline->has_outstanding_slot)
+    {
+        const u64 previous_sequence = pipeline->next_consume_sequence - 1;
+        pipeline->slots[previous_sequence % pipeline->slot_count].state = PACKET_PIPELINE_SLOT_FREE;
+        pipeline->has_outstanding_slot = false;
+        pthread_cond_broadcast(&pipeline->slot_free);
+    }
+
+    const u64 sequence = pipeline->next_consume_sequence;
+    PacketPipelineSlot *slot = &pipeline->slots[sequence % pipeline->slot_count];
+
+    while (!(slot->state == PACKET_PIPELINE_SLOT_READY && slot->sequence == sequence))
+    {
+        if (pipeline->scan_finished && sequence >= pipeline->end_sequence)
+        {
+            pthread_mutex_unlock(&pipeline->mutex);
+            return PARSER_NEXT_PACKET_RET_END;
+        }
+        pthread_cond_wait(&pipeline->slot_ready, &pipeline->mutex);
+    }
+
+    pipeline->next_consume_sequence++;
+    pipeline->has_outstanding_slot = true;
+    pipeline->pos = slot->end_pos;
+
+    pthread_mutex_unlock(&pipeline->mutex);
+
+    //
+    // The slot can't be reused until the consumer comes back, no need to hold the lock
+    //
+    out_packet->type = slot->header.command;
+    out_packet->tick = slot->header.tick;
+    out_packet->data = (slot->header.is_compressed) ? slot->buffer : (char *)slot->payload;
+    out_packet->data_size = (u32)slot->data_size;
+    out_packet->stored_size = slot->header.size;
+    out_packet->is_compressed = slot->header.is_compressed;
+    out_packet->offset = slot->offset;
+
+    return slot->result;
+}
+
+void packet_pipeline_destroy(PacketPipeline *pipeline)
+{
+    pthread_mutex_lock(&pipeline->mutex);
+    pipeline->shutdown = true;
+    pthread_cond_broadcast(&pipeline->slot_free);
+    pthread_cond_broadcast(&pipeline->slot_ready);
+    pthread_mutex_unlock(&pipeline->mutex);
+
+    for (u32 i = 0; i < pipeline->thread_count; i++)
+    {
+        pthread_join(pipeline->threads[i], nullptr);
+    }
+
+    for (u32 i = 0; i < pipeline->slot_count; i++)
+    {
+        free(pipeline->slots[i].buffer);
+    }
+
+    pthread_mutex_destroy(&pipeline->mutex);
+    pthread_cond_destroy(&pipeline->slot_ready);
+    pthread_cond_destroy(&pipeline->slot_free);
+
+    free(pipeline->slots);
+    free(pipeline->threads);
+
+    pipeline->slots = nullptr;
+    pipeline->threads = nullptr;
+    pipeline->slot_count = 0;
+    pipeline->thread_count = 0;
+}
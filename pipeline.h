@@ -0,0 +1,80 @@
+#pragma once
+
+//
+// Pipelined frame reader. Worker threads walk the frame headers and snappy decompress
+// frames into per-slot buffers ahead of the consumer, which receives DemoPackets in file
+// order from a bounded ring. Same contract as the inline frame reader of demo_parser: a
+// packet's data stays valid until the next call. Frames the filter skips never take a
+// slot and are never decompressed.
+//
+
+#include <pthread.h>
+
+#include "common.h"
+#include "demo.h"
+
+#define PACKET_PIPELINE_SLOT_FREE 0
+#define PACKET_PIPELINE_SLOT_CLAIMED 1
+#define PACKET_PIPELINE_SLOT_READY 2
+
+typedef struct
+{
+    u64 sequence;
+    int state;
+    int result;
+    DemoFrameHeader header;
+    size_t offset;
+    const u8 *payload;
+    //
+    // File offset just past this frame
+    //
+    size_t end_pos;
+
+    char *buffer;
+    size_t buffer_size;
+    size_t data_size;
+} PacketPipelineSlot;
+
+typedef struct
+{
+    const u8 *data;
+    size_t data_size;
+    size_t scan_pos;
+    DemoFrameFilter filter;
+    //
+    // File offset just past the last frame handed to the consumer
+    //
+    size_t pos;
+
+    PacketPipelineSlot *slots;
+    u32 slot_count;
+
+    u64 next_scan_sequence;
+    u64 next_consume_sequence;
+    //
+    // Set once the scanner hits the end of the data, a truncated frame or a STOP
+    // command. No frame at or after end_sequence will be produced
+    //
+    bool scan_finished;
+    u64 end_sequence;
+    bool has_outstanding_slot;
+    bool shutdown;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t slot_ready;
+    pthread_cond_t slot_free;
+
+    pthread_t *threads;
+    u32 thread_count;
+} PacketPipeline;
+
+#define PACKET_PIPELINE_INIT_RET_OK 0
+#define PACKET_PIPELINE_INIT_RET_OOM 1
+#define PACKET_PIPELINE_INIT_RET_THREAD_ERROR 2
+
+//
+// filter may be nullptr to hand out every frame
+//
+int packet_pipeline_init(PacketPipeline *pipeline, const u8 *data, size_t data_size, size_t start_pos, u32 thread_count, const DemoFrameFilter *filter);
+int packet_pipeline_next(PacketPipeline *pipeline, DemoPacket *out_packet);
+void packet_pipeline_destroy(PacketPipeline *pipeline);
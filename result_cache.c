@@ -0,0 +1,419 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include "result_cache.h"
+#include "hash.h"
+
+#define RESULT_CACHE_MAGIC "DEMOUT01"
+#define RESULT_CACHE_EXTENSION ".out"
+#define RESULT_CACHE_LOCK_NAME "trim.lock"
+
+//
+// Demos are hashed a block at a time, each block seeding the next, so files can be
+// hashed without reading them whole
+//
+#define RESULT_CACHE_HASH_BLOCK_SIZE (1024 * 1024)
+#define RESULT_CACHE_COPY_BUFFER_SIZE (64 * 1024)
+
+//
+// Temporaries older than this belong to a process that died while writing
+//
+#define RESULT_CACHE_STALE_TEMP_SECONDS 3600
+
+typedef struct
+{
+    char magic[8];
+    u64 demo_hash;
+    u64 config_hash;
+    u64 output_size;
+} ResultCacheHeader;
+
+typedef struct
+{
+    char name[64];
+    u64 size;
+    i64 mtime_ns;
+} ResultCacheEntry;
+
+//
+// Forward declarations
+//
+
+static int result_cache_path(const ResultCache *cache, u64 demo_hash, u64 config_hash, char *out_path, size_t out_path_size);
+static bool result_cache_copy(FILE *input, FILE *output, u64 size);
+static int result_cache_compare_entries(const void *a, const void *b);
+
+static int result_cache_path(const ResultCache *cache, u64 demo_hash, u64 config_hash, char *out_path, size_t out_path_size)
+{
+    const int length = snprintf(out_path, out_path_size, "%s/%016llx-%016llx" RESULT_CACHE_EXTENSION, cache->directory, (unsigned long long)demo_hash,
+                                (unsigned long long)config_hash);
+    if (length < 0 || (size_t)length >= out_path_size)
+    {
+        return RESULT_CACHE_RET_IO_ERROR;
+    }
+
+    return RESULT_CACHE_RET_OK;
+}
+
+static bool result_cache_copy(FILE *input, FILE *output, u64 size)
+{
+    u8 buffer[RESULT_CACHE_COPY_BUFFER_SIZE];
+
+    while (size > 0)
+    {
+        const size_t chunk_size = (size < sizeof(buffer)) ? (size_t)size : sizeof(buffer);
+        if (fread(buffer, 1, chunk_size, input) != chunk_size || fwrite(buffer, 1, chunk_size, output) != chunk_size)
+        {
+            return false;
+        }
+        size -= chunk_size;
+    }
+
+    return true;
+}
+
+//
+// Oldest first
+//
+static int result_cache_compare_entries(const void *a, const void *b)
+{
+    const ResultCacheEntry *entry_a = (const ResultCacheEntry *)a;
+    const ResultCacheEntry *entry_b = (const ResultCacheEntry *)b;
+    return (entry_a->mtime_ns > entry_b->mtime_ns) - (entry_a->mtime_ns < entry_b->mtime_ns);
+}
+
+int result_cache_open(ResultCache *cache, const char *directory, u64 max_size)
+{
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST)
+    {
+        return RESULT_CACHE_RET_IO_ERROR;
+    }
+
+    cache->directory = directory;
+    cache->max_size = max_size;
+
+    return RESULT_CACHE_RET_OK;
+}
+
+u64 result_cache_hash_data(const u8 *data, size_t size)
+{
+    u64 hash = 0;
+    for (size_t offset = 0; offset < size; offset += RESULT_CACHE_HASH_BLOCK_SIZE)
+    {
+        const size_t block_size = (size - offset < RESULT_CACHE_HASH_BLOCK_SIZE) ? size - offset : RESULT_CACHE_HASH_BLOCK_SIZE;
+        hash = hash_xxh64(data + offset, block_size, hash);
+    }
+
+    return hash;
+}
+
+int result_cache_hash_file(const char *path, u64 *out_hash)
+{
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return RESULT_CACHE_RET_IO_ERROR;
+    }
+
+    u8 *block = (u8 *)malloc(RESULT_CACHE_HASH_BLOCK_SIZE);
+    if (!block)
+    {
+        close(fd);
+        return RESULT_CACHE_RET_OOM;
+    }
+
+    //
+    // Blocks are filled completely before they're hashed, short reads would otherwise
+    // change the hash
+    //
+    u64 hash = 0;
+    int ret_code = RESULT_CACHE_RET_OK;
+    bool at_end = false;
+
+    while (!at_end)
+    {
+        size_t block_size = 0;
+        while (block_size < RESULT_CACHE_HASH_BLOCK_SIZE)
+        {
+            const ssize_t read_size = read(fd, block + block_size, RESULT_CACHE_HASH_BLOCK_SIZE - block_size);
+            if (read_size < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (read_size < 0)
+            {
+                ret_code = RESULT_CACHE_RET_IO_ERROR;
+                at_end = true;
+                break;
+            }
+            if (read_size == 0)
+            {
+                at_end = true;
+                break;
+            }
+            block_size += (size_t)read_size;
+        }
+
+        if (block_size > 0)
+        {
+            hash = hash_xxh64(block, block_size, hash);
+        }
+    }
+
+    free(block);
+    close(fd);
+
+    *out_hash = hash;
+    return ret_code;
+}
+
+int result_cache_lookup(const ResultCache *cache, u64 demo_hash, u64 config_hash, FILE *output)
+{
+    char path[4096];
+    if (result_cache_path(cache, demo_hash, config_hash, path, sizeof(path)) != RESULT_CACHE_RET_OK)
+    {
+        return RESULT_CACHE_RET_IO_ERROR;
+    }
+
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        return (errno == ENOENT) ? RESULT_CACHE_RET_MISS : RESULT_CACHE_RET_IO_ERROR;
+    }
+
+    //
+    // Entries are only ever renamed into place whole, a short one was damaged some
+    // other way and is treated as missing
+    //
+    ResultCacheHeader header;
+    struct stat file_stat;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, RESULT_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.demo_hash != demo_hash || header.config_hash != config_hash || fstat(fileno(file), &file_stat) != 0 ||
+        (u64)file_stat.st_size != sizeof(header) + header.output_size)
+    {
+        fclose(file);
+        return RESULT_CACHE_RET_MISS;
+    }
+
+    //
+    // The mtime records when the entry was last used, for trimming
+    //
+    futimens(fileno(file), nullptr);
+
+    const bool copy_ok = result_cache_copy(file, output, header.output_size);
+    fclose(file);
+
+    return (copy_ok) ? RESULT_CACHE_RET_OK : RESULT_CACHE_RET_IO_ERROR;
+}
+
+int result_cache_begin(const ResultCache *cache, u64 demo_hash, u64 config_hash, ResultCacheWriter *writer)
+{
+    memset(writer, 0, sizeof(*writer));
+    writer->demo_hash = demo_hash;
+    writer->config_hash = config_hash;
+
+    if (result_cache_path(cache, demo_hash, config_hash, writer->path, sizeof(writer->path)) != RESULT_CACHE_RET_OK ||
+        snprintf(writer->temp_path, sizeof(writer->temp_path), "%s.XXXXXX", writer->path) >= (int)sizeof(writer->temp_path))
+    {
+        return RESULT_CACHE_RET_IO_ERROR;
+    }
+
+    const int fd = mkstemp(writer->temp_path);
+    if (fd < 0)
+    {
+        return RESULT_CACHE_RET_IO_ERROR;
+    }
+
+    //
+    // mkstemp creates the file private to the user, the cache is meant to be shared
+    //
+    fchmod(fd, 0644);
+
+    writer->file = fdopen(fd, "w+b");
+    if (!writer->file)
+    {
+        close(fd);
+        remove(writer->temp_path);
+        return RESULT_CACHE_RET_IO_ERROR;
+    }
+
+    //
+    // The header is written again with the output size once the parse is done
+    //
+    ResultCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    if (fwrite(&header, sizeof(header), 1, writer->file) != 1)
+    {
+        fclose(writer->file);
+        remove(writer->temp_path);
+        writer->file = nullptr;
+        return RESULT_CACHE_RET_IO_ERROR;
+    }
+
+    return RESULT_CACHE_RET_OK;
+}
+
+int result_cache_end(const ResultCache *cache, ResultCacheWriter *writer, bool store, FILE *output)
+{
+    FILE *file = writer->file;
+    writer->file = nullptr;
+
+    const long end = (fflush(file) == 0) ? ftell(file) : -1;
+    const u64 output_size = (end >= (long)sizeof(ResultCacheHeader)) ? (u64)end - sizeof(ResultCacheHeader) : 0;
+
+    //
+    // The output goes out whether or not it's kept, failed parses print their errors
+    //
+    bool write_ok = end >= (long)sizeof(ResultCacheHeader) && fseek(file, sizeof(ResultCacheHeader), SEEK_SET) == 0 &&
+                    result_cache_copy(file, output, output_size);
+
+    if (store && write_ok)
+    {
+        ResultCacheHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, RESULT_CACHE_MAGIC, sizeof(header.magic));
+        header.demo_hash = writer->demo_hash;
+        header.config_hash = writer->config_hash;
+        header.output_size = output_size;
+
+        write_ok = fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    }
+
+    const bool close_ok = fclose(file) == 0;
+
+    if (!store || !write_ok || !close_ok || rename(writer->temp_path, writer->path) != 0)
+    {
+        remove(writer->temp_path);
+        return (store) ? RESULT_CACHE_RET_IO_ERROR : RESULT_CACHE_RET_OK;
+    }
+
+    return result_cache_trim(cache);
+}
+
+int result_cache_trim(const ResultCache *cache)
+{
+    char path[4096];
+    if (snprintf(path, sizeof(path), "%s/" RESULT_CACHE_LOCK_NAME, cache->directory) >= (int)sizeof(path))
+    {
+        return RESULT_CACHE_RET_IO_ERROR;
+    }
+
+    const int lock_fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (lock_fd < 0)
+    {
+        return RESULT_CACHE_RET_IO_ERROR;
+    }
+
+    //
+    // Whoever holds the lock trims on behalf of everyone, waiting for it would only
+    // repeat the same scan
+    //
+    if (flock(lock_fd, LOCK_EX | LOCK_NB) != 0)
+    {
+        close(lock_fd);
+        return RESULT_CACHE_RET_OK;
+    }
+
+    DIR *directory = opendir(cache->directory);
+    if (!directory)
+    {
+        close(lock_fd);
+        return RESULT_CACHE_RET_IO_ERROR;
+    }
+
+    ResultCacheEntry *entries = nullptr;
+    u32 entry_count = 0;
+    u32 entry_capacity = 0;
+    u64 total_size = 0;
+    int ret_code = RESULT_CACHE_RET_OK;
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    const size_t extension_length = strlen(RESULT_CACHE_EXTENSION);
+
+    struct dirent *dirent;
+    while ((dirent = readdir(directory)) != nullptr)
+    {
+        const char *name = dirent->d_name;
+        const size_t name_length = strlen(name);
+        const char *extension = strstr(name, RESULT_CACHE_EXTENSION);
+
+        if (!extension || name_length >= sizeof(entries[0].name))
+        {
+            continue;
+        }
+
+        struct stat entry_stat;
+        if (fstatat(dirfd(directory), name, &entry_stat, AT_SYMLINK_NOFOLLOW) != 0 || !S_ISREG(entry_stat.st_mode))
+        {
+            continue;
+        }
+
+        //
+        // <entry>.out.XXXXXX is a temporary, only ones nobody is writing anymore go
+        //
+        if (extension + extension_length != name + name_length)
+        {
+            if (now.tv_sec - entry_stat.st_mtim.tv_sec > RESULT_CACHE_STALE_TEMP_SECONDS)
+            {
+                unlinkat(dirfd(directory), name, 0);
+            }
+            continue;
+        }
+
+        if (entry_count == entry_capacity)
+        {
+            const u32 new_capacity = (entry_capacity) ? entry_capacity * 2 : 256;
+            ResultCacheEntry *new_entries = (ResultCacheEntry *)realloc(entries, new_capacity * sizeof(ResultCacheEntry));
+            if (!new_entries)
+            {
+                ret_code = RESULT_CACHE_RET_OOM;
+                break;
+            }
+            entries = new_entries;
+            entry_capacity = new_capacity;
+        }
+
+        ResultCacheEntry *entry = &entries[entry_count++];
+        memcpy(entry->name, name, name_length + 1);
+        entry->size = (u64)entry_stat.st_size;
+        entry->mtime_ns = (i64)entry_stat.st_mtim.tv_sec * 1000000000 + entry_stat.st_mtim.tv_nsec;
+        total_size += entry->size;
+    }
+
+    if (ret_code == RESULT_CACHE_RET_OK && total_size > cache->max_size)
+    {
+        qsort(entries, entry_count, sizeof(ResultCacheEntry), result_cache_compare_entries);
+
+        //
+        // Another process may have removed or replaced an entry since the scan, either
+        // way it no longer counts
+        //
+        for (u32 i = 0; i < entry_count && total_size > cache->max_size; i++)
+        {
+            if (unlinkat(dirfd(directory), entries[i].name, 0) != 0 && errno != ENOENT)
+            {
+                ret_code = RESULT_CACHE_RET_IO_ERROR;
+                continue;
+            }
+            total_size -= entries[i].size;
+        }
+    }
+
+    free(entries);
+    closedir(directory);
+    close(lock_fd);
+
+    return ret_code;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+//
+// On-disk cache of parse output. The same demo tends to come through more than once,
+// retried, ingested again, or copied in from another source, and its output only
+// depends on its bytes and the options it was parsed with. Entries are keyed by a hash
+// of the whole file and a hash of those options, so a demo seen before is answered
+// from the stored output without parsing it, whatever its name or path.
+//
+// Batch workers share one directory. Entries are written to a unique temporary and
+// renamed into place, so a reader never sees half of one and two workers storing the
+// same demo just replace each other's identical entry. A hit touches the entry's mtime
+// and once the directory grows past its size limit the least recently used entries are
+// removed, by one process at a time under an flock. A reader that already opened an
+// entry keeps reading it when it's removed underneath.
+//
+
+#include <stdio.h>
+
+#include "common.h"
+
+#define RESULT_CACHE_RET_OK 0
+#define RESULT_CACHE_RET_MISS 1
+#define RESULT_CACHE_RET_IO_ERROR 2
+#define RESULT_CACHE_RET_OOM 3
+
+#define RESULT_CACHE_DEFAULT_MAX_SIZE (1024ull * 1024 * 1024)
+
+typedef struct
+{
+    const char *directory;
+    //
+    // Bytes the entries may take up together before the least recently used go
+    //
+    u64 max_size;
+} ResultCache;
+
+//
+// Output of a parse on its way into the cache
+//
+typedef struct
+{
+    //
+    // Where the parse writes its output
+    //
+    FILE *file;
+    char path[4096];
+    char temp_path[4096];
+    u64 demo_hash;
+    u64 config_hash;
+} ResultCacheWriter;
+
+//
+// Creates the directory if needed
+//
+int result_cache_open(ResultCache *cache, const char *directory, u64 max_size);
+
+//
+// Hash of a demo's bytes, the same whether they're in memory or read from the file
+//
+u64 result_cache_hash_data(const u8 *data, size_t size);
+int result_cache_hash_file(const char *path, u64 *out_hash);
+
+//
+// Copies the stored output of the demo and options to output. RESULT_CACHE_RET_MISS
+// when there is none
+//
+int result_cache_lookup(const ResultCache *cache, u64 demo_hash, u64 config_hash, FILE *output);
+
+//
+// Opens the temporary the parse writes its output into, see writer->file
+//
+int result_cache_begin(const ResultCache *cache, u64 demo_hash, u64 config_hash, ResultCacheWriter *writer);
+
+//
+// Copies what the parse wrote to output. With store set the output becomes the entry of
+// the demo and options and the cache is trimmed to its size, otherwise it's dropped
+//
+int result_cache_end(const ResultCache *cache, ResultCacheWriter *writer, bool store, FILE *output);
+
+//
+// Removes the least recently used entries until the cache fits in max_size, along with
+// temporaries left behind by processes that died while writing. Returns without doing
+// anything while another process is at it
+//
+int result_cache_trim(const ResultCache *cache);
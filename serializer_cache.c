@@ -0,0 +1,426 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "serializer_cache.h"
+#include "hash.h"
+
+#define SERIALIZER_CACHE_MAGIC "DEMSER01"
+#define SERIALIZER_CACHE_SERIALIZER_NONE -1
+
+typedef struct
+{
+    char magic[8];
+    u64 key;
+    //
+    // Guards against caches written by a build with a different EntityValue or
+    // decoder layout
+    //
+    u32 decoder_kind_count;
+    u32 string_bytes;
+    u32 field_count;
+    u32 serializer_count;
+    u32 field_ref_count;
+    u32 reserved;
+} SerializerCacheHeader;
+
+typedef struct
+{
+    u8 kind;
+    u8 float_kind;
+    u8 component_count;
+    u8 bit_count;
+    QuantizedFloat quantized;
+} SerializerCacheDecoder;
+
+typedef struct
+{
+    u32 name;
+    u32 type;
+    i32 serializer;
+    u32 array_count;
+    u32 model;
+    SerializerCacheDecoder decoder;
+    SerializerCacheDecoder base_decoder;
+} SerializerCacheField;
+
+typedef struct
+{
+    u32 name;
+    i32 version;
+    u32 first_field_ref;
+    u32 field_count;
+    u32 column_count;
+} SerializerCacheSerializer;
+
+typedef struct
+{
+    u32 field;
+    u32 column;
+} SerializerCacheFieldRef;
+
+//
+// Strings are stored once each, records refer to them by offset
+//
+typedef struct
+{
+    char *data;
+    u32 size;
+    u32 capacity;
+} SerializerCacheStrings;
+
+static bool serializer_cache_strings_add(SerializerCacheStrings *strings, const char *string, u32 *out_offset);
+static void serializer_cache_decoder_store(SerializerCacheDecoder *out, const FieldDecoder *decoder);
+static void serializer_cache_decoder_load(FieldDecoder *out, const SerializerCacheDecoder *decoder);
+
+u64 serializer_cache_key(const u8 *send_tables, size_t size)
+{
+    return hash_xxh64(send_tables, size, 0);
+}
+
+int serializer_cache_path(const char *directory, u64 key, char *out_path, size_t out_path_size)
+{
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST)
+    {
+        return SERIALIZER_CACHE_RET_IO_ERROR;
+    }
+
+    const int length = snprintf(out_path, out_path_size, "%s/%016llx.ser", directory, (unsigned long long)key);
+    if (length < 0 || (size_t)length >= out_path_size)
+    {
+        return SERIALIZER_CACHE_RET_IO_ERROR;
+    }
+
+    return SERIALIZER_CACHE_RET_OK;
+}
+
+static bool serializer_cache_strings_add(SerializerCacheStrings *strings, const char *string, u32 *out_offset)
+{
+    const size_t length = strlen(string) + 1;
+    if (strings->size + length > strings->capacity)
+    {
+        u32 new_capacity = (strings->capacity) ? strings->capacity : 64 * 1024;
+        while (strings->size + length > new_capacity)
+        {
+            new_capacity *= 2;
+        }
+        char *new_data = (char *)realloc(strings->data, new_capacity);
+        if (!new_data)
+        {
+            return false;
+        }
+        strings->data = new_data;
+        strings->capacity = new_capacity;
+    }
+
+    *out_offset = strings->size;
+    memcpy(strings->data + strings->size, string, length);
+    strings->size += (u32)length;
+
+    return true;
+}
+
+static void serializer_cache_decoder_store(SerializerCacheDecoder *out, const FieldDecoder *decoder)
+{
+    memset(out, 0, sizeof(*out));
+    out->kind = decoder->kind;
+    out->float_kind = decoder->float_kind;
+    out->component_count = decoder->component_count;
+    out->bit_count = decoder->bit_count;
+    out->quantized = decoder->quantized;
+}
+
+static void serializer_cache_decoder_load(FieldDecoder *out, const SerializerCacheDecoder *decoder)
+{
+    memset(out, 0, sizeof(*out));
+    out->kind = decoder->kind;
+    out->float_kind = decoder->float_kind;
+    out->component_count = decoder->component_count;
+    out->bit_count = decoder->bit_count;
+    out->quantized = decoder->quantized;
+    field_decoder_compile(out);
+}
+
+int serializer_cache_write(const EntityEngine *engine, const char *path, u64 key)
+{
+    u32 field_ref_count = 0;
+    for (u32 i = 0; i < engine->serializer_count; i++)
+    {
+        field_ref_count += engine->serializers[i].field_count;
+    }
+
+    SerializerCacheField *fields = (SerializerCacheField *)calloc((size_t)engine->field_count + 1, sizeof(SerializerCacheField));
+    SerializerCacheSerializer *serializers = (SerializerCacheSerializer *)calloc((size_t)engine->serializer_count + 1, sizeof(SerializerCacheSerializer));
+    SerializerCacheFieldRef *field_refs = (SerializerCacheFieldRef *)calloc((size_t)field_ref_count + 1, sizeof(SerializerCacheFieldRef));
+    SerializerCacheStrings strings = { 0 };
+
+    int ret_code = SERIALIZER_CACHE_RET_OK;
+
+    if (!fields || !serializers || !field_refs)
+    {
+        ret_code = SERIALIZER_CACHE_RET_OOM;
+        goto cleanup;
+    }
+
+    for (u32 i = 0; i < engine->field_count; i++)
+    {
+        const EntityField *field = &engine->fields[i];
+        SerializerCacheField *record = &fields[i];
+
+        if (!serializer_cache_strings_add(&strings, field->name, &record->name) ||
+            !serializer_cache_strings_add(&strings, field->type, &record->type))
+        {
+            ret_code = SERIALIZER_CACHE_RET_OOM;
+            goto cleanup;
+        }
+
+        record->serializer = (field->serializer) ? (i32)(field->serializer - engine->serializers) : SERIALIZER_CACHE_SERIALIZER_NONE;
+        record->array_count = field->array_count;
+        record->model = field->model;
+        serializer_cache_decoder_store(&record->decoder, &field->decoder);
+        serializer_cache_decoder_store(&record->base_decoder, &field->base_decoder);
+    }
+
+    u32 ref = 0;
+    for (u32 i = 0; i < engine->serializer_count; i++)
+    {
+        const EntitySerializer *serializer = &engine->serializers[i];
+        SerializerCacheSerializer *record = &serializers[i];
+
+        if (!serializer_cache_strings_add(&strings, (serializer->name) ? serializer->name : "", &record->name))
+        {
+            ret_code = SERIALIZER_CACHE_RET_OOM;
+            goto cleanup;
+        }
+
+        record->version = serializer->version;
+        record->first_field_ref = ref;
+        record->field_count = serializer->field_count;
+        record->column_count = serializer->column_count;
+
+        for (u32 f = 0; f < serializer->field_count; f++)
+        {
+            field_refs[ref].field = (u32)(serializer->fields[f] - engine->fields);
+            field_refs[ref].column = serializer->field_columns[f];
+            ref++;
+        }
+    }
+
+    SerializerCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SERIALIZER_CACHE_MAGIC, sizeof(header.magic));
+    header.key = key;
+    header.decoder_kind_count = FIELD_DECODER_KIND_COUNT;
+    header.string_bytes = strings.size;
+    header.field_count = engine->field_count;
+    header.serializer_count = engine->serializer_count;
+    header.field_ref_count = field_ref_count;
+
+    //
+    // Write to a temporary and rename so a concurrent reader never sees half a cache.
+    // The temporary is unique so batch workers compiling the same build don't collide
+    //
+    char temp_path[4096];
+    if (snprintf(temp_path, sizeof(temp_path), "%s.XXXXXX", path) >= (int)sizeof(temp_path))
+    {
+        ret_code = SERIALIZER_CACHE_RET_IO_ERROR;
+        goto cleanup;
+    }
+
+    const int fd = mkstemp(temp_path);
+    if (fd < 0)
+    {
+        ret_code = SERIALIZER_CACHE_RET_IO_ERROR;
+        goto cleanup;
+    }
+
+    //
+    // mkstemp creates the file private to the user, the cache is meant to be shared
+    //
+    fchmod(fd, 0644);
+
+    FILE *file = fdopen(fd, "wb");
+    if (!file)
+    {
+        close(fd);
+        remove(temp_path);
+        ret_code = SERIALIZER_CACHE_RET_IO_ERROR;
+        goto cleanup;
+    }
+
+    const bool write_ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                          (strings.size == 0 || fwrite(strings.data, strings.size, 1, file) == 1) &&
+                          (engine->field_count == 0 || fwrite(fields, sizeof(SerializerCacheField), engine->field_count, file) == engine->field_count) &&
+                          (engine->serializer_count == 0 || fwrite(serializers, sizeof(SerializerCacheSerializer), engine->serializer_count, file) == engine->serializer_count) &&
+                          (field_ref_count == 0 || fwrite(field_refs, sizeof(SerializerCacheFieldRef), field_ref_count, file) == field_ref_count);
+    const bool close_ok = fclose(file) == 0;
+
+    if (!write_ok || !close_ok || rename(temp_path, path) != 0)
+    {
+        remove(temp_path);
+        ret_code = SERIALIZER_CACHE_RET_IO_ERROR;
+    }
+
+cleanup:
+    free(fields);
+    free(serializers);
+    free(field_refs);
+    free(strings.data);
+
+    return ret_code;
+}
+
+int serializer_cache_read(EntityEngine *engine, const char *path, u64 key)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        return SERIALIZER_CACHE_RET_IO_ERROR;
+    }
+
+    SerializerCacheHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, SERIALIZER_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.decoder_kind_count != FIELD_DECODER_KIND_COUNT)
+    {
+        fclose(file);
+        return SERIALIZER_CACHE_RET_INVALID;
+    }
+
+    if (header.key != key)
+    {
+        fclose(file);
+        return SERIALIZER_CACHE_RET_MISMATCH;
+    }
+
+    char *strings = (char *)malloc((size_t)header.string_bytes + 1);
+    SerializerCacheField *fields = (SerializerCacheField *)malloc(((size_t)header.field_count + 1) * sizeof(SerializerCacheField));
+    SerializerCacheSerializer *serializers = (SerializerCacheSerializer *)malloc(((size_t)header.serializer_count + 1) * sizeof(SerializerCacheSerializer));
+    SerializerCacheFieldRef *field_refs = (SerializerCacheFieldRef *)malloc(((size_t)header.field_ref_count + 1) * sizeof(SerializerCacheFieldRef));
+
+    int ret_code = SERIALIZER_CACHE_RET_OK;
+
+    if (!strings || !fields || !serializers || !field_refs)
+    {
+        ret_code = SERIALIZER_CACHE_RET_OOM;
+        goto cleanup;
+    }
+
+    const bool read_ok = (header.string_bytes == 0 || fread(strings, header.string_bytes, 1, file) == 1) &&
+                         (header.field_count == 0 || fread(fields, sizeof(SerializerCacheField), header.field_count, file) == header.field_count) &&
+                         (header.serializer_count == 0 || fread(serializers, sizeof(SerializerCacheSerializer), header.serializer_count, file) == header.serializer_count) &&
+                         (header.field_ref_count == 0 || fread(field_refs, sizeof(SerializerCacheFieldRef), header.field_ref_count, file) == header.field_ref_count);
+
+    if (!read_ok || (header.string_bytes && strings[header.string_bytes - 1] != '\0'))
+    {
+        ret_code = SERIALIZER_CACHE_RET_INVALID;
+        goto cleanup;
+    }
+
+    //
+    // Validate every cross reference before touching the engine
+    //
+    for (u32 i = 0; i < header.field_count; i++)
+    {
+        const SerializerCacheField *record = &fields[i];
+        if (record->name >= header.string_bytes || record->type >= header.string_bytes ||
+            record->serializer >= (i32)header.serializer_count || record->serializer < SERIALIZER_CACHE_SERIALIZER_NONE ||
+            record->model > FIELD_MODEL_VARIABLE_TABLE)
+        {
+            ret_code = SERIALIZER_CACHE_RET_INVALID;
+            goto cleanup;
+        }
+    }
+
+    for (u32 i = 0; i < header.serializer_count; i++)
+    {
+        const SerializerCacheSerializer *record = &serializers[i];
+        if (record->name >= header.string_bytes || record->first_field_ref > header.field_ref_count ||
+            record->field_count > header.field_ref_count - record->first_field_ref)
+        {
+            ret_code = SERIALIZER_CACHE_RET_INVALID;
+            goto cleanup;
+        }
+    }
+
+    for (u32 i = 0; i < header.field_ref_count; i++)
+    {
+        if (field_refs[i].field >= header.field_count)
+        {
+            ret_code = SERIALIZER_CACHE_RET_INVALID;
+            goto cleanup;
+        }
+    }
+
+    entity_engine_reset_serializers(engine);
+
+    EntityField *engine_fields = (EntityField *)arena_alloc(&engine->arena, ((size_t)header.field_count + 1) * sizeof(EntityField));
+    EntitySerializer *engine_serializers = (EntitySerializer *)arena_alloc(&engine->arena, ((size_t)header.serializer_count + 1) * sizeof(EntitySerializer));
+    EntityField **field_pointers = (EntityField **)arena_alloc(&engine->arena, ((size_t)header.field_ref_count + 1) * sizeof(EntityField *));
+    u32 *field_columns = (u32 *)arena_alloc(&engine->arena, ((size_t)header.field_ref_count + 1) * sizeof(u32));
+
+    if (!engine_fields || !engine_serializers || !field_pointers || !field_columns)
+    {
+        ret_code = SERIALIZER_CACHE_RET_OOM;
+        goto cleanup;
+    }
+
+    for (u32 i = 0; i < header.field_count; i++)
+    {
+        const SerializerCacheField *record = &fields[i];
+        EntityField *field = &engine_fields[i];
+        const char *name = strings + record->name;
+        const char *type = strings + record->type;
+
+        field->name = string_intern_get(&engine->strings, name, strlen(name));
+        field->type = string_intern_get(&engine->strings, type, strlen(type));
+        field->model = (u8)record->model;
+        field->array_count = record->array_count;
+        field->serializer = (record->serializer == SERIALIZER_CACHE_SERIALIZER_NONE) ? nullptr : &engine_serializers[record->serializer];
+        serializer_cache_decoder_load(&field->decoder, &record->decoder);
+        serializer_cache_decoder_load(&field->base_decoder, &record->base_decoder);
+
+        if (!field->name || !field->type)
+        {
+            ret_code = SERIALIZER_CACHE_RET_OOM;
+            goto cleanup;
+        }
+    }
+
+    for (u32 i = 0; i < header.field_ref_count; i++)
+    {
+        field_pointers[i] = &engine_fields[field_refs[i].field];
+        field_columns[i] = field_refs[i].column;
+    }
+
+    for (u32 i = 0; i < header.serializer_count; i++)
+    {
+        const SerializerCacheSerializer *record = &serializers[i];
+        EntitySerializer *serializer = &engine_serializers[i];
+        const char *name = strings + record->name;
+
+        serializer->name = string_intern_get(&engine->strings, name, strlen(name));
+        serializer->version = record->version;
+        serializer->fields = &field_pointers[record->first_field_ref];
+        serializer->field_columns = &field_columns[record->first_field_ref];
+        serializer->field_count = record->field_count;
+        serializer->column_count = record->column_count;
+    }
+
+    engine->fields = engine_fields;
+    engine->field_count = header.field_count;
+    engine->serializers = engine_serializers;
+    engine->serializer_count = header.serializer_count;
+
+cleanup:
+    fclose(file);
+    free(strings);
+    free(fields);
+    free(serializers);
+    free(field_refs);
+
+    return ret_code;
+}
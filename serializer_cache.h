@@ -0,0 +1,39 @@
+#pragma once
+
+//
+// On-disk cache of compiled entity serializers. Building the serializers means
+// unpacking a flattened serializer with thousands of fields and symbols and deriving a
+// decoder for every field, and every demo recorded on the same game build carries the
+// same send tables. The compiled fields and serializers are written out as flat records
+// keyed by a hash of the send tables blob, so later demos load them directly.
+//
+// Records are written in native byte order and layout, caches are meant to stay on the
+// machine that wrote them.
+//
+
+#include "common.h"
+#include "entity.h"
+
+#define SERIALIZER_CACHE_RET_OK 0
+#define SERIALIZER_CACHE_RET_OOM 1
+#define SERIALIZER_CACHE_RET_IO_ERROR 2
+#define SERIALIZER_CACHE_RET_INVALID 3
+#define SERIALIZER_CACHE_RET_MISMATCH 4
+
+//
+// Key for a DEMO_COMMAND_SEND_TABLES data blob
+//
+u64 serializer_cache_key(const u8 *send_tables, size_t size);
+
+//
+// Builds the path <directory>/<key>.ser, creating the directory if needed
+//
+int serializer_cache_path(const char *directory, u64 key, char *out_path, size_t out_path_size);
+
+int serializer_cache_write(const EntityEngine *engine, const char *path, u64 key);
+
+//
+// Replaces the serializers of engine. Fails with SERIALIZER_CACHE_RET_MISMATCH when
+// the file was written for a different key
+//
+int serializer_cache_read(EntityEngine *engine, const char *path, u64 key);
@@ -0,0 +1,167 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "string_intern.h"
+
+#define STRING_INTERN_INITIAL_CAPACITY 1024
+
+static u32 string_intern_hash(const char *string, size_t length);
+static bool string_intern_grow(StringIntern *intern);
+static const StringInternEntry *string_intern_insert(StringIntern *intern, const char *string, size_t length);
+
+void string_intern_init(StringIntern *intern)
+{
+    arena_init(&intern->arena, 64 * 1024);
+    intern->entries = nullptr;
+    intern->capacity = 0;
+    intern->count = 0;
+    intern->strings = nullptr;
+    intern->strings_capacity = 0;
+}
+
+void string_intern_free(StringIntern *intern)
+{
+    arena_free(&intern->arena);
+    free(intern->entries);
+    free(intern->strings);
+    intern->entries = nullptr;
+    intern->capacity = 0;
+    intern->count = 0;
+    intern->strings = nullptr;
+    intern->strings_capacity = 0;
+}
+
+//
+// FNV-1a
+//
+static u32 string_intern_hash(const char *string, size_t length)
+{
+    u32 hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (u8)string[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static bool string_intern_grow(StringIntern *intern)
+{
+    const u32 new_capacity = (intern->capacity) ? intern->capacity * 2 : STRING_INTERN_INITIAL_CAPACITY;
+    StringInternEntry *new_entries = (StringInternEntry *)calloc(new_capacity, sizeof(StringInternEntry));
+    if (!new_entries)
+    {
+        return false;
+    }
+
+    for (u32 i = 0; i < intern->capacity; i++)
+    {
+        const StringInternEntry *entry = &intern->entries[i];
+        if (!entry->string)
+        {
+            continue;
+        }
+
+        u32 slot = entry->hash & (new_capacity - 1);
+        while (new_entries[slot].string)
+        {
+            slot = (slot + 1) & (new_capacity - 1);
+        }
+        new_entries[slot] = *entry;
+    }
+
+    free(intern->entries);
+    intern->entries = new_entries;
+    intern->capacity = new_capacity;
+
+    return true;
+}
+
+static const StringInternEntry *string_intern_insert(StringIntern *intern, const char *string, size_t length)
+{
+    //
+    // Kept at most half full
+    //
+    if ((intern->count + 1) * 2 > intern->capacity && !string_intern_grow(intern))
+    {
+        return nullptr;
+    }
+
+    const u32 hash = string_intern_hash(string, length);
+    u32 slot = hash & (intern->capacity - 1);
+
+    while (intern->entries[slot].string)
+    {
+        const StringInternEntry *entry = &intern->entries[slot];
+        if (entry->hash == hash && entry->length == length && memcmp(entry->string, string, length) == 0)
+        {
+            return entry;
+        }
+        slot = (slot + 1) & (intern->capacity - 1);
+    }
+
+    if (intern->count == intern->strings_capacity)
+    {
+        const u32 new_capacity = (intern->strings_capacity) ? intern->strings_capacity * 2 : STRING_INTERN_INITIAL_CAPACITY;
+        const char **new_strings = (const char **)realloc(intern->strings, new_capacity * sizeof(const char *));
+        if (!new_strings)
+        {
+            return nullptr;
+        }
+        intern->strings = new_strings;
+        intern->strings_capacity = new_capacity;
+    }
+
+    char *copy = (char *)arena_alloc(&intern->arena, length + 1);
+    if (!copy)
+    {
+        return nullptr;
+    }
+    memcpy(copy, string, length);
+    copy[length] = '\0';
+
+    StringInternEntry *entry = &intern->entries[slot];
+    entry->string = copy;
+    entry->length = (u32)length;
+    entry->hash = hash;
+    entry->id = intern->count;
+    intern->strings[intern->count] = copy;
+    intern->count++;
+
+    return entry;
+}
+
+const char *string_intern_get(StringIntern *intern, const char *string, size_t length)
+{
+    const StringInternEntry *entry = string_intern_insert(intern, string, length);
+    return (entry) ? entry->string : nullptr;
+}
+
+u32 string_intern_id(StringIntern *intern, const char *string, size_t length)
+{
+    const StringInternEntry *entry = string_intern_insert(intern, string, length);
+    return (entry) ? entry->id : STRING_INTERN_ID_NONE;
+}
+
+u32 string_intern_find(const StringIntern *intern, const char *string, size_t length)
+{
+    if (intern->capacity == 0)
+    {
+        return STRING_INTERN_ID_NONE;
+    }
+
+    const u32 hash = string_intern_hash(string, length);
+    u32 slot = hash & (intern->capacity - 1);
+
+    while (intern->entries[slot].string)
+    {
+        const StringInternEntry *entry = &intern->entries[slot];
+        if (entry->hash == hash && entry->length == length && memcmp(entry->string, string, length) == 0)
+        {
+            return entry->id;
+        }
+        slot = (slot + 1) & (intern->capacity - 1);
+    }
+
+    return STRING_INTERN_ID_NONE;
+}
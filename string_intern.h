@@ -0,0 +1,57 @@
+#pragma once
+
+//
+// Deduplicating string store. Every distinct string is copied once into an arena and
+// the same pointer is handed back for equal strings, so decoded entity and string
+// table values can be stored and compared as plain pointers. Strings are also numbered
+// in the order they were first seen, for tables keyed by a small integer.
+//
+
+#include "common.h"
+#include "arena.h"
+
+#define STRING_INTERN_ID_NONE 0xFFFFFFFFu
+
+typedef struct
+{
+    const char *string;
+    u32 length;
+    u32 hash;
+    u32 id;
+} StringInternEntry;
+
+typedef struct
+{
+    Arena arena;
+    StringInternEntry *entries;
+    u32 capacity;
+    u32 count;
+    //
+    // Indexed by ID
+    //
+    const char **strings;
+    u32 strings_capacity;
+} StringIntern;
+
+void string_intern_init(StringIntern *intern);
+void string_intern_free(StringIntern *intern);
+
+//
+// Returns the stored copy of string, or nullptr when out of memory
+//
+const char *string_intern_get(StringIntern *intern, const char *string, size_t length);
+
+//
+// ID of string, stored first if needed. STRING_INTERN_ID_NONE when out of memory
+//
+u32 string_intern_id(StringIntern *intern, const char *string, size_t length);
+
+//
+// ID of string if it was stored before, STRING_INTERN_ID_NONE otherwise
+//
+u32 string_intern_find(const StringIntern *intern, const char *string, size_t length);
+
+static inline const char *string_intern_string(const StringIntern *intern, u32 id)
+{
+    return (id < intern->count) ? intern->strings[id] : nullptr;
+}
@@ -0,0 +1,553 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <snappy-c.h>
+
+#include "string_table.h"
+#include "bitstream.h"
+
+#define STRING_TABLE_INITIAL_ENTRIES 64
+
+typedef struct
+{
+    const char *keys[STRING_TABLE_KEY_HISTORY];
+    u32 lengths[STRING_TABLE_KEY_HISTORY];
+    u32 start;
+    u32 count;
+} StringTableKeyHistory;
+
+static void string_table_free(StringTable *table);
+static bool string_table_reserve(StringTable *table, u32 entry_count);
+static bool string_table_grow_keys(StringTable *table);
+static bool string_table_set_key(StringTables *tables, StringTable *table, u32 entry_index, const char *key, size_t key_length);
+static int string_table_parse(StringTables *tables, u32 table_index, const u8 *data, size_t size, u32 entry_count);
+static int string_table_read_value(StringTables *tables, const StringTable *table, Bitstream *stream, StringTableEntry *entry);
+static const u8 *string_tables_store(StringTables *tables, const u8 *data, size_t size);
+
+static void string_table_key_history_push(StringTableKeyHistory *history, const char *key, u32 length);
+static const char *string_table_key_history_get(const StringTableKeyHistory *history, u32 position, u32 *out_length);
+
+void string_tables_init(StringTables *tables)
+{
+    memset(tables, 0, sizeof(*tables));
+    arena_init(&tables->arena, 256 * 1024);
+    string_intern_init(&tables->strings);
+}
+
+void string_tables_free(StringTables *tables)
+{
+    string_tables_clear(tables);
+    arena_free(&tables->arena);
+    string_intern_free(&tables->strings);
+    free(tables->scratch);
+    tables->scratch = nullptr;
+    tables->scratch_size = 0;
+}
+
+void string_tables_clear(StringTables *tables)
+{
+    for (u32 i = 0; i < tables->table_count; i++)
+    {
+        string_table_free(&tables->tables[i]);
+    }
+    tables->table_count = 0;
+}
+
+void string_tables_set_change_handler(StringTables *tables, StringTableChangeHandler handler, void *user_data)
+{
+    tables->change_handler = handler;
+    tables->change_user_data = user_data;
+}
+
+int string_tables_create(StringTables *tables, const CreateStringTableView *view)
+{
+    if (tables->table_count == STRING_TABLE_MAX_COUNT)
+    {
+        return STRING_TABLE_RET_MALFORMED;
+    }
+
+    StringTable *table = &tables->tables[tables->table_count];
+    memset(table, 0, sizeof(*table));
+
+    table->name_id = string_intern_id(&tables->strings, (const char *)view->name.data, view->name.size);
+    if (table->name_id == STRING_INTERN_ID_NONE)
+    {
+        return STRING_TABLE_RET_OOM;
+    }
+    table->name = string_intern_string(&tables->strings, table->name_id);
+    table->user_data_fixed_size = view->user_data_fixed_size;
+    table->user_data_size_bits = (view->user_data_size_bits > 0) ? (u32)view->user_data_size_bits : 0;
+    table->flags = view->flags;
+    table->using_varint_bitcounts = view->using_varint_bitcounts;
+
+    const u32 table_index = tables->table_count++;
+
+    const u8 *string_data = view->string_data.data;
+    size_t string_data_size = view->string_data.size;
+
+    if (view->data_compressed)
+    {
+        size_t uncompressed_size = 0;
+        if (snappy_uncompressed_length((const char *)string_data, string_data_size, &uncompressed_size) != SNAPPY_OK)
+        {
+            return STRING_TABLE_RET_DECOMPRESS_ERROR;
+        }
+
+        if (tables->scratch_size < uncompressed_size)
+        {
+            u8 *scratch = (u8 *)realloc(tables->scratch, uncompressed_size);
+            if (!scratch)
+            {
+                return STRING_TABLE_RET_OOM;
+            }
+            tables->scratch = scratch;
+            tables->scratch_size = uncompressed_size;
+        }
+
+        if (snappy_uncompress((const char *)string_data, string_data_size, (char *)tables->scratch, &uncompressed_size) != SNAPPY_OK)
+        {
+            return STRING_TABLE_RET_DECOMPRESS_ERROR;
+        }
+
+        string_data = tables->scratch;
+        string_data_size = uncompressed_size;
+    }
+
+    if (view->num_entries <= 0)
+    {
+        return STRING_TABLE_RET_OK;
+    }
+
+    return string_table_parse(tables, table_index, string_data, string_data_size, (u32)view->num_entries);
+}
+
+int string_tables_update(StringTables *tables, const UpdateStringTableView *view)
+{
+    if (view->table_id < 0 || (u32)view->table_id >= tables->table_count)
+    {
+        return STRING_TABLE_RET_UNKNOWN_TABLE;
+    }
+
+    if (view->num_changed_entries <= 0)
+    {
+        return STRING_TABLE_RET_OK;
+    }
+
+    return string_table_parse(tables, (u32)view->table_id, view->string_data.data, view->string_data.size, (u32)view->num_changed_entries);
+}
+
+int string_tables_apply_snapshot(StringTables *tables, const CDemoStringTables *snapshot)
+{
+    for (size_t t = 0; t < snapshot->n_tables; t++)
+    {
+        const CDemoStringTables__TableT *source = snapshot->tables[t];
+        if (!source->table_name)
+        {
+            continue;
+        }
+
+        const u32 table_index = string_tables_find(tables, source->table_name);
+        if (table_index == STRING_TABLE_NONE)
+        {
+            continue;
+        }
+
+        StringTable *table = &tables->tables[table_index];
+        table->entry_count = 0;
+        table->key_count = 0;
+        for (u32 i = 0; i < table->key_slot_capacity; i++)
+        {
+            table->key_slots[i].key_id = STRING_INTERN_ID_NONE;
+        }
+
+        if (source->n_items > STRING_TABLE_MAX_ENTRIES || !string_table_reserve(table, (u32)source->n_items))
+        {
+            return STRING_TABLE_RET_OOM;
+        }
+
+        for (u32 i = 0; i < (u32)source->n_items; i++)
+        {
+            const CDemoStringTables__ItemsT *item = source->items[i];
+            StringTableEntry *entry = &table->entries[i];
+            entry->key_id = STRING_INTERN_ID_NONE;
+            entry->key = nullptr;
+            entry->value = nullptr;
+            entry->value_size = 0;
+            table->entry_count = i + 1;
+
+            if (item->str && !string_table_set_key(tables, table, i, item->str, strlen(item->str)))
+            {
+                return STRING_TABLE_RET_OOM;
+            }
+
+            if (item->has_data && item->data.len > 0)
+            {
+                entry->value = string_tables_store(tables, item->data.data, item->data.len);
+                if (!entry->value)
+                {
+                    return STRING_TABLE_RET_OOM;
+                }
+                entry->value_size = (u32)item->data.len;
+            }
+
+            if (tables->change_handler)
+            {
+                tables->change_handler(tables->change_user_data, tables, table_index, i);
+            }
+        }
+    }
+
+    return STRING_TABLE_RET_OK;
+}
+
+u32 string_tables_find(const StringTables *tables, const char *name)
+{
+    const u32 name_id = string_intern_find(&tables->strings, name, strlen(name));
+    if (name_id == STRING_INTERN_ID_NONE)
+    {
+        return STRING_TABLE_NONE;
+    }
+
+    for (u32 i = 0; i < tables->table_count; i++)
+    {
+        if (tables->tables[i].name_id == name_id)
+        {
+            return i;
+        }
+    }
+    return STRING_TABLE_NONE;
+}
+
+const StringTableEntry *string_table_find_entry(const StringTables *tables, const StringTable *table, const char *key, size_t key_length)
+{
+    const u32 key_id = string_intern_find(&tables->strings, key, key_length);
+    if (key_id == STRING_INTERN_ID_NONE || table->key_slot_capacity == 0)
+    {
+        return nullptr;
+    }
+
+    u32 slot = (key_id * 2654435761u) & (table->key_slot_capacity - 1);
+    while (table->key_slots[slot].key_id != STRING_INTERN_ID_NONE)
+    {
+        if (table->key_slots[slot].key_id == key_id)
+        {
+            const StringTableEntry *entry = &table->entries[table->key_slots[slot].entry_index];
+            //
+            // The slot goes stale when its entry was given another key
+            //
+            return (entry->key_id == key_id) ? entry : nullptr;
+        }
+        slot = (slot + 1) & (table->key_slot_capacity - 1);
+    }
+    return nullptr;
+}
+
+bool string_tables_player_info(const StringTables *tables, u32 player_slot, PlayerInfoView *out_info)
+{
+    const u32 table_index = string_tables_find(tables, "userinfo");
+    if (table_index == STRING_TABLE_NONE)
+    {
+        return false;
+    }
+
+    const StringTable *table = &tables->tables[table_index];
+    if (player_slot >= table->entry_count || !table->entries[player_slot].value)
+    {
+        return false;
+    }
+
+    const StringTableEntry *entry = &table->entries[player_slot];
+    return player_info_view_parse(entry->value, entry->value_size, out_info);
+}
+
+static void string_table_free(StringTable *table)
+{
+    free(table->entries);
+    free(table->key_slots);
+    memset(table, 0, sizeof(*table));
+}
+
+static bool string_table_reserve(StringTable *table, u32 entry_count)
+{
+    if (entry_count <= table->entry_capacity)
+    {
+        return true;
+    }
+
+    u32 new_capacity = (table->entry_capacity) ? table->entry_capacity : STRING_TABLE_INITIAL_ENTRIES;
+    while (new_capacity < entry_count)
+    {
+        new_capacity *= 2;
+    }
+
+    StringTableEntry *new_entries = (StringTableEntry *)realloc(table->entries, new_capacity * sizeof(StringTableEntry));
+    if (!new_entries)
+    {
+        return false;
+    }
+    table->entries = new_entries;
+    table->entry_capacity = new_capacity;
+    return true;
+}
+
+static bool string_table_grow_keys(StringTable *table)
+{
+    const u32 new_capacity = (table->key_slot_capacity) ? table->key_slot_capacity * 2 : STRING_TABLE_INITIAL_ENTRIES * 2;
+    StringTableKeySlot *new_slots = (StringTableKeySlot *)malloc(new_capacity * sizeof(StringTableKeySlot));
+    if (!new_slots)
+    {
+        return false;
+    }
+
+    for (u32 i = 0; i < new_capacity; i++)
+    {
+        new_slots[i].key_id = STRING_INTERN_ID_NONE;
+    }
+
+    for (u32 i = 0; i < table->key_slot_capacity; i++)
+    {
+        const StringTableKeySlot *old_slot = &table->key_slots[i];
+        if (old_slot->key_id == STRING_INTERN_ID_NONE)
+        {
+            continue;
+        }
+
+        u32 slot = (old_slot->key_id * 2654435761u) & (new_capacity - 1);
+        while (new_slots[slot].key_id != STRING_INTERN_ID_NONE)
+        {
+            slot = (slot + 1) & (new_capacity - 1);
+        }
+        new_slots[slot] = *old_slot;
+    }
+
+    free(table->key_slots);
+    table->key_slots = new_slots;
+    table->key_slot_capacity = new_capacity;
+    return true;
+}
+
+static bool string_table_set_key(StringTables *tables, StringTable *table, u32 entry_index, const char *key, size_t key_length)
+{
+    const u32 key_id = string_intern_id(&tables->strings, key, key_length);
+    if (key_id == STRING_INTERN_ID_NONE)
+    {
+        return false;
+    }
+
+    StringTableEntry *entry = &table->entries[entry_index];
+    entry->key_id = key_id;
+    entry->key = string_intern_string(&tables->strings, key_id);
+
+    //
+    // Kept at most half full
+    //
+    if ((table->key_count + 1) * 2 > table->key_slot_capacity && !string_table_grow_keys(table))
+    {
+        return false;
+    }
+
+    u32 slot = (key_id * 2654435761u) & (table->key_slot_capacity - 1);
+    while (table->key_slots[slot].key_id != STRING_INTERN_ID_NONE)
+    {
+        if (table->key_slots[slot].key_id == key_id)
+        {
+            table->key_slots[slot].entry_index = entry_index;
+            return true;
+        }
+        slot = (slot + 1) & (table->key_slot_capacity - 1);
+    }
+
+    table->key_slots[slot].key_id = key_id;
+    table->key_slots[slot].entry_index = entry_index;
+    table->key_count++;
+    return true;
+}
+
+//
+// Each entry starts with its position: the next one, or an explicit index. Then an
+// optional key, either spelled out or as the first size characters of a recent key
+// followed by a suffix, and an optional value
+//
+static int string_table_parse(StringTables *tables, u32 table_index, const u8 *data, size_t size, u32 entry_count)
+{
+    StringTable *table = &tables->tables[table_index];
+    Bitstream stream = bitstream_create(data, size);
+    StringTableKeyHistory history = { 0 };
+    char key[STRING_TABLE_KEY_MAX_LENGTH + 1];
+    i64 index = -1;
+
+    for (u32 i = 0; i < entry_count; i++)
+    {
+        if (bitstream_read_bool(&stream))
+        {
+            index++;
+        }
+        else
+        {
+            index = (i64)bitstream_read_varint32(&stream) + 1;
+        }
+
+        if (stream.overflowed || index < 0 || index >= STRING_TABLE_MAX_ENTRIES)
+        {
+            return STRING_TABLE_RET_MALFORMED;
+        }
+
+        const u32 entry_index = (u32)index;
+        if (!string_table_reserve(table, entry_index + 1))
+        {
+            return STRING_TABLE_RET_OOM;
+        }
+        while (table->entry_count <= entry_index)
+        {
+            StringTableEntry *entry = &table->entries[table->entry_count++];
+            entry->key_id = STRING_INTERN_ID_NONE;
+            entry->key = nullptr;
+            entry->value = nullptr;
+            entry->value_size = 0;
+        }
+
+        if (bitstream_read_bool(&stream))
+        {
+            size_t key_length = 0;
+            if (bitstream_read_bool(&stream))
+            {
+                const u32 position = bitstream_read_u32(&stream, 5);
+                const u32 prefix_length = bitstream_read_u32(&stream, 5);
+
+                u32 previous_length = 0;
+                const char *previous = string_table_key_history_get(&history, position, &previous_length);
+                if (previous)
+                {
+                    key_length = (prefix_length < previous_length) ? prefix_length : previous_length;
+                    memcpy(key, previous, key_length);
+                }
+            }
+            key_length += bitstream_read_string(&stream, key + key_length, sizeof(key) - key_length);
+
+            if (!string_table_set_key(tables, table, entry_index, key, key_length))
+            {
+                return STRING_TABLE_RET_OOM;
+            }
+            string_table_key_history_push(&history, table->entries[entry_index].key, (u32)key_length);
+        }
+
+        if (bitstream_read_bool(&stream))
+        {
+            const int ret_code = string_table_read_value(tables, table, &stream, &table->entries[entry_index]);
+            if (ret_code != STRING_TABLE_RET_OK)
+            {
+                return ret_code;
+            }
+        }
+
+        if (stream.overflowed)
+        {
+            return STRING_TABLE_RET_MALFORMED;
+        }
+
+        if (tables->change_handler)
+        {
+            tables->change_handler(tables->change_user_data, tables, table_index, entry_index);
+        }
+    }
+
+    return STRING_TABLE_RET_OK;
+}
+
+static int string_table_read_value(StringTables *tables, const StringTable *table, Bitstream *stream, StringTableEntry *entry)
+{
+    bool is_compressed = false;
+    u64 bit_count = table->user_data_size_bits;
+    if (!table->user_data_fixed_size)
+    {
+        if (table->flags & STRING_TABLE_FLAG_VALUES_COMPRESSED)
+        {
+            is_compressed = bitstream_read_bool(stream);
+        }
+        bit_count = (u64)((table->using_varint_bitcounts) ? bitstream_read_ubitvar(stream) : bitstream_read_u32(stream, 17)) * 8u;
+    }
+
+    if (bit_count > bitstream_bits_left(stream))
+    {
+        return STRING_TABLE_RET_MALFORMED;
+    }
+
+    const size_t byte_count = (size_t)((bit_count + 7u) / 8u);
+    u8 *value = (u8 *)arena_alloc(&tables->arena, byte_count + 1);
+    if (!value)
+    {
+        return STRING_TABLE_RET_OOM;
+    }
+    bitstream_read_bytes(stream, value, (size_t)(bit_count / 8u));
+    if (bit_count % 8u)
+    {
+        value[byte_count - 1] = (u8)bitstream_read_u32(stream, (u32)(bit_count % 8u));
+    }
+
+    if (!is_compressed)
+    {
+        entry->value = value;
+        entry->value_size = (u32)byte_count;
+        return STRING_TABLE_RET_OK;
+    }
+
+    size_t uncompressed_size = 0;
+    if (snappy_uncompressed_length((const char *)value, byte_count, &uncompressed_size) != SNAPPY_OK)
+    {
+        return STRING_TABLE_RET_DECOMPRESS_ERROR;
+    }
+
+    u8 *uncompressed = (u8 *)arena_alloc(&tables->arena, uncompressed_size + 1);
+    if (!uncompressed)
+    {
+        return STRING_TABLE_RET_OOM;
+    }
+    if (snappy_uncompress((const char *)value, byte_count, (char *)uncompressed, &uncompressed_size) != SNAPPY_OK)
+    {
+        return STRING_TABLE_RET_DECOMPRESS_ERROR;
+    }
+
+    entry->value = uncompressed;
+    entry->value_size = (u32)uncompressed_size;
+    return STRING_TABLE_RET_OK;
+}
+
+static const u8 *string_tables_store(StringTables *tables, const u8 *data, size_t size)
+{
+    u8 *copy = (u8 *)arena_alloc(&tables->arena, size + 1);
+    if (copy)
+    {
+        memcpy(copy, data, size);
+    }
+    return copy;
+}
+
+static void string_table_key_history_push(StringTableKeyHistory *history, const char *key, u32 length)
+{
+    const u32 slot = (history->start + history->count) % STRING_TABLE_KEY_HISTORY;
+    history->keys[slot] = key;
+    history->lengths[slot] = length;
+    if (history->count < STRING_TABLE_KEY_HISTORY)
+    {
+        history->count++;
+    }
+    else
+    {
+        history->start = (history->start + 1) % STRING_TABLE_KEY_HISTORY;
+    }
+}
+
+//
+// position counts from the oldest key still remembered
+//
+static const char *string_table_key_history_get(const StringTableKeyHistory *history, u32 position, u32 *out_length)
+{
+    if (position >= history->count)
+    {
+        return nullptr;
+    }
+
+    const u32 slot = (history->start + position) % STRING_TABLE_KEY_HISTORY;
+    *out_length = history->lengths[slot];
+    return history->keys[slot];
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+//
+// String tables. svc_CreateStringTable creates a table along with its first entries,
+// svc_UpdateStringTable changes entries of an existing one and a full packet carries a
+// snapshot of every table. Entries are a key and an optional binary value, both packed
+// in a bitstream where keys are usually encoded as a prefix of one of the last
+// STRING_TABLE_KEY_HISTORY keys plus a suffix.
+//
+// Table names and keys are interned and looked up by ID, values are copied into an
+// arena that lives as long as the demo. Replaced values aren't reclaimed, tables only
+// change a few hundred times over a whole match.
+//
+
+#include "common.h"
+#include "arena.h"
+#include "string_intern.h"
+#include "message_views.h"
+
+#include "protos/demo.pb-c.h"
+
+#define STRING_TABLE_MAX_COUNT 64
+#define STRING_TABLE_MAX_ENTRIES (1 << 16)
+#define STRING_TABLE_KEY_HISTORY 32
+#define STRING_TABLE_KEY_MAX_LENGTH 1024
+
+//
+// Set in CSVCMsg_CreateStringTable.flags when entry values may be snappy compressed
+//
+#define STRING_TABLE_FLAG_VALUES_COMPRESSED 1
+
+#define STRING_TABLE_NONE 0xFFFFFFFFu
+
+#define STRING_TABLE_RET_OK 0
+#define STRING_TABLE_RET_OOM 1
+#define STRING_TABLE_RET_MALFORMED 2
+#define STRING_TABLE_RET_DECOMPRESS_ERROR 3
+#define STRING_TABLE_RET_UNKNOWN_TABLE 4
+
+typedef struct
+{
+    //
+    // STRING_INTERN_ID_NONE for entries without a key, or slots never written
+    //
+    u32 key_id;
+    const char *key;
+    const u8 *value;
+    u32 value_size;
+} StringTableEntry;
+
+typedef struct
+{
+    u32 key_id;
+    u32 entry_index;
+} StringTableKeySlot;
+
+typedef struct
+{
+    const char *name;
+    u32 name_id;
+
+    bool user_data_fixed_size;
+    u32 user_data_size_bits;
+    i32 flags;
+    bool using_varint_bitcounts;
+
+    StringTableEntry *entries;
+    u32 entry_count;
+    u32 entry_capacity;
+
+    //
+    // Key ID to entry index, open addressing. Free slots have a key_id of STRING_INTERN_ID_NONE
+    //
+    StringTableKeySlot *key_slots;
+    u32 key_slot_capacity;
+    u32 key_count;
+} StringTable;
+
+typedef struct StringTables StringTables;
+
+//
+// Called after an entry was created or changed
+//
+typedef void (*StringTableChangeHandler)(void *user_data, const StringTables *tables, u32 table_index, u32 entry_index);
+
+struct StringTables
+{
+    Arena arena;
+    StringIntern strings;
+
+    //
+    // In creation order, which is the table ID svc_UpdateStringTable refers to
+    //
+    StringTable tables[STRING_TABLE_MAX_COUNT];
+    u32 table_count;
+
+    //
+    // Decompressed string data of compressed tables
+    //
+    u8 *scratch;
+    size_t scratch_size;
+
+    StringTableChangeHandler change_handler;
+    void *change_user_data;
+};
+
+void string_tables_init(StringTables *tables);
+void string_tables_free(StringTables *tables);
+
+//
+// Drops every table, for svc_ClearAllStringTables
+//
+void string_tables_clear(StringTables *tables);
+
+void string_tables_set_change_handler(StringTables *tables, StringTableChangeHandler handler, void *user_data);
+
+int string_tables_create(StringTables *tables, const CreateStringTableView *view);
+int string_tables_update(StringTables *tables, const UpdateStringTableView *view);
+
+//
+// Replaces the entries of every table in snapshot that already exists, for seeking to
+// a full packet
+//
+int string_tables_apply_snapshot(StringTables *tables, const CDemoStringTables *snapshot);
+
+u32 string_tables_find(const StringTables *tables, const char *name);
+
+//
+// Entry with key, nullptr when there is none
+//
+const StringTableEntry *string_table_find_entry(const StringTables *tables, const StringTable *table, const char *key, size_t key_length);
+
+//
+// userinfo entry of a player slot. The view borrows the table's copy of the value
+//
+bool string_tables_player_info(const StringTables *tables, u32 player_slot, PlayerInfoView *out_info);
@@ -0,0 +1,201 @@
+#pragma once
+
+//
+// Minimal protobuf wire format scanner. Walks the fields of an encoded message and
+// hands out borrowed views into the original buffer, so a single field can be pulled
+// out of a message without a protobuf-c unpack and its allocations.
+//
+
+#include <string.h>
+
+#include "common.h"
+
+#define WIRE_TYPE_VARINT 0
+#define WIRE_TYPE_FIXED64 1
+#define WIRE_TYPE_LENGTH_DELIMITED 2
+#define WIRE_TYPE_START_GROUP 3
+#define WIRE_TYPE_END_GROUP 4
+#define WIRE_TYPE_FIXED32 5
+
+//
+// Borrowed view, only valid while the message buffer is
+//
+typedef struct
+{
+    const u8 *data;
+    size_t size;
+} WireBytes;
+
+typedef struct
+{
+    u32 number;
+    u32 wire_type;
+    //
+    // Varint and fixed width values
+    //
+    u64 value;
+    //
+    // Length delimited values
+    //
+    WireBytes bytes;
+} WireField;
+
+typedef struct
+{
+    const u8 *data;
+    size_t size;
+    size_t pos;
+    bool malformed;
+} WireReader;
+
+static inline WireReader wire_reader_create(const u8 *data, size_t size)
+{
+    WireReader result = { data, size, 0, false };
+    return result;
+}
+
+static inline bool wire_read_varint(WireReader *reader, u64 *out_value)
+{
+    u64 result = 0;
+    for (u32 shift = 0; shift < 70; shift += 7)
+    {
+        if (reader->pos >= reader->size)
+        {
+            reader->malformed = true;
+            return false;
+        }
+        const u8 byte = reader->data[reader->pos++];
+        result |= (u64)(byte & 0x7Fu) << shift;
+        if (!(byte & 0x80u))
+        {
+            *out_value = result;
+            return true;
+        }
+    }
+    reader->malformed = true;
+    return false;
+}
+
+static inline bool wire_read_fixed(WireReader *reader, u32 byte_count, u64 *out_value)
+{
+    if (reader->size - reader->pos < byte_count)
+    {
+        reader->malformed = true;
+        return false;
+    }
+
+    u64 result = 0;
+    for (u32 i = 0; i < byte_count; i++)
+    {
+        result |= (u64)reader->data[reader->pos + i] << (8u * i);
+    }
+    reader->pos += byte_count;
+    *out_value = result;
+    return true;
+}
+
+//
+// Returns false at the end of the message or when it's malformed (reader->malformed)
+//
+static inline bool wire_reader_next(WireReader *reader, WireField *out_field)
+{
+    if (reader->pos >= reader->size || reader->malformed)
+    {
+        return false;
+    }
+
+    u64 tag = 0;
+    if (!wire_read_varint(reader, &tag))
+    {
+        return false;
+    }
+
+    out_field->number = (u32)(tag >> 3);
+    out_field->wire_type = (u32)(tag & 7u);
+    out_field->value = 0;
+    out_field->bytes.data = nullptr;
+    out_field->bytes.size = 0;
+
+    switch (out_field->wire_type)
+    {
+    case WIRE_TYPE_VARINT:
+        return wire_read_varint(reader, &out_field->value);
+    case WIRE_TYPE_FIXED64:
+        return wire_read_fixed(reader, 8, &out_field->value);
+    case WIRE_TYPE_FIXED32:
+        return wire_read_fixed(reader, 4, &out_field->value);
+    case WIRE_TYPE_LENGTH_DELIMITED:
+    {
+        u64 length = 0;
+        if (!wire_read_varint(reader, &length))
+        {
+            return false;
+        }
+        if (length > reader->size - reader->pos)
+        {
+            reader->malformed = true;
+            return false;
+        }
+        out_field->bytes.data = reader->data + reader->pos;
+        out_field->bytes.size = (size_t)length;
+        reader->pos += (size_t)length;
+        return true;
+    }
+    default:
+        //
+        // Groups are long deprecated and none of the demo messages use them
+        //
+        reader->malformed = true;
+        return false;
+    }
+}
+
+//
+// Finds a singular length delimited field. As with protobuf, the last occurrence wins
+//
+static inline bool wire_find_bytes(const u8 *data, size_t size, u32 field_number, WireBytes *out_bytes)
+{
+    WireReader reader = wire_reader_create(data, size);
+    WireField field;
+    bool found = false;
+
+    while (wire_reader_next(&reader, &field))
+    {
+        if (field.number == field_number && field.wire_type == WIRE_TYPE_LENGTH_DELIMITED)
+        {
+            *out_bytes = field.bytes;
+            found = true;
+        }
+    }
+
+    return found && !reader.malformed;
+}
+
+static inline bool wire_find_varint(const u8 *data, size_t size, u32 field_number, u64 *out_value)
+{
+    WireReader reader = wire_reader_create(data, size);
+    WireField field;
+    bool found = false;
+
+    while (wire_reader_next(&reader, &field))
+    {
+        if (field.number == field_number && field.wire_type == WIRE_TYPE_VARINT)
+        {
+            *out_value = field.value;
+            found = true;
+        }
+    }
+
+    return found && !reader.malformed;
+}
+
+//
+// Decodes a float stored as fixed32
+//
+static inline f32 wire_value_to_f32(u64 value)
+{
+    const u32 bits = (u32)value;
+    f32 result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}